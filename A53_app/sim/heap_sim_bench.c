@@ -0,0 +1,512 @@
+/* heap_sim_bench.c - host benchmark / regression check for the A53 heap
+   Replays the same allocation traces against the BSP's heap_4 on its own
+   (pvHeap4Malloc/vHeap4Free) and against the fixed block pools in front of
+   it (pvPortMalloc/vPortFree, heap_pool.c), both in the 64 KiB
+   configTOTAL_HEAP_SIZE of the target:
+     - msg:     messages queued between tasks - telemetry, commands, R5
+                replies, log lines - freed in order per stream but interleaved
+                across streams, plus a few long-held bulk buffers
+     - objects: kernel objects created and deleted at random: tasks (stack +
+                TCB), queues, semaphores, software timers, event groups
+     - burst:   bursts of small deferred-work messages freed out of order,
+                with long-lived session buffers allocated in between
+   Reports failed allocations, host time per malloc/free (mean, p99, max;
+   each trace is replayed -r times and every op keeps its fastest time, so
+   host preemption does not show up as allocator latency) and heap_4
+   fragmentation over the run; for the pools also spills,
+   fallbacks to heap_4 and per-class high-water marks. Every block is filled
+   and checked before it is freed, and each run must hand back all memory.
+   Exit status is non-zero if any check failed.
+
+   usage: heap_sim_bench [-n ops] [-s seed] [-r reps] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "heap_pool.h"
+
+#define BENCH_DEFAULT_OPS   200000
+#define BENCH_DEFAULT_REPS  5
+#define BENCH_MAX_SLOTS     4096
+#define BENCH_FRAG_EVERY    64      /* ops between heap_4 fragmentation samples */
+
+/* approximate sizes of the A53 kernel objects (FreeRTOS 10.6.1, 64-bit) */
+#define OBJ_TCB             272
+#define OBJ_QUEUE           168     /* Queue_t; storage follows in the same block */
+#define OBJ_TIMER           96
+#define OBJ_EVENT_GROUP     56
+
+typedef struct {
+    uint32_t slot;
+    uint32_t size;                  /* 0: free the slot */
+} op_t;
+
+typedef struct {
+    const char *name;
+    void *(*alloc)(size_t);
+    void (*release)(void *);
+} allocator_t;
+
+typedef struct {
+    uint32_t allocs, frees, failed;
+    uint64_t alloc_ns, free_ns;
+    uint32_t alloc_p99, alloc_max, free_p99, free_max;
+    uint32_t frag_max;              /* per mille, heap_4 free space outside the largest block */
+    size_t min_largest;             /* smallest "largest free block" seen */
+    size_t end_free;
+} run_result_t;
+
+/* pool counters over the first replay of a trace */
+typedef struct {
+    size_t hits, spills, fallbacks, large;
+    uint64_t granted, requested;
+} pool_delta_t;
+
+static const allocator_t heap4_only = { "heap_4", pvHeap4Malloc, vHeap4Free };
+static const allocator_t with_pools = { "pools", pvPortMalloc, vPortFree };
+
+static op_t *trace;
+static uint32_t trace_len, trace_cap;
+static uint32_t free_slots[BENCH_MAX_SLOTS], num_free_slots;
+static void *ptrs[BENCH_MAX_SLOTS];
+static uint32_t sizes[BENCH_MAX_SLOTS];
+static uint32_t *alloc_samples, *free_samples;
+static uint64_t timer_overhead;
+
+static uint32_t rng_state = 1;
+static int failures = 0;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi)
+{
+    return lo + rng() % (hi - lo + 1);
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/* ---- trace building ---- */
+
+static void trace_reset(void)
+{
+    trace_len = 0;
+    num_free_slots = BENCH_MAX_SLOTS;
+    for (uint32_t i = 0; i < BENCH_MAX_SLOTS; ++i) {
+        free_slots[i] = BENCH_MAX_SLOTS - 1 - i;
+    }
+}
+
+static void emit(uint32_t slot, uint32_t size)
+{
+    if (trace_len == trace_cap) {
+        trace_cap = trace_cap ? trace_cap * 2 : 1024;
+        trace = realloc(trace, trace_cap * sizeof(*trace));
+        if (!trace) {
+            perror("trace");
+            exit(2);
+        }
+    }
+    trace[trace_len].slot = slot;
+    trace[trace_len].size = size;
+    trace_len++;
+}
+
+static uint32_t emit_alloc(uint32_t size)
+{
+    uint32_t slot = free_slots[--num_free_slots];
+    emit(slot, size);
+    return slot;
+}
+
+static void emit_free(uint32_t slot)
+{
+    emit(slot, 0);
+    free_slots[num_free_slots++] = slot;
+}
+
+/* one FIFO per message stream: producers allocate, the consumer frees the oldest */
+#define MSG_MAX_DEPTH 64
+
+typedef struct {
+    uint16_t min, max;              /* message size */
+    uint16_t depth;                 /* queue length */
+    uint16_t weight;                /* share of the traffic */
+    uint16_t hold;                  /* ops a message is held before it may be consumed */
+} msg_stream_t;
+
+static const msg_stream_t msg_streams[] = {
+    { 24, 40, 64, 40, 0 },          /* telemetry samples */
+    { 48, 96, 8, 10, 0 },           /* commands */
+    { 16, 240, 32, 25, 0 },         /* R5 replies: rpu_bench small and large */
+    { 64, 200, 48, 20, 0 },         /* log lines */
+    { 1024, 4096, 3, 5, 400 },      /* bulk transfer buffers */
+};
+#define MSG_STREAMS (sizeof(msg_streams) / sizeof(msg_streams[0]))
+
+static void build_msg(uint32_t ops)
+{
+    struct { uint32_t slot[MSG_MAX_DEPTH], born[MSG_MAX_DEPTH]; uint32_t head, count; } q[MSG_STREAMS];
+    uint32_t total_weight = 0;
+
+    memset(q, 0, sizeof(q));
+    for (uint32_t s = 0; s < MSG_STREAMS; ++s) total_weight += msg_streams[s].weight;
+
+    while (trace_len < ops) {
+        uint32_t pick = rng() % total_weight, s = 0;
+        while (pick >= msg_streams[s].weight) pick -= msg_streams[s++].weight;
+        const msg_stream_t *st = &msg_streams[s];
+
+        int produce = q[s].count == 0 ||
+                      (q[s].count < st->depth && (rng() & 1));
+        if (!produce && trace_len - q[s].born[q[s].head] < st->hold) {
+            continue;
+        }
+        if (produce) {
+            uint32_t tail = (q[s].head + q[s].count) % MSG_MAX_DEPTH;
+            q[s].slot[tail] = emit_alloc(rng_range(st->min, st->max));
+            q[s].born[tail] = trace_len;
+            q[s].count++;
+        } else {
+            emit_free(q[s].slot[q[s].head]);
+            q[s].head = (q[s].head + 1) % MSG_MAX_DEPTH;
+            q[s].count--;
+        }
+    }
+    for (uint32_t s = 0; s < MSG_STREAMS; ++s) {
+        for (; q[s].count; q[s].count--, q[s].head = (q[s].head + 1) % MSG_MAX_DEPTH) {
+            emit_free(q[s].slot[q[s].head]);
+        }
+    }
+}
+
+#define OBJ_MAX_LIVE 48
+
+static void build_objects(uint32_t ops)
+{
+    struct { uint32_t slot[2]; uint8_t parts; } live[OBJ_MAX_LIVE];
+    uint32_t n = 0, target = OBJ_MAX_LIVE / 2;
+
+    while (trace_len < ops) {
+        if ((rng() & 15) == 0) target = rng_range(8, OBJ_MAX_LIVE);
+
+        if (n < target) {
+            uint32_t kind = rng() % 10;
+            live[n].parts = 1;
+            if (kind < 2) {
+                /* xTaskCreate(): the stack, then the TCB */
+                live[n].slot[0] = emit_alloc(rng_range(200, 400) * 8);
+                live[n].slot[1] = emit_alloc(OBJ_TCB);
+                live[n].parts = 2;
+            } else if (kind < 5) {
+                live[n].slot[0] = emit_alloc(OBJ_QUEUE + rng_range(4, 16) * rng_range(1, 4) * 8);
+            } else if (kind < 7) {
+                live[n].slot[0] = emit_alloc(OBJ_QUEUE);        /* semaphore / mutex */
+            } else if (kind < 9) {
+                live[n].slot[0] = emit_alloc(OBJ_TIMER);
+            } else {
+                live[n].slot[0] = emit_alloc(OBJ_EVENT_GROUP);
+            }
+            n++;
+        } else {
+            uint32_t victim = rng() % n;
+            for (uint32_t p = 0; p < live[victim].parts; ++p) emit_free(live[victim].slot[p]);
+            live[victim] = live[--n];
+        }
+    }
+    while (n) {
+        n--;
+        for (uint32_t p = 0; p < live[n].parts; ++p) emit_free(live[n].slot[p]);
+    }
+}
+
+#define BURST_MAX       48
+#define BURST_SESSIONS  16
+
+static void build_burst(uint32_t ops)
+{
+    uint32_t burst[BURST_MAX], session[BURST_SESSIONS], sessions = 0;
+
+    while (trace_len < ops) {
+        uint32_t len = rng_range(8, BURST_MAX);
+
+        for (uint32_t i = 0; i < len; ++i) {
+            burst[i] = emit_alloc(rng_range(16, 128));
+            if ((rng() & 63) == 0) {
+                if (sessions == BURST_SESSIONS) {
+                    uint32_t victim = rng() % sessions;
+                    emit_free(session[victim]);
+                    session[victim] = session[--sessions];
+                }
+                session[sessions++] = emit_alloc(rng_range(256, 512));
+            }
+        }
+        /* consumers finish in any order */
+        while (len) {
+            uint32_t i = rng() % len;
+            emit_free(burst[i]);
+            burst[i] = burst[--len];
+        }
+    }
+    while (sessions) emit_free(session[--sessions]);
+}
+
+/* ---- replay ---- */
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t elapsed(uint64_t t0, uint64_t t1)
+{
+    uint64_t d = t1 - t0;
+    d = d > timer_overhead ? d - timer_overhead : 0;
+    return d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+}
+
+static void calibrate(void)
+{
+    timer_overhead = UINT64_MAX;
+    for (int i = 0; i < 10000; ++i) {
+        uint64_t t0 = host_ns(), t1 = host_ns();
+        if (t1 - t0 < timer_overhead) timer_overhead = t1 - t0;
+    }
+}
+
+static void sample_frag(run_result_t *r)
+{
+    HeapStats_t hs;
+
+    vPortGetHeapStats(&hs);
+    if (hs.xAvailableHeapSpaceInBytes) {
+        uint32_t frag = (uint32_t)(1000 - (uint64_t)hs.xSizeOfLargestFreeBlockInBytes * 1000 /
+                                          hs.xAvailableHeapSpaceInBytes);
+        if (frag > r->frag_max) r->frag_max = frag;
+    }
+    if (hs.xSizeOfLargestFreeBlockInBytes < r->min_largest) {
+        r->min_largest = hs.xSizeOfLargestFreeBlockInBytes;
+    }
+}
+
+static void keep_min(uint32_t *slot, uint32_t ns, int first)
+{
+    if (first || ns < *slot) *slot = ns;
+}
+
+/* first replay counts and samples fragmentation, later ones only refine times */
+static void replay(const allocator_t *a, run_result_t *r, int first)
+{
+    uint32_t allocs = 0, frees = 0;
+
+    if (first) {
+        memset(r, 0, sizeof(*r));
+        r->min_largest = SIZE_MAX;
+    }
+    memset(ptrs, 0, sizeof(ptrs));
+
+    for (uint32_t i = 0; i < trace_len; ++i) {
+        const op_t *op = &trace[i];
+        uint64_t t0, t1;
+
+        if (op->size) {
+            t0 = host_ns();
+            void *p = a->alloc(op->size);
+            t1 = host_ns();
+            keep_min(&alloc_samples[allocs++], elapsed(t0, t1), first);
+            ptrs[op->slot] = p;
+            sizes[op->slot] = op->size;
+            if (!p) {
+                if (first) r->failed++;
+                continue;
+            }
+            check(((uintptr_t)p & portBYTE_ALIGNMENT_MASK) == 0, "block alignment");
+            memset(p, (int)(op->slot & 0xFF), op->size);
+        } else {
+            unsigned char *p = ptrs[op->slot];
+            if (!p) continue;
+            for (uint32_t b = 0; b < sizes[op->slot]; ++b) {
+                if (p[b] != (op->slot & 0xFF)) {
+                    check(0, "block contents overwritten while allocated");
+                    break;
+                }
+            }
+            t0 = host_ns();
+            a->release(p);
+            t1 = host_ns();
+            keep_min(&free_samples[frees++], elapsed(t0, t1), first);
+            ptrs[op->slot] = NULL;
+        }
+        if (first && (i % BENCH_FRAG_EVERY) == 0) sample_frag(r);
+    }
+    r->allocs = allocs;
+    r->frees = frees;
+    r->end_free = xPortGetFreeHeapSize();
+}
+
+static void summarise(run_result_t *r)
+{
+
+    for (uint32_t i = 0; i < r->allocs; ++i) r->alloc_ns += alloc_samples[i];
+    for (uint32_t i = 0; i < r->frees; ++i) r->free_ns += free_samples[i];
+    qsort(alloc_samples, r->allocs, sizeof(uint32_t), cmp_u32);
+    qsort(free_samples, r->frees, sizeof(uint32_t), cmp_u32);
+    if (r->allocs) {
+        r->alloc_p99 = alloc_samples[(uint64_t)r->allocs * 99 / 100];
+        r->alloc_max = alloc_samples[r->allocs - 1];
+    }
+    if (r->frees) {
+        r->free_p99 = free_samples[(uint64_t)r->frees * 99 / 100];
+        r->free_max = free_samples[r->frees - 1];
+    }
+}
+
+static void print_result(const char *trace_name, const allocator_t *a, const run_result_t *r)
+{
+    printf("  %-8s %-7s %7u allocs %5u failed  malloc %4llu/%5u/%6u ns  free %4llu/%5u/%6u ns"
+           "  frag max %3u.%u%%  min largest %5zu\n",
+           trace_name, a->name, r->allocs, r->failed,
+           (unsigned long long)(r->allocs ? r->alloc_ns / r->allocs : 0), r->alloc_p99, r->alloc_max,
+           (unsigned long long)(r->frees ? r->free_ns / r->frees : 0), r->free_p99, r->free_max,
+           r->frag_max / 10, r->frag_max % 10, r->min_largest);
+}
+
+static void pool_totals(pool_delta_t *d)
+{
+    HeapPoolStats_t ps;
+
+    vPortGetHeapPoolStats(&ps);
+    memset(d, 0, sizeof(*d));
+    d->fallbacks = ps.xFallbackAllocations;
+    d->large = ps.xLargeAllocations;
+    for (UBaseType_t c = 0; c < ps.uxClasses; ++c) {
+        d->hits += ps.xClass[c].xAllocations;
+        d->spills += ps.xClass[c].xSpills;
+        d->granted += (uint64_t)ps.xClass[c].xAllocations * ps.xClass[c].xBlockSize;
+        d->requested += ps.xClass[c].ullRequestedBytes;
+    }
+}
+
+static void print_pool_delta(const pool_delta_t *before, const pool_delta_t *after)
+{
+    uint64_t granted = after->granted - before->granted;
+    uint64_t waste = granted ? (granted - (after->requested - before->requested)) * 1000 / granted : 0;
+
+    printf("  %-8s %-7s %7zu from pools (%zu spilled up a class), %zu fallbacks and %zu large to heap_4,"
+           " internal frag %u.%u%%\n", "", "",
+           after->hits - before->hits, after->spills - before->spills,
+           after->fallbacks - before->fallbacks, after->large - before->large,
+           (unsigned)(waste / 10), (unsigned)(waste % 10));
+}
+
+static void print_pool_stats(void)
+{
+    HeapPoolStats_t ps;
+
+    vPortGetHeapPoolStats(&ps);
+    printf("  pools: %zu bytes carved from heap_4, high-water over all traces:\n", ps.xPoolBytes);
+    for (UBaseType_t c = 0; c < ps.uxClasses; ++c) {
+        const HeapPoolClassStats_t *cs = &ps.xClass[c];
+        printf("    %4zu B x %3zu: high-water %3zu, %8zu allocs, %6zu spills, in use %zu\n",
+               cs->xBlockSize, cs->xBlocks, cs->xMaxBlocksInUse, cs->xAllocations,
+               cs->xSpills, cs->xBlocksInUse);
+        check(cs->xBlocksInUse == 0, "pool blocks left in use after a trace");
+        check(cs->xAllocations == cs->xFrees, "pool allocations and frees differ");
+    }
+    check(ps.uxClasses > 0, "pools carved from the heap");
+}
+
+typedef void (*build_fn)(uint32_t ops);
+
+static const struct { const char *name; build_fn build; } traces[] = {
+    { "msg", build_msg },
+    { "objects", build_objects },
+    { "burst", build_burst },
+};
+#define NUM_TRACES (sizeof(traces) / sizeof(traces[0]))
+
+int main(int argc, char **argv)
+{
+    uint32_t ops = BENCH_DEFAULT_OPS, reps = BENCH_DEFAULT_REPS, seed;
+    run_result_t results[2][NUM_TRACES];
+    pool_delta_t pool_before[NUM_TRACES], pool_after[NUM_TRACES];
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            ops = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            rng_state = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            reps = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [-n ops] [-s seed] [-r reps]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (ops < 100) ops = 100;
+    if (reps == 0) reps = 1;
+    seed = rng_state;
+
+    /* room for the trace plus the frees that drain it */
+    alloc_samples = malloc((ops + BENCH_MAX_SLOTS) * sizeof(uint32_t));
+    free_samples = malloc((ops + BENCH_MAX_SLOTS) * sizeof(uint32_t));
+    if (!alloc_samples || !free_samples) {
+        perror("samples");
+        return 2;
+    }
+    calibrate();
+    printf("heap %zu bytes, %u ops per trace, seed %u, best of %u replays, timer overhead %llu ns removed\n",
+           (size_t)configTOTAL_HEAP_SIZE, ops, seed, reps, (unsigned long long)timer_overhead);
+    printf("  (malloc/free: mean/p99/max host ns; frag: heap_4 free space outside its largest block)\n");
+
+    /* heap_4 on its own first: the pools take their region from heap_4 on the
+       first pvPortMalloc() and keep it */
+    for (uint32_t a = 0; a < 2; ++a) {
+        const allocator_t *al = a ? &with_pools : &heap4_only;
+        for (uint32_t t = 0; t < NUM_TRACES; ++t) {
+            rng_state = seed + t;
+            trace_reset();
+            traces[t].build(ops);
+            for (uint32_t rep = 0; rep < reps; ++rep) {
+                if (a && rep == 0) pool_totals(&pool_before[t]);
+                replay(al, &results[a][t], rep == 0);
+                if (a && rep == 0) pool_totals(&pool_after[t]);
+            }
+            summarise(&results[a][t]);
+            check(results[a][t].allocs == results[a][t].frees + results[a][t].failed,
+                  "every allocation freed");
+            check(results[a][t].end_free == results[a][0].end_free, "heap returns to its starting free size");
+        }
+    }
+
+    for (uint32_t t = 0; t < NUM_TRACES; ++t) {
+        print_result(traces[t].name, &heap4_only, &results[0][t]);
+        print_result(traces[t].name, &with_pools, &results[1][t]);
+        print_pool_delta(&pool_before[t], &pool_after[t]);
+    }
+    print_pool_stats();
+
+    free(trace);
+    free(alloc_samples);
+    free(free_samples);
+    printf("%s (%d failed checks)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+/* FreeRTOS.h - host stand-in: just enough of the kernel configuration and
+   portable.h for MemMang/heap_4.c and heap_pool.c to build on x86-64. The
+   heap and pool sizes match the A53 BSP (FreeRTOSConfig.h) */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint64_t TickType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define portMAX_DELAY           ((TickType_t)0xffffffffffffffffULL)
+#define portBYTE_ALIGNMENT      16
+#define portBYTE_ALIGNMENT_MASK 0x000f
+#define portPOINTER_SIZE_TYPE   uint64_t
+
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+#define configAPPLICATION_ALLOCATED_HEAP 0
+#define configUSE_MALLOC_FAILED_HOOK     0  /* the bench counts failures itself */
+#define configTOTAL_HEAP_SIZE            ((size_t)65536)
+#define configUSE_HEAP_POOLS             1
+#define configASSERT(x)                  assert(x)
+
+#define PRIVILEGED_DATA
+#define PRIVILEGED_FUNCTION
+#define mtCOVERAGE_TEST_MARKER()
+#define traceMALLOC(pv, size)
+#define traceFREE(pv, size)
+
+typedef struct xHeapStats {
+    size_t xAvailableHeapSpaceInBytes;
+    size_t xSizeOfLargestFreeBlockInBytes;
+    size_t xSizeOfSmallestFreeBlockInBytes;
+    size_t xNumberOfFreeBlocks;
+    size_t xMinimumEverFreeBytesRemaining;
+    size_t xNumberOfSuccessfulAllocations;
+    size_t xNumberOfSuccessfulFrees;
+} HeapStats_t;
+
+void vPortGetHeapStats(HeapStats_t *pxHeapStats);
+void *pvPortMalloc(size_t xSize);
+void *pvPortCalloc(size_t xNum, size_t xSize);
+void vPortFree(void *pv);
+void vPortInitialiseBlocks(void);
+size_t xPortGetFreeHeapSize(void);
+size_t xPortGetMinimumEverFreeHeapSize(void);
+
+#endif
@@ -0,0 +1,18 @@
+/* task.h - host stand-in: the bench is single threaded, so suspending the
+   scheduler and critical sections are no-ops */
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+static inline void vTaskSuspendAll(void)
+{
+}
+
+static inline BaseType_t xTaskResumeAll(void)
+{
+    return pdFALSE;
+}
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif
@@ -1,55 +1,218 @@
 /********************************************************************************************
- * Dual ARM core Hello World
+ * Dual ARM core aperture tuner - APU controller
  * Aouther: FPGAPS
  * Date: 12/DEC/2024
- * ARM0: A53_0 FreeRTOS
+ * ARM0: A53_0 FreeRTOS, drives the R5 tuner over the shared-memory command rings
  ********************************************************************************************/
 
 #include "xparameters.h"
-#include "xil_io.h"
-#include "sleep.h"
+#include "xil_printf.h"
+#include "xstatus.h"
+#include "xiltimer.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rpu_ctrl.h"
+#include "rpu_bench.h"
+#include "apu_smp.h"
+#include "smp_bench.h"
+#include "rt_prof.h"
+#if configUSE_HEAP_POOLS == 1
+#include "heap_pool.h"
+#endif
 
-/********************************************************************************************
- * Address of AXI GPIOs here, you can find them in xparameters.h or in Vivado address editor *
- ********************************************************************************************/
-// #define LED_GPIO_ADDR        XPAR_ARM0_LED_CONTROL_BASEADDR //0xA0000000
-// #define PUSHBUTTON_GPIO_ADDR XPAR_ARM0_SWITCH_BASEADDR  //0xA0010000
-
-/*********************************
- * Amount of delay in loop in us *
- *********************************/
-// #define loop_delay_us 250000
-#define loop_delay_us 1000000
-
-int main() {
-	// u32 pushbutton_state;
-	// u32 led_state = 0; // Initially, LED is off
-	xil_printf("\r\n ******************* ARM0: A53_0 ****************.\r\n");
-	xil_printf(
-			" ARM0 A53_0: Polling pushbutton for LED control and message display.\r\n");
-	xil_printf("*****************************************************.\r\n");
-	u32 counter = 0;
-	while (1) {
-		// Read the pushbutton state
-		//pushbutton_state = Xil_In32(PUSHBUTTON_GPIO_ADDR);
+/*****************************************************************************
+ * Benchmark mode: round-trip throughput/latency to the R5 at boot, then the *
+ * controller keeps running. 0 = skip.                                       *
+ *****************************************************************************/
+#ifndef RPU_BENCH_ENABLE
+#define RPU_BENCH_ENABLE	1
+#endif
+#define RPU_BENCH_COUNT		10000
+#define RPU_BENCH_SMALL_LEN	16
+#define RPU_BENCH_LARGE_LEN	224
+
+/* A53 cores 1-3 run apu_smp jobs; scaling benchmark at boot. 0 = skip. */
+#ifndef SMP_BENCH_ENABLE
+#define SMP_BENCH_ENABLE	1
+#endif
+
+/* seconds between controller stats reports */
+#define STATS_PERIOD_S		10
 
-		// Check if the pushbutton is pressed (assuming active-high logic)
-		// if (pushbutton_state != 0) {
-			// Toggle the LED state
-			// led_state ^= 1;
-			// Xil_Out32(LED_GPIO_ADDR, led_state);
+/* task/IRQ profile with each stats report; 2 = also the binary snapshot as hex */
+#ifndef RT_PROF_REPORT
+#define RT_PROF_REPORT		1
+#endif
 
-			// Print "Hello World"
-			xil_printf("%d-Hello\r\n",counter);
-			counter++;
+/* R5 deferred log (dlog) printed by the A53 instead of the R5 idle hook. 0 = leave it on the R5. */
+#ifndef RPU_LOG_ON_APU
+#define RPU_LOG_ON_APU		1
+#endif
+#define LOG_POLL_MS		20
+#define LOG_BATCH		32
 
-		// } else {
-			//turn off the LED if push button is not pressed
-			// Xil_Out32(LED_GPIO_ADDR, 0);
-		// }
-		// Add a small delay in our loop
-		usleep(loop_delay_us);
+#define CTRL_TASK_PRIORITY	(tskIDLE_PRIORITY + 2)
+#define CTRL_TASK_STACK		(configMINIMAL_STACK_SIZE * 4)
+#define LOG_TASK_PRIORITY	(tskIDLE_PRIORITY + 1)
+#define LOG_TASK_STACK		(configMINIMAL_STACK_SIZE * 2)
+
+static void print_stats(void)
+{
+	rpu_ctrl_stats_t st;
+	uint32_t avg;
+
+	rpu_ctrl_get_stats(&st);
+	avg = st.completed ? (uint32_t)(st.rtt_total / st.completed / (COUNTS_PER_SECOND / 1000000U)) : 0;
+	xil_printf("rpu_ctrl: %d sent, %d done, %d err, %d timeout, %d stray, %d queue full, "
+		   "%d doorbells, %d irqs, max inflight %d, avg rtt %d us\r\n",
+		   (int)st.submitted, (int)st.completed, (int)st.errors, (int)st.timeouts,
+		   (int)st.stray, (int)st.queue_full, (int)st.doorbells, (int)st.irqs,
+		   (int)st.max_inflight, (int)avg);
+}
+
+/* R5 retune latency (GPIO edge -> last expander ACK) */
+static void print_switch_stats(void)
+{
+	rpu_ctrl_switch_stats_t st;
+	int32_t rc = rpu_ctrl_switch_stats(&st, NULL, 0, NULL);
+	uint32_t tpu;
+
+	if (rc != XST_SUCCESS) {
+		xil_printf("retunes: switch_stats rc %d\r\n", (int)rc);
+		return;
 	}
+	tpu = st.ticks_per_us ? st.ticks_per_us : 1;
+	xil_printf("retunes: %d done, %d with errors, %d dropped, last %d us, worst %d us\r\n",
+		   (int)st.count, (int)st.errors, (int)st.dropped,
+		   (int)(st.last_ticks / tpu), (int)(st.worst_ticks / tpu));
+}
 
+#if configUSE_HEAP_POOLS == 1
+static void print_heap_stats(void)
+{
+	HeapPoolStats_t hs;
+
+	vPortGetHeapPoolStats(&hs);
+	xil_printf("heap: %d free (min %d) in %d blocks, largest %d, frag %d.%d%%; "
+		   "pools %d large, %d fallback, internal frag %d.%d%%\r\n",
+		   (int)hs.xHeap4.xAvailableHeapSpaceInBytes, (int)hs.xHeap4.xMinimumEverFreeBytesRemaining,
+		   (int)hs.xHeap4.xNumberOfFreeBlocks, (int)hs.xHeap4.xSizeOfLargestFreeBlockInBytes,
+		   (int)(hs.ulExternalFragmentation / 10), (int)(hs.ulExternalFragmentation % 10),
+		   (int)hs.xLargeAllocations, (int)hs.xFallbackAllocations,
+		   (int)(hs.ulInternalFragmentation / 10), (int)(hs.ulInternalFragmentation % 10));
+	for (UBaseType_t c = 0; c < hs.uxClasses; ++c) {
+		const HeapPoolClassStats_t *cs = &hs.xClass[c];
+		xil_printf("  pool %dB: %d/%d in use, high-water %d, %d allocs, %d spills\r\n",
+			   (int)cs->xBlockSize, (int)cs->xBlocksInUse, (int)cs->xBlocks,
+			   (int)cs->xMaxBlocksInUse, (int)cs->xAllocations, (int)cs->xSpills);
+	}
+}
+#endif
+
+#if RPU_BENCH_ENABLE
+static void run_bench(void)
+{
+	static const uint32_t depths[] = { 1, 4, 16, RPU_CTRL_MAX_INFLIGHT };
+	rpu_bench_result_t r;
+
+	for (uint32_t i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i) {
+		if (rpu_bench_run(RPU_BENCH_COUNT, depths[i], RPU_BENCH_SMALL_LEN, &r) != XST_SUCCESS) {
+			xil_printf("bench: %d of %d commands failed\r\n", (int)r.failed, (int)r.count);
+		}
+		rpu_bench_print(&r);
+	}
+	if (rpu_bench_run(RPU_BENCH_COUNT, RPU_CTRL_MAX_INFLIGHT, RPU_BENCH_LARGE_LEN, &r) != XST_SUCCESS) {
+		xil_printf("bench: %d of %d commands failed\r\n", (int)r.failed, (int)r.count);
+	}
+	rpu_bench_print(&r);
+}
+#endif
+
+#if SMP_BENCH_ENABLE
+static void run_smp_bench(void)
+{
+	smp_bench_result_t r[APU_SMP_MAX_CORES];
+	uint32_t n = 0;
+
+	if (smp_bench_run(r, APU_SMP_MAX_CORES, &n) != 0) {
+		xil_printf("smp bench: output differs between core counts\r\n");
+	}
+	for (uint32_t i = 0; i < n; ++i) {
+		smp_bench_print(&r[i]);
+	}
+}
+#endif
+
+#if RPU_LOG_ON_APU
+static void log_task(void *arg)
+{
+	(void)arg;
+	for (;;) {
+		vTaskDelay(pdMS_TO_TICKS(LOG_POLL_MS));
+		while (rpu_ctrl_log_drain(LOG_BATCH) == LOG_BATCH) {
+		}
+	}
+}
+#endif
+
+static void ctrl_task(void *arg)
+{
+	uint8_t mux = 0;
+	int32_t rc;
+
+	(void)arg;
+	xil_printf("APU cores online: mask 0x%x\r\n", (unsigned)apu_smp_init(APU_SMP_ALL_CORES));
+#if SMP_BENCH_ENABLE
+	run_smp_bench();
+#endif
+
+	if (rpu_ctrl_init() != XST_SUCCESS) {
+		xil_printf("rpu_ctrl_init failed\r\n");
+		vTaskDelete(NULL);
+	}
+
+	rc = rpu_ctrl_read_mux(&mux);
+	xil_printf("R5 link up: read_mux rc %d, mux 0x%02x\r\n", (int)rc, mux);
+
+#if RPU_LOG_ON_APU
+	rc = rpu_ctrl_log_attach();
+	if (rc != XST_SUCCESS) {
+		xil_printf("R5 log stays on the R5: attach rc %d\r\n", (int)rc);
+	} else {
+		xTaskCreate(log_task, "rpu_log", LOG_TASK_STACK, NULL, LOG_TASK_PRIORITY, NULL);
+	}
+#endif
+
+#if RPU_BENCH_ENABLE
+	run_bench();
+	print_stats();
+	rpu_ctrl_reset_stats();
+#endif
+
+	for (;;) {
+		vTaskDelay(pdMS_TO_TICKS(STATS_PERIOD_S * 1000));
+		print_stats();
+		print_switch_stats();
+#if configUSE_HEAP_POOLS == 1
+		print_heap_stats();
+#endif
+#if RT_PROF_REPORT
+		rt_prof_report(RT_PROF_REPORT > 1);
+#endif
+	}
+}
+
+int main()
+{
+	xil_printf("\r\n ******************* ARM0: A53_0 ****************.\r\n");
+	xil_printf(" ARM0 A53_0: FreeRTOS controller for the R5 aperture tuner.\r\n");
+	xil_printf("*****************************************************.\r\n");
+
+	xTaskCreate(ctrl_task, "ctrl", CTRL_TASK_STACK, NULL, CTRL_TASK_PRIORITY, NULL);
+	vTaskStartScheduler();
+
+	/* only reached if the scheduler could not allocate the idle task */
+	for (;;) {
+	}
 	return 0;
 }
@@ -0,0 +1,360 @@
+/********************************************************************************************
+ * apu_smp.c - data-processing executor across the four Cortex-A53 cores (see apu_smp.h)
+ ********************************************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+#include "xil_io.h"
+#include "xil_cache.h"
+#include "xiltimer.h"
+#include "xinterrupt_wrap.h"
+#include "apu_smp.h"
+
+/* ZynqMP APU bring-up registers */
+#define APU_RVBARADDR(n)	(0xFD5C0040U + 8U * (n))	/* 64-bit reset vector, per core */
+#define CRF_APB_RST_FPD_APU	0xFD1A0104U
+#define RST_ACPU(n)		(1U << (n))
+#define RST_ACPU_PWRON(n)	(1U << (10 + (n)))
+#define PMU_REQ_PWRUP_STATUS	0xFFD80110U
+#define PMU_REQ_PWRUP_INT_EN	0xFFD80118U
+#define PMU_REQ_PWRUP_TRIG	0xFFD80120U
+#define PMU_PWRUP_ACPU(n)	(1U << (n))
+
+#define GICD_SGIR		(configINTERRUPT_CONTROLLER_BASE_ADDRESS + 0xF00U)
+#define SGI_TO_CORE0		(1U << 16)
+#define SGI_INTR		(0x400000U | APU_SMP_SGI_ID)	/* SDT encoding: SGI */
+
+#define NOTIFY_SLOTS		32	/* per worker, power of two */
+
+/* boot block read by apu_smp_entry.S with the MMU off: cleaned to PoC before use */
+typedef struct {
+	uint64_t ttbr0;
+	uint64_t tcr;
+	uint64_t mair;
+	uint64_t sctlr;
+	uint64_t scr;
+	uint64_t cntfrq;
+	uint64_t stack_top[APU_SMP_MAX_CORES];
+} apu_smp_boot_t;
+
+_Static_assert(offsetof(apu_smp_boot_t, scr) == 32 && offsetof(apu_smp_boot_t, cntfrq) == 40 &&
+	       offsetof(apu_smp_boot_t, stack_top) == 48, "apu_smp_entry.S offsets");
+
+/* per-core run queue; one cache line each so the locks do not bounce together */
+typedef struct {
+	apu_spinlock_t lock;
+	uint32_t depth;
+	apu_job_t *head;
+	apu_job_t *tail;
+	apu_smp_core_stats_t stats;
+	/* worker -> core 0 SGI handler: tasks to wake (SPSC) */
+	TaskHandle_t notify[NOTIFY_SLOTS];
+	volatile uint32_t notify_head;
+	volatile uint32_t notify_tail;
+} __attribute__((aligned(64))) core_queue_t;
+
+extern void apu_smp_secondary_entry(void);
+void apu_smp_worker_main(uint64_t core);
+
+apu_smp_boot_t apu_smp_boot __attribute__((aligned(64)));
+static uint8_t worker_stacks[APU_SMP_MAX_CORES - 1][APU_SMP_STACK_BYTES] __attribute__((aligned(16)));
+static core_queue_t queues[APU_SMP_MAX_CORES];
+static volatile uint32_t online_mask = 1;
+static volatile uint32_t active_mask = 1;
+
+static inline uint64_t now_ticks(void)
+{
+	XTime t;
+	XTime_GetTime(&t);
+	return (uint64_t)t;
+}
+
+/* core 0 shares the queues with FreeRTOS tasks and ISRs: mask while holding */
+static inline UBaseType_t q_lock(uint32_t self, core_queue_t *q)
+{
+	if (self == 0) {
+		return apu_spin_lock_irqsave(&q->lock);
+	}
+	apu_spin_lock(&q->lock);
+	return 0;
+}
+
+static inline void q_unlock(uint32_t self, core_queue_t *q, UBaseType_t mask)
+{
+	if (self == 0) {
+		apu_spin_unlock_irqrestore(&q->lock, mask);
+	} else {
+		apu_spin_unlock(&q->lock);
+	}
+}
+
+/* unlink the first job in q that `core` may run */
+static apu_job_t *q_take(core_queue_t *q, uint32_t core)
+{
+	apu_job_t *prev = NULL;
+
+	for (apu_job_t *j = q->head; j != NULL; prev = j, j = j->next) {
+		if (j->affinity & (1U << core)) {
+			if (prev) {
+				prev->next = j->next;
+			} else {
+				q->head = j->next;
+			}
+			if (q->tail == j) {
+				q->tail = prev;
+			}
+			q->depth--;
+			return j;
+		}
+	}
+	return NULL;
+}
+
+/* own queue first, then steal from the others */
+static apu_job_t *take_job(uint32_t self)
+{
+	apu_job_t *job;
+	UBaseType_t m;
+
+	for (uint32_t i = 0; i < APU_SMP_MAX_CORES; ++i) {
+		uint32_t c = (self + i) % APU_SMP_MAX_CORES;
+		core_queue_t *q = &queues[c];
+		if (!(online_mask & (1U << c)) || q->depth == 0) {
+			continue;
+		}
+		m = q_lock(self, q);
+		job = q_take(q, self);
+		q_unlock(self, q, m);
+		if (job) {
+			if (c != self) {
+				queues[self].stats.steals++;
+			}
+			return job;
+		}
+	}
+	return NULL;
+}
+
+static void run_job(uint32_t self, apu_job_t *job)
+{
+	core_queue_t *q = &queues[self];
+	TaskHandle_t waiter = job->waiter;
+	uint64_t t0 = now_ticks();
+
+	job->fn(job->arg);
+	q->stats.busy_ticks += now_ticks() - t0;
+	q->stats.jobs_run++;
+	job->core = self;
+
+	/* the job may be reused as soon as done is set: nothing touches it after */
+	__atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+	if (self == 0 || waiter == NULL) {
+		return;
+	}
+
+	uint32_t head = q->notify_head;
+	if (head - __atomic_load_n(&q->notify_tail, __ATOMIC_ACQUIRE) < NOTIFY_SLOTS) {
+		q->notify[head & (NOTIFY_SLOTS - 1)] = waiter;
+		__atomic_store_n(&q->notify_head, head + 1, __ATOMIC_RELEASE);
+	}
+	/* full ring: the waiter still sees `done` on its next poll tick */
+	__asm__ volatile("dsb ish" ::: "memory");
+	Xil_Out32(GICD_SGIR, SGI_TO_CORE0 | APU_SMP_SGI_ID);
+	q->stats.sgis++;
+}
+
+void apu_smp_worker_main(uint64_t core)
+{
+	uint32_t self = (uint32_t)core;
+
+	__atomic_or_fetch(&online_mask, 1U << self, __ATOMIC_RELEASE);
+	__asm__ volatile("dsb ish\n\tsev" ::: "memory");
+
+	for (;;) {
+		apu_job_t *job = NULL;
+		if (active_mask & (1U << self)) {
+			job = take_job(self);
+		}
+		if (job) {
+			run_job(self, job);
+			continue;
+		}
+		/* a SEV between the check and here leaves the event register set */
+		__asm__ volatile("wfe" ::: "memory");
+		queues[self].stats.wakeups++;
+	}
+}
+
+/* core 0: wake every task a worker finished a job for, then yield to them */
+static void apu_smp_sgi_handler(void *ref)
+{
+	BaseType_t woken = pdFALSE;
+
+	(void)ref;
+	queues[0].stats.sgis++;
+	for (uint32_t c = 1; c < APU_SMP_MAX_CORES; ++c) {
+		core_queue_t *q = &queues[c];
+		uint32_t tail = q->notify_tail;
+		while (tail != __atomic_load_n(&q->notify_head, __ATOMIC_ACQUIRE)) {
+			vTaskNotifyGiveFromISR(q->notify[tail & (NOTIFY_SLOTS - 1)], &woken);
+			tail++;
+		}
+		__atomic_store_n(&q->notify_tail, tail, __ATOMIC_RELEASE);
+	}
+	portYIELD_FROM_ISR(woken);
+}
+
+static int start_core(uint32_t n)
+{
+	uint64_t entry = (uint64_t)(UINTPTR)apu_smp_secondary_entry;
+	TickType_t start;
+
+	Xil_Out32(APU_RVBARADDR(n), (u32)entry);
+	Xil_Out32(APU_RVBARADDR(n) + 4U, (u32)(entry >> 32));
+
+	/* power the core up through the PMU, then release its resets */
+	Xil_Out32(PMU_REQ_PWRUP_INT_EN, PMU_PWRUP_ACPU(n));
+	Xil_Out32(PMU_REQ_PWRUP_TRIG, PMU_PWRUP_ACPU(n));
+	start = xTaskGetTickCount();
+	while (Xil_In32(PMU_REQ_PWRUP_STATUS) & PMU_PWRUP_ACPU(n)) {
+		if (xTaskGetTickCount() - start > pdMS_TO_TICKS(APU_SMP_ONLINE_TIMEOUT_MS)) {
+			return -1;
+		}
+	}
+	Xil_Out32(CRF_APB_RST_FPD_APU,
+		  Xil_In32(CRF_APB_RST_FPD_APU) & ~(RST_ACPU(n) | RST_ACPU_PWRON(n)));
+
+	start = xTaskGetTickCount();
+	while (!(online_mask & (1U << n))) {
+		if (xTaskGetTickCount() - start > pdMS_TO_TICKS(APU_SMP_ONLINE_TIMEOUT_MS)) {
+			return -1;
+		}
+		vTaskDelay(1);
+	}
+	return 0;
+}
+
+uint32_t apu_smp_init(uint32_t core_mask)
+{
+	uint64_t v;
+
+	/* workers inherit core 0's EL3 setup */
+	__asm__ volatile("mrs %0, TTBR0_EL3" : "=r" (v)); apu_smp_boot.ttbr0 = v;
+	__asm__ volatile("mrs %0, TCR_EL3" : "=r" (v)); apu_smp_boot.tcr = v;
+	__asm__ volatile("mrs %0, MAIR_EL3" : "=r" (v)); apu_smp_boot.mair = v;
+	__asm__ volatile("mrs %0, SCTLR_EL3" : "=r" (v)); apu_smp_boot.sctlr = v;
+	__asm__ volatile("mrs %0, SCR_EL3" : "=r" (v)); apu_smp_boot.scr = v;
+	__asm__ volatile("mrs %0, CNTFRQ_EL0" : "=r" (v)); apu_smp_boot.cntfrq = v;
+	apu_smp_boot.stack_top[0] = 0;		/* core 0 keeps the FreeRTOS stacks */
+	for (uint32_t n = 1; n < APU_SMP_MAX_CORES; ++n) {
+		apu_smp_boot.stack_top[n] = (uint64_t)(UINTPTR)&worker_stacks[n - 1][APU_SMP_STACK_BYTES];
+	}
+	Xil_DCacheFlushRange((UINTPTR)&apu_smp_boot, sizeof(apu_smp_boot));
+	Xil_DCacheFlushRange((UINTPTR)queues, sizeof(queues));
+
+	/* the port's install/enable take a u16 id and would drop the SGI flag */
+	(void)XConnectToInterruptCntrl(SGI_INTR, apu_smp_sgi_handler, NULL,
+				       configINTERRUPT_CONTROLLER_BASE_ADDRESS);
+	XEnableIntrId(SGI_INTR, configINTERRUPT_CONTROLLER_BASE_ADDRESS);
+
+	for (uint32_t n = 1; n < APU_SMP_MAX_CORES; ++n) {
+		if ((core_mask & (1U << n)) && !(online_mask & (1U << n))) {
+			(void)start_core(n);
+		}
+	}
+	active_mask = online_mask;
+	return online_mask;
+}
+
+uint32_t apu_smp_online_mask(void)
+{
+	return online_mask;
+}
+
+void apu_smp_set_active_mask(uint32_t mask)
+{
+	active_mask = (mask & online_mask) | 1U;
+	__asm__ volatile("dsb ish\n\tsev" ::: "memory");
+}
+
+void apu_smp_submit(apu_job_t *job)
+{
+	uint32_t allowed, target = 0, best = UINT32_MAX;
+	core_queue_t *q;
+	UBaseType_t m;
+
+	if (job->affinity == 0) {
+		job->affinity = APU_SMP_ALL_CORES;
+	}
+	allowed = job->affinity & active_mask & online_mask;
+	if (allowed == 0) {
+		allowed = 1;		/* core 0 always runs what nobody else may */
+		job->affinity |= 1;
+	}
+	for (uint32_t c = 0; c < APU_SMP_MAX_CORES; ++c) {
+		if ((allowed & (1U << c)) && queues[c].depth < best) {
+			best = queues[c].depth;
+			target = c;
+		}
+	}
+
+	job->done = 0;
+	job->next = NULL;
+	job->waiter = xTaskGetCurrentTaskHandle();
+	q = &queues[target];
+	m = q_lock(0, q);
+	if (q->tail) {
+		q->tail->next = job;
+	} else {
+		q->head = job;
+	}
+	q->tail = job;
+	q->depth++;
+	q_unlock(0, q, m);
+	__asm__ volatile("dsb ish\n\tsev" ::: "memory");
+}
+
+void apu_smp_wait(apu_job_t *jobs, uint32_t count)
+{
+	uint32_t first = 0;
+
+	for (;;) {
+		while (first < count && __atomic_load_n(&jobs[first].done, __ATOMIC_ACQUIRE)) {
+			first++;
+		}
+		if (first == count) {
+			return;
+		}
+		apu_job_t *job = take_job(0);
+		if (job) {
+			run_job(0, job);
+		} else {
+			/* woken by a worker's SGI; the tick is only a backstop */
+			(void)ulTaskNotifyTake(pdTRUE, 1);
+		}
+	}
+}
+
+void apu_smp_run(apu_job_t *jobs, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i) {
+		apu_smp_submit(&jobs[i]);
+	}
+	apu_smp_wait(jobs, count);
+}
+
+void apu_smp_get_stats(uint32_t core, apu_smp_core_stats_t *out)
+{
+	if (core < APU_SMP_MAX_CORES) {
+		*out = queues[core].stats;
+	} else {
+		memset(out, 0, sizeof(*out));
+	}
+}
+
+void apu_smp_reset_stats(void)
+{
+	for (uint32_t c = 0; c < APU_SMP_MAX_CORES; ++c) {
+		memset(&queues[c].stats, 0, sizeof(queues[c].stats));
+	}
+}
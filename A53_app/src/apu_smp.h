@@ -0,0 +1,113 @@
+/********************************************************************************************
+ * apu_smp.h - data-processing executor across the four Cortex-A53 cores
+ *
+ * FreeRTOS keeps running on core 0 only (the BSP kernel is single-core). Cores
+ * 1-3 are released from reset into a bare worker loop, with the same MMU tables
+ * and coherency (SMPEN) as core 0. Jobs go into per-core run queues guarded by
+ * ARMv8 exclusive-access spinlocks. Each job carries a core affinity mask; an
+ * idle core steals from the other queues within that mask. Submitters wake
+ * parked cores with SEV. Finished jobs are reported to core 0 with an SGI,
+ * whose handler yields to the waiting task. The waiting task on core 0 also
+ * runs queued jobs itself while it waits.
+ ********************************************************************************************/
+#ifndef APU_SMP_H
+#define APU_SMP_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define APU_SMP_MAX_CORES	4
+#define APU_SMP_ALL_CORES	((1U << APU_SMP_MAX_CORES) - 1)
+#define APU_SMP_STACK_BYTES	0x4000		/* per worker core */
+#define APU_SMP_SGI_ID		9		/* worker -> core 0 completion doorbell */
+#define APU_SMP_ONLINE_TIMEOUT_MS	100
+
+/* ---- spinlock: LDAXR/STXR, parked in WFE while contended ---- */
+typedef struct {
+	volatile uint32_t lock;
+} apu_spinlock_t;
+
+#define APU_SPINLOCK_INIT	{ 0 }
+
+static inline void apu_spin_lock(apu_spinlock_t *l)
+{
+	uint32_t tmp, busy;
+
+	__asm__ volatile(
+		"	sevl\n"
+		"1:	wfe\n"
+		"2:	ldaxr	%w0, [%2]\n"
+		"	cbnz	%w0, 1b\n"
+		"	stxr	%w1, %w3, [%2]\n"
+		"	cbnz	%w1, 2b\n"
+		: "=&r" (tmp), "=&r" (busy)
+		: "r" (&l->lock), "r" (1)
+		: "memory");
+}
+
+/* store-release clears the exclusive monitor of waiters: they wake from WFE */
+static inline void apu_spin_unlock(apu_spinlock_t *l)
+{
+	__asm__ volatile("stlr wzr, [%0]" : : "r" (&l->lock) : "memory");
+}
+
+/* core 0 only: also keeps the FreeRTOS tick / SGI handler off the lock holder */
+static inline UBaseType_t apu_spin_lock_irqsave(apu_spinlock_t *l)
+{
+	UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	apu_spin_lock(l);
+	return mask;
+}
+
+static inline void apu_spin_unlock_irqrestore(apu_spinlock_t *l, UBaseType_t mask)
+{
+	apu_spin_unlock(l);
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+/* ---- jobs ---- */
+typedef void (*apu_job_fn)(void *arg);
+
+typedef struct apu_job {
+	apu_job_fn fn;
+	void *arg;
+	uint32_t affinity;		/* cores allowed to run it; 0 = any online core */
+
+	/* filled in by the executor */
+	volatile uint32_t done;
+	uint32_t core;			/* core that ran it */
+	TaskHandle_t waiter;
+	struct apu_job *next;
+} apu_job_t;
+
+typedef struct {
+	uint32_t jobs_run;
+	uint32_t steals;		/* taken from another core's queue */
+	uint32_t wakeups;		/* left WFE */
+	uint32_t sgis;			/* completion SGIs sent (workers) / taken (core 0) */
+	uint64_t busy_ticks;		/* XTime spent inside jobs */
+} apu_smp_core_stats_t;
+
+/* Start the worker cores in `core_mask` (bit 0, core 0, is always online).
+   Call from a task. Returns the mask of cores that came online. */
+uint32_t apu_smp_init(uint32_t core_mask);
+
+uint32_t apu_smp_online_mask(void);
+
+/* Restrict which cores take new jobs (subset of the online mask; bit 0 always set) */
+void apu_smp_set_active_mask(uint32_t mask);
+
+/* Queue a job on the least loaded active core allowed by its affinity */
+void apu_smp_submit(apu_job_t *job);
+
+/* Wait until every job in `jobs` is done, running queued jobs on core 0 meanwhile */
+void apu_smp_wait(apu_job_t *jobs, uint32_t count);
+
+/* Submit `count` jobs and wait for all of them */
+void apu_smp_run(apu_job_t *jobs, uint32_t count);
+
+void apu_smp_get_stats(uint32_t core, apu_smp_core_stats_t *out);
+void apu_smp_reset_stats(void);
+
+#endif
@@ -0,0 +1,63 @@
+/* dlog.h - deferred binary logging, ring layout and format table */
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+
+/* Copy of the shared part of R5_app/src/dlog.h: the ring layout and the format
+   list must match the R5 build, keep both in sync and bump DLOG_VERSION on
+   change. The R5 API is not here; rpu_ctrl reads the ring in place through the
+   RPU0 TCM global alias (rpu_ctrl_log_attach). */
+
+#define DLOG_MAGIC          0x474F4C44U  /* "DLOG" */
+#define DLOG_VERSION        1
+#define DLOG_SLOTS          256          /* power of two */
+#define DLOG_MAX_ARGS       4
+
+#define DLOG_CONSUMER_RPU   0            /* R5 idle hook prints to the UART */
+#define DLOG_CONSUMER_APU   1            /* A53 reads records, R5 never drains */
+
+/* Format IDs are positions in this list: append only. Strings carry no line
+   ending. */
+#define DLOG_MESSAGES(X) \
+    X(DLOG_DROPPED,             "dlog: %d records dropped") \
+    X(DLOG_PRESET_CHANGE,       "Aperture Tuning Change (%d)") \
+    X(DLOG_PRESET_QUEUE_FAILED, "Aperture Tuning Change (%d) failed to queue") \
+    X(DLOG_INITIAL_TUNING,      "Setting Initial Tuning = %d") \
+    X(DLOG_SEQ_START,           "Sample test sequence: echoes %d, scans %d, t_end %d") \
+    X(DLOG_SEQ_REJECTED,        "Sample test sequence rejected") \
+    X(DLOG_SEQ_DONE,            "Sample test sequence complete (%d scans, jitter %d ticks)") \
+    X(DLOG_UPLOAD_COMMITTED,    "Preset upload %d committed") \
+    X(DLOG_TOPOLOGY_REJECTED,   "set_topology rejected: %d") \
+    X(DLOG_VERIFY_UNREPAIRED,   "atc verify: expanders still wrong after retries")
+
+#define DLOG_ENUM(id, fmt) id,
+enum { DLOG_MESSAGES(DLOG_ENUM) DLOG_NUM_MESSAGES };
+#undef DLOG_ENUM
+
+typedef struct {
+    volatile uint32_t seq;       /* == position + 1 once written, + SLOTS once free */
+    uint32_t stamp;              /* XTime ticks, low 32 bits */
+    uint16_t id;
+    uint8_t nargs;
+    uint8_t rsvd;
+    uint32_t args[DLOG_MAX_ARGS];
+    uint32_t pad;
+} dlog_rec_t;                    /* 32 bytes */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t rec_bytes;
+    uint32_t ticks_per_us;
+    volatile uint32_t consumer;  /* DLOG_CONSUMER_*, written by the R5 only */
+    volatile uint32_t head;      /* producers: next position to claim */
+    volatile uint32_t tail;      /* consumer: next position to read */
+    volatile uint32_t written;
+    volatile uint32_t dropped;   /* ring full, record discarded */
+    uint32_t pad[6];
+    dlog_rec_t recs[DLOG_SLOTS];
+} dlog_ring_t;
+
+#endif
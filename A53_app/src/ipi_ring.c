@@ -0,0 +1,129 @@
+/* ipi_ring.c */
+#include "ipi_ring.h"
+#include "xil_cache.h"
+#include <string.h>
+
+/* The R5 and A53 caches are not coherent here: writers flush, readers invalidate. */
+#define RING_MASK (IPI_RING_SLOTS - 1)
+
+static inline void ring_dmb(void)
+{
+    __asm__ volatile ("dmb sy" ::: "memory");
+}
+
+static inline uint32_t ring_read(volatile uint32_t *p)
+{
+    Xil_DCacheInvalidateRange((UINTPTR)p, IPI_RING_CACHE_LINE);
+    return *p;
+}
+
+static inline void ring_write(volatile uint32_t *p, uint32_t v)
+{
+    *p = v;
+    Xil_DCacheFlushRange((UINTPTR)p, IPI_RING_CACHE_LINE);
+}
+
+void ipi_ring_region_init(ipi_ring_region_t *region)
+{
+    memset(region, 0, sizeof(*region));
+    region->magic = IPI_RING_MAGIC;
+    region->version = IPI_RING_VERSION;
+    region->slots = IPI_RING_SLOTS;
+    region->slot_bytes = IPI_RING_SLOT_BYTES;
+    /* both consumers start idle: first publish rings the doorbell */
+    region->to_rpu.armed = 1;
+    region->to_apu.armed = 1;
+    Xil_DCacheFlushRange((UINTPTR)region, sizeof(*region));
+}
+
+int ipi_ring_region_valid(ipi_ring_region_t *region)
+{
+    Xil_DCacheInvalidateRange((UINTPTR)region, IPI_RING_CACHE_LINE);
+    return region->magic == IPI_RING_MAGIC &&
+           region->version == IPI_RING_VERSION &&
+           region->slots == IPI_RING_SLOTS &&
+           region->slot_bytes == IPI_RING_SLOT_BYTES;
+}
+
+void ipi_ring_tx_attach(ipi_ring_tx_t *tx, ipi_ring_t *ring)
+{
+    tx->ring = ring;
+    tx->head = ring_read(&ring->head);
+}
+
+void ipi_ring_rx_attach(ipi_ring_rx_t *rx, ipi_ring_t *ring)
+{
+    rx->ring = ring;
+    rx->tail = ring_read(&ring->tail);
+}
+
+int ipi_ring_push(ipi_ring_tx_t *tx, uint32_t cmd, uint32_t seq, uint32_t status,
+                  const void *payload, uint32_t len)
+{
+    ipi_ring_t *ring = tx->ring;
+    if (len > IPI_RING_SLOT_PAYLOAD) return -2;
+    if (tx->head - ring_read(&ring->tail) >= IPI_RING_SLOTS) return -1;
+
+    ipi_slot_t *slot = &ring->slots[tx->head & RING_MASK];
+    slot->hdr.cmd = cmd;
+    slot->hdr.len = len;
+    slot->hdr.seq = seq;
+    slot->hdr.status = status;
+    if (len) memcpy(slot->payload, payload, len);
+    Xil_DCacheFlushRange((UINTPTR)slot, sizeof(ipi_slot_hdr_t) + len);
+    tx->head++;
+    return 0;
+}
+
+int ipi_ring_publish(ipi_ring_tx_t *tx)
+{
+    ipi_ring_t *ring = tx->ring;
+    ring_dmb();                     /* slot contents before the index */
+    ring_write(&ring->head, tx->head);
+    ring_dmb();
+    if (ring_read(&ring->armed)) {
+        return 1;
+    }
+    return 0;
+}
+
+ipi_slot_t *ipi_ring_peek(ipi_ring_rx_t *rx, uint32_t *len)
+{
+    ipi_ring_t *ring = rx->ring;
+    if (rx->tail == ring_read(&ring->head)) return NULL;
+    ring_dmb();
+
+    ipi_slot_t *slot = &ring->slots[rx->tail & RING_MASK];
+    Xil_DCacheInvalidateRange((UINTPTR)slot, sizeof(ipi_slot_hdr_t));
+    /* clamp locally: the header line belongs to the producer, never write it back */
+    uint32_t n = slot->hdr.len;
+    if (n > IPI_RING_SLOT_PAYLOAD) n = IPI_RING_SLOT_PAYLOAD;
+    if (n) Xil_DCacheInvalidateRange((UINTPTR)slot->payload, n);
+    *len = n;
+    return slot;
+}
+
+void ipi_ring_release(ipi_ring_rx_t *rx)
+{
+    ring_dmb();                     /* done reading before giving the slot back */
+    rx->tail++;
+    ring_write(&rx->ring->tail, rx->tail);
+}
+
+void ipi_ring_disarm(ipi_ring_rx_t *rx)
+{
+    ring_write(&rx->ring->armed, 0);
+}
+
+int ipi_ring_arm(ipi_ring_rx_t *rx)
+{
+    ipi_ring_t *ring = rx->ring;
+    ring_write(&ring->armed, 1);
+    ring_dmb();
+    /* producer may have published between our last peek and arming */
+    if (rx->tail != ring_read(&ring->head)) {
+        ring_write(&ring->armed, 0);
+        return 1;
+    }
+    return 0;
+}
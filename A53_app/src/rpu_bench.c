@@ -0,0 +1,132 @@
+/********************************************************************************************
+ * rpu_bench.c - round-trip benchmark of the APU -> R5 command path (see rpu_bench.h)
+ ********************************************************************************************/
+
+#include <string.h>
+#include "xiltimer.h"
+#include "xil_printf.h"
+#include "xstatus.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "rpu_bench.h"
+
+#define BENCH_MAX_PAYLOAD	IPI_RING_SLOT_PAYLOAD
+#define TICKS_PER_US		(COUNTS_PER_SECOND / 1000000U)
+
+typedef struct {
+	rpu_ctrl_req_t req;
+	uint8_t tx[BENCH_MAX_PAYLOAD];
+	uint8_t rx[BENCH_MAX_PAYLOAD];
+} bench_slot_t;
+
+static bench_slot_t slots[RPU_CTRL_MAX_INFLIGHT];
+static QueueHandle_t done_queue;
+
+/* service task context: hand the finished slot back to the bench task */
+static void bench_done(rpu_ctrl_req_t *req)
+{
+	(void)xQueueSend(done_queue, &req->user, 0);
+}
+
+static void fill_payload(bench_slot_t *s, uint32_t len, uint32_t tag)
+{
+	for (uint32_t i = 0; i < len; ++i) {
+		s->tx[i] = (uint8_t)(tag + i * 7U);
+	}
+}
+
+int rpu_bench_run(uint32_t count, uint32_t depth, uint32_t payload_len, rpu_bench_result_t *out)
+{
+	uint32_t issued = 0, tag = 0;
+	uint64_t t0;
+
+	if (depth == 0) {
+		depth = 1;
+	}
+	if (depth > RPU_CTRL_MAX_INFLIGHT) {
+		depth = RPU_CTRL_MAX_INFLIGHT;
+	}
+	if (depth > count) {
+		depth = count;
+	}
+	if (payload_len > BENCH_MAX_PAYLOAD) {
+		payload_len = BENCH_MAX_PAYLOAD;
+	}
+	memset(out, 0, sizeof(*out));
+	out->count = count;
+	out->depth = depth;
+	out->payload_len = payload_len;
+	if (count == 0) {
+		return XST_SUCCESS;
+	}
+
+	if (done_queue == NULL) {
+		done_queue = xQueueCreate(RPU_CTRL_MAX_INFLIGHT, sizeof(bench_slot_t *));
+		if (done_queue == NULL) {
+			return XST_FAILURE;
+		}
+	}
+	xQueueReset(done_queue);
+
+	XTime_GetTime(&t0);
+	for (uint32_t i = 0; i < depth; ++i) {
+		bench_slot_t *s = &slots[i];
+		memset(&s->req, 0, sizeof(s->req));
+		s->req.cmd = RPU_CMD_ECHO;
+		s->req.payload = s->tx;
+		s->req.len = payload_len;
+		s->req.resp = s->rx;
+		s->req.resp_max = sizeof(s->rx);
+		s->req.done = bench_done;
+		s->req.user = s;
+		fill_payload(s, payload_len, tag++);
+		(void)rpu_ctrl_submit(&s->req, portMAX_DELAY);
+		issued++;
+	}
+
+	for (uint32_t finished = 0; finished < count; ++finished) {
+		bench_slot_t *s;
+		(void)xQueueReceive(done_queue, &s, portMAX_DELAY);
+
+		rpu_ctrl_req_t *req = &s->req;
+		uint64_t rtt = req->t_done - req->t_submit;
+		if (req->status == XST_SUCCESS && req->resp_len == payload_len &&
+		    memcmp(s->rx, s->tx, payload_len) == 0) {
+			out->ok++;
+		} else {
+			out->failed++;
+		}
+		if (finished == 0 || rtt < out->rtt_min) {
+			out->rtt_min = rtt;
+		}
+		if (rtt > out->rtt_max) {
+			out->rtt_max = rtt;
+		}
+		out->rtt_total += rtt;
+
+		if (issued < count) {
+			fill_payload(s, payload_len, tag++);
+			memset(s->rx, 0, payload_len);
+			(void)rpu_ctrl_submit(req, portMAX_DELAY);
+			issued++;
+		}
+	}
+
+	XTime t1;
+	XTime_GetTime(&t1);
+	out->elapsed_ticks = t1 - t0;
+	if (out->elapsed_ticks) {
+		out->cmds_per_sec = (uint32_t)(((uint64_t)count * COUNTS_PER_SECOND) / out->elapsed_ticks);
+	}
+	return out->failed ? XST_FAILURE : XST_SUCCESS;
+}
+
+void rpu_bench_print(const rpu_bench_result_t *r)
+{
+	uint32_t avg = r->count ? (uint32_t)(r->rtt_total / r->count / TICKS_PER_US) : 0;
+
+	xil_printf("bench depth %2d len %3d: %6d cmd/s, rtt us min %d avg %d max %d, %d/%d ok\r\n",
+		   (int)r->depth, (int)r->payload_len, (int)r->cmds_per_sec,
+		   (int)(r->rtt_min / TICKS_PER_US), (int)avg, (int)(r->rtt_max / TICKS_PER_US),
+		   (int)r->ok, (int)r->count);
+}
@@ -0,0 +1,33 @@
+/********************************************************************************************
+ * rpu_bench.h - round-trip benchmark of the APU -> R5 command path
+ *
+ * Keeps `depth` echo requests in flight through rpu_ctrl and reports commands
+ * per second plus submit -> completion latency. Every response is checked
+ * against its request payload.
+ ********************************************************************************************/
+#ifndef RPU_BENCH_H
+#define RPU_BENCH_H
+
+#include <stdint.h>
+#include "rpu_ctrl.h"
+
+typedef struct {
+	uint32_t count;
+	uint32_t depth;
+	uint32_t payload_len;
+	uint32_t ok;
+	uint32_t failed;		/* bad status, timeout or echo mismatch */
+	uint64_t elapsed_ticks;		/* first submit -> last completion, XTime */
+	uint64_t rtt_min;
+	uint64_t rtt_max;
+	uint64_t rtt_total;
+	uint32_t cmds_per_sec;
+} rpu_bench_result_t;
+
+/* depth is clamped to RPU_CTRL_MAX_INFLIGHT, payload_len to a ring slot.
+   Returns XST_SUCCESS if every command round-tripped intact. */
+int rpu_bench_run(uint32_t count, uint32_t depth, uint32_t payload_len, rpu_bench_result_t *out);
+
+void rpu_bench_print(const rpu_bench_result_t *r);
+
+#endif
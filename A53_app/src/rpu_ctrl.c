@@ -0,0 +1,543 @@
+/********************************************************************************************
+ * rpu_ctrl.c - APU-side controller for the R5 aperture tuner (see rpu_ctrl.h)
+ ********************************************************************************************/
+
+#include <string.h>
+#include "xparameters.h"
+#include "xipipsu.h"
+#include "xiltimer.h"
+#include "xil_printf.h"
+#include "xil_mmu.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "rpu_ctrl.h"
+#include "dlog.h"
+
+#define RPU_IPI_MASK		XPAR_IPI0_1_IPI_BITMASK	/* RPU0 channel */
+#define INFLIGHT_MASK		(RPU_CTRL_MAX_INFLIGHT - 1)
+#define TIMEOUT_POLL_MS		10	/* timeout sweep period while requests are outstanding */
+#define TICKS_PER_MS		(COUNTS_PER_SECOND / 1000U)
+#define RPU0_TCM_GLOBAL_BASE	0xFFE00000U	/* RPU0 ATCM/BTCM in the APU map */
+#define RPU0_TCM_GLOBAL_SIZE	0x00040000U
+#define LOG_MODE_KEEP		0xFE
+#define LOG_MASK		(DLOG_SLOTS - 1)
+#define SWITCH_STATS_RESET	0xFF
+
+static XIpiPsu ipi;
+static ipi_ring_region_t *const rings = (ipi_ring_region_t *)IPI_RING_BASE_ADDR;
+static ipi_ring_tx_t req_tx;
+static ipi_ring_rx_t resp_rx;
+
+static QueueHandle_t cmd_queue;
+static TaskHandle_t service_task;
+
+/* owned by the service task */
+static rpu_ctrl_req_t *inflight[RPU_CTRL_MAX_INFLIGHT];
+static uint32_t inflight_count;
+static rpu_ctrl_req_t *held;		/* dequeued, waiting for ring space */
+static uint32_t next_seq = 1;
+
+static rpu_ctrl_stats_t stats;
+
+/* dlog reader, owned by the draining task once attached */
+static dlog_ring_t *log_ring;
+static uint32_t log_dropped_reported;
+
+#define DLOG_FMT(id, fmt) fmt,
+static const char *const log_fmt[DLOG_NUM_MESSAGES] = { DLOG_MESSAGES(DLOG_FMT) };
+#undef DLOG_FMT
+
+_Static_assert(sizeof(dlog_rec_t) == 32, "dlog_rec_t must match the R5 layout");
+_Static_assert(sizeof(rpu_ctrl_switch_record_t) == 12, "must match preset_switch_record_t");
+_Static_assert(sizeof(rpu_ctrl_switch_stats_t) == 24, "must match preset_switch_stats_t");
+_Static_assert((RPU_CTRL_MAX_INFLIGHT & INFLIGHT_MASK) == 0, "RPU_CTRL_MAX_INFLIGHT must be a power of two");
+_Static_assert(RPU_CTRL_MAX_INFLIGHT <= IPI_RING_SLOTS, "more requests in flight than ring slots");
+
+static inline uint64_t now_ticks(void)
+{
+	XTime t;
+	XTime_GetTime(&t);
+	return (uint64_t)t;
+}
+
+static void rpu_ctrl_irq(void *ref)
+{
+	(void)ref;
+	BaseType_t woken = pdFALSE;
+	u32 status = XIpiPsu_GetInterruptStatus(&ipi);
+
+	XIpiPsu_ClearInterruptStatus(&ipi, status);
+	stats.irqs++;
+	vTaskNotifyGiveFromISR(service_task, &woken);
+	portYIELD_FROM_ISR(woken);
+}
+
+/* Service task: hand the request back to its owner */
+static void complete(rpu_ctrl_req_t *req, int32_t status)
+{
+	rpu_ctrl_done_fn done = req->done;
+	TaskHandle_t waiter = req->waiter;
+	uint64_t rtt;
+
+	req->t_done = now_ticks();
+	rtt = req->t_done - req->t_submit;
+	if (stats.completed == 0 || rtt < stats.rtt_min) {
+		stats.rtt_min = rtt;
+	}
+	if (rtt > stats.rtt_max) {
+		stats.rtt_max = rtt;
+	}
+	stats.rtt_total += rtt;
+	stats.completed++;
+	if (status == RPU_CTRL_ERR_TIMEOUT) {
+		stats.timeouts++;
+	} else if (status != XST_SUCCESS) {
+		stats.errors++;
+	}
+
+	/* the request may be reused or freed as soon as status is set */
+	__atomic_store_n(&req->status, status, __ATOMIC_RELEASE);
+	if (done != NULL) {
+		done(req);
+	} else {
+		xTaskNotifyGive(waiter);
+	}
+}
+
+static void collect_responses(void)
+{
+	ipi_slot_t *slot;
+	uint32_t len;
+
+	while ((slot = ipi_ring_peek(&resp_rx, &len)) != NULL) {
+		uint32_t seq = slot->hdr.seq;
+		rpu_ctrl_req_t *req = inflight[seq & INFLIGHT_MASK];
+
+		if (req != NULL && req->seq == seq) {
+			uint32_t n = len;
+			if (n > req->resp_max) {
+				n = req->resp_max;
+			}
+			if (n && req->resp != NULL) {
+				memcpy(req->resp, slot->payload, n);
+			}
+			req->resp_len = n;
+			inflight[seq & INFLIGHT_MASK] = NULL;
+			inflight_count--;
+			complete(req, (int32_t)slot->hdr.status);
+		} else {
+			stats.stray++;
+		}
+		ipi_ring_release(&resp_rx);
+	}
+}
+
+/* Move queued requests into the ring until it, or the in-flight table, is full */
+static void issue_requests(void)
+{
+	uint32_t pushed = 0;
+
+	for (;;) {
+		if (held == NULL && xQueueReceive(cmd_queue, &held, 0) != pdPASS) {
+			break;
+		}
+		if (held->len > IPI_RING_SLOT_PAYLOAD) {
+			rpu_ctrl_req_t *req = held;
+			held = NULL;
+			complete(req, RPU_CTRL_ERR_RING);
+			continue;
+		}
+		/* an older request still holds this seq's slot: wait for it */
+		if (inflight[next_seq & INFLIGHT_MASK] != NULL) {
+			break;
+		}
+		if (ipi_ring_push(&req_tx, held->cmd, next_seq, 0, held->payload, held->len) != 0) {
+			break;
+		}
+		held->seq = next_seq;
+		inflight[next_seq & INFLIGHT_MASK] = held;
+		inflight_count++;
+		if (inflight_count > stats.max_inflight) {
+			stats.max_inflight = inflight_count;
+		}
+		next_seq++;
+		held = NULL;
+		pushed++;
+	}
+
+	/* one doorbell per batch, and only if the R5 is not already draining */
+	if (pushed && ipi_ring_publish(&req_tx)) {
+		XIpiPsu_TriggerIpi(&ipi, RPU_IPI_MASK);
+		stats.doorbells++;
+	}
+}
+
+/* anything submitted and not completed yet, sent to the R5 or not */
+static int outstanding(void)
+{
+	return inflight_count || held != NULL || uxQueueMessagesWaiting(cmd_queue) != 0;
+}
+
+static int expired(const rpu_ctrl_req_t *req, uint64_t now)
+{
+	uint32_t ms = req->timeout_ms ? req->timeout_ms : RPU_CTRL_DEFAULT_TIMEOUT_MS;
+
+	return now - req->t_submit > (uint64_t)ms * TICKS_PER_MS;
+}
+
+/* Time out requests that were never sent as well: the one held for ring space
+   and those still queued behind it */
+static void expire_requests(void)
+{
+	uint64_t now = now_ticks();
+	rpu_ctrl_req_t *stale[RPU_CTRL_QUEUE_DEPTH];
+	uint32_t n_stale = 0;
+	UBaseType_t queued;
+
+	for (uint32_t i = 0; i < RPU_CTRL_MAX_INFLIGHT && inflight_count; ++i) {
+		rpu_ctrl_req_t *req = inflight[i];
+		if (req == NULL) {
+			continue;
+		}
+		if (expired(req, now)) {
+			/* a late response for this seq is counted as stray */
+			inflight[i] = NULL;
+			inflight_count--;
+			complete(req, RPU_CTRL_ERR_TIMEOUT);
+		}
+	}
+
+	if (held != NULL && expired(held, now)) {
+		rpu_ctrl_req_t *req = held;
+		held = NULL;
+		complete(req, RPU_CTRL_ERR_TIMEOUT);
+	}
+
+	/* rotate the queue once; with the scheduler suspended no submitter can slip
+	   in between, so the survivors keep their order and the slot each one
+	   frees is still there to put it back. Completion (callbacks, notifies)
+	   waits until the scheduler runs again. */
+	vTaskSuspendAll();
+	queued = uxQueueMessagesWaiting(cmd_queue);
+	while (queued--) {
+		rpu_ctrl_req_t *req;
+		if (xQueueReceive(cmd_queue, &req, 0) != pdPASS) {
+			break;
+		}
+		if (expired(req, now)) {
+			stale[n_stale++] = req;
+		} else {
+			(void)xQueueSendToBack(cmd_queue, &req, 0);
+		}
+	}
+	(void)xTaskResumeAll();
+
+	for (uint32_t i = 0; i < n_stale; ++i) {
+		complete(stale[i], RPU_CTRL_ERR_TIMEOUT);
+	}
+}
+
+static void rpu_ctrl_service(void *arg)
+{
+	(void)arg;
+
+	for (;;) {
+		TickType_t wait = outstanding() ? pdMS_TO_TICKS(TIMEOUT_POLL_MS) : portMAX_DELAY;
+		if (wait == 0) {
+			wait = 1;
+		}
+		(void)ulTaskNotifyTake(pdTRUE, wait);
+
+		/* responses free in-flight slots, so collect before issuing; re-arm only
+		   once both sides are drained */
+		ipi_ring_disarm(&resp_rx);
+		do {
+			collect_responses();
+			issue_requests();
+		} while (ipi_ring_arm(&resp_rx));
+
+		if (outstanding()) {
+			expire_requests();
+		}
+	}
+}
+
+int rpu_ctrl_init(void)
+{
+	XIpiPsu_Config *cfg;
+	TickType_t start;
+	int status;
+
+#ifdef SDT
+	cfg = XIpiPsu_LookupConfig(XPAR_XIPIPSU_0_BASEADDR);
+#else
+	cfg = XIpiPsu_LookupConfig(XPAR_XIPIPSU_0_DEVICE_ID);
+#endif
+	if (cfg == NULL) {
+		return XST_FAILURE;
+	}
+	status = XIpiPsu_CfgInitialize(&ipi, cfg, cfg->BaseAddress);
+	if (status != XST_SUCCESS) {
+		return status;
+	}
+
+	/* the R5 stamps the ring region once it is up */
+	start = xTaskGetTickCount();
+	while (!ipi_ring_region_valid(rings)) {
+		if (xTaskGetTickCount() - start > pdMS_TO_TICKS(RPU_CTRL_ATTACH_TIMEOUT_MS)) {
+			xil_printf("rpu_ctrl: no R5 command rings at 0x%08x\r\n", IPI_RING_BASE_ADDR);
+			return XST_FAILURE;
+		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	ipi_ring_tx_attach(&req_tx, &rings->to_rpu);
+	ipi_ring_rx_attach(&resp_rx, &rings->to_apu);
+
+	cmd_queue = xQueueCreate(RPU_CTRL_QUEUE_DEPTH, sizeof(rpu_ctrl_req_t *));
+	if (cmd_queue == NULL) {
+		return XST_FAILURE;
+	}
+	if (xTaskCreate(rpu_ctrl_service, "rpu_ctrl", RPU_CTRL_TASK_STACK, NULL,
+			RPU_CTRL_TASK_PRIORITY, &service_task) != pdPASS) {
+		return XST_FAILURE;
+	}
+
+	/* service task exists before the first IPI can notify it */
+	XIpiPsu_ClearInterruptStatus(&ipi, XIPIPSU_ALL_MASK);
+	if (xPortInstallInterruptHandler(XPAR_XIPIPSU_0_INTERRUPTS, rpu_ctrl_irq, NULL) != pdPASS) {
+		return XST_FAILURE;
+	}
+	XIpiPsu_InterruptEnable(&ipi, RPU_IPI_MASK);
+	vPortEnableInterrupt(XPAR_XIPIPSU_0_INTERRUPTS);
+	return XST_SUCCESS;
+}
+
+BaseType_t rpu_ctrl_submit(rpu_ctrl_req_t *req, TickType_t wait)
+{
+	req->status = RPU_CTRL_PENDING;
+	req->resp_len = 0;
+	req->t_submit = now_ticks();
+	if (req->done == NULL) {
+		req->waiter = xTaskGetCurrentTaskHandle();
+	}
+	if (xQueueSend(cmd_queue, &req, wait) != pdPASS) {
+		__atomic_fetch_add(&stats.queue_full, 1, __ATOMIC_RELAXED);
+		return errQUEUE_FULL;
+	}
+	__atomic_fetch_add(&stats.submitted, 1, __ATOMIC_RELAXED);
+	xTaskNotifyGive(service_task);
+	return pdPASS;
+}
+
+int32_t rpu_ctrl_call(uint32_t cmd, const void *payload, uint32_t len,
+		      void *resp, uint32_t resp_max, uint32_t *resp_len)
+{
+	rpu_ctrl_req_t req;
+
+	memset(&req, 0, sizeof(req));
+	req.cmd = cmd;
+	req.payload = payload;
+	req.len = len;
+	req.resp = resp;
+	req.resp_max = resp_max;
+	(void)rpu_ctrl_submit(&req, portMAX_DELAY);
+
+	/* completion is guaranteed (timeout sweep), so wait without a limit */
+	while (__atomic_load_n(&req.status, __ATOMIC_ACQUIRE) == RPU_CTRL_PENDING) {
+		(void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
+	if (resp_len != NULL) {
+		*resp_len = req.resp_len;
+	}
+	return req.status;
+}
+
+int32_t rpu_ctrl_read_mux(uint8_t *mux_val)
+{
+	uint8_t resp[3] = { 0 };
+	uint32_t n = 0;
+	int32_t rc = rpu_ctrl_call(RPU_CMD_READ_MUX, NULL, 0, resp, sizeof(resp), &n);
+
+	if (rc == XST_SUCCESS && n == sizeof(resp) && mux_val != NULL) {
+		*mux_val = resp[2];
+	}
+	return rc;
+}
+
+/* One ring slot at most; larger tables go through the chunked upload commands */
+int32_t rpu_ctrl_load_presets(const uint8_t *cfg, uint32_t len)
+{
+	return rpu_ctrl_call(RPU_CMD_LOAD_PRESETS, cfg, len, NULL, 0, NULL);
+}
+
+int32_t rpu_ctrl_set_preset(uint8_t preset)
+{
+	return rpu_ctrl_call(RPU_CMD_SET_PRESET, &preset, 1, NULL, 0, NULL);
+}
+
+int32_t rpu_ctrl_sample_seq(uint32_t echoes, uint32_t scans, uint32_t t_end)
+{
+	uint32_t args[3] = { echoes, scans, t_end };
+	return rpu_ctrl_call(RPU_CMD_SAMPLE_SEQ, args, sizeof(args), NULL, 0, NULL);
+}
+
+int32_t rpu_ctrl_switch_stats(rpu_ctrl_switch_stats_t *st, rpu_ctrl_switch_record_t *log,
+			      uint32_t max, uint32_t *n)
+{
+	uint8_t resp[IPI_RING_SLOT_PAYLOAD];
+	uint32_t len = 0;
+	uint32_t got;
+	uint8_t want = (max < SWITCH_STATS_RESET) ? (uint8_t)max : SWITCH_STATS_RESET - 1;
+	int32_t rc = rpu_ctrl_call(RPU_CMD_SWITCH_STATS, &want, 1, resp, sizeof(resp), &len);
+
+	if (n != NULL) {
+		*n = 0;
+	}
+	if (rc != XST_SUCCESS) {
+		return rc;
+	}
+	if (len < sizeof(*st)) {
+		return XST_FAILURE;
+	}
+	memcpy(st, resp, sizeof(*st));
+	got = (len - sizeof(*st)) / sizeof(rpu_ctrl_switch_record_t);
+	if (got > max) {
+		got = max;
+	}
+	if (got) {
+		memcpy(log, resp + sizeof(*st), got * sizeof(rpu_ctrl_switch_record_t));
+	}
+	if (n != NULL) {
+		*n = got;
+	}
+	return XST_SUCCESS;
+}
+
+int32_t rpu_ctrl_switch_reset(void)
+{
+	uint8_t reset = SWITCH_STATS_RESET;
+	return rpu_ctrl_call(RPU_CMD_SWITCH_STATS, &reset, 1, NULL, 0, NULL);
+}
+
+int32_t rpu_ctrl_log_mode(uint8_t mode, rpu_ctrl_log_info_t *info)
+{
+	rpu_ctrl_log_info_t out;
+	uint32_t n = 0;
+	int32_t rc = rpu_ctrl_call(RPU_CMD_LOG_MODE, &mode, 1, &out, sizeof(out), &n);
+
+	if (rc == XST_SUCCESS && n != sizeof(out)) {
+		rc = XST_FAILURE;
+	}
+	if (rc == XST_SUCCESS && info != NULL) {
+		*info = out;
+	}
+	return rc;
+}
+
+int32_t rpu_ctrl_log_attach(void)
+{
+	rpu_ctrl_log_info_t info;
+	dlog_ring_t *r;
+	int32_t rc;
+
+	/* locate and check the ring first; the R5 keeps draining until the switch */
+	rc = rpu_ctrl_log_mode(LOG_MODE_KEEP, &info);
+	if (rc != XST_SUCCESS) {
+		return rc;
+	}
+	if (info.ring_addr < RPU0_TCM_GLOBAL_BASE ||
+	    info.ring_addr + sizeof(dlog_ring_t) > RPU0_TCM_GLOBAL_BASE + RPU0_TCM_GLOBAL_SIZE) {
+		xil_printf("rpu_ctrl: dlog ring at 0x%08x is outside the RPU0 TCM\r\n", info.ring_addr);
+		return XST_FAILURE;
+	}
+
+	/* The BSP maps TCM and OCM as one cacheable 2 MB block. An A53 line holds
+	   two records, and tail shares one with the R5-owned head, so a write-back
+	   would undo R5 stores: map the block non-cacheable (nothing of ours lives
+	   in OCM). */
+	Xil_SetTlbAttributes(RPU0_TCM_GLOBAL_BASE, NORM_NONCACHE);
+	r = (dlog_ring_t *)(UINTPTR)info.ring_addr;
+	if (r->magic != DLOG_MAGIC || r->version != DLOG_VERSION ||
+	    r->slots != DLOG_SLOTS || r->rec_bytes != sizeof(dlog_rec_t)) {
+		xil_printf("rpu_ctrl: dlog ring layout mismatch (version %d, %d slots of %d bytes)\r\n",
+			   (int)r->version, (int)r->slots, (int)r->rec_bytes);
+		return XST_FAILURE;
+	}
+
+	/* the R5 answers from the context that drains, so tail is ours from here;
+	   drops up to now were the R5's to report */
+	rc = rpu_ctrl_log_mode(DLOG_CONSUMER_APU, &info);
+	if (rc != XST_SUCCESS) {
+		return rc;
+	}
+	log_dropped_reported = info.dropped;
+	__atomic_store_n(&log_ring, r, __ATOMIC_RELEASE);
+	return XST_SUCCESS;
+}
+
+/* Same consume/free scheme as dlog_drain on the R5 */
+uint32_t rpu_ctrl_log_drain(uint32_t max)
+{
+	dlog_ring_t *r = __atomic_load_n(&log_ring, __ATOMIC_ACQUIRE);
+	uint32_t dropped;
+	uint32_t n = 0;
+
+	if (r == NULL) {
+		return 0;
+	}
+
+	dropped = r->dropped;
+	if (dropped != log_dropped_reported && max) {
+		xil_printf(log_fmt[DLOG_DROPPED], (int)(dropped - log_dropped_reported));
+		xil_printf("\r\n");
+		log_dropped_reported = dropped;
+		n++;
+	}
+
+	while (n < max) {
+		uint32_t pos = r->tail;
+		dlog_rec_t *rec = &r->recs[pos & LOG_MASK];
+		uint32_t a[DLOG_MAX_ARGS];
+		uint16_t id;
+
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+			break;
+		}
+		id = rec->id;
+		for (uint32_t i = 0; i < DLOG_MAX_ARGS; ++i) {
+			a[i] = (i < rec->nargs) ? rec->args[i] : 0;
+		}
+		/* free the slot before the slow UART part */
+		__atomic_store_n(&rec->seq, pos + DLOG_SLOTS, __ATOMIC_RELEASE);
+		r->tail = pos + 1;
+
+		if (id < DLOG_NUM_MESSAGES) {
+			xil_printf(log_fmt[id], a[0], a[1], a[2], a[3]);
+			xil_printf("\r\n");
+		} else {
+			xil_printf("dlog: unknown id %d\r\n", (int)id);
+		}
+		n++;
+	}
+	return n;
+}
+
+int32_t rpu_ctrl_log_detach(void)
+{
+	__atomic_store_n(&log_ring, NULL, __ATOMIC_RELEASE);
+	return rpu_ctrl_log_mode(DLOG_CONSUMER_RPU, NULL);
+}
+
+void rpu_ctrl_get_stats(rpu_ctrl_stats_t *out)
+{
+	taskENTER_CRITICAL();
+	*out = stats;
+	taskEXIT_CRITICAL();
+}
+
+void rpu_ctrl_reset_stats(void)
+{
+	taskENTER_CRITICAL();
+	memset(&stats, 0, sizeof(stats));
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,149 @@
+/********************************************************************************************
+ * rpu_ctrl.h - APU-side controller for the R5 aperture tuner
+ *
+ * Requests travel over the batched command rings shared with the R5
+ * (ipi_ring.h, 0x7FFF0000). One service task owns both rings: it moves
+ * submitted requests into the request ring, rings the R5 doorbell once per
+ * batch, and matches responses back to their request by sequence number.
+ * Any task may submit; submitters block (back-pressure) when the command
+ * queue is full.
+ ********************************************************************************************/
+#ifndef RPU_CTRL_H
+#define RPU_CTRL_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "ipi_ring.h"
+
+/* R5 command ids (R5_app/src/R5_main.c) */
+#define RPU_CMD_READ_MUX		1
+#define RPU_CMD_LOAD_PRESETS		2
+#define RPU_CMD_SET_PRESET		3
+#define RPU_CMD_SAMPLE_SEQ		4
+#define RPU_CMD_QUERY_STATS		5
+#define RPU_CMD_EVENT_STATS		13
+#define RPU_CMD_LOG_MODE		14
+#define RPU_CMD_ECHO			15
+#define RPU_CMD_SWITCH_STATS		16
+
+#define RPU_CTRL_QUEUE_DEPTH		32	/* submitted, not yet in the ring */
+#define RPU_CTRL_MAX_INFLIGHT		32	/* in the ring, awaiting a response; power of two */
+#define RPU_CTRL_TASK_PRIORITY		(configMAX_PRIORITIES - 2)
+#define RPU_CTRL_TASK_STACK		(configMINIMAL_STACK_SIZE * 4)
+#define RPU_CTRL_DEFAULT_TIMEOUT_MS	1000
+#define RPU_CTRL_ATTACH_TIMEOUT_MS	5000	/* R5 must have stamped the ring region by then */
+
+/* Request status codes besides the R5 handler result (XST_*) */
+#define RPU_CTRL_PENDING		(-1)
+#define RPU_CTRL_ERR_TIMEOUT		(-2)
+#define RPU_CTRL_ERR_RING		(-3)	/* payload larger than a ring slot */
+
+typedef struct rpu_ctrl_req rpu_ctrl_req_t;
+typedef void (*rpu_ctrl_done_fn)(rpu_ctrl_req_t *req);
+
+/* Caller-owned. Must stay valid until completion: the service task always
+   completes a request, with RPU_CTRL_ERR_TIMEOUT if the R5 never answers. */
+struct rpu_ctrl_req {
+	uint32_t cmd;
+	const void *payload;
+	uint32_t len;
+	void *resp;			/* may be NULL */
+	uint32_t resp_max;
+	uint32_t timeout_ms;		/* 0 = RPU_CTRL_DEFAULT_TIMEOUT_MS */
+	rpu_ctrl_done_fn done;		/* service task context; NULL = notify `waiter` */
+	void *user;
+
+	/* filled in by the service */
+	volatile int32_t status;	/* RPU_CTRL_PENDING until completed */
+	uint32_t resp_len;
+	uint32_t seq;
+	uint64_t t_submit;		/* XTime */
+	uint64_t t_done;
+	TaskHandle_t waiter;
+};
+
+typedef struct {
+	uint32_t submitted;
+	uint32_t completed;
+	uint32_t errors;		/* R5 handler returned non-zero */
+	uint32_t timeouts;
+	uint32_t stray;			/* response with no matching request (late or bogus seq) */
+	uint32_t queue_full;		/* submit gave up waiting for queue space */
+	uint32_t doorbells;		/* IPIs sent to the R5 */
+	uint32_t irqs;			/* IPIs received */
+	uint32_t max_inflight;
+	uint64_t rtt_min;		/* XTime ticks, submit -> completion */
+	uint64_t rtt_max;
+	uint64_t rtt_total;
+} rpu_ctrl_stats_t;
+
+/* Command 16 response, layout of R5_app/src/preset_switch.h. Times in R5 XTime ticks. */
+typedef struct {
+	uint8_t preset;
+	uint8_t xfers;			/* bus transactions issued */
+	uint8_t failed;			/* transactions NACKed/aborted */
+	uint8_t from_isr;		/* 1 = kicked from the GPIO ISR */
+	uint32_t edge_ticks;		/* low 32 bits of XTime at the GPIO edge */
+	uint32_t latency_ticks;		/* edge -> last expander ACK */
+} rpu_ctrl_switch_record_t;
+
+typedef struct {
+	uint32_t count;			/* completed retunes */
+	uint32_t errors;		/* retunes with at least one failed transaction */
+	uint32_t dropped;		/* requests that could not be queued */
+	uint32_t worst_ticks;
+	uint32_t last_ticks;
+	uint32_t ticks_per_us;
+} rpu_ctrl_switch_stats_t;
+
+/* Command 14 response */
+typedef struct {
+	uint32_t ring_addr;		/* dlog ring in the APU map (RPU0 TCM global alias) */
+	uint32_t consumer;		/* DLOG_CONSUMER_* */
+	uint32_t written;
+	uint32_t dropped;
+} rpu_ctrl_log_info_t;
+
+/* Initialise the IPI channel, wait for the R5 rings and start the service task.
+   Call from a task (blocks while the R5 boots). Returns XST_SUCCESS or XST_FAILURE. */
+int rpu_ctrl_init(void);
+
+/* Queue a request. Blocks up to `wait` ticks for queue space; returns pdPASS or
+   errQUEUE_FULL (request not taken). */
+BaseType_t rpu_ctrl_submit(rpu_ctrl_req_t *req, TickType_t wait);
+
+/* Submit and wait for completion. Returns the request status. */
+int32_t rpu_ctrl_call(uint32_t cmd, const void *payload, uint32_t len,
+		      void *resp, uint32_t resp_max, uint32_t *resp_len);
+
+/* Commands 1-4 */
+int32_t rpu_ctrl_read_mux(uint8_t *mux_val);
+int32_t rpu_ctrl_load_presets(const uint8_t *cfg, uint32_t len);
+int32_t rpu_ctrl_set_preset(uint8_t preset);
+int32_t rpu_ctrl_sample_seq(uint32_t echoes, uint32_t scans, uint32_t t_end);
+
+/* Command 16: R5 retune stats plus up to `max` of the most recent records
+   (oldest first) in `log`, which may be NULL with max 0. Returns the status;
+   records copied in *n. */
+int32_t rpu_ctrl_switch_stats(rpu_ctrl_switch_stats_t *st, rpu_ctrl_switch_record_t *log,
+			      uint32_t max, uint32_t *n);
+int32_t rpu_ctrl_switch_reset(void);
+
+/* Command 14: set the R5 log consumer (DLOG_CONSUMER_*, 0xFE keeps it). `info` may be NULL. */
+int32_t rpu_ctrl_log_mode(uint8_t mode, rpu_ctrl_log_info_t *info);
+
+/* Deferred log reader. Attach makes the A53 the consumer of the R5 dlog ring and
+   reads it in place; drain prints up to `max` records (one task only) and
+   returns the number printed; detach hands the ring back to the R5 idle hook.
+   Drain and detach from the same task.
+   Attach returns XST_SUCCESS, the command status, or XST_FAILURE if the ring
+   header does not match A53_app/src/dlog.h. */
+int32_t rpu_ctrl_log_attach(void);
+uint32_t rpu_ctrl_log_drain(uint32_t max);
+int32_t rpu_ctrl_log_detach(void);
+
+void rpu_ctrl_get_stats(rpu_ctrl_stats_t *out);
+void rpu_ctrl_reset_stats(void);
+
+#endif
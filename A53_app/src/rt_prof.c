@@ -0,0 +1,94 @@
+/********************************************************************************************
+ * rt_prof.c - periodic run-time profile of the APU FreeRTOS tasks and interrupts (see rt_prof.h)
+ ********************************************************************************************/
+
+#include <string.h>
+#include "xil_printf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "port_prof.h"
+#include "rt_prof.h"
+
+#define HEX_BYTES_PER_LINE	32
+
+static uint8_t snap[portPROF_SNAPSHOT_MAX] __attribute__((aligned(8)));
+
+/* previous report, for per-interval figures */
+static uint64_t prev_time;
+static uint64_t prev_isr_time;
+static uint64_t prev_run[portPROF_MAX_TASKS];
+static uint64_t prev_switches[portPROF_MAX_TASKS];
+
+static uint32_t counts_to_us(uint64_t counts, uint64_t hz)
+{
+	return hz ? (uint32_t)(counts * 1000000U / hz) : 0;
+}
+
+/* share of `span` in hundredths of a percent */
+static uint32_t share_x100(uint64_t part, uint64_t span)
+{
+	return span ? (uint32_t)(part * 10000U / span) : 0;
+}
+
+static void dump_hex(const PortProfHeader_t *h, size_t len)
+{
+	xil_printf("PROF %d %d\r\n", (int)h->ulSequence, (int)len);
+	for (size_t i = 0; i < len; i += HEX_BYTES_PER_LINE) {
+		size_t n = (len - i < HEX_BYTES_PER_LINE) ? len - i : HEX_BYTES_PER_LINE;
+		for (size_t j = 0; j < n; ++j) {
+			xil_printf("%02x", snap[i + j]);
+		}
+		xil_printf("\r\n");
+	}
+	xil_printf("PROF END\r\n");
+}
+
+void rt_prof_report(int hex)
+{
+	const PortProfHeader_t *h = (const PortProfHeader_t *)snap;
+	const PortProfTask_t *t;
+	const PortProfIrq_t *irq;
+	size_t len = xPortProfSnapshot(snap, sizeof(snap), pdTRUE);
+	uint64_t span, isr;
+
+	if (len == 0) {
+		xil_printf("prof: snapshot failed (more than %d tasks?)\r\n", (int)portPROF_MAX_TASKS);
+		return;
+	}
+
+	span = h->ullTimestamp - prev_time;
+	isr = h->ullIsrTime - prev_isr_time;
+	xil_printf("prof #%d: %d ms, %d switches total, isr %d.%02d%%\r\n",
+		   (int)h->ulSequence, (int)(counts_to_us(span, h->ullCounterHz) / 1000U),
+		   (int)h->ullSwitchCount, (int)(share_x100(isr, span) / 100),
+		   (int)(share_x100(isr, span) % 100));
+
+	t = (const PortProfTask_t *)(h + 1);
+	for (uint32_t i = 0; i < h->usTaskCount; ++i, ++t) {
+		uint32_t slot = t->ulTaskNumber < portPROF_MAX_TASKS ? t->ulTaskNumber : 0;
+		uint32_t cpu = share_x100(t->ullRunTime - prev_run[slot], span);
+		uint32_t avg = t->ullReadyCount ?
+			       counts_to_us(t->ullReadyLatencyTotal / t->ullReadyCount, h->ullCounterHz) : 0;
+
+		xil_printf("  %-10s pri %d cpu %2d.%02d%% sw %6d ready->run us avg %d max %d stack %d\r\n",
+			   t->cName, (int)t->ulPriority, (int)(cpu / 100), (int)(cpu % 100),
+			   (int)(t->ullSwitchesIn - prev_switches[slot]), (int)avg,
+			   (int)counts_to_us(t->ullReadyLatencyMax, h->ullCounterHz),
+			   (int)t->ulStackHighWater);
+		prev_run[slot] = t->ullRunTime;
+		prev_switches[slot] = t->ullSwitchesIn;
+	}
+
+	irq = (const PortProfIrq_t *)t;
+	for (uint32_t i = 0; i < h->usIrqCount; ++i, ++irq) {
+		xil_printf("  irq %3d: %8d calls, %d us since boot, max %d us\r\n", (int)irq->ulIrqId,
+			   (int)irq->ullCount, (int)counts_to_us(irq->ullTime, h->ullCounterHz),
+			   (int)counts_to_us(irq->ulMaxTime, h->ullCounterHz));
+	}
+
+	prev_time = h->ullTimestamp;
+	prev_isr_time = h->ullIsrTime;
+	if (hex) {
+		dump_hex(h, len);
+	}
+}
@@ -0,0 +1,20 @@
+/********************************************************************************************
+ * rt_prof.h - periodic run-time profile of the APU FreeRTOS tasks and interrupts
+ *
+ * Takes a port_prof snapshot (BSP, ARM_CA53/port_prof.h) and reports it over the
+ * UART twice: as a readable per-task summary of the last interval, and as the
+ * raw binary snapshot in a hex frame
+ *
+ *     PROF <seq> <bytes>
+ *     <up to 32 bytes per line, hex>
+ *     PROF END
+ *
+ * which a host tool can decode and diff against the previous frame.
+ ********************************************************************************************/
+#ifndef RT_PROF_H
+#define RT_PROF_H
+
+/* hex = 0 prints only the summary. Latency and IRQ maxima restart after each report. */
+void rt_prof_report(int hex);
+
+#endif
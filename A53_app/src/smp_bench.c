@@ -0,0 +1,122 @@
+/********************************************************************************************
+ * smp_bench.c - throughput scaling of a data-processing job across 1..4 A53 cores
+ ********************************************************************************************/
+
+#include <string.h>
+#include "xiltimer.h"
+#include "xil_printf.h"
+#include "apu_smp.h"
+#include "smp_bench.h"
+
+#define CHUNK_SAMPLES	(SMP_BENCH_SAMPLES / SMP_BENCH_CHUNKS)
+
+typedef struct {
+	uint32_t first;
+	uint32_t sum;			/* checksum of this chunk's output */
+} chunk_t;
+
+static int16_t samples[SMP_BENCH_SAMPLES + SMP_BENCH_TAPS];
+static int16_t filtered[SMP_BENCH_SAMPLES];
+static chunk_t chunks[SMP_BENCH_CHUNKS];
+static apu_job_t jobs[SMP_BENCH_CHUNKS];
+
+static const int16_t taps[SMP_BENCH_TAPS] = {
+	-31, -87, -112, 64, 533, 1229, 1877, 2223, 2223, 1877, 1229, 533, 64, -112, -87, -31
+};
+
+static void fir_chunk(void *arg)
+{
+	chunk_t *c = arg;
+	uint32_t sum = 0;
+
+	for (uint32_t i = c->first; i < c->first + CHUNK_SAMPLES; ++i) {
+		int32_t acc = 0;
+		for (uint32_t t = 0; t < SMP_BENCH_TAPS; ++t) {
+			acc += (int32_t)samples[i + t] * taps[t];
+		}
+		filtered[i] = (int16_t)(acc >> 14);
+		sum = (sum << 1 | sum >> 31) ^ (uint16_t)filtered[i];
+	}
+	c->sum = sum;
+}
+
+static uint32_t run_once(void)
+{
+	uint32_t sum = 0;
+
+	for (uint32_t i = 0; i < SMP_BENCH_CHUNKS; ++i) {
+		chunks[i].first = i * CHUNK_SAMPLES;
+		jobs[i].fn = fir_chunk;
+		jobs[i].arg = &chunks[i];
+		jobs[i].affinity = APU_SMP_ALL_CORES;
+	}
+	apu_smp_run(jobs, SMP_BENCH_CHUNKS);
+	for (uint32_t i = 0; i < SMP_BENCH_CHUNKS; ++i) {
+		sum = (sum << 3 | sum >> 29) ^ chunks[i].sum;
+	}
+	return sum;
+}
+
+int smp_bench_run(smp_bench_result_t *out, uint32_t max_results, uint32_t *n_results)
+{
+	uint32_t online = apu_smp_online_mask();
+	uint32_t seed = 0x1234567U, n = 0;
+	int mismatch = 0;
+
+	for (uint32_t i = 0; i < SMP_BENCH_SAMPLES + SMP_BENCH_TAPS; ++i) {
+		seed = seed * 1664525U + 1013904223U;
+		samples[i] = (int16_t)(seed >> 16);
+	}
+
+	/* cores are added in order: 0, 0+1, 0+1+2, ... */
+	for (uint32_t cores = 1; cores <= APU_SMP_MAX_CORES && n < max_results; ++cores) {
+		uint32_t mask = (1U << cores) - 1;
+		smp_bench_result_t *r = &out[n];
+		XTime t0, t1;
+
+		if ((online & mask) != mask) {
+			break;
+		}
+		apu_smp_set_active_mask(mask);
+		apu_smp_reset_stats();
+		memset(r, 0, sizeof(*r));
+		r->cores = cores;
+
+		(void)run_once();		/* warm the caches */
+		XTime_GetTime(&t0);
+		for (uint32_t rep = 0; rep < SMP_BENCH_REPS; ++rep) {
+			r->checksum = run_once();
+		}
+		XTime_GetTime(&t1);
+
+		r->elapsed_ticks = t1 - t0;
+		if (r->elapsed_ticks) {
+			r->ksamples_per_sec = (uint32_t)((uint64_t)SMP_BENCH_SAMPLES * SMP_BENCH_REPS *
+							 (COUNTS_PER_SECOND / 1000U) / r->elapsed_ticks);
+		}
+		r->speedup_x100 = (out[0].elapsed_ticks && r->elapsed_ticks) ?
+				  (uint32_t)(out[0].elapsed_ticks * 100U / r->elapsed_ticks) : 100U;
+		for (uint32_t c = 0; c < APU_SMP_MAX_CORES; ++c) {
+			apu_smp_core_stats_t st;
+			apu_smp_get_stats(c, &st);
+			r->per_core_jobs[c] = st.jobs_run;
+		}
+		if (r->checksum != out[0].checksum) {
+			mismatch = 1;
+		}
+		n++;
+	}
+
+	apu_smp_set_active_mask(online);
+	*n_results = n;
+	return mismatch ? -1 : 0;
+}
+
+void smp_bench_print(const smp_bench_result_t *r)
+{
+	xil_printf("smp bench %d core(s): %d ksamples/s, speedup %d.%02dx, jobs %d/%d/%d/%d, sum %08x\r\n",
+		   (int)r->cores, (int)r->ksamples_per_sec,
+		   (int)(r->speedup_x100 / 100), (int)(r->speedup_x100 % 100),
+		   (int)r->per_core_jobs[0], (int)r->per_core_jobs[1],
+		   (int)r->per_core_jobs[2], (int)r->per_core_jobs[3], (unsigned)r->checksum);
+}
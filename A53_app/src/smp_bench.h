@@ -0,0 +1,32 @@
+/********************************************************************************************
+ * smp_bench.h - throughput scaling of a data-processing job across 1..4 A53 cores
+ *
+ * A 16-tap FIR over a block of 16-bit samples, split into chunk jobs and run
+ * through apu_smp with 1, 2, 3 and 4 cores active. Every run must produce the
+ * same output checksum as the single-core run.
+ ********************************************************************************************/
+#ifndef SMP_BENCH_H
+#define SMP_BENCH_H
+
+#include <stdint.h>
+
+#define SMP_BENCH_SAMPLES	(256 * 1024)
+#define SMP_BENCH_CHUNKS	64
+#define SMP_BENCH_TAPS		16
+#define SMP_BENCH_REPS		4
+
+typedef struct {
+	uint32_t cores;
+	uint64_t elapsed_ticks;		/* XTime, all reps */
+	uint32_t ksamples_per_sec;
+	uint32_t speedup_x100;		/* against the first (single-core) run */
+	uint32_t checksum;
+	uint32_t per_core_jobs[4];
+} smp_bench_result_t;
+
+/* Runs every core count from 1 to the number online; returns 0 if all checksums match */
+int smp_bench_run(smp_bench_result_t *out, uint32_t max_results, uint32_t *n_results);
+
+void smp_bench_print(const smp_bench_result_t *r);
+
+#endif
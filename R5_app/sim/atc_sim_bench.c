@@ -0,0 +1,579 @@
+/* atc_sim_bench.c - host benchmark / regression check for the retune path
+   Runs aperture_tuning.c against the simulated bus (sim_i2c.c):
+     - precompute time per preset (host clock)
+     - bus transactions, bytes and bus time per preset switch for the full,
+       delta, async and fan-out executors, checking every expander's output
+       registers against the precomputed payload after each switch
+     - NACK and clock-stretch injection: the failing expander must be left
+       stale and repaired by the next apply
+   - readback verify: bus overhead at a 30% budget, and silent corruptions
+       (ACKed but latched wrong) caught and repaired on the blocking and
+       async paths
+   - topology upload: malformed descriptors are rejected without touching the
+       active map, then the same benchmarks run on a larger loaded topology
+   - deferred log: cost of a dlog post against formatting the same line, ring
+       overflow accounting and A53-style draining of the shared ring
+   Exit status is non-zero if any check failed.
+
+   usage: atc_sim_bench [-n switches] [-s seed] [-r wire_log.txt] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "aperture_tuning.h"
+#include "dlog.h"
+#include "sim_i2c.h"
+
+#define BENCH_DEFAULT_SWITCHES  1000
+#define BENCH_PRECOMPUTE_REPS   2000
+#define BENCH_RECORD_SWITCHES   8       /* switches per mode written to the wire log */
+#define BENCH_DLOG_REPS         200000
+
+#define MODE_FULL       0   /* shadow dropped before every apply: whole program */
+#define MODE_DELTA      1   /* blocking executor, changed expanders only */
+#define MODE_ASYNC      2   /* async queue, drained by platform_i2c_service */
+#define MODE_FANOUT     3   /* buses spread over two controllers */
+
+static const char *const mode_names[] = { "full", "delta", "async", "fanout" };
+
+static aperture_channel_config_t presets[MAX_PRESETS][ATC_MAX_CHANNELS];
+
+/* expander index -> where it sits, learned from the compiled program */
+static struct { uint8_t bus; uint8_t addr; } topo[ATC_MAX_EXPANDERS];
+static uint8_t num_ex, num_ch;     /* active topology */
+
+static uint32_t rng_state = 1;
+static int failures = 0;
+static FILE *record = NULL;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void check(int ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/* half the channels follow preset 0, so deltas have something to skip */
+static void make_presets(void)
+{
+    for (int p = 0; p < MAX_PRESETS; ++p) {
+        for (int c = 0; c < num_ch; ++c) {
+            if (p > 0 && (rng() & 1)) {
+                presets[p][c] = presets[0][c];
+                continue;
+            }
+            presets[p][c].tuning = (uint8_t)(rng() & 0x7F);
+            presets[p][c].matching = (uint8_t)(rng() & 0x0F);
+            presets[p][c].detune_enable = (uint8_t)(rng() & 1);
+        }
+    }
+}
+
+static void learn_topology(void)
+{
+    const atc_prog_op_t *ops;
+    uint8_t n;
+    num_ex = atc_num_io_expanders();
+    num_ch = atc_num_channels();
+    atc_get_program(0, &ops, &n);
+    for (uint8_t i = 0; i < n; ++i) {
+        if (ops[i].expander == ATC_OP_MUX) continue;
+        topo[ops[i].expander].bus = ops[i].bus;
+        topo[ops[i].expander].addr = ops[i].xfer.addr;
+    }
+}
+
+/* expanders whose output registers differ from preset p */
+static uint32_t stale_mask(uint8_t p)
+{
+    uint32_t mask = 0;
+    for (uint8_t ex = 0; ex < num_ex; ++ex) {
+        const uint8_t *regs = sim_i2c_regs(topo[ex].bus, topo[ex].addr);
+        const ioexp_payload_t *want = atc_get_payload_ptr(p, ex);
+        uint8_t out = IO_EXP_OUTPUTS_REG & (SIM_I2C_NUM_REGS - 1);
+        if (!regs || memcmp(&regs[out], want->bytes, 3) != 0) mask |= 1u << ex;
+    }
+    return mask;
+}
+
+static void apply(int mode, uint8_t p)
+{
+    switch (mode) {
+    case MODE_FULL:
+        atc_invalidate_shadow();
+        atc_apply_preset_blocking(p);
+        break;
+    case MODE_DELTA:
+    case MODE_FANOUT:
+        atc_apply_preset_blocking(p);
+        break;
+    case MODE_ASYNC:
+        atc_apply_preset_async(p);
+        platform_i2c_service();
+        break;
+    }
+}
+
+static void record_log(const char *title)
+{
+    if (!record) return;
+    fprintf(record, "# %s\n", title);
+    sim_i2c_log_dump(record);
+    sim_i2c_log_clear();
+}
+
+static void bench_precompute(void)
+{
+    uint64_t t0 = host_ns();
+    for (int r = 0; r < BENCH_PRECOMPUTE_REPS; ++r) {
+        atc_precompute_sets(presets, MAX_PRESETS);
+    }
+    uint64_t ns = host_ns() - t0;
+    printf("precompute: %u presets x %u expanders, %.1f ns/preset\n",
+           (unsigned)MAX_PRESETS, (unsigned)num_ex,
+           (double)ns / ((double)BENCH_PRECOMPUTE_REPS * MAX_PRESETS));
+}
+
+static void bench_switch(int mode, uint32_t switches)
+{
+    uint64_t xfers = 0, bytes = 0, bus_ns = 0, host = 0, max_bus_ns = 0;
+    uint32_t mismatches = 0;
+    uint8_t p = 0;
+
+    sim_i2c_set_fanout(mode == MODE_FANOUT);
+    atc_reset_latency_stats();
+    sim_i2c_log_clear();
+    for (uint32_t i = 0; i < switches; ++i) {
+        uint8_t next = (uint8_t)(rng() % MAX_PRESETS);
+        if (next == p) next = (uint8_t)((next + 1) % MAX_PRESETS);
+        p = next;
+
+        sim_i2c_stats_t st;
+        sim_i2c_clear_stats();
+        uint64_t t0 = host_ns();
+        apply(mode, p);
+        host += host_ns() - t0;
+        sim_i2c_get_stats(&st);
+
+        xfers += st.transactions;
+        bytes += st.bytes;
+        bus_ns += st.bus_ns;
+        if (st.bus_ns > max_bus_ns) max_bus_ns = st.bus_ns;
+        if (stale_mask(p)) mismatches++;
+        if (i + 1 == BENCH_RECORD_SWITCHES) record_log(mode_names[mode]);
+    }
+    sim_i2c_set_fanout(0);
+
+    printf("%-7s %6u switches  %5.2f xfers  %6.1f bytes  bus %7.1f us (max %7.1f)  host %6.0f ns\n",
+           mode_names[mode], (unsigned)switches,
+           (double)xfers / switches, (double)bytes / switches,
+           (double)bus_ns / switches / 1000.0, (double)max_bus_ns / 1000.0,
+           (double)host / switches);
+    if (mode == MODE_ASYNC) {
+        uint64_t total = 0, count = 0;
+        for (uint8_t q = 0; q < MAX_PRESETS; ++q) {
+            const atc_latency_stat_t *ls = atc_get_latency_stat(q);
+            total += ls->total_us;
+            count += ls->count;
+        }
+        printf("        atc latency stats agree: %.1f us/switch\n",
+               count ? (double)total / (double)count : 0.0);
+    }
+    char what[64];
+    snprintf(what, sizeof(what), "%s: %u switches left expanders stale",
+             mode_names[mode], (unsigned)mismatches);
+    check(mismatches == 0, what);
+}
+
+/* a preset that changes expander `ex` from what it holds now */
+static uint8_t preset_changing(uint8_t ex)
+{
+    for (uint8_t p = 0; p < MAX_PRESETS; ++p) {
+        if (stale_mask(p) & (1u << ex)) return p;
+    }
+    return 0;
+}
+
+/* fault on expander `ex` while moving to preset p; the next apply must repair it */
+static void fault_case(const char *name, int mode, uint8_t ex, uint8_t p)
+{
+    sim_i2c_stats_t st;
+
+    apply(mode, p);
+    sim_i2c_nack_next(topo[ex].bus, topo[ex].addr, 0);
+    uint32_t stale = stale_mask(p);
+    sim_i2c_clear_stats();
+    apply(mode, p);
+    sim_i2c_get_stats(&st);
+
+    printf("%-22s stale after fault 0x%02x, repair %u xfers, stale after repair 0x%02x\n",
+           name, (unsigned)stale, (unsigned)st.transactions, (unsigned)stale_mask(p));
+    check(stale == (1u << ex), name);
+    check(stale_mask(p) == 0, name);
+    record_log(name);
+}
+
+static void fault_scenarios(void)
+{
+    uint8_t ex = num_ex - 1;
+    uint8_t bus = topo[ex].bus, addr = topo[ex].addr;
+    sim_i2c_stats_t st;
+
+    /* start from a known state with every expander written */
+    apply(MODE_FULL, 0);
+    sim_i2c_log_clear();
+
+    sim_i2c_nack_next(bus, addr, 1);
+    fault_case("nack (blocking)", MODE_FULL, ex, preset_changing(ex));
+
+    sim_i2c_nack_next(bus, addr, 1);
+    fault_case("nack (async)", MODE_ASYNC, ex, preset_changing(ex));
+
+    /* stretching within the timeout only costs time */
+    uint8_t p = preset_changing(ex);
+    sim_i2c_clear_stats();
+    apply(MODE_FULL, p);
+    sim_i2c_get_stats(&st);
+    uint64_t base_ns = st.bus_ns;
+    sim_i2c_set_stretch(bus, addr, 20000);
+    sim_i2c_clear_stats();
+    apply(MODE_FULL, p);
+    sim_i2c_get_stats(&st);
+    printf("%-22s bus %.1f us -> %.1f us\n", "stretch 20 us/byte",
+           (double)base_ns / 1000.0, (double)st.bus_ns / 1000.0);
+    check(stale_mask(p) == 0, "stretch within timeout");
+    record_log("stretch 20 us/byte");
+
+    /* past the timeout the write is abandoned */
+    p = preset_changing(ex);
+    sim_i2c_set_stretch(bus, addr, PLATFORM_I2C_BUS_FREE_TIMEOUT_US * 1000u);
+    apply(MODE_DELTA, p);
+    uint32_t stale = stale_mask(p);
+    sim_i2c_set_stretch(bus, addr, 0);
+    apply(MODE_DELTA, p);
+    printf("%-22s stale after fault 0x%02x, stale after repair 0x%02x\n",
+           "stretch past timeout", (unsigned)stale, (unsigned)stale_mask(p));
+    check(stale == (1u << ex), "stretch past timeout");
+    check(stale_mask(p) == 0, "stretch past timeout repair");
+    record_log("stretch past timeout");
+}
+
+/* delta switches with verify at `pct`; returns bus time */
+static uint64_t verify_run_switches(uint8_t pct, uint32_t switches, uint32_t seed)
+{
+    sim_i2c_stats_t st;
+    uint8_t p = 0;
+
+    rng_state = seed;
+    atc_set_verify(pct);
+    apply(MODE_FULL, 0);
+    sim_i2c_clear_stats();
+    for (uint32_t i = 0; i < switches; ++i) {
+        uint8_t next = (uint8_t)(rng() % MAX_PRESETS);
+        if (next == p) next = (uint8_t)((next + 1) % MAX_PRESETS);
+        p = next;
+        atc_apply_preset_blocking(p);
+    }
+    sim_i2c_get_stats(&st);
+    check(stale_mask(p) == 0, "verify switches");
+    return st.bus_ns;
+}
+
+static void verify_scenarios(uint32_t switches)
+{
+    atc_verify_stats_t vs;
+    uint32_t seed = rng_state;
+    uint8_t ex = num_ex - 1;
+    uint8_t bus = topo[ex].bus, addr = topo[ex].addr;
+
+    /* the same switch sequence without and with verify */
+    uint64_t base_ns = verify_run_switches(ATC_VERIFY_OFF, switches, seed);
+    atc_reset_verify_stats();
+    uint64_t budget_ns = verify_run_switches(30, switches, seed);
+    atc_get_verify_stats(&vs);
+    double overhead = 100.0 * (double)(budget_ns - base_ns) / (double)base_ns;
+    printf("%-22s %u reads over %u switches, bus overhead %.1f%%\n", "verify 30%",
+           (unsigned)vs.reads, (unsigned)switches, overhead);
+    check(overhead <= 30.0, "verify 30% stays within budget");
+    check(vs.reads >= num_ex, "verify rotation covers every expander");
+    check(vs.corruptions == 0 && vs.read_errors == 0, "verify on a clean bus");
+
+    uint64_t all_ns = verify_run_switches(ATC_VERIFY_ALL, switches, seed);
+    printf("%-22s bus overhead %.1f%%\n", "verify all",
+           100.0 * (double)(all_ns - base_ns) / (double)base_ns);
+
+    /* silent corruption on the blocking path: caught and rewritten inline */
+    atc_reset_verify_stats();
+    uint8_t p = preset_changing(ex);
+    sim_i2c_corrupt_next(bus, addr, 0x01);
+    atc_apply_preset_blocking(p);
+    atc_get_verify_stats(&vs);
+    printf("%-22s corruptions %u repaired %u, stale after 0x%02x\n", "corrupt (blocking)",
+           (unsigned)vs.corruptions, (unsigned)vs.repaired, (unsigned)stale_mask(p));
+    check(vs.corruptions == 1 && vs.repaired == 1 && stale_mask(p) == 0, "corrupt (blocking)");
+    record_log("corrupt (blocking)");
+
+    /* async path: verified from the main loop once the queue drained */
+    atc_reset_verify_stats();
+    p = preset_changing(ex);
+    sim_i2c_corrupt_next(bus, addr, 0x80);
+    atc_apply_preset_async(p);
+    platform_i2c_service();
+    uint32_t stale = stale_mask(p);
+    int wrong = atc_verify_service();
+    atc_get_verify_stats(&vs);
+    printf("%-22s stale before verify 0x%02x, corruptions %u repaired %u, stale after 0x%02x\n",
+           "corrupt (async)", (unsigned)stale, (unsigned)vs.corruptions, (unsigned)vs.repaired,
+           (unsigned)stale_mask(p));
+    check(stale == (1u << ex) && wrong == 0 && vs.repaired == 1 && stale_mask(p) == 0,
+          "corrupt (async)");
+    record_log("corrupt (async)");
+
+    /* a failed readback drops the shadow: the next apply rewrites the expander */
+    atc_reset_verify_stats();
+    sim_i2c_nack_next(bus, addr, 1);
+    atc_verify_now();
+    atc_get_verify_stats(&vs);
+    uint8_t rewritten;
+    atc_apply_preset_delta(p, &rewritten);
+    platform_i2c_service();
+    printf("%-22s read errors %u, stale after 0x%02x\n", "verify read nack",
+           (unsigned)vs.read_errors, (unsigned)stale_mask(p));
+    check(vs.read_errors == 1 && stale_mask(p) == 0, "verify read nack");
+
+    atc_set_verify(ATC_VERIFY_OFF);
+    rng_state = seed;
+}
+
+/* descriptor builder: header, expanders, then channel 0 (TX) and the RX channels */
+static uint32_t topo_desc(uint8_t *d, uint8_t nex, const uint8_t *bus, const uint8_t *addr,
+                          uint8_t nch, const uint8_t *chan_ex, const uint8_t *chan_slot)
+{
+    uint32_t n = 0;
+    d[n++] = ATC_TOPO_VERSION;
+    d[n++] = nex;
+    d[n++] = (uint8_t)(nch - 1);
+    d[n++] = 0;
+    for (uint8_t e = 0; e < nex; ++e) {
+        d[n++] = bus[e];
+        d[n++] = addr[e];
+    }
+    for (uint8_t c = 0; c < nch; ++c) {
+        d[n++] = chan_ex[c];
+        d[n++] = chan_slot[c];
+    }
+    return n;
+}
+
+static void reject_case(const char *name, const uint8_t *d, uint32_t len, int want)
+{
+    int rc = atc_load_topology(d, len);
+    printf("%-22s rc %d\n", name, rc);
+    check(rc == want, name);
+    check(atc_num_io_expanders() == num_ex && atc_num_channels() == num_ch, name);
+}
+
+/* every expander on all four buses at 0x20.., TX on the last expander's A slot */
+static void topology_scenario(uint32_t switches)
+{
+    uint8_t bus[ATC_MAX_EXPANDERS], addr[ATC_MAX_EXPANDERS];
+    uint8_t chan_ex[ATC_MAX_CHANNELS], chan_slot[ATC_MAX_CHANNELS];
+    uint8_t d[ATC_TOPO_HDR_BYTES + 2 * ATC_MAX_EXPANDERS + 2 * ATC_MAX_CHANNELS];
+    const uint8_t nex = 24, nch = 1 + 2 * (nex - 1);
+
+    for (uint8_t e = 0; e < nex; ++e) {
+        bus[e] = e % PLATFORM_I2C_NUM_BUSES;
+        addr[e] = (uint8_t)(0x20 + e / PLATFORM_I2C_NUM_BUSES);
+    }
+    chan_ex[0] = nex - 1;
+    chan_slot[0] = 0;
+    for (uint8_t c = 1; c < nch; ++c) {
+        chan_ex[c] = (uint8_t)((c - 1) / 2);
+        chan_slot[c] = (uint8_t)((c - 1) & 1);
+    }
+    uint32_t len = topo_desc(d, nex, bus, addr, nch, chan_ex, chan_slot);
+
+    /* each malformed copy must leave the built-in topology in place */
+    uint8_t bad[sizeof(d)];
+    memcpy(bad, d, len);
+    bad[0] = ATC_TOPO_VERSION + 1;
+    reject_case("topo bad version", bad, len, ATC_TOPO_ERR_FORMAT);
+    reject_case("topo truncated", d, len - 1, ATC_TOPO_ERR_FORMAT);
+    memcpy(bad, d, len);
+    bad[ATC_TOPO_HDR_BYTES] = PLATFORM_I2C_NUM_BUSES;
+    reject_case("topo bad bus", bad, len, ATC_TOPO_ERR_BUS);
+    memcpy(bad, d, len);
+    bad[ATC_TOPO_HDR_BYTES + 1] = PLATFORM_I2C_MUX_ADDR;
+    reject_case("topo mux address", bad, len, ATC_TOPO_ERR_ADDR);
+    memcpy(bad, d, len);
+    bad[ATC_TOPO_HDR_BYTES + 2] = bad[ATC_TOPO_HDR_BYTES];
+    bad[ATC_TOPO_HDR_BYTES + 3] = bad[ATC_TOPO_HDR_BYTES + 1];
+    reject_case("topo duplicate", bad, len, ATC_TOPO_ERR_DUP);
+    memcpy(bad, d, len);
+    bad[ATC_TOPO_HDR_BYTES + 2 * nex] = nex;
+    reject_case("topo bad channel", bad, len, ATC_TOPO_ERR_CHANNEL);
+    memcpy(bad, d, len);
+    bad[ATC_TOPO_HDR_BYTES + 2 * nex] = 0;    /* TX onto channel 1's slot */
+    reject_case("topo slot clash", bad, len, ATC_TOPO_ERR_SLOT);
+
+    for (uint8_t e = 0; e < nex; ++e) sim_i2c_add_device(bus[e], addr[e]);
+    check(atc_load_topology(d, len) == 0, "topology load");
+    check(atc_apply_preset_blocking(0) == -1, "presets dropped with the old topology");
+    num_ch = atc_num_channels();
+    make_presets();
+    check(atc_precompute_sets(presets, MAX_PRESETS) == 0, "precompute on loaded topology");
+    learn_topology();
+    check(num_ex == nex && num_ch == nch, "loaded topology size");
+    printf("loaded topology: %u expanders, %u channels\n", (unsigned)num_ex, (unsigned)num_ch);
+    record_log("topology load");
+
+    bench_precompute();
+    bench_switch(MODE_FULL, switches);
+    bench_switch(MODE_DELTA, switches);
+    bench_switch(MODE_ASYNC, switches);
+    bench_switch(MODE_FANOUT, switches);
+    fault_scenarios();
+}
+
+/* Read the ring the way the A53 does: records in order, slot handed back */
+static uint32_t dlog_consume_as_apu(uint32_t expect_first, uint32_t max)
+{
+    dlog_ring_t *r = (dlog_ring_t *)dlog_ring();
+    uint32_t n = 0;
+    while (n < max) {
+        dlog_rec_t *rec = &r->recs[r->tail & (r->slots - 1)];
+        if (rec->seq != r->tail + 1) break;
+        check(rec->id == DLOG_SEQ_DONE && rec->nargs == 2 && rec->args[0] == expect_first + n &&
+              rec->args[1] == ~(expect_first + n), "dlog record content / order");
+        rec->seq = r->tail + r->slots;
+        r->tail++;
+        n++;
+    }
+    return n;
+}
+
+static void dlog_scenario(void)
+{
+    char line[96];
+    volatile size_t sink = 0;
+    uint64_t t0, post_ns, fmt_ns;
+
+    dlog_init();
+    check(dlog_ring()->magic == DLOG_MAGIC && dlog_ring()->slots == DLOG_SLOTS, "dlog header");
+    dlog_set_consumer(DLOG_CONSUMER_APU);
+
+    /* hot path cost: one post vs. formatting the line (UART time not included) */
+    uint32_t seq = 0;
+    post_ns = 0;
+    for (uint32_t done = 0; done < BENCH_DLOG_REPS; ) {
+        uint32_t burst = DLOG_SLOTS;
+        t0 = host_ns();
+        for (uint32_t i = 0; i < burst; ++i) {
+            DLOG2(DLOG_SEQ_DONE, seq + i, ~(seq + i));
+        }
+        post_ns += host_ns() - t0;
+        check(dlog_consume_as_apu(seq, burst) == burst, "dlog apu drain count");
+        seq += burst;
+        done += burst;
+    }
+    t0 = host_ns();
+    for (uint32_t i = 0; i < seq; ++i) {
+        sink += (size_t)snprintf(line, sizeof(line), dlog_format(DLOG_SEQ_DONE), (int)i, (int)~i);
+    }
+    fmt_ns = host_ns() - t0;
+    printf("dlog: post %.1f ns, snprintf of the same line %.1f ns (host; 115200 baud UART "
+           "adds ~%u us for it)\n", (double)post_ns / seq, (double)fmt_ns / seq,
+           (unsigned)(strlen(line) + 2) * 87);
+
+    /* overflow: newest records are dropped and counted, older ones survive */
+    for (uint32_t i = 0; i < DLOG_SLOTS + 10; ++i) {
+        int rc = DLOG2(DLOG_SEQ_DONE, seq + i, ~(seq + i));
+        check(rc == (i < DLOG_SLOTS ? 0 : -2), "dlog post result at capacity");
+    }
+    check(dlog_ring()->dropped == 10, "dlog dropped count");
+    check(dlog_drain(8) == 0 && dlog_pending() == 0, "dlog: R5 leaves an APU-owned ring alone");
+    check(dlog_consume_as_apu(seq, DLOG_SLOTS) == DLOG_SLOTS, "dlog survivors after overflow");
+    check(DLOG0(DLOG_NUM_MESSAGES) == -1, "dlog rejects unknown id");
+
+    /* back to the R5: the drop report comes first, then the records */
+    dlog_set_consumer(DLOG_CONSUMER_RPU);
+    DLOG1(DLOG_PRESET_CHANGE, 7);
+    check(dlog_pending() == 1, "dlog pending after handback");
+    check(dlog_drain(8) == 2 && dlog_pending() == 0, "dlog R5 drain");
+    (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t switches = BENCH_DEFAULT_SWITCHES;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            switches = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            rng_state = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            record = fopen(argv[++i], "w");
+            if (!record) {
+                perror(argv[i]);
+                return 2;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [-n switches] [-s seed] [-r wire_log.txt]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (switches == 0) switches = 1;
+
+    sim_i2c_reset();
+    platform_i2c_init(0);
+    num_ch = atc_num_channels();
+    make_presets();
+    if (atc_precompute_sets(presets, MAX_PRESETS) != 0) {
+        printf("FAIL: precompute\n");
+        return 1;
+    }
+    learn_topology();
+    for (uint8_t ex = 0; ex < num_ex; ++ex) {
+        sim_i2c_add_device(topo[ex].bus, topo[ex].addr);
+    }
+
+    atc_init();
+    for (uint8_t ex = 0; ex < num_ex; ++ex) {
+        const uint8_t *regs = sim_i2c_regs(topo[ex].bus, topo[ex].addr);
+        uint8_t cfg = IO_EXP_CONFIG_REG & (SIM_I2C_NUM_REGS - 1);
+        uint8_t inv = IO_EXP_INVERT_REG & (SIM_I2C_NUM_REGS - 1);
+        check(regs[cfg] == 0x00 && regs[cfg + 2] == 0x00 &&
+              regs[inv] == 0xFF && regs[inv + 2] == 0xFF, "atc_init expander setup");
+    }
+    record_log("atc_init");
+
+    bench_precompute();
+    platform_i2c_async_init(0);
+    bench_switch(MODE_FULL, switches);
+    bench_switch(MODE_DELTA, switches);
+    bench_switch(MODE_ASYNC, switches);
+    bench_switch(MODE_FANOUT, switches);
+    fault_scenarios();
+    verify_scenarios(switches);
+    topology_scenario(switches);
+    dlog_scenario();
+
+    if (record) fclose(record);
+    printf("%s (%d failed checks)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
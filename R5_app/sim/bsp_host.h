@@ -0,0 +1,31 @@
+/* bsp_host.h - force-included (-include) into the host build of the real
+   platform_i2c.c and AXI IIC driver sources (i2c_async_sim). Takes the include
+   guards of the two BSP headers that touch the hardware directly and supplies
+   host versions: register accesses go to the AXI IIC model in i2c_async_sim.c,
+   CPSR and CP15 accesses to a plain variable. */
+#ifndef BSP_HOST_H
+#define BSP_HOST_H
+
+#include "xil_types.h"
+#include "xreg_cortexr5.h"
+
+/* xpseudo_asm.h */
+#define XPSEUDO_ASM_H
+extern u32 sim_cpsr;
+#define mfcpsr()        (sim_cpsr)
+#define mtcpsr(v)       (sim_cpsr = (v))
+#define mfcp(reg)       0U
+#define mtcp(reg, v)    ((void)(v))
+#define dsb()
+#define isb()
+#define dmb()
+
+/* xil_io.h */
+#define XIL_IO_H
+#define INLINE inline
+#include "xil_printf.h"
+#include "xstatus.h"
+u32 Xil_In32(UINTPTR Addr);
+void Xil_Out32(UINTPTR Addr, u32 Value);
+
+#endif
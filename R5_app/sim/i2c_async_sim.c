@@ -0,0 +1,359 @@
+/* i2c_async_sim.c - host regression check for the async I2C engine
+   Builds the real platform_i2c.c and the BSP AXI IIC driver (xiic*.c) against
+   a register-level model of the AXI IIC core, so the driver's own interrupt
+   dispatch is what routes events to the engine:
+     - plain batch: every transaction on the wire once, in order
+     - bus busy at the kick (a STOP still on the wire): the engine waits for
+       the bus-not-busy event and resumes by itself
+     - bus taken again between that event and the restart: still resumes
+     - arbitration lost: the transaction is failed and reported, the batch
+       goes on once the other master releases the bus
+   Any driver assert (an event routed to an unset handler) fails the run.
+   Exit status is non-zero if any check failed.
+
+   usage: i2c_async_sim */
+#include <stdio.h>
+#include <string.h>
+#include "xparameters.h"
+#include "xiic.h"
+#include "xiic_l.h"
+#include "xiicps.h"
+#include "xil_exception.h"
+#include "platform_i2c.h"
+
+#define IIC_BASE        XPAR_XIIC_0_BASEADDR
+#define IIC_REG_SPAN    0x200u
+#define WIRE_MAX        64
+#define STEP_LIMIT      200
+
+#define CPSR_SYS        0x1Fu
+#define CPSR_IRQ        0x12u
+
+u32 sim_cpsr = CPSR_SYS;
+u32 Xil_AssertStatus;
+s32 Xil_AssertWait;
+
+static int failures = 0;
+static int asserts = 0;
+
+#define CHECK(cond, ...) do {                 \
+        if (!(cond)) {                        \
+            printf("  FAIL: " __VA_ARGS__);   \
+            printf("\n");                     \
+            failures++;                       \
+        }                                     \
+    } while (0)
+
+/* ---------------- AXI IIC model ----------------
+   IISR is toggle-on-write, except TX empty, TX half empty and bus-not-busy:
+   those follow their condition (the driver enables BNB right after a START
+   and relies on it staying low until the STOP). The wire only moves in
+   hw_step(), so each test decides what happens between two interrupts. */
+
+#define HW_LEVEL_INTRS  (XIIC_INTR_TX_EMPTY_MASK | XIIC_INTR_TX_HALF_MASK | XIIC_INTR_BNB_MASK)
+
+typedef struct {
+    uint8_t addr;
+    uint8_t len;
+    uint8_t buf[PLATFORM_I2C_XFER_MAX_BYTES];
+} wire_xfer_t;
+
+static struct {
+    u32 isr, ier, gie, cr, rfd;
+    uint8_t fifo[IIC_TX_FIFO_DEPTH];
+    unsigned n;
+    int master;             /* START issued, we hold the bus */
+    int other_busy;         /* another master, or our STOP still on the wire */
+    int arb_next;           /* lose arbitration on the next address phase */
+    int regrab_sr_reads;    /* SR reads until another master grabs the bus again */
+    wire_xfer_t cur;
+    wire_xfer_t wire[WIRE_MAX];
+    unsigned nwire;
+} hw;
+
+static uint64_t clock_ns;
+
+/* xiltimer.h (sim): every read moves time on, so bounded spins end */
+uint64_t sim_i2c_now_ns(void)
+{
+    clock_ns += 1000;
+    return clock_ns;
+}
+
+static int hw_bus_busy(void)
+{
+    return hw.master || hw.other_busy;
+}
+
+static void hw_levels(void)
+{
+    hw.isr &= ~HW_LEVEL_INTRS;
+    if (hw.n == 0) hw.isr |= XIIC_INTR_TX_EMPTY_MASK;
+    if (hw.n <= IIC_TX_FIFO_DEPTH / 2) hw.isr |= XIIC_INTR_TX_HALF_MASK;
+    if (!hw_bus_busy()) hw.isr |= XIIC_INTR_BNB_MASK;
+}
+
+static void hw_reset(void)
+{
+    hw.isr = hw.ier = hw.gie = hw.cr = hw.rfd = 0;
+    hw.n = 0;
+    hw.master = 0;
+}
+
+u32 Xil_In32(UINTPTR addr)
+{
+    u32 off = (u32)(addr - IIC_BASE);
+
+    hw_levels();
+    switch (off) {
+    case XIIC_DGIER_OFFSET:  return hw.gie;
+    case XIIC_IISR_OFFSET:   return hw.isr;
+    case XIIC_IIER_OFFSET:   return hw.ier;
+    case XIIC_CR_REG_OFFSET: return hw.cr;
+    case XIIC_RFD_REG_OFFSET: return hw.rfd;
+    case XIIC_TFO_REG_OFFSET: return hw.n ? hw.n - 1 : 0;
+    case XIIC_SR_REG_OFFSET:
+        if (hw.regrab_sr_reads && --hw.regrab_sr_reads == 0) hw.other_busy = 1;
+        return (hw_bus_busy() ? XIIC_SR_BUS_BUSY_MASK : 0) |
+               (hw.n ? 0 : XIIC_SR_TX_FIFO_EMPTY_MASK) |
+               (hw.n == IIC_TX_FIFO_DEPTH ? XIIC_SR_TX_FIFO_FULL_MASK : 0) |
+               XIIC_SR_RX_FIFO_EMPTY_MASK;
+    default:
+        return 0;
+    }
+}
+
+void Xil_Out32(UINTPTR addr, u32 v)
+{
+    u32 off = (u32)(addr - IIC_BASE);
+
+    if (off >= IIC_REG_SPAN) return;
+    switch (off) {
+    case XIIC_DGIER_OFFSET:  hw.gie = v; break;
+    case XIIC_IISR_OFFSET:   hw.isr ^= v; break;
+    case XIIC_IIER_OFFSET:   hw.ier = v; break;
+    case XIIC_RFD_REG_OFFSET: hw.rfd = v; break;
+    case XIIC_RESETR_OFFSET:
+        if (v == XIIC_RESET_MASK) hw_reset();
+        break;
+    case XIIC_CR_REG_OFFSET:
+        if (v & XIIC_CR_TX_FIFO_RESET_MASK) hw.n = 0;
+        if ((v & XIIC_CR_MSMS_MASK) && !(hw.cr & XIIC_CR_MSMS_MASK)) {
+            hw.master = 1;          /* START */
+            hw.cur.addr = 0xFF;
+            hw.cur.len = 0;
+        }
+        hw.cr = v;
+        break;
+    case XIIC_DTR_REG_OFFSET:
+        if (hw.n < IIC_TX_FIFO_DEPTH) hw.fifo[hw.n++] = (uint8_t)v;
+        break;
+    default:
+        break;
+    }
+    hw_levels();
+}
+
+/* move the wire: drain the TX FIFO, STOP once MSMS is dropped and it is empty */
+static void hw_step(void)
+{
+    if (hw.master && hw.n) {
+        if (hw.arb_next && hw.cur.addr == 0xFF) {
+            /* the other master wins the address phase and keeps the bus */
+            hw.arb_next = 0;
+            hw.isr |= XIIC_INTR_ARB_LOST_MASK;
+            hw.cr &= ~XIIC_CR_MSMS_MASK;
+            hw.n = 0;
+            hw.master = 0;
+            hw.other_busy = 1;
+            return;
+        }
+        for (unsigned i = 0; i < hw.n; ++i) {
+            if (hw.cur.addr == 0xFF) {
+                hw.cur.addr = hw.fifo[i] >> 1;
+            } else if (hw.cur.len < PLATFORM_I2C_XFER_MAX_BYTES) {
+                hw.cur.buf[hw.cur.len++] = hw.fifo[i];
+            }
+        }
+        hw.n = 0;
+    }
+    if (hw.master && !(hw.cr & XIIC_CR_MSMS_MASK) && hw.n == 0) {
+        hw.master = 0;              /* STOP */
+        if (hw.nwire < WIRE_MAX) hw.wire[hw.nwire++] = hw.cur;
+        hw.cur.addr = 0xFF;
+    }
+    hw_levels();
+}
+
+static int hw_irq_pending(void)
+{
+    hw_levels();
+    return (hw.gie & XIIC_GINTR_ENABLE_MASK) && (hw.isr & hw.ier);
+}
+
+/* run the wire and the IRQ until the engine idles, or STEP_LIMIT passes */
+static void run(unsigned steps)
+{
+    for (unsigned s = 0; s < steps; ++s) {
+        hw_step();
+        for (int guard = 0; guard < 16 && hw_irq_pending(); ++guard) {
+            sim_cpsr = CPSR_IRQ | XIL_EXCEPTION_IRQ;
+            platform_i2c_intr_handler(NULL);
+            sim_cpsr = CPSR_SYS;
+        }
+        if (!platform_i2c_async_busy()) return;
+    }
+}
+
+/* ---------------- BSP pieces outside the AXI IIC driver ---------------- */
+
+void Xil_Assert(const char8 *file, s32 line)
+{
+    printf("  driver assert at %s:%d\n", file, (int)line);
+    asserts++;
+}
+
+XIicPs_Config *XIicPs_LookupConfig(u32 BaseAddress) { (void)BaseAddress; return NULL; }
+s32 XIicPs_CfgInitialize(XIicPs *I, XIicPs_Config *C, u32 A) { (void)I; (void)C; (void)A; return XST_FAILURE; }
+void XIicPs_Reset(XIicPs *I) { (void)I; }
+s32 XIicPs_SetSClk(XIicPs *I, u32 F) { (void)I; (void)F; return XST_FAILURE; }
+void XIicPs_SetStatusHandler(XIicPs *I, void *R, XIicPs_IntrHandler H) { (void)I; (void)R; (void)H; }
+void XIicPs_MasterSend(XIicPs *I, u8 *M, s32 B, u16 A) { (void)I; (void)M; (void)B; (void)A; }
+void XIicPs_MasterInterruptHandler(XIicPs *I) { (void)I; }
+void XIicPs_Abort(XIicPs *I) { (void)I; }
+s32 XIicPs_BusIsBusy(XIicPs *I) { (void)I; return 0; }
+
+/* ---------------- tests ---------------- */
+
+static int cb_calls;
+static uint8_t cb_failed;
+
+static void batch_done(void *ref, uint8_t failed)
+{
+    (void)ref;
+    cb_calls++;
+    cb_failed = failed;
+}
+
+static const platform_i2c_xfer_t batch[] = {
+    { PLATFORM_I2C_MUX_ADDR, 1, { 0x04 } },
+    { 0x20, 4, { 0x84, 0x11, 0x22, 0x33 } },
+    { 0x21, 2, { 0x04, 0x55 } },
+};
+#define BATCH_LEN ((uint8_t)(sizeof(batch) / sizeof(batch[0])))
+
+static void start_case(const char *name)
+{
+    printf("%s\n", name);
+    hw.nwire = 0;
+    hw.cur.addr = 0xFF;
+    hw.other_busy = 0;
+    hw.arb_next = 0;
+    hw.regrab_sr_reads = 0;
+    cb_calls = 0;
+    cb_failed = 0xFF;
+    asserts = 0;
+}
+
+/* wire[from..] must hold batch[first..] in order */
+static void check_wire(unsigned from, unsigned first)
+{
+    CHECK(hw.nwire - from == BATCH_LEN - first, "%u transactions on the wire, expected %u",
+          hw.nwire - from, BATCH_LEN - first);
+    for (unsigned i = 0; i < hw.nwire - from && first + i < BATCH_LEN; ++i) {
+        const wire_xfer_t *w = &hw.wire[from + i];
+        const platform_i2c_xfer_t *x = &batch[first + i];
+        CHECK(w->addr == x->addr && w->len == x->len && memcmp(w->buf, x->buf, x->len) == 0,
+              "wire transaction %u is 0x%02x/%u, expected 0x%02x/%u",
+              i, w->addr, w->len, x->addr, x->len);
+    }
+}
+
+static void finish_case(uint8_t want_failed)
+{
+    CHECK(!platform_i2c_async_busy(), "engine still busy");
+    CHECK(cb_calls == 1, "batch callback ran %d times", cb_calls);
+    CHECK(cb_failed == want_failed, "batch reported %u failed, expected %u", cb_failed, want_failed);
+    CHECK(asserts == 0, "%d driver asserts", asserts);
+}
+
+static void test_plain(void)
+{
+    start_case("plain batch");
+    CHECK(platform_i2c_submit(batch, BATCH_LEN, batch_done, NULL) == 0, "submit failed");
+    run(STEP_LIMIT);
+    check_wire(0, 0);
+    finish_case(0);
+}
+
+static void test_bus_busy(void)
+{
+    start_case("bus busy at the kick, resumed on bus-not-busy");
+    hw.other_busy = 1;
+    CHECK(platform_i2c_submit(batch, BATCH_LEN, batch_done, NULL) == 0, "submit failed");
+    run(20);
+    CHECK(hw.nwire == 0 && platform_i2c_async_busy(), "started while the bus was busy");
+    hw.other_busy = 0;
+    run(STEP_LIMIT);
+    check_wire(0, 0);
+    finish_case(0);
+}
+
+static void test_regrab(void)
+{
+    start_case("bus taken again before the restart");
+    hw.other_busy = 1;
+    CHECK(platform_i2c_submit(batch, BATCH_LEN, batch_done, NULL) == 0, "submit failed");
+    run(20);
+    /* released; the next interrupt reads SR once itself, the restart's bus
+       check is the second read: the other master is back by then */
+    hw.other_busy = 0;
+    hw.regrab_sr_reads = 2;
+    run(20);
+    CHECK(hw.nwire == 0 && platform_i2c_async_busy(), "started while the bus was busy");
+    hw.other_busy = 0;
+    run(STEP_LIMIT);
+    check_wire(0, 0);
+    finish_case(0);
+}
+
+static void test_arb_lost(void)
+{
+    platform_i2c_trace_rec_t rec[PLATFORM_I2C_TRACE_DEPTH];
+    uint32_t seq = platform_i2c_trace_total();
+
+    start_case("arbitration lost on the first transaction");
+    hw.arb_next = 1;
+    CHECK(platform_i2c_submit(batch, BATCH_LEN, batch_done, NULL) == 0, "submit failed");
+    run(20);
+    CHECK(hw.nwire == 0 && platform_i2c_async_busy(),
+          "went on while the other master held the bus");
+    hw.other_busy = 0;
+    run(STEP_LIMIT);
+    check_wire(0, 1);
+    finish_case(1);
+
+    uint32_t n = platform_i2c_trace_read(&seq, rec, PLATFORM_I2C_TRACE_DEPTH);
+    CHECK(n == BATCH_LEN, "%u trace records, expected %u", n, BATCH_LEN);
+    CHECK(n > 0 && rec[0].op == PLATFORM_I2C_OP_ASYNC && rec[0].result == PLATFORM_I2C_SEG_ARB_LOST,
+          "first transaction not traced as arbitration lost");
+}
+
+int main(void)
+{
+    hw.cur.addr = 0xFF;
+    if (platform_i2c_init(IIC_BASE) != XST_SUCCESS ||
+        platform_i2c_async_init(1) != XST_SUCCESS) {
+        printf("FAIL: platform_i2c init\n");
+        return 1;
+    }
+
+    test_plain();
+    test_bus_busy();
+    test_regrab();
+    test_arb_lost();
+    test_plain();       /* nothing left behind by the fault cases */
+
+    printf("%s (%d failed checks)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,8 @@
+/* xil_printf.h - host stand-in for the standalone BSP header */
+#ifndef XIL_PRINTF_H
+#define XIL_PRINTF_H
+#include <stdio.h>
+
+#define xil_printf printf
+
+#endif
@@ -0,0 +1,18 @@
+/* xiltimer.h - host stand-in: XTime reads the simulated bus clock (ns), so
+   latencies measured by the code under test are bus time, not host time */
+#ifndef XILTIMER_H
+#define XILTIMER_H
+#include <stdint.h>
+
+typedef uint64_t XTime;
+
+#define COUNTS_PER_SECOND 1000000000u
+
+uint64_t sim_i2c_now_ns(void);
+
+static inline void XTime_GetTime(XTime *t)
+{
+    *t = sim_i2c_now_ns();
+}
+
+#endif
@@ -0,0 +1,559 @@
+/* sim_i2c.c - simulated I2C bus behind the platform_i2c.h API */
+#include "sim_i2c.h"
+#include <string.h>
+
+#define BIT_NS      (1000000000u / SIM_I2C_SCL_HZ)
+#define TIMEOUT_NS  ((uint64_t)PLATFORM_I2C_BUS_FREE_TIMEOUT_US * 1000u)
+#define QUEUE_MASK  (PLATFORM_I2C_QUEUE_DEPTH - 1)
+
+typedef struct {
+    uint8_t chan;
+    uint8_t addr;
+    uint8_t regs[SIM_I2C_NUM_REGS];
+    uint32_t nack_next;
+    uint32_t stretch_ns;
+    uint8_t corrupt_xor;    /* applied to the next data byte latched, then cleared */
+} sim_dev_t;
+
+static sim_dev_t devs[SIM_I2C_MAX_DEVICES];
+static uint8_t num_devs = 0;
+
+/* PCA954x: the control byte only takes effect on STOP */
+static uint8_t mux_mask = 0;
+static uint8_t mux_pending = 0;
+static int mux_has_pending = 0;
+
+static int bus_open = 0;          /* START seen, no STOP yet */
+static uint64_t now_ns = 0;
+static sim_i2c_stats_t stats;
+static sim_i2c_event_t wire_log[SIM_I2C_LOG_MAX];
+static uint32_t log_n = 0;
+
+static int g_inited = 0;
+static int fanout_on = 0;
+
+/* async engine: the queue runs to completion on platform_i2c_service() */
+typedef struct {
+    platform_i2c_xfer_t xfer;
+    platform_i2c_done_cb_t cb;
+    void *cb_ref;
+} sim_slot_t;
+
+static sim_slot_t async_queue[PLATFORM_I2C_QUEUE_DEPTH];
+static uint16_t async_head = 0;
+static uint16_t async_tail = 0;
+static uint8_t async_failed = 0;
+static int async_inited = 0;
+
+/* ---------------- model control ---------------- */
+
+void sim_i2c_reset(void)
+{
+    memset(devs, 0, sizeof(devs));
+    num_devs = 0;
+    mux_mask = mux_pending = 0;
+    mux_has_pending = 0;
+    bus_open = 0;
+    now_ns = 0;
+    memset(&stats, 0, sizeof(stats));
+    log_n = 0;
+    fanout_on = 0;
+    async_head = async_tail = 0;
+    async_failed = 0;
+}
+
+static sim_dev_t *find_dev(uint8_t chan, uint8_t addr)
+{
+    for (uint8_t i = 0; i < num_devs; ++i) {
+        if (devs[i].chan == chan && devs[i].addr == addr) return &devs[i];
+    }
+    return NULL;
+}
+
+int sim_i2c_add_device(uint8_t chan, uint8_t addr)
+{
+    if (find_dev(chan, addr)) return 0;
+    if (num_devs >= SIM_I2C_MAX_DEVICES) return -1;
+    sim_dev_t *d = &devs[num_devs++];
+    memset(d, 0, sizeof(*d));
+    d->chan = chan;
+    d->addr = addr;
+    return 0;
+}
+
+uint8_t *sim_i2c_regs(uint8_t chan, uint8_t addr)
+{
+    sim_dev_t *d = find_dev(chan, addr);
+    return d ? d->regs : NULL;
+}
+
+void sim_i2c_nack_next(uint8_t chan, uint8_t addr, uint32_t count)
+{
+    sim_dev_t *d = find_dev(chan, addr);
+    if (d) d->nack_next = count;
+}
+
+void sim_i2c_corrupt_next(uint8_t chan, uint8_t addr, uint8_t xor_mask)
+{
+    sim_dev_t *d = find_dev(chan, addr);
+    if (d) d->corrupt_xor = xor_mask;
+}
+
+void sim_i2c_set_stretch(uint8_t chan, uint8_t addr, uint32_t ns)
+{
+    sim_dev_t *d = find_dev(chan, addr);
+    if (d) d->stretch_ns = ns;
+}
+
+void sim_i2c_set_fanout(int on)
+{
+    fanout_on = on;
+}
+
+uint64_t sim_i2c_now_ns(void)
+{
+    return now_ns;
+}
+
+void sim_i2c_advance_ns(uint64_t ns)
+{
+    now_ns += ns;
+}
+
+void sim_i2c_get_stats(sim_i2c_stats_t *out)
+{
+    *out = stats;
+}
+
+void sim_i2c_clear_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t sim_i2c_log_count(void)
+{
+    return log_n;
+}
+
+const sim_i2c_event_t *sim_i2c_log(void)
+{
+    return wire_log;
+}
+
+void sim_i2c_log_clear(void)
+{
+    log_n = 0;
+}
+
+void sim_i2c_log_dump(FILE *f)
+{
+    for (uint32_t i = 0; i < log_n; ++i) {
+        const sim_i2c_event_t *e = &wire_log[i];
+        switch (e->kind) {
+        case SIM_I2C_EV_START:   fputs("S", f); break;
+        case SIM_I2C_EV_RESTART: fputs(" Sr", f); break;
+        case SIM_I2C_EV_BYTE:    fprintf(f, " %02X%c", e->byte, e->ack ? '+' : '-'); break;
+        case SIM_I2C_EV_STOP:    fputs(" P\n", f); break;
+        }
+    }
+    if (bus_open) fputs("\n", f);
+}
+
+/* ---------------- wire ---------------- */
+
+static void wire_event(uint8_t kind, uint8_t byte, uint8_t ack, uint64_t ns)
+{
+    if (log_n < SIM_I2C_LOG_MAX) {
+        wire_log[log_n].kind = kind;
+        wire_log[log_n].byte = byte;
+        wire_log[log_n].ack = ack;
+        log_n++;
+    }
+    now_ns += ns;
+    stats.bus_ns += ns;
+}
+
+static void wire_start(void)
+{
+    wire_event(bus_open ? SIM_I2C_EV_RESTART : SIM_I2C_EV_START, 0, 0, BIT_NS);
+    bus_open = 1;
+}
+
+static void wire_stop(void)
+{
+    wire_event(SIM_I2C_EV_STOP, 0, 0, BIT_NS);
+    bus_open = 0;
+    stats.stops++;
+    if (mux_has_pending) {
+        mux_mask = mux_pending;
+        mux_has_pending = 0;
+    }
+}
+
+static void wire_byte(uint8_t b, int ack, uint32_t stretch_ns)
+{
+    wire_event(SIM_I2C_EV_BYTE, b, (uint8_t)ack, 9u * BIT_NS + (ack ? stretch_ns : 0));
+}
+
+/* devices answering `addr` through the current mux setting */
+static uint8_t visible(uint8_t addr, sim_dev_t **out)
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < num_devs; ++i) {
+        if (devs[i].addr == addr && (mux_mask & (1u << devs[i].chan))) out[n++] = &devs[i];
+    }
+    return n;
+}
+
+/* address phase: NACKs (and releases the bus) unless some device answers */
+static int wire_address(uint8_t addr, int read, sim_dev_t **vis, uint8_t *nvis, uint32_t *stretch)
+{
+    wire_start();
+    stats.transactions++;
+
+    uint8_t n = (addr == PLATFORM_I2C_MUX_ADDR) ? 0 : visible(addr, vis);
+    int ack = (addr == PLATFORM_I2C_MUX_ADDR) || n > 0;
+    *stretch = 0;
+    for (uint8_t i = 0; i < n; ++i) {
+        if (vis[i]->nack_next) {
+            vis[i]->nack_next--;
+            ack = 0;
+        }
+        if (vis[i]->stretch_ns > *stretch) *stretch = vis[i]->stretch_ns;
+    }
+    wire_byte((uint8_t)((addr << 1) | (read ? 1 : 0)), ack, *stretch);
+    if (!ack) {
+        stats.nacks++;
+        wire_stop();
+    }
+    *nvis = n;
+    return ack;
+}
+
+/* one write: addr+W then buf[0] (command / mux control byte), buf[1..]. Returns
+   PLATFORM_I2C_SEG_*; the bus is released on failure */
+static uint8_t sim_write(uint8_t addr, const uint8_t *buf, uint8_t len, int stop)
+{
+    sim_dev_t *vis[SIM_I2C_MAX_DEVICES];
+    uint8_t n;
+    uint32_t stretch;
+    uint64_t t0 = now_ns;
+
+    if (!wire_address(addr, 0, vis, &n, &stretch)) return PLATFORM_I2C_SEG_NACK;
+
+    uint8_t reg = 0;
+    int auto_inc = 0;
+    for (uint8_t i = 0; i < len; ++i) {
+        wire_byte(buf[i], 1, stretch);
+        stats.bytes++;
+        if (addr == PLATFORM_I2C_MUX_ADDR) {
+            mux_pending = buf[i];
+            mux_has_pending = 1;
+        } else if (i == 0) {
+            reg = buf[0] & (SIM_I2C_NUM_REGS - 1);
+            auto_inc = (buf[0] & SIM_I2C_AUTO_INC) != 0;
+        } else {
+            for (uint8_t k = 0; k < n; ++k) {
+                vis[k]->regs[reg] = buf[i] ^ vis[k]->corrupt_xor;
+                vis[k]->corrupt_xor = 0;
+            }
+            if (auto_inc) reg = (uint8_t)((reg + 1) & (SIM_I2C_NUM_REGS - 1));
+        }
+        if (now_ns - t0 > TIMEOUT_NS) {
+            stats.timeouts++;
+            wire_stop();
+            return PLATFORM_I2C_SEG_TIMEOUT;
+        }
+    }
+    if (stop) wire_stop();
+    return PLATFORM_I2C_SEG_OK;
+}
+
+/* ---------------- platform_i2c.h ---------------- */
+
+int platform_i2c_init(uint32_t axi_iic_device_id)
+{
+    (void)axi_iic_device_id;
+    g_inited = 1;
+    return 0;
+}
+
+void platform_i2c_deinit(void)
+{
+    g_inited = 0;
+}
+
+int platform_i2c_write(uint8_t dev_addr, uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    if (!g_inited) return -1;
+    if (platform_i2c_async_busy()) return -4;
+    if (len > 15) return -2;
+
+    uint8_t txbuf[1 + 16];
+    txbuf[0] = reg;
+    if (len) memcpy(&txbuf[1], data, len);
+    for (int retries = 0; retries <= 2; ++retries) {
+        if (sim_write(dev_addr, txbuf, (uint8_t)(1 + len), 1) == PLATFORM_I2C_SEG_OK) return 0;
+    }
+    return -3;
+}
+
+/* register read: addr+W, reg, Sr, addr+R, len bytes (last one NACKed by the
+   master), P. Returns PLATFORM_I2C_SEG_*; the bus is released either way */
+static uint8_t sim_read(uint8_t addr, uint8_t reg, uint8_t *out, uint8_t len)
+{
+    sim_dev_t *vis[SIM_I2C_MAX_DEVICES];
+    uint8_t n;
+    uint32_t stretch;
+    uint64_t t0 = now_ns;
+
+    uint8_t st = sim_write(addr, &reg, 1, 0);
+    if (st != PLATFORM_I2C_SEG_OK) return st;
+    if (!wire_address(addr, 1, vis, &n, &stretch)) return PLATFORM_I2C_SEG_NACK;
+
+    uint8_t r = reg & (SIM_I2C_NUM_REGS - 1);
+    for (uint8_t i = 0; i < len; ++i) {
+        out[i] = vis[0]->regs[r];
+        wire_byte(out[i], i + 1 < len, stretch);
+        if (reg & SIM_I2C_AUTO_INC) r = (uint8_t)((r + 1) & (SIM_I2C_NUM_REGS - 1));
+        if (now_ns - t0 > TIMEOUT_NS) {
+            stats.timeouts++;
+            wire_stop();
+            return PLATFORM_I2C_SEG_TIMEOUT;
+        }
+    }
+    wire_stop();
+    return PLATFORM_I2C_SEG_OK;
+}
+
+int platform_i2c_read(uint8_t addr7, uint8_t reg, uint16_t *out)
+{
+    uint8_t b[2];
+
+    if (!g_inited) return -1;
+    if (platform_i2c_async_busy()) return -4;
+    if (sim_read(addr7, reg, b, 2) != PLATFORM_I2C_SEG_OK) return -3;
+    *out = (uint16_t)((b[0] << 8) | b[1]);
+    return 0;
+}
+
+int platform_i2c_write_mux(uint8_t bus)
+{
+    if (!g_inited) return -1;
+    if (platform_i2c_async_busy()) return -4;
+    uint8_t b = (uint8_t)(1u << bus);
+    return sim_write(PLATFORM_I2C_MUX_ADDR, &b, 1, 1) == PLATFORM_I2C_SEG_OK ? 0 : -3;
+}
+
+int platform_i2c_read_mux(uint8_t *out)
+{
+    sim_dev_t *vis[SIM_I2C_MAX_DEVICES];
+    uint8_t n;
+    uint32_t stretch;
+
+    if (!g_inited) return -1;
+    if (platform_i2c_async_busy()) return -4;
+    if (!wire_address(PLATFORM_I2C_MUX_ADDR, 1, vis, &n, &stretch)) return -3;
+    wire_byte(mux_mask, 0, 0);
+    wire_stop();
+    *out = mux_mask;
+    return 0;
+}
+
+int platform_i2c_write_batch(const platform_i2c_seg_t *segs, uint8_t count,
+                             uint8_t *seg_status)
+{
+    if (!g_inited) return -1;
+    if (platform_i2c_async_busy()) return -4;
+    if (count == 0 || count > PLATFORM_I2C_BATCH_MAX_SEGS) return -2;
+
+    int failed = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        uint8_t buf[1 + 255];
+        buf[0] = segs[i].reg;
+        if (segs[i].len) memcpy(&buf[1], segs[i].data, segs[i].len);
+        int stop = (segs[i].flags & PLATFORM_I2C_SEG_STOP) || (i + 1 == count);
+        uint8_t st = sim_write(segs[i].addr, buf, (uint8_t)(segs[i].len + 1), stop);
+        if (st != PLATFORM_I2C_SEG_OK) failed++;
+        if (seg_status) seg_status[i] = st;
+    }
+    return failed;
+}
+
+int platform_i2c_read_batch(const platform_i2c_seg_t *segs, uint8_t count,
+                            uint8_t *seg_status)
+{
+    if (!g_inited) return -1;
+    if (count == 0 || count > PLATFORM_I2C_BATCH_MAX_SEGS) return -2;
+    for (uint8_t i = 0; i < count; ++i) {
+        if ((segs[i].flags & PLATFORM_I2C_SEG_READ) && (segs[i].len == 0 || !segs[i].rx)) return -2;
+    }
+    if (platform_i2c_async_busy()) return -4;
+
+    int failed = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        uint8_t st;
+        if (segs[i].flags & PLATFORM_I2C_SEG_READ) {
+            st = sim_read(segs[i].addr, segs[i].reg, segs[i].rx, segs[i].len);
+        } else {
+            uint8_t buf[1 + 255];
+            buf[0] = segs[i].reg;
+            if (segs[i].len) memcpy(&buf[1], segs[i].data, segs[i].len);
+            int stop = (segs[i].flags & PLATFORM_I2C_SEG_STOP) || (i + 1 == count);
+            st = sim_write(segs[i].addr, buf, (uint8_t)(segs[i].len + 1), stop);
+        }
+        if (st != PLATFORM_I2C_SEG_OK) failed++;
+        if (seg_status) seg_status[i] = st;
+    }
+    return failed;
+}
+
+int platform_i2c_async_init(int use_interrupts)
+{
+    (void)use_interrupts;
+    if (!g_inited) return -1;
+    async_head = async_tail = 0;
+    async_failed = 0;
+    async_inited = 1;
+    return 0;
+}
+
+void platform_i2c_mux_xfer(uint8_t bus, platform_i2c_xfer_t *out)
+{
+    out->addr = PLATFORM_I2C_MUX_ADDR;
+    out->len = 1;
+    out->buf[0] = (uint8_t)(1u << bus);
+}
+
+int platform_i2c_submit(const platform_i2c_xfer_t *xfers, uint8_t count,
+                        platform_i2c_done_cb_t cb, void *ref)
+{
+    if (!async_inited) return -1;
+    if (!xfers || count == 0) return -2;
+    if ((uint16_t)(async_tail - async_head) + count > PLATFORM_I2C_QUEUE_DEPTH) return -2;
+
+    for (uint8_t i = 0; i < count; ++i) {
+        sim_slot_t *slot = &async_queue[(async_tail + i) & QUEUE_MASK];
+        slot->xfer = xfers[i];
+        if (slot->xfer.len > PLATFORM_I2C_XFER_MAX_BYTES) slot->xfer.len = PLATFORM_I2C_XFER_MAX_BYTES;
+        slot->cb = (i == count - 1) ? cb : NULL;
+        slot->cb_ref = ref;
+    }
+    async_tail += count;
+    return 0;
+}
+
+int platform_i2c_async_ready(void)
+{
+    return async_inited;
+}
+
+int platform_i2c_async_busy(void)
+{
+    return async_head != async_tail;
+}
+
+void platform_i2c_intr_handler(void *ref)
+{
+    (void)ref;
+    platform_i2c_service();
+}
+
+/* run every queued transaction (each is a MasterSend: own START/STOP) */
+void platform_i2c_service(void)
+{
+    while (async_head != async_tail) {
+        sim_slot_t slot = async_queue[async_head & QUEUE_MASK];
+        if (sim_write(slot.xfer.addr, slot.xfer.buf, slot.xfer.len, 1) != PLATFORM_I2C_SEG_OK) {
+            async_failed++;
+        }
+        async_head++;
+        if (slot.cb) {
+            uint8_t failed = async_failed;
+            async_failed = 0;
+            slot.cb(slot.cb_ref, failed);
+        }
+    }
+}
+
+int platform_i2c_ps_init(void)
+{
+    return 0;
+}
+
+int platform_i2c_set_route(uint8_t bus, uint8_t ctrl, uint8_t mux_chan)
+{
+    (void)mux_chan;
+    if (bus >= PLATFORM_I2C_NUM_BUSES || ctrl >= PLATFORM_I2C_NUM_CTRL) return -1;
+    return 0;
+}
+
+int platform_i2c_fanout_active(void)
+{
+    return fanout_on;
+}
+
+/* same wire pattern as the AXI half of the real fan-out: a STOP-terminated mux
+   select at every bus change, writes chained with repeated START */
+int platform_i2c_fanout(const platform_i2c_xfer_t *xfers, const uint8_t *bus,
+                        uint8_t count, uint8_t *status)
+{
+    platform_i2c_seg_t segs[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t map[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t st[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t n = 0;
+    uint8_t cur = 0xFF;
+
+    if (!g_inited) return -1;
+    if (platform_i2c_async_busy()) return -4;
+    if (count > PLATFORM_I2C_FANOUT_MAX) return -2;
+    if (count == 0) return 0;
+
+    for (uint8_t i = 0; i < count; ++i) {
+        if (bus[i] != cur) {
+            segs[n].addr = PLATFORM_I2C_MUX_ADDR;
+            segs[n].reg = (uint8_t)(1u << bus[i]);
+            segs[n].len = 0;
+            segs[n].data = NULL;
+            segs[n].flags = PLATFORM_I2C_SEG_STOP;
+            map[n++] = 0xFF;
+            cur = bus[i];
+        }
+        segs[n].addr = xfers[i].addr;
+        segs[n].reg = xfers[i].buf[0];
+        segs[n].len = (uint8_t)(xfers[i].len - 1);
+        segs[n].data = &xfers[i].buf[1];
+        segs[n].flags = 0;
+        map[n++] = i;
+    }
+    platform_i2c_write_batch(segs, n, st);
+
+    /* a failed select fails the writes it was routing */
+    int failed = 0;
+    uint8_t sel = PLATFORM_I2C_SEG_OK;
+    for (uint8_t k = 0; k < n; ++k) {
+        if (map[k] == 0xFF) {
+            sel = st[k];
+            continue;
+        }
+        uint8_t r = (sel != PLATFORM_I2C_SEG_OK) ? sel : st[k];
+        if (r != PLATFORM_I2C_SEG_OK) failed++;
+        if (status) status[map[k]] = r;
+    }
+    return failed;
+}
+
+uint32_t platform_i2c_irq_save(void)
+{
+    return 0;
+}
+
+void platform_i2c_irq_restore(uint32_t cpsr)
+{
+    (void)cpsr;
+}
+
+int platform_i2c_in_isr(void)
+{
+    return 0;
+}
@@ -0,0 +1,78 @@
+/* sim_i2c.h - host model of the aperture I2C topology
+   Implements the platform_i2c.h API the tuning code uses against a simulated
+   bus: a PCA954x mux on the root bus, register-file IO expanders behind its
+   channels, a virtual clock advanced by bit times, a byte-level wire log, and
+   NACK / clock-stretch fault injection per device. */
+#ifndef SIM_I2C_H
+#define SIM_I2C_H
+#include <stdint.h>
+#include <stdio.h>
+#include "platform_i2c.h"
+
+#define SIM_I2C_MAX_DEVICES   32
+#define SIM_I2C_NUM_REGS      128          /* command byte bits 6:0 */
+#define SIM_I2C_AUTO_INC      0x80         /* command byte bit 7 (PCAL6524) */
+#define SIM_I2C_LOG_MAX       (1u << 16)   /* wire events kept, oldest first */
+#define SIM_I2C_SCL_HZ        400000u
+
+/* wire log event kinds */
+#define SIM_I2C_EV_START      0
+#define SIM_I2C_EV_RESTART    1
+#define SIM_I2C_EV_BYTE       2
+#define SIM_I2C_EV_STOP       3
+
+typedef struct {
+    uint8_t kind;     /* SIM_I2C_EV_* */
+    uint8_t byte;     /* SIM_I2C_EV_BYTE: value on the wire (addr byte incl. R/W) */
+    uint8_t ack;      /* SIM_I2C_EV_BYTE: 1 = ACK */
+} sim_i2c_event_t;
+
+typedef struct {
+    uint32_t transactions;   /* address phases */
+    uint32_t bytes;          /* data bytes after the address */
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t stops;
+    uint64_t bus_ns;         /* time the bus was driven */
+} sim_i2c_stats_t;
+
+/* Reset the model: no devices, mux on no channel, clock and log cleared */
+void sim_i2c_reset(void);
+
+/* Add an expander at `addr` behind mux channel `chan` (no-op if it is already
+   there). Returns 0, -1 table full. */
+int sim_i2c_add_device(uint8_t chan, uint8_t addr);
+
+/* Register file of the device, NULL if there is none */
+uint8_t *sim_i2c_regs(uint8_t chan, uint8_t addr);
+
+/* NACK the next `count` address phases to the device */
+void sim_i2c_nack_next(uint8_t chan, uint8_t addr, uint32_t count);
+
+/* Silent corruption: the next data byte the device latches is XORed with
+   `xor_mask` (still ACKed) */
+void sim_i2c_corrupt_next(uint8_t chan, uint8_t addr, uint8_t xor_mask);
+
+/* Stretch SCL by `ns` on every byte the device ACKs (0 clears). Stretching past
+   PLATFORM_I2C_BUS_FREE_TIMEOUT_US in one transaction times it out. */
+void sim_i2c_set_stretch(uint8_t chan, uint8_t addr, uint32_t ns);
+
+/* Route logical buses over two controllers so platform_i2c_fanout_active() is 1
+   (the model still has a single wire; fan-out runs the transfers in order) */
+void sim_i2c_set_fanout(int on);
+
+/* Virtual clock */
+uint64_t sim_i2c_now_ns(void);
+void sim_i2c_advance_ns(uint64_t ns);
+
+void sim_i2c_get_stats(sim_i2c_stats_t *out);
+void sim_i2c_clear_stats(void);
+
+/* Wire log: events since the last clear (capped at SIM_I2C_LOG_MAX) */
+uint32_t sim_i2c_log_count(void);
+const sim_i2c_event_t *sim_i2c_log(void);
+void sim_i2c_log_clear(void);
+/* one line per transaction: "S E0+ 01+ P" ('-' marks a NACK) */
+void sim_i2c_log_dump(FILE *f);
+
+#endif
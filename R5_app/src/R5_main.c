@@ -7,7 +7,6 @@
 #include "xipipsu.h"
 #include "xil_cache.h"
 #include "xil_mpu.h"
-#include "sleep.h"
 #include <stdint.h>
 #include <xgpio.h>
 #include <xil_types.h>
@@ -15,6 +14,15 @@
 #include "xiic_l.h"
 #include "aperture_tuning.h"
 #include "platform_i2c.h"
+#include "preset_switch.h"
+#include "sample_seq.h"
+#include "ipi_ring.h"
+#include "ipi_cmd.h"
+#include "event_loop.h"
+#include "dlog.h"
+#include "xiltimer.h"
+#include <string.h>
+#include <stddef.h>
 #include "xgpio.h"
 #include "xgpio_l.h"
 #include <math.h>
@@ -44,9 +52,27 @@ static XGpio   Gpio_Tui_Trigger;
 #define GPIO_CH               1   // channel 2 used for output
 
 #define TUI_TRIGGER_US              500
+/* DDS edge -> I2C program straight from the GPIO ISR (see preset_switch.h) */
+#define PRESET_SWITCH_MODE          PRESET_SWITCH_MODE_ISR
 #define NUM_PRESETS 7
-aperture_channel_config_t presets[NUM_PRESETS][NUM_CHANNELS];
+aperture_channel_config_t presets[NUM_PRESETS][ATC_MAX_CHANNELS];
 #define XPAR_AXI_IIC_0_DEVICE_ID    0
+/* logical expander buses wired to PS I2C1 instead of the AXI IIC mux (bit per
+   bus); 0 on the current board. PS_IIC_MUX_CHAN gives the PCA954x channel on
+   the PS side, or PLATFORM_I2C_NO_MUX if the bus is wired straight */
+#ifndef PS_IIC_BUS_MASK
+#define PS_IIC_BUS_MASK             0
+#endif
+#ifndef PS_IIC_MUX_CHAN
+#define PS_IIC_MUX_CHAN(bus)        PLATFORM_I2C_NO_MUX
+#endif
+/* axi_iic_0 IRQ is not routed in the current XSA; define AXI_IIC_INTR_ID (GIC id)
+   once it is, otherwise the async I2C engine is serviced from the main loop */
+#ifdef AXI_IIC_INTR_ID
+#define AXI_IIC_USE_INTERRUPTS      1
+#else
+#define AXI_IIC_USE_INTERRUPTS      0
+#endif
 
 typedef struct {
     uint32_t magic;    // sanity check, e.g. 0xABCD1234
@@ -56,16 +82,90 @@ typedef struct {
     uint8_t  payload[IPI_MAX_PAYLOAD_BYTES];
 } ipi_msg_t;
 
-volatile bool ipi_message_flag = false;
-ipi_msg_t ipi_buffer;
+#define IPI_MSG_HDR_BYTES           offsetof(ipi_msg_t, payload)
+
+/* Ownership token for the legacy mailbox: set by IpiHandler when a request is
+   posted, cleared by the main loop once the response is written back. While
+   set, the RPU owns the shared slot and reads the payload in place. */
+static ipi_msg_t *volatile ipi_owned_msg = NULL;
+
+/* batched command rings (see ipi_ring.h); legacy ipi_msg_t mailbox still served */
+static ipi_ring_region_t *const ipi_rings = (ipi_ring_region_t *)IPI_RING_BASE_ADDR;
+static ipi_ring_rx_t ipi_req_rx;
+static ipi_ring_tx_t ipi_resp_tx;
+volatile uint8_t ipi_ring_doorbell = 0;   /* ring drain event queued */
+static uint32_t ipi_resp_dropped = 0;
 
 /* ISR-visible state */
 static volatile unsigned irq_count = 0;
 
-/* globals shared between ISR and main */
-volatile uint8_t pending_preset = 0xFF;   /* 0xFF = none */
-volatile uint8_t aperture_tuning_change_flag = 0;
-volatile uint8_t pulse_tui_start_flag = 0;
+/* Work reaches main() as events (see event_loop.h): ISRs post, nothing polls
+   flags. The IPI class holds at most one mailbox and one ring event at a time. */
+#define PRESET_EV_TUI   0x100   /* ev_preset_apply arg flag: pulse TUI trigger after queuing */
+
+static void ev_ipi_mailbox(uint32_t arg);
+static void ev_ipi_ring(uint32_t arg);
+
+/* TUI pulse whose end could not get a timer: main_idle retries, see tui_end_service */
+static uint8_t tui_end_deferred = 0;
+static uint32_t tui_pulse_start;
+
+static void ev_tui_end(uint32_t arg)
+{
+    (void)arg;
+    XGpio_DiscreteWrite(&Gpio_Tui_Trigger, GPIO_CH, 0);
+}
+
+static inline uint32_t tui_now_ticks(void)
+{
+    XTime t;
+    XTime_GetTime(&t);
+    return (uint32_t)t;
+}
+
+/* Main context: end a deferred pulse once it has lasted TUI_TRIGGER_US, or hand
+   the rest of it to the next free timer. Returns 1 while still deferred. */
+static int tui_end_service(void)
+{
+    if (!tui_end_deferred) return 0;
+    uint32_t elapsed_us = (tui_now_ticks() - tui_pulse_start) / event_loop_ticks_per_us();
+    if (elapsed_us >= TUI_TRIGGER_US) {
+        ev_tui_end(0);
+    } else if (event_loop_post_after(EVENT_CLASS_PRESET, ev_tui_end, 0,
+                                     TUI_TRIGGER_US - elapsed_us) != 0) {
+        return 1;
+    }
+    tui_end_deferred = 0;
+    return 0;
+}
+
+/* Queue a preset on the I2C engine (GPIO fallback, IPI initial tuning). The TUI
+   pulse is ended by a timer event instead of a usleep in the loop; with every
+   timer taken the end is deferred to the idle hook rather than waited for. */
+static void ev_preset_apply(uint32_t arg)
+{
+    uint8_t p = (uint8_t)arg;
+    if (preset_switch_apply(p) != 0) {
+        DLOG1(DLOG_PRESET_QUEUE_FAILED, p);
+    }
+    if (arg & PRESET_EV_TUI) {
+        XGpio_DiscreteWrite(&Gpio_Tui_Trigger, GPIO_CH, 1);
+        if (event_loop_post_after(EVENT_CLASS_PRESET, ev_tui_end, 0, TUI_TRIGGER_US) != 0) {
+            tui_pulse_start = tui_now_ticks();
+            tui_end_deferred = 1;
+        }
+    }
+}
+
+/* ISR or main: one ring drain event outstanding at a time */
+static void ipi_ring_kick(void)
+{
+    if (ipi_ring_doorbell) return;
+    ipi_ring_doorbell = 1;
+    if (event_loop_post(EVENT_CLASS_IPI, ev_ipi_ring, 0) != 0) {
+        ipi_ring_doorbell = 0;   /* the next IPI tries again */
+    }
+}
 
 
 static void DeviceDriverHandler(void *Ref)
@@ -73,8 +173,10 @@ static void DeviceDriverHandler(void *Ref)
     (void)Ref;
     irq_count++;
     uint8_t pl_value = (uint8_t)XGpio_DiscreteRead(&Gpio_DDS_Chan, GPIO_CH);
-    pending_preset = pl_value;
-    aperture_tuning_change_flag = 1;
+    if (preset_switch_from_isr(pl_value) != 0) {
+        (void)event_loop_post(EVENT_CLASS_PRESET, ev_preset_apply, pl_value);
+    }
+    DLOG1(DLOG_PRESET_CHANGE, pl_value);
     // Clear interrupt
     uint32_t status = XGpio_InterruptGetStatus(&Gpio_DDS_Chan);
     XGpio_InterruptClear(&Gpio_DDS_Chan, status);
@@ -102,27 +204,550 @@ void IpiHandler(void *CallBackRef)
     XIpiPsu *IpiPtr = (XIpiPsu *)CallBackRef;
     ipi_msg_t *msg = (ipi_msg_t *)SHARED_MEM_ADDR;
     XIpiPsu_ClearInterruptStatus(IpiPtr, IPI_MASK_SELF);
-    Xil_DCacheInvalidateRange((UINTPTR)msg, sizeof(ipi_msg_t));
-    if (msg->magic == IPI_MAGIC && msg->status == 1 && msg->cmd != 1) {
-        memcpy((void *)&ipi_buffer, msg, sizeof(ipi_msg_t));
-        ipi_message_flag = true;
-        msg->status = 2;  // mark as "response ready"
-    }
-    else {
-
-        int Status;
-        uint8_t mux_val;
-        Status = platform_i2c_read_mux(&mux_val);
-        msg->payload[0] = Status;
-        msg->payload[1] = 0x70;
-        msg->payload[2] = mux_val;
-        msg->len = 3;
-        msg->status = 2;  // mark as "response ready"
+    /* ring traffic is drained by the main loop; one IPI may cover many commands */
+    ipi_ring_kick();
+
+    /* previous mailbox request still being served; the APU must wait for status 2 */
+    if (ipi_owned_msg != NULL) {
+        return;
     }
-    Xil_DCacheFlushRange((UINTPTR)msg, sizeof(ipi_msg_t));
-    XIpiPsu_TriggerIpi(IpiPtr, IPI_MASK_APU);
+
+    /* header first, then only the bytes the APU says are valid */
+    Xil_DCacheInvalidateRange((UINTPTR)msg, IPI_MSG_HDR_BYTES);
+    if (msg->magic == IPI_MAGIC && msg->status == 1) {
+        uint32_t len = msg->len;
+        if (len > IPI_MAX_PAYLOAD_BYTES) {
+            len = IPI_MAX_PAYLOAD_BYTES;
+        }
+        if (len) {
+            Xil_DCacheInvalidateRange((UINTPTR)msg->payload, len);
+        }
+        ipi_owned_msg = msg;
+        if (event_loop_post(EVENT_CLASS_IPI, ev_ipi_mailbox, 0) != 0) {
+            ipi_owned_msg = NULL;   /* left at status 1: served on the next IPI */
+        }
+    }
+}
+
+
+/* chunked preset upload in progress (cmds 6-8) */
+static struct {
+    uint8_t  open;
+    uint16_t id;
+    uint16_t next_seq;
+} upload;
+
+/* IPI command handlers (registered in register_ipi_commands). They run from the
+   main loop, never from IpiHandler, so they may block on I2C. ctx->payload is
+   the shared slot itself; the registry has already checked the length. */
+
+/* I2C mux readback. A GPIO-ISR retune can preempt it here: platform_i2c_read_mux()
+   holds the AXI IIC so the retune only queues, and answers XST_DEVICE_BUSY
+   (mux_val left 0) while one is still on the bus. */
+static int ipi_cmd_read_mux(ipi_cmd_ctx_t *ctx)
+{
+    uint8_t mux_val = 0;
+    int rc = platform_i2c_read_mux(&mux_val);
+    ctx->resp[0] = (uint8_t)rc;
+    ctx->resp[1] = PLATFORM_I2C_MUX_ADDR;
+    ctx->resp[2] = mux_val;
+    ctx->resp_len = 3;
+    return rc;
+}
+
+/* RX entire aperture tuning config for scan */
+static int ipi_cmd_load_presets(ipi_cmd_ctx_t *ctx)
+{
+    const uint8_t *payload = ctx->payload;
+    uint32_t nch = atc_num_channels();
+    if (ctx->len > NUM_PRESETS * nch * 3) {
+        return XST_INVALID_PARAM;
+    }
+    for (uint32_t i = 0; i < ctx->len; i=i+3) {
+        // xil_printf("%02x) %02x %02x %02x\r\n",i, (unsigned int)payload[i], (unsigned int)payload[i+1], (unsigned int)payload[i+2]);
+        presets[i/3/nch][(i/3)%nch].tuning = payload[i];
+        presets[i/3/nch][(i/3)%nch].matching = payload[i+1];
+        presets[i/3/nch][(i/3)%nch].detune_enable = payload[i+2];
+    }
+
+    /* reuses the staging table: any chunked upload in progress is abandoned */
+    upload.open = 0;
+    atc_precompute_sets(presets, NUM_PRESETS);
+
+    return XST_SUCCESS;
+}
+
+/* RX Tuning set change for Sequence Start, Triggers Tui 
+   (usually triggered from GPIO interrupt from PL) */
+static int ipi_cmd_set_preset(ipi_cmd_ctx_t *ctx)
+{
+    uint8_t p = (uint8_t)ctx->arg[0];
+    DLOG1(DLOG_INITIAL_TUNING, p);
+    if (event_loop_post(EVENT_CLASS_PRESET, ev_preset_apply, p | PRESET_EV_TUI) != 0) {
+        return XST_DEVICE_BUSY;
+    }
+    DLOG1(DLOG_PRESET_CHANGE, p);
+    return XST_SUCCESS;
+}
+
+/* Sample pulse test sequence: echoes, scans, t_end_us (missing args are 0) */
+static int ipi_cmd_sample_seq(ipi_cmd_ctx_t *ctx)
+{
+    if (sample_seq_busy()) {
+        return XST_DEVICE_BUSY;
+    }
+
+    DLOG3(DLOG_SEQ_START, ctx->arg[0], ctx->arg[1], ctx->arg[2]);
+    if (sample_seq_start(ctx->arg[0], ctx->arg[1], ctx->arg[2]) != 0) {
+        DLOG0(DLOG_SEQ_REJECTED);
+        return XST_INVALID_PARAM;
+    }
+    return XST_SUCCESS;
+}
+
+/* Per-command counters: u8 command id -> ipi_cmd_stats_t + ticks_per_us */
+static int ipi_cmd_query_stats(ipi_cmd_ctx_t *ctx)
+{
+    ipi_cmd_stats_t st;
+    uint32_t tpu = ipi_cmd_ticks_per_us();
+    if (ipi_cmd_get_stats(ctx->arg[0], &st) != 0) {
+        return XST_INVALID_PARAM;
+    }
+    if (ctx->resp_max < sizeof(st) + sizeof(tpu)) {
+        return XST_BUFFER_TOO_SMALL;
+    }
+    memcpy(ctx->resp, &st, sizeof(st));
+    memcpy(ctx->resp + sizeof(st), &tpu, sizeof(tpu));
+    ctx->resp_len = sizeof(st) + sizeof(tpu);
+    return XST_SUCCESS;
+}
+
+/* Chunked preset upload (cmds 6-8). Every chunk carries whole presets, each one is
+   precomputed as soon as it lands; the table goes live on commit. Responses are
+   { u16 next expected seq, u8 presets still missing, u8 0 }. */
+#define UPLOAD_CHUNK_HDR_BYTES  6
+#define UPLOAD_PRESET_BYTES     (atc_num_channels() * 3u)   /* follows the topology */
+
+static void upload_reply(ipi_cmd_ctx_t *ctx)
+{
+    ctx->resp[0] = (uint8_t)(upload.next_seq & 0xFF);
+    ctx->resp[1] = (uint8_t)(upload.next_seq >> 8);
+    ctx->resp[2] = atc_stage_remaining();
+    ctx->resp[3] = 0;
+    ctx->resp_len = 4;
+}
+
+/* u16 upload id, u8 preset count */
+static int ipi_cmd_upload_begin(ipi_cmd_ctx_t *ctx)
+{
+    if (atc_stage_begin((uint8_t)ctx->arg[1]) != 0) {
+        upload.open = 0;
+        return XST_INVALID_PARAM;
+    }
+    upload.open = 1;
+    upload.id = (uint16_t)ctx->arg[0];
+    upload.next_seq = 0;
+    upload_reply(ctx);
+    return XST_SUCCESS;
+}
+
+/* u16 upload id, u16 seq, u8 first preset, u8 count, count * atc_num_channels() * {tuning, matching, detune} */
+static int ipi_cmd_upload_chunk(ipi_cmd_ctx_t *ctx)
+{
+    uint16_t seq = (uint16_t)ctx->arg[1];
+    uint8_t first = (uint8_t)ctx->arg[2];
+    uint8_t count = (uint8_t)ctx->arg[3];
+
+    if (!upload.open || (uint16_t)ctx->arg[0] != upload.id) {
+        return XST_INVALID_PARAM;
+    }
+    if (ctx->len != UPLOAD_CHUNK_HDR_BYTES + (uint32_t)count * UPLOAD_PRESET_BYTES) {
+        return XST_INVALID_PARAM;
+    }
+    if ((uint16_t)(upload.next_seq - seq) - 1u < 0x8000u) {
+        /* retransmit of a chunk we already have */
+        upload_reply(ctx);
+        return XST_SUCCESS;
+    }
+    if (seq != upload.next_seq) {
+        /* gap: tell the APU where to resume */
+        upload_reply(ctx);
+        return XST_DATA_LOST;
+    }
+
+    const uint8_t *rec = ctx->payload + UPLOAD_CHUNK_HDR_BYTES;
+    for (uint8_t k = 0; k < count; k++, rec += UPLOAD_PRESET_BYTES) {
+        aperture_channel_config_t cfg[ATC_MAX_CHANNELS];
+        for (uint32_t c = 0; c < atc_num_channels(); c++) {
+            cfg[c].tuning = rec[3 * c];
+            cfg[c].matching = rec[3 * c + 1];
+            cfg[c].detune_enable = rec[3 * c + 2];
+        }
+        if (atc_stage_preset((uint8_t)(first + k), cfg) != 0) {
+            return XST_INVALID_PARAM;
+        }
+    }
+    upload.next_seq++;
+    upload_reply(ctx);
+    return XST_SUCCESS;
+}
+
+/* u16 upload id: publish the staged table */
+static int ipi_cmd_upload_commit(ipi_cmd_ctx_t *ctx)
+{
+    if (!upload.open || (uint16_t)ctx->arg[0] != upload.id) {
+        return XST_INVALID_PARAM;
+    }
+    upload_reply(ctx);
+    if (atc_stage_commit() != 0) {
+        return XST_DATA_LOST;
+    }
+    upload.open = 0;
+    DLOG1(DLOG_UPLOAD_COMMITTED, upload.id);
+    return XST_SUCCESS;
+}
+
+/* Topology descriptor (see aperture_tuning.h) -> { u8 expanders, u8 channels,
+   u16 0 }. Drops the presets and any upload in progress: the APU
+   re-sends them with the new channel count. */
+static int ipi_cmd_set_topology(ipi_cmd_ctx_t *ctx)
+{
+    int rc = atc_load_topology(ctx->payload, ctx->len);
+    if (rc != 0) {
+        DLOG1(DLOG_TOPOLOGY_REJECTED, rc);
+        return XST_INVALID_PARAM;
+    }
+    upload.open = 0;
+
+    ctx->resp[0] = atc_num_io_expanders();
+    ctx->resp[1] = atc_num_channels();
+    ctx->resp[2] = 0;
+    ctx->resp[3] = 0;
+    ctx->resp_len = 4;
+    return XST_SUCCESS;
+}
+
+/* Readback verify: u8 budget (percent, ATC_VERIFY_ALL, or VERIFY_KEEP to only
+   read) -> { u8 budget, u8 0, u16 0, atc_verify_stats_t } */
+#define VERIFY_KEEP 0xFE
+
+static int ipi_cmd_verify(ipi_cmd_ctx_t *ctx)
+{
+    atc_verify_stats_t st;
+    if (ctx->resp_max < 4 + sizeof(st)) {
+        return XST_BUFFER_TOO_SMALL;
+    }
+    if (ctx->arg[0] != VERIFY_KEEP) {
+        atc_set_verify((uint8_t)ctx->arg[0]);
+    }
+    atc_get_verify_stats(&st);
+    ctx->resp[0] = atc_get_verify();
+    ctx->resp[1] = 0;
+    ctx->resp[2] = 0;
+    ctx->resp[3] = 0;
+    memcpy(ctx->resp + 4, &st, sizeof(st));
+    ctx->resp_len = 4 + sizeof(st);
+    return XST_SUCCESS;
+}
+
+/* Event loop stats: u8 class (0xFF clears all) -> { u32 ticks per us,
+   event_class_stats_t } */
+static int ipi_cmd_event_stats(ipi_cmd_ctx_t *ctx)
+{
+    event_class_stats_t st;
+    uint32_t tpu = event_loop_ticks_per_us();
+    if (ctx->arg[0] == 0xFF) {
+        event_loop_reset_stats();
+        ctx->resp_len = 0;
+        return XST_SUCCESS;
+    }
+    if (event_loop_get_stats((uint8_t)ctx->arg[0], &st) != 0) {
+        return XST_INVALID_PARAM;
+    }
+    if (ctx->resp_max < sizeof(tpu) + sizeof(st)) {
+        return XST_BUFFER_TOO_SMALL;
+    }
+    memcpy(ctx->resp, &tpu, sizeof(tpu));
+    memcpy(ctx->resp + sizeof(tpu), &st, sizeof(st));
+    ctx->resp_len = sizeof(tpu) + sizeof(st);
+    return XST_SUCCESS;
 }
 
+/* Deferred log consumer: u8 mode (DLOG_CONSUMER_RPU / _APU, 0xFE keeps it)
+   -> { u32 ring address in the APU map, u32 consumer, u32 written, u32 dropped } */
+#define LOG_MODE_KEEP 0xFE
+static int ipi_cmd_log_mode(ipi_cmd_ctx_t *ctx)
+{
+    uint32_t mode = ctx->arg[0];
+    if (mode != LOG_MODE_KEEP) {
+        if (mode != DLOG_CONSUMER_RPU && mode != DLOG_CONSUMER_APU) {
+            return XST_INVALID_PARAM;
+        }
+        dlog_set_consumer(mode);
+    }
+    const dlog_ring_t *r = dlog_ring();
+    uint32_t out[4] = { dlog_ring_global_addr(), dlog_get_consumer(), r->written, r->dropped };
+    if (ctx->resp_max < sizeof(out)) {
+        return XST_BUFFER_TOO_SMALL;
+    }
+    memcpy(ctx->resp, out, sizeof(out));
+    ctx->resp_len = sizeof(out);
+    return XST_SUCCESS;
+}
+
+/* Retune stats and latency log: u8 records wanted (0xFF clears both) ->
+   { preset_switch_stats_t, preset_switch_record_t[] } most recent records that
+   fit, oldest first */
+#define SWITCH_STATS_RESET 0xFF
+
+static int ipi_cmd_switch_stats(ipi_cmd_ctx_t *ctx)
+{
+    preset_switch_stats_t st;
+    preset_switch_record_t recs[IPI_RING_SLOT_PAYLOAD / sizeof(preset_switch_record_t)];
+
+    if (ctx->arg[0] == SWITCH_STATS_RESET) {
+        preset_switch_reset_stats();
+        ctx->resp_len = 0;
+        return XST_SUCCESS;
+    }
+    if (ctx->resp_max < sizeof(st)) {
+        return XST_BUFFER_TOO_SMALL;
+    }
+    uint32_t max = (ctx->resp_max - sizeof(st)) / sizeof(recs[0]);
+    if (max > sizeof(recs) / sizeof(recs[0])) {
+        max = sizeof(recs) / sizeof(recs[0]);
+    }
+    if (max > ctx->arg[0]) {
+        max = ctx->arg[0];
+    }
+    /* log first: a retune completing in between shows up in the stats only */
+    uint32_t n = preset_switch_get_log(recs, max);
+    preset_switch_get_stats(&st);
+    memcpy(ctx->resp, &st, sizeof(st));
+    memcpy(ctx->resp + sizeof(st), recs, n * sizeof(recs[0]));
+    ctx->resp_len = sizeof(st) + n * sizeof(recs[0]);
+    return XST_SUCCESS;
+}
+
+/* Round-trip probe for the APU controller benchmark: payload comes back as is */
+static int ipi_cmd_echo(ipi_cmd_ctx_t *ctx)
+{
+    uint32_t n = (ctx->len < ctx->resp_max) ? ctx->len : ctx->resp_max;
+    memcpy(ctx->resp, ctx->payload, n);
+    ctx->resp_len = n;
+    return XST_SUCCESS;
+}
+
+/* I2C tracer (cmds 9-10). Histogram: u8 slot -> { u32 cycles per us, u32 slots in
+   use, platform_i2c_dev_stats_t }; slot 0xFF clears the tracer instead. */
+#define I2C_TRACE_RESET         0xFF
+
+static int ipi_cmd_i2c_hist(ipi_cmd_ctx_t *ctx)
+{
+    uint32_t hdr[2] = { platform_i2c_trace_cycles_per_us(), 0 };
+    platform_i2c_dev_stats_t st;
+
+    if (ctx->arg[0] == I2C_TRACE_RESET) {
+        platform_i2c_trace_reset();
+        return XST_SUCCESS;
+    }
+    if (ctx->resp_max < sizeof(hdr) + sizeof(st)) {
+        return XST_BUFFER_TOO_SMALL;
+    }
+    while (hdr[1] < PLATFORM_I2C_TRACE_DEVS && platform_i2c_trace_dev((uint8_t)hdr[1], &st) == 0) {
+        hdr[1]++;
+    }
+    if (platform_i2c_trace_dev((uint8_t)ctx->arg[0], &st) != 0) {
+        return XST_INVALID_PARAM;
+    }
+    memcpy(ctx->resp, hdr, sizeof(hdr));
+    memcpy(ctx->resp + sizeof(hdr), &st, sizeof(st));
+    ctx->resp_len = sizeof(hdr) + sizeof(st);
+    return XST_SUCCESS;
+}
+
+/* u32 first record wanted -> { u32 first record returned, u32 records logged,
+   platform_i2c_trace_rec_t[] } as many as fit; poll again from first + n */
+static int ipi_cmd_i2c_trace(ipi_cmd_ctx_t *ctx)
+{
+    uint32_t hdr[2] = { ctx->arg[0], 0 };
+    platform_i2c_trace_rec_t recs[IPI_RING_SLOT_PAYLOAD / sizeof(platform_i2c_trace_rec_t)];
+
+    if (ctx->resp_max < sizeof(hdr)) {
+        return XST_BUFFER_TOO_SMALL;
+    }
+    uint32_t max = (ctx->resp_max - sizeof(hdr)) / sizeof(recs[0]);
+    if (max > sizeof(recs) / sizeof(recs[0])) {
+        max = sizeof(recs) / sizeof(recs[0]);
+    }
+    uint32_t n = platform_i2c_trace_read(&hdr[0], recs, max);
+    hdr[1] = platform_i2c_trace_total();
+    memcpy(ctx->resp, hdr, sizeof(hdr));
+    memcpy(ctx->resp + sizeof(hdr), recs, n * sizeof(recs[0]));
+    ctx->resp_len = sizeof(hdr) + n * sizeof(recs[0]);
+    return XST_SUCCESS;
+}
+
+#define IPI_CMD_READ_MUX        1
+#define IPI_CMD_LOAD_PRESETS    2
+#define IPI_CMD_SET_PRESET      3
+#define IPI_CMD_SAMPLE_SEQ      4
+#define IPI_CMD_QUERY_STATS     5
+#define IPI_CMD_UPLOAD_BEGIN    6
+#define IPI_CMD_UPLOAD_CHUNK    7
+#define IPI_CMD_UPLOAD_COMMIT   8
+#define IPI_CMD_I2C_HIST        9
+#define IPI_CMD_I2C_TRACE       10
+#define IPI_CMD_SET_TOPOLOGY    11
+#define IPI_CMD_VERIFY          12
+#define IPI_CMD_EVENT_STATS     13
+#define IPI_CMD_LOG_MODE        14
+#define IPI_CMD_ECHO            15
+#define IPI_CMD_SWITCH_STATS    16
+
+static const ipi_cmd_desc_t ipi_cmd_descs[] = {
+    [IPI_CMD_READ_MUX]     = { "read_mux",     ipi_cmd_read_mux,     0, IPI_MAX_PAYLOAD_BYTES, 0, 0, { 0 } },
+    [IPI_CMD_LOAD_PRESETS] = { "load_presets", ipi_cmd_load_presets, 3, IPI_MAX_PAYLOAD_BYTES, 3, 0, { 0 } },
+    [IPI_CMD_SET_PRESET]   = { "set_preset",   ipi_cmd_set_preset,   1, IPI_MAX_PAYLOAD_BYTES, 0, 1, { IPI_ARG_U8 } },
+    [IPI_CMD_SAMPLE_SEQ]   = { "sample_seq",   ipi_cmd_sample_seq,   0, IPI_MAX_PAYLOAD_BYTES, 0, 3,
+                               { IPI_ARG_U32, IPI_ARG_U32, IPI_ARG_U32 } },
+    [IPI_CMD_QUERY_STATS]  = { "query_stats",  ipi_cmd_query_stats,  1, 1, 0, 1, { IPI_ARG_U8 } },
+    [IPI_CMD_UPLOAD_BEGIN] = { "upload_begin", ipi_cmd_upload_begin, 3, 3, 0, 2, { IPI_ARG_U16, IPI_ARG_U8 } },
+    [IPI_CMD_UPLOAD_CHUNK] = { "upload_chunk", ipi_cmd_upload_chunk, UPLOAD_CHUNK_HDR_BYTES + 3,
+                               IPI_MAX_PAYLOAD_BYTES, 0, 4, { IPI_ARG_U16, IPI_ARG_U16, IPI_ARG_U8, IPI_ARG_U8 } },
+    [IPI_CMD_UPLOAD_COMMIT]= { "upload_commit",ipi_cmd_upload_commit,2, 2, 0, 1, { IPI_ARG_U16 } },
+    [IPI_CMD_I2C_HIST]     = { "i2c_hist",     ipi_cmd_i2c_hist,     1, 1, 0, 1, { IPI_ARG_U8 } },
+    [IPI_CMD_I2C_TRACE]    = { "i2c_trace",    ipi_cmd_i2c_trace,    4, 4, 0, 1, { IPI_ARG_U32 } },
+    [IPI_CMD_SET_TOPOLOGY] = { "set_topology", ipi_cmd_set_topology, ATC_TOPO_HDR_BYTES + 4,
+                               ATC_TOPO_HDR_BYTES + 2 * ATC_MAX_EXPANDERS + 2 * ATC_MAX_CHANNELS, 0, 0, { 0 } },
+    [IPI_CMD_VERIFY]       = { "verify",       ipi_cmd_verify,       1, 1, 0, 1, { IPI_ARG_U8 } },
+    [IPI_CMD_EVENT_STATS]  = { "event_stats",  ipi_cmd_event_stats,  1, 1, 0, 1, { IPI_ARG_U8 } },
+    [IPI_CMD_LOG_MODE]     = { "log_mode",     ipi_cmd_log_mode,     1, 1, 0, 1, { IPI_ARG_U8 } },
+    [IPI_CMD_ECHO]         = { "echo",         ipi_cmd_echo,         0, IPI_MAX_PAYLOAD_BYTES, 0, 0, { 0 } },
+    [IPI_CMD_SWITCH_STATS] = { "switch_stats", ipi_cmd_switch_stats, 1, 1, 0, 1, { IPI_ARG_U8 } },
+};
+
+static void register_ipi_commands(void)
+{
+    for (uint32_t i = 0; i < sizeof(ipi_cmd_descs) / sizeof(ipi_cmd_descs[0]); i++) {
+        if (ipi_cmd_descs[i].fn != NULL) {
+            ipi_cmd_register(i, &ipi_cmd_descs[i]);
+        }
+    }
+}
+
+
+/* Serve the mailbox request the ISR handed over, in place, then give the slot
+   back to the APU. Only the header and the response bytes are written back. */
+static void serve_ipi_mailbox(ipi_msg_t *msg)
+{
+    static uint8_t resp[IPI_RING_SLOT_PAYLOAD];
+    uint32_t resp_len = 0;
+
+    uint32_t len = msg->len;
+    if (len > IPI_MAX_PAYLOAD_BYTES) {
+        len = IPI_MAX_PAYLOAD_BYTES;
+    }
+
+    (void)ipi_cmd_dispatch(msg->cmd, msg->payload, len, resp, sizeof(resp), &resp_len);
+
+    /* commands without a response leave the request payload untouched */
+    if (resp_len) {
+        memcpy(msg->payload, resp, resp_len);
+        msg->len = resp_len;
+        Xil_DCacheFlushRange((UINTPTR)msg->payload, resp_len);
+    }
+    msg->status = 2;  // mark as "response ready"
+    Xil_DCacheFlushRange((UINTPTR)msg, IPI_MSG_HDR_BYTES);
+
+    ipi_owned_msg = NULL;
+    XIpiPsu_TriggerIpi(&IpiInst, IPI_MASK_APU);
+}
+
+
+/* Drain queued requests, answer each on the response ring and ring the APU
+   doorbell once per batch (and only if the APU is waiting for one). Stops early
+   when a preset event is waiting; returns 1 if requests were left behind. */
+static int drain_ipi_ring(void)
+{
+    static uint8_t resp[IPI_RING_SLOT_PAYLOAD];
+    int responses = 0;
+    int more = 0;
+
+    ipi_ring_disarm(&ipi_req_rx);
+    do {
+        ipi_slot_t *slot;
+        uint32_t len;
+        while ((slot = ipi_ring_peek(&ipi_req_rx, &len)) != NULL) {
+            uint32_t resp_len = 0;
+            int rc = ipi_cmd_dispatch(slot->hdr.cmd, slot->payload, len,
+                                      resp, sizeof(resp), &resp_len);
+            uint32_t cmd = slot->hdr.cmd;
+            uint32_t seq = slot->hdr.seq;
+            ipi_ring_release(&ipi_req_rx);
+
+            if (ipi_ring_push(&ipi_resp_tx, cmd, seq, (uint32_t)rc, resp, resp_len) != 0) {
+                /* APU is not draining responses; never block the RPU on it */
+                ipi_resp_dropped++;
+            } else {
+                responses++;
+            }
+            if (event_loop_should_yield(EVENT_CLASS_IPI)) {
+                more = 1;   /* ring stays disarmed: the repost finishes it */
+                break;
+            }
+        }
+    } while (!more && ipi_ring_arm(&ipi_req_rx));
+
+    if (responses && ipi_ring_publish(&ipi_resp_tx)) {
+        XIpiPsu_TriggerIpi(&IpiInst, IPI_MASK_APU);
+    }
+    return more;
+}
+
+static void ev_ipi_mailbox(uint32_t arg)
+{
+    (void)arg;
+    if (ipi_owned_msg != NULL) {
+        serve_ipi_mailbox(ipi_owned_msg);
+    }
+}
+
+static void ev_ipi_ring(uint32_t arg)
+{
+    (void)arg;
+    ipi_ring_doorbell = 0;
+    if (drain_ipi_ring()) {
+        ipi_ring_kick();
+    }
+}
+
+/* Log records printed per idle pass: the loop gets back to pending events
+   after at most this much UART time */
+#define DLOG_IDLE_BATCH 2
+
+/* Runs whenever the event rings are empty; nonzero while it needs polling */
+static int main_idle(void)
+{
+    /* no-op when the AXI IIC IRQ is connected */
+    platform_i2c_service();
+
+    /* read back what the async applies wrote, once the queue is idle */
+    if (atc_verify_service() > 0) {
+        DLOG0(DLOG_VERIFY_UNREPAIRED);
+    }
+
+    if (sample_seq_take_done()) {
+        sample_seq_stats_t st;
+        sample_seq_get_stats(&st);
+        DLOG2(DLOG_SEQ_DONE, st.scans_done, st.isr_lat_max_ticks - st.isr_lat_min_ticks);
+    }
+
+    int tui_wait = tui_end_service();
+
+    dlog_drain(DLOG_IDLE_BATCH);
+    return (!AXI_IIC_USE_INTERRUPTS && platform_i2c_async_busy()) || dlog_pending() || tui_wait;
+}
 
 static int InitIpi(XIpiPsu *IpiPtr)
 {
@@ -186,6 +811,17 @@ static int SetupInterruptSystem(XScuGic *GicPtr,
     XScuGic_Enable(GicPtr, IPI_INT_ID);
     XScuGic_Enable(GicPtr, FABRIC_INTC_IRQ_ID);
 
+#ifdef AXI_IIC_INTR_ID
+    /* AXI IIC interrupt drives the async preset engine */
+    Status = XScuGic_Connect(GicPtr, AXI_IIC_INTR_ID,
+                             (Xil_ExceptionHandler)platform_i2c_intr_handler,
+                             NULL);
+    if (Status != XST_SUCCESS) {
+        return Status;
+    }
+    XScuGic_Enable(GicPtr, AXI_IIC_INTR_ID);
+#endif
+
     /* Register GIC handler with the CPU exception system */
     Xil_ExceptionRegisterHandler(
         XIL_EXCEPTION_ID_IRQ_INT,               // <- use IRQ_INT consistently
@@ -251,8 +887,6 @@ void init_axi_gpio(void)
 int main(void)
 {
     /* build NUM_PRESETS presets each with NUM_CHANNELS_RX aperture_channel_config_t entries */
-    aperture_channel_config_t presets[NUM_PRESETS][NUM_CHANNELS];
-
     for (int p=0;p<NUM_PRESETS;++p) {
         for (int ch=0; ch<NUM_CHANNELS; ++ch) {
             presets[p][ch].tuning = 0;
@@ -265,6 +899,10 @@ int main(void)
 
     xil_printf("R5 bring-up: PL IRQ + IPI\r\n");
 
+    /* ISRs post and log from the moment they are connected */
+    event_loop_init();
+    dlog_init();
+
     /* Map PL IO before touching 0xA0.. regs */
     Map_PlIo();
 
@@ -277,6 +915,20 @@ int main(void)
         xil_printf("InitAxiIic failed: %d\r\n", Status);
         return -7;
     }
+
+#if PS_IIC_BUS_MASK
+    /* move the selected logical buses onto PS I2C1 so retunes fan out */
+    Status = platform_i2c_ps_init();
+    if (Status == XST_SUCCESS) {
+        for (uint8_t b = 0; b < PLATFORM_I2C_NUM_BUSES; b++) {
+            if (PS_IIC_BUS_MASK & (1u << b)) {
+                platform_i2c_set_route(b, PLATFORM_I2C_CTRL_PS, PS_IIC_MUX_CHAN(b));
+            }
+        }
+    } else {
+        xil_printf("PS IIC init failed: %d, all buses stay on AXI IIC\r\n", Status);
+    }
+#endif
     // TestTmp117();
     // TestMuxRead();
 
@@ -329,117 +981,30 @@ int main(void)
     }
     Xil_DCacheFlushRange((UINTPTR)msg, sizeof(ipi_msg_t));
 
+    /* R5 owns the ring region: reset it before the APU starts streaming */
+    ipi_ring_region_init(ipi_rings);
+    ipi_ring_rx_attach(&ipi_req_rx, &ipi_rings->to_rpu);
+    ipi_ring_tx_attach(&ipi_resp_tx, &ipi_rings->to_apu);
+    register_ipi_commands();
+
     atc_init();
     atc_precompute_sets(presets, NUM_PRESETS);
 
-    int echos = 0;
-    int scans = 0;
-    int scans_target = 0;
-    int t_end = 0;
-    int test_seq = 0;
-
-
-    // main loop 
-    for (;;) {
-        /* Apply new tuning set */
-        if (aperture_tuning_change_flag) {
-            aperture_tuning_change_flag = 0;
-            uint8_t p = pending_preset;
-            xil_printf("Aperture Tuning Change (%d)\r\n", p);
-            // atc_apply_preset_blocking(p);
-        }
-        
-        /* Pulse TUI Trigger input, not needed on initial set */
-        if (pulse_tui_start_flag){   
-            pulse_tui_start_flag = 0;       
-            XGpio_DiscreteWrite(&Gpio_Tui_Trigger, GPIO_CH, 1);
-            usleep(TUI_TRIGGER_US); 
-            XGpio_DiscreteWrite(&Gpio_Tui_Trigger, GPIO_CH, 0);
-        }
-
-        if (test_seq){
-            if (scans < scans_target){
-                xil_printf("Scan %d\r\n", scans);
-                int echos_scan = echos                
-;                while (echos_scan > 0){
-                    XGpio_DiscreteWrite(&Gpio_Sample, GPIO_CH, 1);
-                    usleep(400); 
-                    XGpio_DiscreteWrite(&Gpio_Sample, GPIO_CH, 0);
-                    usleep(400); 
-                    echos_scan--;                    
-                }
-                scans++;
-            }
-            if (scans == scans_target){
-                test_seq = 0;
-                scans_target = 0;
-                xil_printf("Sample test sequence complete\r\n");
-            }
-            usleep(t_end); 
-        }
-
-        if (ipi_message_flag) {
-            ipi_message_flag = 0;
-
-            /* RX entire aperture tuning config for scan */
-            if (ipi_buffer.cmd == 2){
-                for (uint32_t i = 0; i < ipi_buffer.len && i < IPI_MAX_PAYLOAD_BYTES; i=i+3) {
-                    // xil_printf("%02x) %02x %02x %02x\r\n",i, (unsigned int)ipi_buffer.payload[i], (unsigned int)ipi_buffer.payload[i+1], (unsigned int)ipi_buffer.payload[i+2]);
-                    presets[i/3/NUM_PRESETS][(i/3)%(NUM_CHANNELS)].tuning = ipi_buffer.payload[i];
-                    presets[i/3/NUM_PRESETS][(i/3)%(NUM_CHANNELS)].matching = ipi_buffer.payload[i+1];
-                    presets[i/3/NUM_PRESETS][(i/3)%(NUM_CHANNELS)].detune_enable = ipi_buffer.payload[i+2];
-                }
-
-                atc_precompute_sets(presets, NUM_PRESETS);
-
-                pending_preset = 0;
-                pulse_tui_start_flag = 0;
-                // aperture_tuning_change_flag = 1;
-
-            }
-            /* RX Tuning set change for Sequence Start, Triggers Tui 
-               (usually triggered from GPIO interrupt from PL) */
-            else if (ipi_buffer.cmd == 3){
-                pending_preset = ipi_buffer.payload[0];
-                pulse_tui_start_flag = 1;
-                aperture_tuning_change_flag = 1;
-                xil_printf("Setting Initial Tuning = %d\r\n", pending_preset);
-            }
+    /* blocking init writes are done; hand the bus to the async engine */
+    Status = platform_i2c_async_init(AXI_IIC_USE_INTERRUPTS);
+    if (Status != XST_SUCCESS) {
+        xil_printf("platform_i2c_async_init failed: %d\r\n", Status);
+    }
+    preset_switch_init(PRESET_SWITCH_MODE);
 
-            else if (ipi_buffer.cmd == 4){
-                if (test_seq == 0){
-                    
-                    uint32_t rxdata[3];
-
-                    size_t n = ipi_buffer.len / 4;
-
-                    for (size_t i = 0; i < n; i++) {
-                        size_t j = 4 * i;
-                        rxdata[i] =  (uint32_t)ipi_buffer.payload[j]
-                                | ((uint32_t)ipi_buffer.payload[j + 1] << 8)
-                                | ((uint32_t)ipi_buffer.payload[j + 2] << 16)
-                                | ((uint32_t)ipi_buffer.payload[j + 3] << 24);
-                    }
-
-                    echos = rxdata[0];
-                    scans_target = rxdata[1];
-                    scans = 0;
-                    t_end = rxdata[2];
-
-                    xil_printf("Sample test sequence\r\n");
-                    xil_printf("echoes: %d\r\n", echos);
-                    xil_printf("scans:  %d\r\n", scans_target);
-                    xil_printf("t_end:  %d\r\n", t_end);
-                    test_seq = 1;
-                }
-            }
+    /* echo/scan/t_end pulses are generated from TTC0 interrupts */
+    Status = sample_seq_init(&GicInst, &Gpio_Sample);
+    if (Status != XST_SUCCESS) {
+        xil_printf("sample_seq_init failed: %d\r\n", Status);
+    }
 
-        }
 
-        /* Check for work to be done before sleep in wait for interrupt */
-        if ((aperture_tuning_change_flag == 0) && (ipi_message_flag == 0) && (test_seq == 0)) {
-            __asm__ volatile("wfi");
-        }
-    }
+    /* run-to-completion from here on: preset > IPI > diagnostics */
+    event_loop_run(main_idle);
     return 0;
 }
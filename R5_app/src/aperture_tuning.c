@@ -1,8 +1,8 @@
 #include "aperture_tuning.h"
 #include <string.h>
-#include <stdlib.h>
 #include "platform_i2c.h"
 #include "xil_printf.h"
+#include "xiltimer.h"
 
 /* --- Platform-specific I2C hooks (replace these) --- */
 /* These are simple prototypes; implement for your MCU */
@@ -18,7 +18,8 @@ typedef struct {
     uint8_t chan_mask;
 } ioexp_map_t;
 
-/* Default mapping - adjust to match IOEXP_SETUP_CONFIG */
+/* Default mapping - adjust to match IOEXP_SETUP_CONFIG
+   (built-in topology, replaced at run time by atc_load_topology) */
 static const ioexp_map_t ioexp_map[NUM_IO_EXPANDERS] = {
     {IO_EXP_BUS0, IO_EXP_ADDR1, 3}, /* 0 => A+B */
     {IO_EXP_BUS0, IO_EXP_ADDR2, 3}, /* 1 */
@@ -29,45 +30,120 @@ static const ioexp_map_t ioexp_map[NUM_IO_EXPANDERS] = {
     {IOEXP_TX_BUS, IO_EXP_ADDR1, 1} /* 6: TX only on chanA */
 };
 
-/* Precomputed payloads: [preset_index][expander_index] => 3 bytes */
-static ioexp_payload_t *precomputed_payloads = NULL;
-static uint8_t precomputed_num_presets = 0;
-
-/* helper: allocate/clear precomputed storage */
-static int alloc_precomputed_storage(uint8_t num_presets)
+/* Tables live in BTCM (see lscript.ld). The section is NOLOAD, so nothing in it
+   may rely on zero-init: banks are cleared by atc_stage_begin and shadow entries
+   are only read once their shadow_valid bit is set. */
+#ifndef ATC_TABLE_SECTION
+#define ATC_TABLE_SECTION __attribute__((section(".atc_tables"), aligned(32)))
+#endif
+#ifndef ATC_TABLE_BUDGET_BYTES
+#define ATC_TABLE_BUDGET_BYTES 0x8000   /* half of BTCM */
+#endif
+
+/* One complete preset table: payloads [preset_index][expander_index] => 3 bytes,
+   plus the bus-sorted mux/write program compiled from them */
+typedef struct {
+    ioexp_payload_t payloads[MAX_PRESETS][ATC_MAX_EXPANDERS];
+    atc_prog_op_t programs[MAX_PRESETS][ATC_PROGRAM_MAX_OPS];
+    uint8_t payload_crc[MAX_PRESETS][ATC_MAX_EXPANDERS];   /* travels with the payload into the shadow */
+    uint8_t program_len[MAX_PRESETS];
+    uint8_t num_presets;
+} atc_bank_t;
+
+/* Double buffered: appliers (including the GPIO ISR) only read the active bank,
+   uploads fill the other one and publish it with a single pointer store */
+static atc_bank_t banks[2] ATC_TABLE_SECTION;
+static atc_bank_t *volatile active_bank = NULL;
+static atc_bank_t *staging_bank = NULL;
+static uint8_t staged[MAX_PRESETS];          /* 1 = preset filled in staging_bank */
+static uint8_t staged_count = 0;
+
+/* Shadow of what each expander will hold once everything emitted so far has run
+   (optimistic: entries are dropped again on write errors) */
+#define ATC_NONE 0xFF
+static ioexp_payload_t shadow_payloads[ATC_MAX_EXPANDERS] ATC_TABLE_SECTION;
+static uint8_t shadow_crc[ATC_MAX_EXPANDERS] ATC_TABLE_SECTION;   /* payload_crc() of each entry */
+static uint32_t shadow_valid = 0;            /* bit per expander */
+static volatile uint32_t shadow_gen = 0;     /* bumped by every emit */
+static uint8_t emitted_mux_bus = ATC_NONE;   /* bus the mux will be left on */
+static uint32_t saved_xfers_total = 0;
+
+/* tables must be complete before the pointer store that publishes them */
+#if defined(__arm__)
+#define ATC_PUBLISH_BARRIER() __asm__ volatile ("dmb" ::: "memory")
+#else
+#define ATC_PUBLISH_BARRIER() __atomic_thread_fence(__ATOMIC_RELEASE)   /* host sim */
+#endif
+
+_Static_assert(sizeof(banks) + sizeof(shadow_payloads) + sizeof(shadow_crc) <= ATC_TABLE_BUDGET_BYTES,
+               "MAX_PRESETS x ATC_MAX_EXPANDERS tables exceed the TCM budget");
+_Static_assert(sizeof(atc_topo_expander_t) == 2 && sizeof(atc_topo_channel_t) == 2,
+               "topology records are read straight from the descriptor");
+_Static_assert(ATC_PROGRAM_MAX_OPS <= PLATFORM_I2C_BATCH_MAX_SEGS &&
+               ATC_PROGRAM_MAX_OPS <= PLATFORM_I2C_QUEUE_DEPTH,
+               "a preset program must fit one burst / the async queue");
+
+static inline void shadow_invalidate_all(void)
 {
-    if (precomputed_payloads) free(precomputed_payloads);
-    precomputed_payloads = malloc((size_t)num_presets * NUM_IO_EXPANDERS * sizeof(ioexp_payload_t));
-    if (!precomputed_payloads) return -1;
-    memset(precomputed_payloads, 0, (size_t)num_presets * NUM_IO_EXPANDERS * sizeof(ioexp_payload_t));
-    precomputed_num_presets = num_presets;
-    return 0;
+    shadow_valid = 0;
+    emitted_mux_bus = ATC_NONE;
 }
 
-/* reverse bits of value `x` for `bits` length (LSB <-> MSB) */
-static uint32_t reverse_bits_uint32(uint32_t x, uint8_t bits)
+/* CRC-8 (poly 0x07) of a payload, a nibble at a time */
+static const uint8_t crc8_nibble[16] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+    0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+static inline uint8_t payload_crc(const ioexp_payload_t *pl)
 {
-    uint32_t r = 0;
-    for (uint8_t i = 0; i < bits; ++i) {
-        r <<= 1;
-        r |= (x & 1);
-        x >>= 1;
+    uint8_t crc = 0xFF;
+    for (uint8_t i = 0; i < sizeof(pl->bytes); ++i) {
+        crc ^= pl->bytes[i];
+        crc = (uint8_t)((crc << 4) ^ crc8_nibble[crc >> 4]);
+        crc = (uint8_t)((crc << 4) ^ crc8_nibble[crc >> 4]);
     }
-    return r;
+    return crc;
+}
+
+/* Encoding: matching | bit-reversed 7-bit tuning << 4 | detune << 11. The tuning
+   field is one RBIT on the R5 (ARMv7-R has it); the host build uses a LUT. */
+#define TUNING_MASK    ((1u << TUNING_MAX_BITS) - 1u)
+#define MATCHING_MASK  ((1u << MATCHING_MAX_BITS) - 1u)
+
+#if defined(__arm__)
+static inline uint32_t reverse_tuning(uint32_t x)
+{
+    uint32_t r;
+    __asm__ ("rbit %0, %1" : "=r" (r) : "r" (x));
+    return r >> (32 - TUNING_MAX_BITS);
+}
+#else
+#define R2(n) (n), (n) + 64, (n) + 32, (n) + 96
+#define R4(n) R2(n), R2((n) + 16), R2((n) + 8), R2((n) + 24)
+#define R6(n) R4(n), R4((n) + 4), R4((n) + 2), R4((n) + 6)
+static const uint8_t tuning_rev_lut[1u << TUNING_MAX_BITS] = { R6(0), R6(1) };
+#undef R2
+#undef R4
+#undef R6
+
+static inline uint32_t reverse_tuning(uint32_t x)
+{
+    return tuning_rev_lut[x & TUNING_MASK];
+}
+#endif
+
+static inline uint16_t encode_channel(const aperture_channel_config_t *cfg)
+{
+    return (uint16_t)(((cfg->matching & MATCHING_MASK) << MATCHING_OFFSET) |
+                      (reverse_tuning(cfg->tuning & TUNING_MASK) << TUNING_OFFSET) |
+                      ((cfg->detune_enable & 0x1u) << DETUNE_ENABLE_OFFSET));
 }
 
 /* Public utility: encode a channel to a 12-bit integer */
 uint16_t atc_encode_channel_config(const aperture_channel_config_t *cfg)
 {
-    uint32_t tuning = cfg->tuning & ((1u << TUNING_MAX_BITS) - 1u);
-    uint32_t matching = cfg->matching & ((1u << MATCHING_MAX_BITS) - 1u);
-    uint32_t det = cfg->detune_enable & 0x1u;
-
-    uint32_t reversed_tuning = reverse_bits_uint32(tuning, TUNING_MAX_BITS); /* 7 bits reversed */
-    uint16_t encoded = (uint16_t)((matching << MATCHING_OFFSET) |
-                                 (reversed_tuning << TUNING_OFFSET) |
-                                 (det << DETUNE_ENABLE_OFFSET));
-    return encoded & 0x0FFFu;
+    return encode_channel(cfg);
 }
 
 /* Public: decode encoded 12-bit value into channels */
@@ -77,150 +153,774 @@ void atc_decode_channel_config(uint16_t encoded, aperture_channel_config_t *out)
     uint16_t reversed_tuning_val = (encoded >> TUNING_OFFSET) & 0x7F;
     uint16_t det_val = (encoded >> DETUNE_ENABLE_OFFSET) & 0x1;
 
-    uint32_t tuning_val = (uint32_t)reverse_bits_uint32(reversed_tuning_val, TUNING_MAX_BITS);
-    out->tuning = (uint8_t)(tuning_val & 0x7F);
+    out->tuning = (uint8_t)reverse_tuning(reversed_tuning_val);
     out->matching = (uint8_t)matching_val;
     out->detune_enable = (uint8_t)det_val;
 }
 
-/* internal helper to compute 3-byte payload from two 12-bit channel encodings */
-/* order: combined = (chanB << 12) | chanA */
-static void assemble_payload_from_chan12(uint16_t chanA_enc, uint16_t chanB_enc, ioexp_payload_t *out)
+/* Hardcoded mapping table to match your Python TUNING_SETUP_CONFIG (index 0==ch1).
+   Format: {bus, addr, chanb, active}. Only the first NUM_CHANNELS_RX entries are
+   in use. If your hardware mapping differs, replace this table with the real mapping. */
+static const struct { uint8_t bus; uint8_t addr; uint8_t chanb; uint8_t active; } rx_channel_map[] = {
+    {IO_EXP_BUS0, IO_EXP_ADDR1, 0, ACTIVE_CHANNEL}, /* ch1 */
+    {IO_EXP_BUS0, IO_EXP_ADDR1, 1, ACTIVE_CHANNEL}, /* ch2 */
+    {IO_EXP_BUS1, IO_EXP_ADDR1, 0, ACTIVE_CHANNEL}, /* ch3 */
+    {IO_EXP_BUS1, IO_EXP_ADDR1, 1, ACTIVE_CHANNEL}, /* ch4 */
+    {IO_EXP_BUS1, IO_EXP_ADDR2, 0, ACTIVE_CHANNEL}, /* ch5 */
+    {IO_EXP_BUS1, IO_EXP_ADDR2, 1, ACTIVE_CHANNEL}, /* ch6 */
+    {IO_EXP_BUS0, IO_EXP_ADDR2, 0, INACTIVE_CHANNEL},/* ch7 */
+    {IO_EXP_BUS0, IO_EXP_ADDR2, 1, INACTIVE_CHANNEL},/* ch8 */
+    {IO_EXP_BUS2, IO_EXP_ADDR1, 0, INACTIVE_CHANNEL},/* ch9 */
+    {IO_EXP_BUS2, IO_EXP_ADDR1, 1, INACTIVE_CHANNEL},/* ch10 */
+    {IO_EXP_BUS2, IO_EXP_ADDR2, 0, INACTIVE_CHANNEL},/* ch11 */
+    {IO_EXP_BUS2, IO_EXP_ADDR2, 1, INACTIVE_CHANNEL} /* ch12 */
+};
+#define RX_MAP_ENTRIES (sizeof(rx_channel_map) / sizeof(rx_channel_map[0]))
+#define RX_MAP_USED    (NUM_CHANNELS_RX < RX_MAP_ENTRIES ? NUM_CHANNELS_RX : RX_MAP_ENTRIES)
+
+/* Compiled topology: the built-in maps, or a descriptor from atc_load_topology.
+   chan_src[ex][0/1] = cfg index feeding channel A/B of the expander (CHAN_ZERO
+   if nothing does); prog_template = the bus-sorted program with the payload
+   bytes left blank */
+#define CHAN_ZERO ATC_MAX_CHANNELS   /* encoded-channel slot that stays 0 */
+
+typedef struct {
+    uint8_t num_expanders;
+    uint8_t num_channels;
+    uint8_t prog_len;
+    atc_topo_expander_t map[ATC_MAX_EXPANDERS];
+    uint8_t chan_src[ATC_MAX_EXPANDERS][2];
+    atc_prog_op_t prog_template[ATC_PROGRAM_MAX_OPS];
+} atc_topology_t;
+
+static atc_topology_t topo;
+static atc_topology_t topo_next;      /* compile target, copied over topo once valid */
+static uint8_t topo_ready = 0;
+
+/* expander indices ordered by bus (stable), so each bus is selected once per program */
+static void sorted_expander_order(const atc_topology_t *t, uint8_t *order)
 {
-    uint32_t combined = ((uint32_t)chanB_enc << 12) | ((uint32_t)chanA_enc & 0x0FFFu);
-    uint8_t b1 = combined & 0xFFu;
-    uint8_t b2 = (combined >> 8) & 0xFFu;
-    uint8_t b3 = (combined >> 16) & 0xFFu;
-    out->bytes[0] = b1;
-    out->bytes[1] = b2;
-    out->bytes[2] = b3;
+    for (uint8_t i = 0; i < t->num_expanders; ++i) {
+        uint8_t ex = i;
+        int j = i - 1;
+        while (j >= 0 && t->map[order[j]].bus > t->map[ex].bus) {
+            order[j + 1] = order[j];
+            --j;
+        }
+        order[j + 1] = ex;
+    }
 }
 
-/* New signature: presets has NUM_CHANNELS_RX + 1 entries per preset:
-   index 0 = TX, indices 1..NUM_CHANNELS_RX = RX1..RXN */
-int atc_precompute_sets(const aperture_channel_config_t presets[][NUM_CHANNELS],
-                        uint8_t num_presets)
+/* validate + compile into *t; returns 0 or ATC_TOPO_ERR_* */
+static int topo_compile(atc_topology_t *t, const atc_topo_expander_t *ex, uint8_t num_ex,
+                        const atc_topo_channel_t *ch, uint8_t num_ch)
 {
-    if (num_presets == 0 || num_presets > MAX_PRESETS) return -1;
-    if (alloc_precomputed_storage(num_presets) != 0) return -2;
+    if (num_ex == 0 || num_ex > ATC_MAX_EXPANDERS) return ATC_TOPO_ERR_FORMAT;
+    if (num_ch == 0 || num_ch > ATC_MAX_CHANNELS) return ATC_TOPO_ERR_FORMAT;
+
+    for (uint8_t i = 0; i < num_ex; ++i) {
+        if (ex[i].bus >= PLATFORM_I2C_NUM_BUSES) return ATC_TOPO_ERR_BUS;
+        /* 0x00-0x07 and 0x78-0x7F are reserved */
+        if (ex[i].addr < 0x08 || ex[i].addr > 0x77 || ex[i].addr == PLATFORM_I2C_MUX_ADDR) {
+            return ATC_TOPO_ERR_ADDR;
+        }
+        for (uint8_t j = 0; j < i; ++j) {
+            if (ex[j].bus == ex[i].bus && ex[j].addr == ex[i].addr) return ATC_TOPO_ERR_DUP;
+        }
+        t->map[i] = ex[i];
+        t->chan_src[i][0] = t->chan_src[i][1] = CHAN_ZERO;
+    }
+    for (uint8_t c = 0; c < num_ch; ++c) {
+        if (ch[c].expander == ATC_CHAN_UNUSED) continue;
+        if (ch[c].expander >= num_ex || ch[c].slot > 1) return ATC_TOPO_ERR_CHANNEL;
+        uint8_t *src = &t->chan_src[ch[c].expander][ch[c].slot];
+        if (*src != CHAN_ZERO) return ATC_TOPO_ERR_SLOT;
+        *src = c;
+    }
+    t->num_expanders = num_ex;
+    t->num_channels = num_ch;
+
+    uint8_t order[ATC_MAX_EXPANDERS];
+    sorted_expander_order(t, order);
+    uint8_t n = 0;
+    uint8_t cur_bus = ATC_NONE;
+    for (uint8_t i = 0; i < num_ex; ++i) {
+        uint8_t e = order[i];
+        const atc_topo_expander_t *map = &t->map[e];
+
+        if (map->bus != cur_bus) {
+            t->prog_template[n].expander = ATC_OP_MUX;
+            t->prog_template[n].bus = map->bus;
+            platform_i2c_mux_xfer(map->bus, &t->prog_template[n].xfer);
+            cur_bus = map->bus;
+            ++n;
+        }
 
-    /* For each preset, compute payloads for each IO expander */
-    for (uint8_t p = 0; p < num_presets; ++p) {
-        for (uint8_t ex = 0; ex < NUM_IO_EXPANDERS; ++ex) {
-            const ioexp_map_t *map = &ioexp_map[ex];
-            ioexp_payload_t payload = { .bytes = {0,0,0} };
-
-            /* Hardcoded mapping table to match your Python TUNING_SETUP_CONFIG (index 0==ch1).
-               Format: {bus, addr, chanb, active}
-               If your hardware mapping differs, replace this table with the real mapping.
-            */
-            static const struct { uint8_t bus; uint8_t addr; uint8_t chanb; uint8_t active; } rx_channel_map[NUM_CHANNELS_RX] = {
-                {IO_EXP_BUS0, IO_EXP_ADDR1, 0, ACTIVE_CHANNEL}, /* ch1 */
-                {IO_EXP_BUS0, IO_EXP_ADDR1, 1, ACTIVE_CHANNEL}, /* ch2 */
-                {IO_EXP_BUS1, IO_EXP_ADDR1, 0, ACTIVE_CHANNEL}, /* ch3 */
-                {IO_EXP_BUS1, IO_EXP_ADDR1, 1, ACTIVE_CHANNEL}, /* ch4 */
-                {IO_EXP_BUS1, IO_EXP_ADDR2, 0, ACTIVE_CHANNEL}, /* ch5 */
-                {IO_EXP_BUS1, IO_EXP_ADDR2, 1, ACTIVE_CHANNEL}, /* ch6 */
-                {IO_EXP_BUS0, IO_EXP_ADDR2, 0, INACTIVE_CHANNEL},/* ch7 */
-                {IO_EXP_BUS0, IO_EXP_ADDR2, 1, INACTIVE_CHANNEL},/* ch8 */
-                {IO_EXP_BUS2, IO_EXP_ADDR1, 0, INACTIVE_CHANNEL},/* ch9 */
-                {IO_EXP_BUS2, IO_EXP_ADDR1, 1, INACTIVE_CHANNEL},/* ch10 */
-                {IO_EXP_BUS2, IO_EXP_ADDR2, 0, INACTIVE_CHANNEL},/* ch11 */
-                {IO_EXP_BUS2, IO_EXP_ADDR2, 1, INACTIVE_CHANNEL} /* ch12 */
-            };
-
-            /* Find chanA_index & chanB_index matching this expander mapping.
-               chanA_index/chanB_index are indices 0..(NUM_CHANNELS_RX-1) for RX channels.
-            */
-            int chanA_index = -1;
-            int chanB_index = -1;
-            for (int i = 0; i < NUM_CHANNELS_RX; ++i) {
-                if (rx_channel_map[i].bus == map->bus && rx_channel_map[i].addr == map->addr) {
-                    if (rx_channel_map[i].chanb == 0) chanA_index = i; else chanB_index = i;
-                }
-            }
+        t->prog_template[n].expander = e;
+        t->prog_template[n].bus = map->bus;
+        t->prog_template[n].xfer.addr = map->addr;
+        t->prog_template[n].xfer.len = 4;
+        t->prog_template[n].xfer.buf[0] = IO_EXP_OUTPUTS_REG;
+        ++n;
+    }
+    t->prog_len = n;
+    return 0;
+}
+
+/* built-in topology from ioexp_map / rx_channel_map: TX drives channel A of the
+   expander on IOEXP_TX_BUS, RX channels go where rx_channel_map points them */
+static void topo_load_default(void)
+{
+    atc_topo_expander_t ex[NUM_IO_EXPANDERS];
+    atc_topo_channel_t ch[NUM_CHANNELS];
 
-            uint16_t chanA_enc = 0;
-            uint16_t chanB_enc = 0;
-
-            /* If this expander is the TX expander, use presets[p][0] as TX config (first element) */
-            if (map->bus == IOEXP_TX_BUS) {
-                const aperture_channel_config_t *tx_cfg = &presets[p][0];
-                chanA_enc = atc_encode_channel_config(tx_cfg);
-                chanB_enc = 0;
-            } else {
-                /* For RX expanders, pick the rx config from presets[p][1 + rx_index] */
-                if (chanA_index >= 0) {
-                    const aperture_channel_config_t *cfg = &presets[p][1 + chanA_index];
-                    chanA_enc = atc_encode_channel_config(cfg);
-                } else {
-                    chanA_enc = 0;
-                }
-                if (chanB_index >= 0) {
-                    const aperture_channel_config_t *cfg = &presets[p][1 + chanB_index];
-                    chanB_enc = atc_encode_channel_config(cfg);
-                } else {
-                    chanB_enc = 0;
-                }
+    for (uint8_t e = 0; e < NUM_IO_EXPANDERS; ++e) {
+        ex[e].bus = ioexp_map[e].bus;
+        ex[e].addr = ioexp_map[e].addr;
+    }
+    for (uint8_t c = 0; c < NUM_CHANNELS; ++c) {
+        ch[c].expander = ATC_CHAN_UNUSED;
+        ch[c].slot = 0;
+    }
+    for (uint8_t e = 0; e < NUM_IO_EXPANDERS; ++e) {
+        if (ioexp_map[e].bus == IOEXP_TX_BUS) ch[0].expander = e;
+    }
+    for (uint8_t i = 0; i < RX_MAP_USED; ++i) {
+        for (uint8_t e = 0; e < NUM_IO_EXPANDERS; ++e) {
+            if (ioexp_map[e].bus == IOEXP_TX_BUS) continue;
+            if (rx_channel_map[i].bus == ioexp_map[e].bus &&
+                rx_channel_map[i].addr == ioexp_map[e].addr) {
+                ch[1 + i].expander = e;
+                ch[1 + i].slot = rx_channel_map[i].chanb ? 1 : 0;
             }
+        }
+    }
+    if (topo_compile(&topo, ex, NUM_IO_EXPANDERS, ch, NUM_CHANNELS) != 0) {
+        xil_printf("atc: built-in topology rejected\r\n");
+    }
+    topo_ready = 1;
+}
 
-            assemble_payload_from_chan12(chanA_enc, chanB_enc, &payload);
+static inline void topo_ensure(void)
+{
+    if (!topo_ready) topo_load_default();
+}
 
-            /* store into precomputed array */
-            precomputed_payloads[p * NUM_IO_EXPANDERS + ex] = payload;
+/* compute payloads + program for one preset into `bank`.
+   cfg has topo.num_channels entries: index 0 = TX, 1..N = RX1..RXN.
+   Linear in channels + expanders, no branches on the mapping. */
+static void precompute_preset(atc_bank_t *bank, uint8_t p, const aperture_channel_config_t *cfg_in)
+{
+    /* every channel encoded once; slot CHAN_ZERO feeds unused expander inputs */
+    uint16_t enc[ATC_MAX_CHANNELS + 1];
+    for (uint8_t c = 0; c < topo.num_channels; ++c) {
+        enc[c] = encode_channel(&cfg_in[c]);
+    }
+    enc[CHAN_ZERO] = 0;
+
+    /* combined = (chanB << 12) | chanA, little-endian into the 3 payload bytes */
+    ioexp_payload_t *out = bank->payloads[p];
+    for (uint8_t ex = 0; ex < topo.num_expanders; ++ex) {
+        uint32_t combined = ((uint32_t)enc[topo.chan_src[ex][1]] << 12) | enc[topo.chan_src[ex][0]];
+        out[ex].bytes[0] = (uint8_t)combined;
+        out[ex].bytes[1] = (uint8_t)(combined >> 8);
+        out[ex].bytes[2] = (uint8_t)(combined >> 16);
+        bank->payload_crc[p][ex] = payload_crc(&out[ex]);
+    }
+
+    /* program = template + payloads */
+    atc_prog_op_t *ops = bank->programs[p];
+    memcpy(ops, topo.prog_template, topo.prog_len * sizeof(ops[0]));
+    for (uint8_t i = 0; i < topo.prog_len; ++i) {
+        if (ops[i].expander != ATC_OP_MUX) {
+            memcpy(&ops[i].xfer.buf[1], out[ops[i].expander].bytes, 3);
         }
     }
+    bank->program_len[p] = topo.prog_len;
+}
+
+int atc_stage_begin(uint8_t num_presets)
+{
+    if (num_presets == 0 || num_presets > MAX_PRESETS) return -1;
+    topo_ensure();
+
+    /* never the bank an applier can see */
+    staging_bank = (active_bank == &banks[0]) ? &banks[1] : &banks[0];
+    memset(staging_bank, 0, sizeof(*staging_bank));
+    staging_bank->num_presets = num_presets;
+    memset(staged, 0, sizeof(staged));
+    staged_count = 0;
+    return 0;
+}
+
+int atc_stage_preset(uint8_t preset_index, const aperture_channel_config_t *cfg)
+{
+    if (!staging_bank) return -1;
+    if (preset_index >= staging_bank->num_presets) return -2;
+
+    precompute_preset(staging_bank, preset_index, cfg);
+    if (!staged[preset_index]) {
+        staged[preset_index] = 1;
+        staged_count++;
+    }
+    return 0;
+}
+
+uint8_t atc_stage_remaining(void)
+{
+    if (!staging_bank) return 0;
+    return (uint8_t)(staging_bank->num_presets - staged_count);
+}
+
+int atc_stage_commit(void)
+{
+    if (!staging_bank) return -1;
+    if (staged_count != staging_bank->num_presets) return -2;
 
+    /* single aligned store: an ISR sees either the old or the new table */
+    ATC_PUBLISH_BARRIER();
+    active_bank = staging_bank;
+    staging_bank = NULL;
     return 0;
 }
 
+void atc_stage_abort(void)
+{
+    staging_bank = NULL;
+    staged_count = 0;
+}
+
+/* New signature: presets has atc_num_channels() entries per preset:
+   index 0 = TX, indices 1..N = RX1..RXN */
+int atc_precompute_sets(const aperture_channel_config_t presets[][ATC_MAX_CHANNELS],
+                        uint8_t num_presets)
+{
+    if (atc_stage_begin(num_presets) != 0) return -1;
+
+    /* For each preset, compute payloads for each IO expander */
+    for (uint8_t p = 0; p < num_presets; ++p) {
+        atc_stage_preset(p, presets[p]);
+    }
+
+    return atc_stage_commit();
+}
+
 /* Return pointer to precomputed payload */
 const ioexp_payload_t* atc_get_payload_ptr(uint8_t preset_index, uint8_t expander_index)
 {
-    if (!precomputed_payloads) return NULL;
-    if (preset_index >= precomputed_num_presets) return NULL;
-    if (expander_index >= NUM_IO_EXPANDERS) return NULL;
-    return &precomputed_payloads[preset_index * NUM_IO_EXPANDERS + expander_index];
+    const atc_bank_t *bank = active_bank;
+    if (!bank) return NULL;
+    if (preset_index >= bank->num_presets) return NULL;
+    if (expander_index >= topo.num_expanders) return NULL;
+    return &bank->payloads[preset_index][expander_index];
 }
 
 /* Number of expanders */
-uint8_t atc_num_io_expanders(void) { return NUM_IO_EXPANDERS; }
+uint8_t atc_num_io_expanders(void) { topo_ensure(); return topo.num_expanders; }
 
-/* Blocking application: loop expanders, set MUX, write 3 bytes to outputs register */
-int atc_apply_preset_blocking(uint8_t preset_index)
+uint8_t atc_num_channels(void) { topo_ensure(); return topo.num_channels; }
+
+int atc_get_program(uint8_t preset_index, const atc_prog_op_t **ops, uint8_t *count)
 {
-    if (!precomputed_payloads) return -1;
-    if (preset_index >= precomputed_num_presets) return -2;
+    const atc_bank_t *bank = active_bank;
+    if (!bank) return -1;
+    if (preset_index >= bank->num_presets) return -2;
+    *ops = bank->programs[preset_index];
+    *count = bank->program_len[preset_index];
+    return 0;
+}
 
-    for (uint8_t ex = 0; ex < NUM_IO_EXPANDERS; ++ex) {
-        const ioexp_map_t *map = &ioexp_map[ex];
-        const ioexp_payload_t *pl = atc_get_payload_ptr(preset_index, ex);
-        if (!pl) continue;
-        /* Set MUX to appropriate bus */
-        if (platform_i2c_write_mux(map->bus) != 0) {
-            /* handle mux error */
+/* --- readback verify state (see atc_set_verify) --- */
+#define VERIFY_READ_BYTES  6    /* addr+W, reg, addr+R, 3 data bytes */
+#define VERIFY_MUX_BYTES   2    /* addr+W, channel mask */
+
+static uint8_t verify_pct = ATC_VERIFY_OFF;
+static volatile uint32_t verify_credit = 0;  /* wire bytes verify may spend; >0 = pass due */
+static uint8_t verify_cursor = 0;            /* next prog_template slot to read back */
+static atc_verify_stats_t verify_stats;
+
+/* applies earn verify budget in proportion to what they put on the wire
+   (called from emit, so possibly from the GPIO ISR) */
+static inline void verify_earn(const platform_i2c_xfer_t *xfers, uint8_t n)
+{
+    if (verify_pct == ATC_VERIFY_OFF || n == 0) return;
+    uint32_t bytes = 0;
+    for (uint8_t i = 0; i < n; ++i) bytes += 1u + xfers[i].len;
+    uint32_t cap = (uint32_t)topo.num_expanders * (VERIFY_READ_BYTES + VERIFY_MUX_BYTES);
+    uint32_t credit = verify_credit +
+                      ((verify_pct == ATC_VERIFY_ALL) ? cap : bytes * verify_pct / 100u);
+    verify_credit = (credit > cap) ? cap : credit;
+}
+
+/* emit helper; ex_out (optional) receives the expander index per xfer (ATC_OP_MUX for mux) */
+static int emit_program(uint8_t preset_index, platform_i2c_xfer_t *out, uint8_t *ex_out,
+                        uint8_t max_xfers)
+{
+    const atc_bank_t *bank = active_bank;
+    if (!bank) return -1;
+    if (preset_index >= bank->num_presets) return -2;
+
+    const atc_prog_op_t *ops = bank->programs[preset_index];
+    const ioexp_payload_t *target = bank->payloads[preset_index];
+    uint8_t len = bank->program_len[preset_index];
+    uint8_t mux_bus = emitted_mux_bus;
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < len; ++i) {
+        const atc_prog_op_t *op = &ops[i];
+        if (op->expander == ATC_OP_MUX) continue; /* emitted lazily below */
+
+        /* skip expanders whose last written value already matches */
+        if ((shadow_valid & (1u << op->expander)) &&
+            memcmp(&shadow_payloads[op->expander], &target[op->expander],
+                   sizeof(ioexp_payload_t)) == 0) {
             continue;
-            // return -3;
         }
-        /* write to IO_EXP_OUTPUTS_REG */
-        if (platform_i2c_write(map->addr, IO_EXP_OUTPUTS_REG, pl->bytes, 3) != 0) {
-            /* handle write error */
-            continue;
-            // return -4;
+
+        if (op->bus != mux_bus) {
+            if (n >= max_xfers) return -3;
+            if (ex_out) ex_out[n] = ATC_OP_MUX;
+            platform_i2c_mux_xfer(op->bus, &out[n++]);
+            mux_bus = op->bus;
         }
+        if (n >= max_xfers) return -3;
+        if (ex_out) ex_out[n] = op->expander;
+        out[n++] = op->xfer;
+    }
 
-        // xil_printf("AT Control: %02x %02x %02x\r\n", (unsigned int)pl->bytes[0], (unsigned int)pl->bytes[1], (unsigned int)pl->bytes[2]);
+    /* commit the shadow only once the whole sequence fits */
+    for (uint8_t ex = 0; ex < topo.num_expanders; ++ex) {
+        shadow_payloads[ex] = target[ex];
     }
+    memcpy(shadow_crc, bank->payload_crc[preset_index], topo.num_expanders);
+    shadow_valid = (1u << topo.num_expanders) - 1u;
+    shadow_gen++;
+    emitted_mux_bus = mux_bus;
+    saved_xfers_total += (uint32_t)(len - n);
+    verify_earn(out, n);
+    return n;
+}
+
+int atc_emit_program(uint8_t preset_index, platform_i2c_xfer_t *out, uint8_t max_xfers)
+{
+    return emit_program(preset_index, out, NULL, max_xfers);
+}
+
+static int run_program_fanout(const platform_i2c_xfer_t *xfers, const uint8_t *ex_idx, int n)
+{
+    platform_i2c_xfer_t writes[ATC_MAX_EXPANDERS];
+    uint8_t bus[ATC_MAX_EXPANDERS];
+    uint8_t ex_of[ATC_MAX_EXPANDERS];
+    uint8_t st[ATC_MAX_EXPANDERS];
+    uint8_t m = 0;
+
+    /* the platform layer selects mux channels per controller itself */
+    for (int i = 0; i < n; ++i) {
+        if (ex_idx[i] == ATC_OP_MUX) continue;
+        writes[m] = xfers[i];
+        bus[m] = topo.map[ex_idx[i]].bus;
+        ex_of[m] = ex_idx[i];
+        ++m;
+    }
+    emitted_mux_bus = ATC_NONE;
+    if (m == 0) return 0;
+
+    /* the fan-out takes PLATFORM_I2C_FANOUT_MAX writes at a time */
+    for (uint8_t k = 0; k < m; k += PLATFORM_I2C_FANOUT_MAX) {
+        uint8_t cnt = (uint8_t)((m - k < PLATFORM_I2C_FANOUT_MAX) ? m - k : PLATFORM_I2C_FANOUT_MAX);
+        if (platform_i2c_fanout(&writes[k], &bus[k], cnt, &st[k]) < 0) {
+            memset(&st[k], PLATFORM_I2C_SEG_TIMEOUT, cnt);
+        }
+    }
+
+    int failed = 0;
+    for (uint8_t k = 0; k < m; ++k) {
+        if (st[k] == PLATFORM_I2C_SEG_OK) continue;
+        failed++;
+        shadow_valid &= ~(1u << ex_of[k]);
+    }
+    return failed;
+}
+
+/* polled executor: runs xfers as one repeated-START burst (or fanned out over
+   several controllers), drops the shadow of any expander that failed */
+static int run_program_blocking(const platform_i2c_xfer_t *xfers, const uint8_t *ex_idx, int n)
+{
+    platform_i2c_seg_t segs[ATC_PROGRAM_MAX_OPS];
+    uint8_t seg_status[ATC_PROGRAM_MAX_OPS];
+
+    if (n <= 0) return 0;
+    if (n > ATC_PROGRAM_MAX_OPS) n = ATC_PROGRAM_MAX_OPS;   /* emit_program bound */
+    if (platform_i2c_fanout_active()) {
+        return run_program_fanout(xfers, ex_idx, n);
+    }
+    for (int i = 0; i < n; ++i) {
+        const platform_i2c_xfer_t *x = &xfers[i];
+        /* buf[0] is the register (or the mux channel byte for mux selects) */
+        segs[i].addr = x->addr;
+        segs[i].reg = x->buf[0];
+        segs[i].len = (uint8_t)(x->len - 1);
+        segs[i].data = &x->buf[1];
+        segs[i].flags = (ex_idx[i] == ATC_OP_MUX) ? PLATFORM_I2C_SEG_STOP : 0;
+    }
+
+    if (platform_i2c_write_batch(segs, (uint8_t)n, seg_status) < 0) {
+        /* nothing went out */
+        memset(seg_status, PLATFORM_I2C_SEG_TIMEOUT, (size_t)n);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < n; ++i) {
+        if (seg_status[i] == PLATFORM_I2C_SEG_OK) continue;
+        /* handle write error */
+        failed++;
+        if (ex_idx[i] == ATC_OP_MUX) {
+            emitted_mux_bus = ATC_NONE;
+        } else {
+            shadow_valid &= ~(1u << ex_idx[i]);
+        }
+    }
+    if (failed) emitted_mux_bus = ATC_NONE;
+    return failed;
+}
+
+/* --- readback verify ---
+   One pass is a single mixed burst: a STOP-terminated mux select per bus and
+   a write-reg / repeated-START / 3-byte read of IO_EXP_OUTPUTS_REG per
+   expander, walking the bus-sorted template from verify_cursor for as long
+   as the earned credit lasts. Each retry round is again one burst: rewrite
+   from the shadow, then read back, for the mismatched expanders only.
+   An ISR emit during the pass (shadow_gen moves) voids the comparison: the
+   shadow then describes the queued program, not the wire. */
+
+#define ATC_TICKS_PER_US (COUNTS_PER_SECOND / 1000000u)
+
+typedef struct {
+    platform_i2c_seg_t segs[ATC_PROGRAM_MAX_OPS + ATC_MAX_EXPANDERS];
+    uint8_t ex_of[ATC_PROGRAM_MAX_OPS + ATC_MAX_EXPANDERS];   /* ATC_OP_MUX for selects */
+    uint8_t n;
+    uint8_t bus;
+} verify_burst_t;
+
+static void verify_add(verify_burst_t *vb, uint8_t ex, int rewrite, ioexp_payload_t *rb)
+{
+    const atc_topo_expander_t *map = &topo.map[ex];
+    platform_i2c_seg_t *sg;
+
+    if (map->bus != vb->bus) {
+        platform_i2c_xfer_t mux;
+        platform_i2c_mux_xfer(map->bus, &mux);
+        sg = &vb->segs[vb->n];
+        sg->addr = mux.addr;
+        sg->reg = mux.buf[0];
+        sg->len = 0;
+        sg->data = NULL;
+        sg->flags = PLATFORM_I2C_SEG_STOP;
+        vb->ex_of[vb->n++] = ATC_OP_MUX;
+        vb->bus = map->bus;
+    }
+    if (rewrite) {
+        sg = &vb->segs[vb->n];
+        sg->addr = map->addr;
+        sg->reg = IO_EXP_OUTPUTS_REG;
+        sg->len = sizeof(ioexp_payload_t);
+        sg->data = shadow_payloads[ex].bytes;
+        sg->flags = 0;
+        vb->ex_of[vb->n++] = ex;
+    }
+    sg = &vb->segs[vb->n];
+    sg->addr = map->addr;
+    sg->reg = IO_EXP_OUTPUTS_REG;
+    sg->len = sizeof(ioexp_payload_t);
+    sg->rx = rb->bytes;
+    sg->flags = PLATFORM_I2C_SEG_READ;
+    vb->ex_of[vb->n++] = ex;
+}
+
+/* run a burst; failed expanders lose their shadow bit and are dropped from
+   the list. Returns <0 if the bus could not be taken. */
+static int verify_run(verify_burst_t *vb, uint8_t *list, uint8_t *count)
+{
+    uint8_t st[ATC_PROGRAM_MAX_OPS + ATC_MAX_EXPANDERS];
+    int rc = platform_i2c_read_batch(vb->segs, vb->n, st);
+    if (rc < 0) return rc;
+
+    uint32_t failed_mask = 0;
+    int mux_failed = 0;
+    for (uint8_t i = 0; i < vb->n; ++i) {
+        if (st[i] == PLATFORM_I2C_SEG_OK) continue;
+        if (vb->ex_of[i] == ATC_OP_MUX) mux_failed = 1;
+        else failed_mask |= 1u << vb->ex_of[i];
+    }
+    uint8_t m = 0;
+    for (uint8_t k = 0; k < *count; ++k) {
+        if (failed_mask & (1u << list[k])) {
+            verify_stats.read_errors++;
+            shadow_valid &= ~(1u << list[k]);
+        } else {
+            list[m++] = list[k];
+        }
+    }
+    *count = m;
+    return mux_failed ? 1 : 0;
+}
+
+/* Returns expanders still wrong, <0 if the bus was busy */
+static int verify_pass(int all)
+{
+    if (platform_i2c_fanout_active()) {
+        verify_credit = 0;
+        return 0;
+    }
+
+    XTime t0;
+    XTime_GetTime(&t0);
+
+    uint32_t irq = platform_i2c_irq_save();
+    uint32_t budget = verify_credit;
+    uint32_t gen = shadow_gen;
+    uint8_t mux_after = emitted_mux_bus;
+    emitted_mux_bus = ATC_NONE;          /* an emit during the pass selects explicitly */
+    platform_i2c_irq_restore(irq);
+
+    /* pick shadow-valid expanders, bus-sorted from the cursor, while the budget lasts */
+    uint8_t list[ATC_MAX_EXPANDERS];
+    ioexp_payload_t rb[ATC_MAX_EXPANDERS];   /* by expander index */
+    uint8_t count = 0;
+    uint8_t bus = ATC_NONE;
+    uint32_t spent = 0;
+    int starved = 0;
+    uint8_t slot = (verify_cursor < topo.prog_len) ? verify_cursor : 0;
+    for (uint8_t k = 0; k < topo.prog_len; ++k) {
+        uint8_t ex = topo.prog_template[slot].expander;
+        if (ex != ATC_OP_MUX && (shadow_valid & (1u << ex))) {
+            uint32_t cost = VERIFY_READ_BYTES + ((topo.map[ex].bus != bus) ? VERIFY_MUX_BYTES : 0);
+            if (!all && spent + cost > budget) {
+                starved = 1;
+                break;
+            }
+            spent += cost;
+            bus = topo.map[ex].bus;
+            list[count++] = ex;
+        }
+        slot = (uint8_t)((slot + 1) % topo.prog_len);
+    }
+    verify_cursor = slot;
+
+    int wrong = 0;
+    verify_burst_t vb;
+    for (uint8_t attempt = 0; count > 0; ++attempt) {
+        vb.n = 0;
+        vb.bus = ATC_NONE;
+        for (uint8_t k = 0; k < count; ++k) verify_add(&vb, list[k], attempt > 0, &rb[list[k]]);
+        if (attempt == 0) verify_stats.reads += count;
+        int rc = verify_run(&vb, list, &count);
+        if (rc < 0) {
+            /* bus taken (an ISR apply got in first): try again next time */
+            wrong = rc;
+            break;
+        }
+        mux_after = rc ? ATC_NONE : vb.bus;
+        if (attempt == 0) verify_stats.passes++;
+        if (shadow_gen != gen) break;   /* superseded by a new apply */
+
+        /* keep the mismatched ones */
+        uint8_t m = 0;
+        for (uint8_t k = 0; k < count; ++k) {
+            uint8_t ex = list[k];
+            if (payload_crc(&shadow_payloads[ex]) != shadow_crc[ex]) {
+                verify_stats.shadow_errors++;
+                shadow_valid &= ~(1u << ex);   /* next apply rewrites it from the bank */
+                continue;
+            }
+            if (memcmp(rb[ex].bytes, shadow_payloads[ex].bytes, sizeof(ioexp_payload_t)) == 0) {
+                if (attempt > 0) verify_stats.repaired++;
+                continue;
+            }
+            if (attempt == 0) verify_stats.corruptions++;
+            list[m++] = ex;
+        }
+        count = m;
+        if (count > 0 && attempt == ATC_VERIFY_RETRIES) {
+            verify_stats.unrepaired += count;
+            for (uint8_t k = 0; k < count; ++k) shadow_valid &= ~(1u << list[k]);
+            wrong = count;
+            break;
+        }
+    }
+
+    irq = platform_i2c_irq_save();
+    if (emitted_mux_bus == ATC_NONE && shadow_gen == gen) emitted_mux_bus = mux_after;
+    if (wrong >= 0) {
+        if (all || !starved) verify_credit = 0;
+        else verify_credit = (verify_credit > spent) ? verify_credit - spent : 0;
+    }
+    platform_i2c_irq_restore(irq);
+
+    XTime t1;
+    XTime_GetTime(&t1);
+    verify_stats.total_us += ((uint32_t)t1 - (uint32_t)t0) / ATC_TICKS_PER_US;
+    return wrong;
+}
+
+void atc_set_verify(uint8_t budget_pct)
+{
+    verify_pct = (budget_pct > 100 && budget_pct != ATC_VERIFY_ALL) ? 100 : budget_pct;
+    verify_credit = 0;
+}
+
+uint8_t atc_get_verify(void) { return verify_pct; }
+
+int atc_verify_service(void)
+{
+    if (verify_pct == ATC_VERIFY_OFF || verify_credit == 0) return 0;
+    if (platform_i2c_async_busy()) return -1;
+    return verify_pass(verify_pct == ATC_VERIFY_ALL);
+}
+
+int atc_verify_now(void)
+{
+    if (platform_i2c_async_busy()) return -1;
+    return verify_pass(1);
+}
+
+void atc_get_verify_stats(atc_verify_stats_t *out) { *out = verify_stats; }
+
+void atc_reset_verify_stats(void) { memset(&verify_stats, 0, sizeof(verify_stats)); }
+
+/* Blocking application: polled executor for the emitted program, then the
+   verify pass it paid for */
+int atc_apply_preset_blocking(uint8_t preset_index)
+{
+    platform_i2c_xfer_t xfers[ATC_PROGRAM_MAX_OPS];
+    uint8_t ex_idx[ATC_PROGRAM_MAX_OPS];
+    int n = emit_program(preset_index, xfers, ex_idx, ATC_PROGRAM_MAX_OPS);
+    if (n < 0) return n;
+
+    run_program_blocking(xfers, ex_idx, n);
+    if (verify_credit) verify_pass(verify_pct == ATC_VERIFY_ALL);
     return 0;
 }
 
-/* Placeholder async API - actual implementation depends on your platform */
+/* --- async apply: mux+payload sequence handed to the platform_i2c ISR engine --- */
+static atc_apply_done_cb_t apply_done_cb = NULL;
+static atc_latency_stat_t latency_stats[MAX_PRESETS];
+static XTime async_start_time[MAX_PRESETS];
+
+
+static void atc_record_latency(uint8_t preset_index, XTime start, int failed)
+{
+    XTime now;
+    XTime_GetTime(&now);
+    /* TTC counter is 32 bit: take the delta modulo 2^32 */
+    uint32_t us = ((uint32_t)now - (uint32_t)start) / ATC_TICKS_PER_US;
+
+    atc_latency_stat_t *st = &latency_stats[preset_index];
+    if (st->count == 0 || us < st->min_us) st->min_us = us;
+    if (us > st->max_us) st->max_us = us;
+    st->last_us = us;
+    st->total_us += us;
+    st->count++;
+    if (failed) st->errors++;
+}
+
+/* platform_i2c batch callback (ISR context) */
+static void atc_async_done(void *ref, uint8_t failed)
+{
+    uint8_t preset_index = (uint8_t)(uintptr_t)ref;
+    if (failed) {
+        /* the batch does not say which write failed */
+        shadow_invalidate_all();
+    }
+    atc_record_latency(preset_index, async_start_time[preset_index], failed);
+    if (apply_done_cb) apply_done_cb(preset_index, failed);
+}
+
+/* shared async path; returns number of transactions issued, <0 on error */
+static int apply_async(uint8_t preset_index)
+{
+    const atc_bank_t *bank = active_bank;
+    if (!bank) return -1;
+    if (preset_index >= bank->num_presets) return -2;
+
+    if (!platform_i2c_async_ready() || platform_i2c_fanout_active()) {
+        /* async engine not set up, or buses spread over several controllers
+           (the async queue only drives the AXI IIC): polled/fan-out executor.
+           It spins on the bus, so an ISR caller gets an error and defers. */
+        if (platform_i2c_in_isr()) return -4;
+        platform_i2c_xfer_t xfers[ATC_PROGRAM_MAX_OPS];
+        uint8_t ex_idx[ATC_PROGRAM_MAX_OPS];
+        XTime_GetTime(&async_start_time[preset_index]);
+        int n = emit_program(preset_index, xfers, ex_idx, ATC_PROGRAM_MAX_OPS);
+        if (n < 0) return n;
+        int failed = run_program_blocking(xfers, ex_idx, n);
+        atc_record_latency(preset_index, async_start_time[preset_index], failed);
+        if (apply_done_cb) apply_done_cb(preset_index, failed);
+        return n;
+    }
+
+    /* snapshot so a full queue leaves the shadow untouched */
+    ioexp_payload_t prev_shadow[ATC_MAX_EXPANDERS];
+    uint8_t prev_crc[ATC_MAX_EXPANDERS];
+    uint32_t prev_valid = shadow_valid;
+    uint8_t prev_mux = emitted_mux_bus;
+    uint32_t prev_credit = verify_credit;
+    memcpy(prev_shadow, shadow_payloads, sizeof(prev_shadow));
+    memcpy(prev_crc, shadow_crc, sizeof(prev_crc));
+
+    platform_i2c_xfer_t xfers[ATC_PROGRAM_MAX_OPS];
+    int n = emit_program(preset_index, xfers, NULL, ATC_PROGRAM_MAX_OPS);
+    if (n < 0) return n;
+
+    XTime_GetTime(&async_start_time[preset_index]);
+    if (n == 0) {
+        /* already there */
+        atc_async_done((void *)(uintptr_t)preset_index, 0);
+        return 0;
+    }
+    if (platform_i2c_submit(xfers, (uint8_t)n, atc_async_done, (void *)(uintptr_t)preset_index) != 0) {
+        /* nothing was queued: roll back the shadow state */
+        memcpy(shadow_payloads, prev_shadow, sizeof(prev_shadow));
+        memcpy(shadow_crc, prev_crc, sizeof(prev_crc));
+        shadow_valid = prev_valid;
+        emitted_mux_bus = prev_mux;
+        verify_credit = prev_credit;
+        saved_xfers_total -= (uint32_t)(bank->program_len[preset_index] - n);
+        return -3;
+    }
+    return n;
+}
+
 int atc_apply_preset_async(uint8_t preset_index)
 {
-    /* Ideally push preset_index into a queue that an I2C transfer task processes.
-       To keep this file generic, we just call blocking implementation.
-       Replace this with a non-blocking dispatcher for production. */
-    return atc_apply_preset_blocking(preset_index);
+    int n = apply_async(preset_index);
+    return (n < 0) ? n : 0;
+}
+
+int atc_apply_preset_delta(uint8_t preset_index, uint8_t *saved_xfers)
+{
+    const atc_bank_t *bank = active_bank;
+    int n = apply_async(preset_index);
+    if (n < 0) return n;
+    if (saved_xfers) *saved_xfers = (uint8_t)(bank->program_len[preset_index] - n);
+    return n;
+}
+
+void atc_invalidate_shadow(void) { shadow_invalidate_all(); }
+
+uint32_t atc_saved_transactions_total(void) { return saved_xfers_total; }
+
+void atc_set_apply_callback(atc_apply_done_cb_t cb) { apply_done_cb = cb; }
+
+const atc_latency_stat_t* atc_get_latency_stat(uint8_t preset_index)
+{
+    if (preset_index >= MAX_PRESETS) return NULL;
+    return &latency_stats[preset_index];
+}
+
+void atc_reset_latency_stats(void)
+{
+    memset(latency_stats, 0, sizeof(latency_stats));
 }
 
 /* Initialization placeholder - sets up I2C, optionally config/invert regs on expanders */
@@ -229,41 +929,95 @@ const uint8_t inversion_register_config[3] = {0xFF, 0xFF, 0xFF};
 
 int atc_init(void)
 {
-    /* If you need to configure expanders (set config/invert registers), do it here once.
-       For example: for each expander set platform_i2c_set_mux(map.bus) then write config registers. */
-
-    for (uint8_t ex = 0; ex < NUM_IO_EXPANDERS; ++ex) {
-        const ioexp_map_t *map = &ioexp_map[ex];
+    /* Configure every expander (config + invert registers) in as few bursts as
+       possible: bus-sorted, a STOP-terminated mux select per bus, then both
+       register writes per expander chained with repeated START. */
+    platform_i2c_seg_t segs[PLATFORM_I2C_BATCH_MAX_SEGS];
+    uint8_t order[ATC_MAX_EXPANDERS];
+    uint8_t n = 0;
+    uint8_t cur_bus = ATC_NONE;
+    int failed = 0;
+
+    topo_ensure();
+    sorted_expander_order(&topo, order);
+    for (uint8_t i = 0; i < topo.num_expanders; ++i) {
+        const atc_topo_expander_t *map = &topo.map[order[i]];
+
+        /* burst full: flush and select the bus again in the next one */
+        if (n + 3 > PLATFORM_I2C_BATCH_MAX_SEGS) {
+            failed |= platform_i2c_write_batch(segs, n, NULL);
+            n = 0;
+            cur_bus = ATC_NONE;
+        }
 
         /* Set MUX to appropriate bus */
-        if (platform_i2c_write_mux(map->bus) != 0) {
-            /* handle mux error */
-            continue;
-            // return -3;
+        if (map->bus != cur_bus) {
+            platform_i2c_xfer_t mux;
+            platform_i2c_mux_xfer(map->bus, &mux);
+            segs[n].addr = mux.addr;
+            segs[n].reg = mux.buf[0];
+            segs[n].len = 0;
+            segs[n].data = NULL;
+            segs[n].flags = PLATFORM_I2C_SEG_STOP;
+            ++n;
+            cur_bus = map->bus;
         }
 
-        if (platform_i2c_write(map->addr, IO_EXP_CONFIG_REG, outputs_register_config, 3) != 0) {
-            /* handle write error */
-            continue;
-            // return -4;
-        }
+        segs[n].addr = map->addr;
+        segs[n].reg = IO_EXP_CONFIG_REG;
+        segs[n].len = 3;
+        segs[n].data = outputs_register_config;
+        segs[n].flags = 0;
+        ++n;
+
+        segs[n].addr = map->addr;
+        segs[n].reg = IO_EXP_INVERT_REG;
+        segs[n].len = 3;
+        segs[n].data = inversion_register_config;
+        segs[n].flags = 0;
+        ++n;
+    }
+    if (n) failed |= platform_i2c_write_batch(segs, n, NULL);
 
-        if (platform_i2c_write(map->addr, IO_EXP_INVERT_REG, inversion_register_config, 3) != 0) {
-            /* handle write error */
-            continue;
-            // return -4;
-        }
+    /* failed expanders are left as they are (no error return, as before);
+       the first preset apply writes every expander anyway */
+    if (failed) {
+        xil_printf("atc_init: expander configuration incomplete\r\n");
     }
     return 0;
 }
 
-/* de-init freeing storage */
-void atc_deinit(void)
+int atc_load_topology(const uint8_t *desc, uint32_t len)
 {
-    if (precomputed_payloads) {
-        free(precomputed_payloads);
-        precomputed_payloads = NULL;
+    if (!desc || len < ATC_TOPO_HDR_BYTES || desc[0] != ATC_TOPO_VERSION) {
+        return ATC_TOPO_ERR_FORMAT;
     }
-    precomputed_num_presets = 0;
+    uint8_t num_ex = desc[1];
+    uint32_t num_ch = 1u + desc[2];
+    if (len != ATC_TOPO_HDR_BYTES + 2u * num_ex + 2u * num_ch || num_ch > ATC_MAX_CHANNELS) {
+        return ATC_TOPO_ERR_FORMAT;
+    }
+
+    /* both records are two bytes, no padding */
+    const atc_topo_expander_t *ex = (const atc_topo_expander_t *)(const void *)&desc[ATC_TOPO_HDR_BYTES];
+    const atc_topo_channel_t *ch = (const atc_topo_channel_t *)(const void *)&desc[ATC_TOPO_HDR_BYTES + 2u * num_ex];
+    int rc = topo_compile(&topo_next, ex, num_ex, ch, (uint8_t)num_ch);
+    if (rc != 0) return rc;
+
+    /* presets were computed for the old map: retire them before it changes */
+    active_bank = NULL;
+    ATC_PUBLISH_BARRIER();
+    atc_stage_abort();
+    topo = topo_next;
+    topo_ready = 1;
+    shadow_invalidate_all();
+    return atc_init();
+}
+
+/* de-init: drop the preset tables (appliers return -1 until the next commit) */
+void atc_deinit(void)
+{
+    active_bank = NULL;
+    atc_stage_abort();
 }
 
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "platform_i2c.h"
 
 #define NUM_CHANNELS_RX 6 // 12
 #define NUM_CHANNELS_TX 1
@@ -47,6 +48,26 @@
 #define NUM_IO_EXPANDERS 7
 #endif
 
+/* Capacity for topologies loaded at run time (atc_load_topology); NUM_IO_EXPANDERS
+   and NUM_CHANNELS only describe the built-in one. A program is one write per
+   expander plus a mux select per bus, and must fit one I2C burst. */
+#ifndef ATC_MAX_EXPANDERS
+#define ATC_MAX_EXPANDERS 28
+#endif
+#define ATC_MAX_CHANNELS  (2 * ATC_MAX_EXPANDERS)   /* two 12-bit channels per expander */
+
+/* preset tables are statically sized from MAX_PRESETS x ATC_MAX_EXPANDERS (x2 for
+   double buffering) and placed in the BTCM .atc_tables section */
+#if MAX_PRESETS > 255
+#error "MAX_PRESETS must fit the uint8_t preset index"
+#endif
+#if ATC_MAX_EXPANDERS > 31
+#error "ATC_MAX_EXPANDERS must fit the 32-bit shadow mask"
+#endif
+#if NUM_IO_EXPANDERS > ATC_MAX_EXPANDERS || NUM_CHANNELS > ATC_MAX_CHANNELS
+#error "built-in topology exceeds ATC_MAX_EXPANDERS"
+#endif
+
 /* structure for a single channel config (tuning, matching, detune_enable) */
 typedef struct {
     uint8_t tuning;        /* 0..127 (7 bits) */
@@ -59,21 +80,146 @@ typedef struct {
     uint8_t bytes[3];
 } ioexp_payload_t;
 
+/* precompiled preset program: bus-sorted, one mux select per bus group */
+#define ATC_PROGRAM_MAX_OPS (ATC_MAX_EXPANDERS + PLATFORM_I2C_NUM_BUSES)
+#define ATC_OP_MUX          0xFF   /* atc_prog_op_t.expander value for mux selects */
+
+typedef struct {
+    uint8_t expander;          /* expander index, or ATC_OP_MUX */
+    uint8_t bus;               /* logical bus the op runs on */
+    platform_i2c_xfer_t xfer;  /* ready-to-send transaction */
+} atc_prog_op_t;
+
+/* Topology descriptor, as uploaded over IPI (packed bytes):
+     u8 version (ATC_TOPO_VERSION), u8 num_expanders, u8 num_rx, u8 0,
+     num_expanders x { u8 bus, u8 addr7 },
+     (1 + num_rx)  x { u8 expander index or ATC_CHAN_UNUSED, u8 slot (0 = A, 1 = B) }
+   channel 0 is TX, 1..num_rx are RX1..RXN, matching the preset cfg layout */
+#define ATC_TOPO_VERSION      1
+#define ATC_TOPO_HDR_BYTES    4
+#define ATC_CHAN_UNUSED       0xFF
+
+typedef struct {
+    uint8_t bus;    /* logical bus (mux channel / fan-out route) */
+    uint8_t addr;
+} atc_topo_expander_t;
+
+typedef struct {
+    uint8_t expander;
+    uint8_t slot;
+} atc_topo_channel_t;
+
+/* atc_load_topology errors */
+#define ATC_TOPO_ERR_FORMAT   -1   /* version / counts / length */
+#define ATC_TOPO_ERR_BUS      -2   /* bus out of range */
+#define ATC_TOPO_ERR_ADDR     -3   /* reserved address or the mux */
+#define ATC_TOPO_ERR_DUP      -4   /* two expanders at the same bus/address */
+#define ATC_TOPO_ERR_CHANNEL  -5   /* bad expander index or slot */
+#define ATC_TOPO_ERR_SLOT     -6   /* two channels driving the same slot */
+
+/* completion callback for async apply (ISR context).
+   status: 0 = every write ACKed, >0 = number of failed I2C transactions */
+typedef void (*atc_apply_done_cb_t)(uint8_t preset_index, int status);
+
+/* per-preset switch latency on the async path (request -> last ACK), microseconds */
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} atc_latency_stat_t;
+
+/* Readback verify: after an apply, IO_EXP_OUTPUTS_REG is read back from a
+   rotating set of expanders and compared with the shadow (each entry CRC-8
+   protected). Mismatches are rewritten and re-read up to ATC_VERIFY_RETRIES
+   times. The budget is the share of the apply's own wire bytes spent on it. */
+#define ATC_VERIFY_OFF      0
+#define ATC_VERIFY_ALL      0xFF    /* every expander after every apply */
+#define ATC_VERIFY_RETRIES  2
+
+typedef struct {
+    uint32_t passes;         /* verify passes run */
+    uint32_t reads;          /* expanders read back */
+    uint32_t corruptions;    /* ACKed writes that read back wrong (silent corruption) */
+    uint32_t repaired;       /* corruptions fixed by a rewrite */
+    uint32_t unrepaired;     /* still wrong after ATC_VERIFY_RETRIES rewrites */
+    uint32_t read_errors;    /* readback NACKed / timed out */
+    uint32_t shadow_errors;  /* shadow entry failed its CRC */
+    uint32_t total_us;       /* time spent verifying */
+} atc_verify_stats_t;
+
 /* public API */
 
 /* Initialize controller (set up expanders, i2c, etc) */
 int atc_init(void);
 
-/* Provide mapping arrays (see default mapping in C file) */
-int atc_precompute_sets(const aperture_channel_config_t presets[][NUM_CHANNELS],
+/* Validate a topology descriptor (format above) and compile it. Replaces the
+   built-in map: the preset tables are dropped (appliers return -1 until presets
+   are uploaded again for the new channel count) and the expanders configured.
+   Returns 0 or ATC_TOPO_ERR_*. */
+int atc_load_topology(const uint8_t *desc, uint32_t len);
+
+/* Readback verify budget in percent of apply traffic (1..100), ATC_VERIFY_ALL or
+   ATC_VERIFY_OFF. Blocking applies verify inline; async applies are verified by
+   atc_verify_service() once the queue has drained. Not run while fan-out is
+   active (reads go over the AXI IIC only). */
+void atc_set_verify(uint8_t budget_pct);
+uint8_t atc_get_verify(void);
+
+/* Main loop: verify what async applies wrote since the last call. Returns the
+   number of expanders left wrong, <0 if the bus was busy. */
+int atc_verify_service(void);
+
+/* Verify every expander now, regardless of budget (same return) */
+int atc_verify_now(void);
+
+void atc_get_verify_stats(atc_verify_stats_t *out);
+void atc_reset_verify_stats(void);
+
+/* Provide mapping arrays (see default mapping in C file). Each preset row holds
+   atc_num_channels() entries used of ATC_MAX_CHANNELS. */
+int atc_precompute_sets(const aperture_channel_config_t presets[][ATC_MAX_CHANNELS],
                         uint8_t num_presets);
 
+/* Incremental, double-buffered precompute. Presets are staged one at a time into
+   the inactive table while appliers keep using the active one; commit swaps them
+   atomically once every preset has been staged. atc_precompute_sets is
+   begin + stage all + commit. */
+int atc_stage_begin(uint8_t num_presets);
+int atc_stage_preset(uint8_t preset_index, const aperture_channel_config_t *cfg); /* atc_num_channels() entries */
+uint8_t atc_stage_remaining(void);     /* presets not yet staged */
+int atc_stage_commit(void);            /* -2 while presets are missing */
+void atc_stage_abort(void);
+
 /* Apply a given preset index synchronously (blocking I2C writes) */
 int atc_apply_preset_blocking(uint8_t preset_index);
 
-/* Queue a preset to be applied asynchronously (non-blocking) - driver dependent */
+/* Queue a preset to be applied asynchronously (non-blocking, ISR-driven I2C).
+   Falls back to the blocking path if the async engine is not initialized. */
 int atc_apply_preset_async(uint8_t preset_index);
 
+/* Delta apply: only expanders whose payload differs from the shadow are written
+   (async engine if initialized, polled otherwise). Returns the number of bus
+   transactions issued, <0 on error; *saved_xfers (optional) gets how many the
+   full program would have needed on top of that. -4 from an ISR when only the
+   polled path is available. */
+int atc_apply_preset_delta(uint8_t preset_index, uint8_t *saved_xfers);
+
+/* Forget the shadow (e.g. after an expander reset): next apply writes everything */
+void atc_invalidate_shadow(void);
+
+/* Running total of transactions skipped by the delta logic */
+uint32_t atc_saved_transactions_total(void);
+
+/* Register a callback fired when an async apply finishes (NULL to clear) */
+void atc_set_apply_callback(atc_apply_done_cb_t cb);
+
+/* Latency stats for a preset (NULL if index out of range) */
+const atc_latency_stat_t* atc_get_latency_stat(uint8_t preset_index);
+void atc_reset_latency_stats(void);
+
 /* Utility: build a single channel encode */
 uint16_t atc_encode_channel_config(const aperture_channel_config_t *cfg);
 
@@ -83,7 +229,19 @@ void atc_decode_channel_config(uint16_t encoded, aperture_channel_config_t *out)
 /* Optional: get pointer to precomputed payload for a given preset and expander */
 const ioexp_payload_t* atc_get_payload_ptr(uint8_t preset_index, uint8_t expander_index);
 
+/* Full precompiled program for a preset (replayable by any executor) */
+int atc_get_program(uint8_t preset_index, const atc_prog_op_t **ops, uint8_t *count);
+
+/* Emit the transactions needed to move the expanders to `preset_index`, given the
+   shadow of the last value written to each one: unchanged expanders and redundant
+   mux selects are dropped. Returns number of xfers written to `out`
+   (0 = nothing to do), <0 on error. Updates the shadow. */
+int atc_emit_program(uint8_t preset_index, platform_i2c_xfer_t *out, uint8_t max_xfers);
+
 /* Number of expanders used */
 uint8_t atc_num_io_expanders(void);
 
+/* Config entries per preset in the current topology (TX + RX) */
+uint8_t atc_num_channels(void);
+
 #endif /* APERTURE_TUNING_H */
@@ -0,0 +1,159 @@
+/* dlog.c */
+#include "dlog.h"
+#include "xiltimer.h"
+#include "xil_printf.h"
+
+/* Ring lives in BTCM next to the retune tables (see lscript.ld): single-cycle
+   stores for the producers and reachable by the A53 without a cache in the way.
+   NOLOAD, so dlog_init() builds it from scratch. */
+#ifndef DLOG_SECTION
+#define DLOG_SECTION __attribute__((section(".dlog"), aligned(64)))
+#endif
+
+#define DLOG_MASK (DLOG_SLOTS - 1)
+#define RPU0_TCM_GLOBAL_BASE 0xFFE00000U   /* RPU0 ATCM/BTCM in the APU map */
+
+static dlog_ring_t ring DLOG_SECTION;
+static int dlog_ready = 0;
+static uint32_t dropped_reported = 0;
+
+#define DLOG_FMT(id, fmt) fmt,
+static const char *const dlog_fmt[DLOG_NUM_MESSAGES] = { DLOG_MESSAGES(DLOG_FMT) };
+#undef DLOG_FMT
+
+_Static_assert(sizeof(dlog_rec_t) == 32, "dlog_rec_t is part of the A53 layout");
+_Static_assert((DLOG_SLOTS & DLOG_MASK) == 0, "DLOG_SLOTS must be a power of two");
+
+void dlog_init(void)
+{
+    for (uint32_t i = 0; i < DLOG_SLOTS; ++i) {
+        ring.recs[i].seq = i;
+    }
+    ring.slots = DLOG_SLOTS;
+    ring.rec_bytes = sizeof(dlog_rec_t);
+    ring.ticks_per_us = COUNTS_PER_SECOND / 1000000u;
+    ring.consumer = DLOG_CONSUMER_RPU;
+    ring.head = 0;
+    ring.tail = 0;
+    ring.written = 0;
+    ring.dropped = 0;
+    ring.version = DLOG_VERSION;
+    __atomic_store_n(&ring.magic, DLOG_MAGIC, __ATOMIC_RELEASE);
+    dropped_reported = 0;
+    dlog_ready = 1;
+}
+
+/* Same claim/publish scheme as the event rings: CAS on head, then publish
+   through the record's sequence number. An ISR that preempts another post
+   just retries the CAS. */
+int dlog_post(uint16_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    if (!dlog_ready || id >= DLOG_NUM_MESSAGES) return -1;
+
+    uint32_t pos = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+    dlog_rec_t *rec;
+    for (;;) {
+        rec = &ring.recs[pos & DLOG_MASK];
+        int32_t diff = (int32_t)(__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring.head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&ring.dropped, 1, __ATOMIC_RELAXED);
+            return -2;
+        } else {
+            pos = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+        }
+    }
+
+    XTime t;
+    XTime_GetTime(&t);
+    rec->stamp = (uint32_t)t;
+    rec->id = id;
+    rec->nargs = (nargs > DLOG_MAX_ARGS) ? DLOG_MAX_ARGS : nargs;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&ring.written, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int dlog_pending(void)
+{
+    if (!dlog_ready || ring.consumer != DLOG_CONSUMER_RPU) return 0;
+    const dlog_rec_t *rec = &ring.recs[ring.tail & DLOG_MASK];
+    return __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == ring.tail + 1 ||
+           ring.dropped != dropped_reported;
+}
+
+uint32_t dlog_drain(uint32_t max)
+{
+    uint32_t n = 0;
+    if (!dlog_ready || ring.consumer != DLOG_CONSUMER_RPU) return 0;
+
+    uint32_t dropped = ring.dropped;
+    if (dropped != dropped_reported && max) {
+        xil_printf(dlog_fmt[DLOG_DROPPED], (int)(dropped - dropped_reported));
+        xil_printf("\r\n");
+        dropped_reported = dropped;
+        n++;
+    }
+
+    while (n < max) {
+        uint32_t pos = ring.tail;
+        dlog_rec_t *rec = &ring.recs[pos & DLOG_MASK];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != pos + 1) break;
+
+        /* copy out and free the slot before the slow UART part */
+        uint16_t id = rec->id;
+        uint32_t a[DLOG_MAX_ARGS];
+        for (uint8_t i = 0; i < DLOG_MAX_ARGS; ++i) {
+            a[i] = (i < rec->nargs) ? rec->args[i] : 0;
+        }
+        __atomic_store_n(&rec->seq, pos + DLOG_SLOTS, __ATOMIC_RELEASE);
+        ring.tail = pos + 1;
+
+        const char *fmt = dlog_format(id);
+        if (fmt) {
+            xil_printf(fmt, a[0], a[1], a[2], a[3]);
+            xil_printf("\r\n");
+        } else {
+            xil_printf("dlog: unknown id %d\r\n", (int)id);
+        }
+        n++;
+    }
+    return n;
+}
+
+/* Main context only (same context as dlog_drain). The APU picks up at `tail`
+   and hands it back the same way. */
+void dlog_set_consumer(uint32_t consumer)
+{
+    __atomic_store_n(&ring.consumer,
+                     (consumer == DLOG_CONSUMER_APU) ? DLOG_CONSUMER_APU : DLOG_CONSUMER_RPU,
+                     __ATOMIC_RELEASE);
+}
+
+uint32_t dlog_get_consumer(void)
+{
+    return ring.consumer;
+}
+
+const dlog_ring_t *dlog_ring(void)
+{
+    return &ring;
+}
+
+uint32_t dlog_ring_global_addr(void)
+{
+    return RPU0_TCM_GLOBAL_BASE + (uint32_t)(uintptr_t)&ring;
+}
+
+const char *dlog_format(uint16_t id)
+{
+    return (id < DLOG_NUM_MESSAGES) ? dlog_fmt[id] : NULL;
+}
@@ -0,0 +1,98 @@
+/* dlog.h - deferred binary logging */
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+
+/* Log calls store a format ID, a timestamp and up to four integer arguments in
+   a lock-free ring in BTCM; formatting and UART output happen later, from the
+   main loop's idle hook, or not at all on the R5 when the A53 drains the ring
+   itself. Formats may only use integer conversions (%d %u %x %c): arguments are
+   captured as 32-bit words, so %s would print a stale pointer.
+
+   The ring layout is shared with the A53 side (read through the RPU0 TCM global
+   alias, see dlog_ring_global_addr): keep it in sync, bump DLOG_VERSION on change. */
+
+#define DLOG_MAGIC          0x474F4C44U  /* "DLOG" */
+#define DLOG_VERSION        1
+#define DLOG_SLOTS          256          /* power of two */
+#define DLOG_MAX_ARGS       4
+
+#define DLOG_CONSUMER_RPU   0            /* R5 idle hook prints to the UART */
+#define DLOG_CONSUMER_APU   1            /* A53 reads records, R5 never drains */
+
+/* Format IDs are positions in this list: append only. A53_app/src/dlog.h carries
+   a copy of it and of the ring layout for the A53 reader (rpu_ctrl_log_*), keep
+   both in sync. Strings carry no line ending. */
+#define DLOG_MESSAGES(X) \
+    X(DLOG_DROPPED,             "dlog: %d records dropped") \
+    X(DLOG_PRESET_CHANGE,       "Aperture Tuning Change (%d)") \
+    X(DLOG_PRESET_QUEUE_FAILED, "Aperture Tuning Change (%d) failed to queue") \
+    X(DLOG_INITIAL_TUNING,      "Setting Initial Tuning = %d") \
+    X(DLOG_SEQ_START,           "Sample test sequence: echoes %d, scans %d, t_end %d") \
+    X(DLOG_SEQ_REJECTED,        "Sample test sequence rejected") \
+    X(DLOG_SEQ_DONE,            "Sample test sequence complete (%d scans, jitter %d ticks)") \
+    X(DLOG_UPLOAD_COMMITTED,    "Preset upload %d committed") \
+    X(DLOG_TOPOLOGY_REJECTED,   "set_topology rejected: %d") \
+    X(DLOG_VERIFY_UNREPAIRED,   "atc verify: expanders still wrong after retries")
+
+#define DLOG_ENUM(id, fmt) id,
+enum { DLOG_MESSAGES(DLOG_ENUM) DLOG_NUM_MESSAGES };
+#undef DLOG_ENUM
+
+typedef struct {
+    volatile uint32_t seq;       /* == position + 1 once written, + SLOTS once free */
+    uint32_t stamp;              /* XTime ticks, low 32 bits */
+    uint16_t id;
+    uint8_t nargs;
+    uint8_t rsvd;
+    uint32_t args[DLOG_MAX_ARGS];
+    uint32_t pad;
+} dlog_rec_t;                    /* 32 bytes */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t rec_bytes;
+    uint32_t ticks_per_us;
+    volatile uint32_t consumer;  /* DLOG_CONSUMER_*, written by the R5 only */
+    volatile uint32_t head;      /* producers: next position to claim */
+    volatile uint32_t tail;      /* consumer: next position to read */
+    volatile uint32_t written;
+    volatile uint32_t dropped;   /* ring full, record discarded */
+    uint32_t pad[6];
+    dlog_rec_t recs[DLOG_SLOTS];
+} dlog_ring_t;
+
+/* Call once, before any source that logs is enabled */
+void dlog_init(void);
+
+/* ISR-safe, lock-free. Returns 0, -1 not initialised / bad id, -2 ring full. */
+int dlog_post(uint16_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+#define DLOG0(id)               dlog_post((id), 0, 0, 0, 0, 0)
+#define DLOG1(id, a)            dlog_post((id), 1, (uint32_t)(a), 0, 0, 0)
+#define DLOG2(id, a, b)         dlog_post((id), 2, (uint32_t)(a), (uint32_t)(b), 0, 0)
+#define DLOG3(id, a, b, c)      dlog_post((id), 3, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), 0)
+#define DLOG4(id, a, b, c, d)   dlog_post((id), 4, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d))
+
+/* Main context: print up to `max` records to the UART. Returns records printed
+   (0 while the A53 is the consumer). */
+uint32_t dlog_drain(uint32_t max);
+
+/* 1 if the R5 is the consumer and records are waiting */
+int dlog_pending(void);
+
+void dlog_set_consumer(uint32_t consumer);
+uint32_t dlog_get_consumer(void);
+
+const dlog_ring_t *dlog_ring(void);
+
+/* Ring address as seen from the A53 (RPU0 TCM global alias) */
+uint32_t dlog_ring_global_addr(void);
+
+/* Format string of an ID, NULL if unknown */
+const char *dlog_format(uint16_t id);
+
+#endif
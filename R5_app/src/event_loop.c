@@ -0,0 +1,265 @@
+/* event_loop.c */
+#include "event_loop.h"
+#include "xiltimer.h"
+#include <string.h>
+
+/* Each class ring is a bounded MPSC queue: producers claim a slot with a CAS
+   on `tail` (LDREX/STREX on the R5, so an ISR interrupting another post just
+   retries) and publish it through the slot's sequence number; the main loop is
+   the only consumer. */
+#define QUEUE_MASK (EVENT_QUEUE_DEPTH - 1)
+#define TICKS_PER_US (COUNTS_PER_SECOND / 1000000u)
+
+typedef struct {
+    volatile uint32_t seq;      /* == position + 1 once filled, + DEPTH once free */
+    event_fn_t fn;
+    uint32_t arg;
+    uint32_t stamp;             /* post time (due time for timers) */
+} event_slot_t;
+
+typedef struct {
+    event_slot_t slots[EVENT_QUEUE_DEPTH];
+    volatile uint32_t tail;     /* next position to claim (producers) */
+    uint32_t head;              /* next position to run (consumer) */
+} event_ring_t;
+
+typedef struct {
+    event_fn_t fn;              /* NULL = free */
+    uint32_t arg;
+    uint32_t due;
+    uint8_t cls;
+} event_timer_t;
+
+static event_ring_t rings[EVENT_NUM_CLASSES];
+static event_timer_t timers[EVENT_MAX_TIMERS];
+static event_class_stats_t class_stats[EVENT_NUM_CLASSES];
+static int rings_ready = 0;
+
+static const uint32_t deadline_ticks[EVENT_NUM_CLASSES] = {
+    EVENT_DEADLINE_PRESET_US * TICKS_PER_US,
+    EVENT_DEADLINE_IPI_US * TICKS_PER_US,
+};
+
+_Static_assert((EVENT_QUEUE_DEPTH & QUEUE_MASK) == 0, "EVENT_QUEUE_DEPTH must be a power of two");
+
+static inline uint32_t now_ticks(void)
+{
+    XTime t;
+    XTime_GetTime(&t);
+    return (uint32_t)t;   /* TTC counter is 32 bit; deltas wrap cleanly */
+}
+
+void event_loop_init(void)
+{
+    for (uint8_t c = 0; c < EVENT_NUM_CLASSES; ++c) {
+        for (uint32_t i = 0; i < EVENT_QUEUE_DEPTH; ++i) {
+            rings[c].slots[i].seq = i;
+        }
+        rings[c].tail = 0;
+        rings[c].head = 0;
+    }
+    memset(timers, 0, sizeof(timers));
+    event_loop_reset_stats();
+    rings_ready = 1;
+}
+
+static int post_stamped(uint8_t cls, event_fn_t fn, uint32_t arg, uint32_t stamp)
+{
+    if (cls >= EVENT_NUM_CLASSES || fn == NULL || !rings_ready) return -1;
+    event_ring_t *r = &rings[cls];
+
+    uint32_t pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    event_slot_t *slot;
+    for (;;) {
+        slot = &r->slots[pos & QUEUE_MASK];
+        int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            /* pos was reloaded by the failed CAS */
+        } else if (diff < 0) {
+            __atomic_fetch_add(&class_stats[cls].dropped, 1, __ATOMIC_RELAXED);
+            return -2;
+        } else {
+            pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+        }
+    }
+    slot->fn = fn;
+    slot->arg = arg;
+    slot->stamp = stamp;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&class_stats[cls].posted, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int event_loop_post(uint8_t cls, event_fn_t fn, uint32_t arg)
+{
+    return post_stamped(cls, fn, arg, now_ticks());
+}
+
+int event_loop_post_after(uint8_t cls, event_fn_t fn, uint32_t arg, uint32_t delay_us)
+{
+    if (cls >= EVENT_NUM_CLASSES || fn == NULL) return -1;
+    for (uint8_t i = 0; i < EVENT_MAX_TIMERS; ++i) {
+        if (timers[i].fn == NULL) {
+            timers[i].arg = arg;
+            timers[i].due = now_ticks() + delay_us * TICKS_PER_US;
+            timers[i].cls = cls;
+            timers[i].fn = fn;
+            return 0;
+        }
+    }
+    return -2;
+}
+
+/* head slot of a class ring, NULL if empty */
+static inline event_slot_t *ring_head(uint8_t cls)
+{
+    event_ring_t *r = &rings[cls];
+    event_slot_t *slot = &r->slots[r->head & QUEUE_MASK];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != r->head + 1) return NULL;
+    return slot;
+}
+
+/* Class to run next: the most overdue head if any is past its deadline,
+   otherwise the highest non-empty class. -1 if every ring is empty. */
+static int pick_class(uint32_t now)
+{
+    int first = -1, late = -1;
+    uint32_t worst = 0;
+    for (uint8_t c = 0; c < EVENT_NUM_CLASSES; ++c) {
+        event_slot_t *slot = ring_head(c);
+        if (!slot) continue;
+        if (first < 0) first = c;
+        uint32_t age = now - slot->stamp;
+        if ((int32_t)age > 0 && age > deadline_ticks[c] && age - deadline_ticks[c] > worst) {
+            worst = age - deadline_ticks[c];
+            late = c;
+        }
+    }
+    return (late >= 0) ? late : first;
+}
+
+int event_loop_should_yield(uint8_t cls)
+{
+    if (!rings_ready) return 0;
+    int c = pick_class(now_ticks());
+    return c >= 0 && (uint8_t)c < cls;
+}
+
+/* move due timers into their rings, stamped with the due time */
+static void timers_fire(uint32_t now)
+{
+    for (uint8_t i = 0; i < EVENT_MAX_TIMERS; ++i) {
+        event_timer_t *t = &timers[i];
+        if (t->fn == NULL || (int32_t)(now - t->due) < 0) continue;
+        if (post_stamped(t->cls, t->fn, t->arg, t->due) == 0) {
+            t->fn = NULL;
+        }
+    }
+}
+
+static int timers_armed(void)
+{
+    for (uint8_t i = 0; i < EVENT_MAX_TIMERS; ++i) {
+        if (timers[i].fn != NULL) return 1;
+    }
+    return 0;
+}
+
+static int dispatch_one(void)
+{
+    uint32_t now = now_ticks();
+    timers_fire(now);
+
+    int c = pick_class(now);
+    if (c < 0) return 0;
+
+    event_ring_t *r = &rings[c];
+    event_slot_t *slot = &r->slots[r->head & QUEUE_MASK];
+    event_fn_t fn = slot->fn;
+    uint32_t arg = slot->arg;
+    uint32_t stamp = slot->stamp;
+    __atomic_store_n(&slot->seq, r->head + EVENT_QUEUE_DEPTH, __ATOMIC_RELEASE);
+    r->head++;
+
+    event_class_stats_t *st = &class_stats[c];
+    for (uint8_t h = 0; h < (uint8_t)c; ++h) {
+        if (ring_head(h)) {
+            st->promoted++;
+            break;
+        }
+    }
+    uint32_t t0 = now_ticks();
+    uint32_t lat = ((int32_t)(t0 - stamp) > 0) ? t0 - stamp : 0;
+    st->last_latency_ticks = lat;
+    st->total_latency_ticks += lat;
+    if (lat > st->worst_latency_ticks) st->worst_latency_ticks = lat;
+    if (lat > deadline_ticks[c]) st->deadline_misses++;
+
+    fn(arg);
+
+    uint32_t run = now_ticks() - t0;
+    if (run > st->worst_run_ticks) st->worst_run_ticks = run;
+    st->dispatched++;
+    return 1;
+}
+
+uint32_t event_loop_run_pending(void)
+{
+    uint32_t n = 0;
+    if (!rings_ready) return 0;
+    while (dispatch_one()) n++;
+    return n;
+}
+
+void event_loop_run(int (*idle)(void))
+{
+    for (;;) {
+        event_loop_run_pending();
+
+        int poll = idle ? idle() : 0;
+        if (poll || timers_armed()) continue;
+
+        /* sleep with IRQs masked so a post between the check and the wfi still
+           wakes us (wfi returns on a pending IRQ even while it is masked) */
+#if defined(__arm__)
+        __asm__ volatile ("cpsid i" ::: "memory");
+        if (pick_class(now_ticks()) < 0) {
+            __asm__ volatile ("wfi" ::: "memory");
+        }
+        __asm__ volatile ("cpsie i" ::: "memory");
+#endif
+    }
+}
+
+int event_loop_get_stats(uint8_t cls, event_class_stats_t *out)
+{
+    if (cls >= EVENT_NUM_CLASSES) return -1;
+    *out = class_stats[cls];
+    return 0;
+}
+
+void event_loop_reset_stats(void)
+{
+    /* posted/dropped are bumped from ISRs: clear field by field, not with memset,
+       so a concurrent increment is at worst lost rather than torn */
+    for (uint8_t c = 0; c < EVENT_NUM_CLASSES; ++c) {
+        __atomic_store_n(&class_stats[c].posted, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&class_stats[c].dropped, 0, __ATOMIC_RELAXED);
+        class_stats[c].dispatched = 0;
+        class_stats[c].deadline_misses = 0;
+        class_stats[c].promoted = 0;
+        class_stats[c].worst_latency_ticks = 0;
+        class_stats[c].last_latency_ticks = 0;
+        class_stats[c].worst_run_ticks = 0;
+        class_stats[c].total_latency_ticks = 0;
+    }
+}
+
+uint32_t event_loop_ticks_per_us(void)
+{
+    return TICKS_PER_US;
+}
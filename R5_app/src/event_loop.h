@@ -0,0 +1,69 @@
+/* event_loop.h */
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+
+/* Run-to-completion executor for the R5 main loop. ISRs and handlers post
+   events into one lock-free ring per priority class; the loop dispatches the
+   highest class first, except that an event already past its class deadline
+   goes ahead of everything that is not. Handlers must not block: waits are
+   split with event_loop_post_after(), long jobs check event_loop_should_yield()
+   and repost themselves. */
+
+#define EVENT_CLASS_PRESET      0   /* preset switches, TUI trigger */
+#define EVENT_CLASS_IPI         1   /* APU mailbox / ring commands */
+#define EVENT_NUM_CLASSES       2
+/* reports and housekeeping (I2C polling, verify, log drain) run from the idle
+   hook passed to event_loop_run, below every class */
+
+#ifndef EVENT_QUEUE_DEPTH
+#define EVENT_QUEUE_DEPTH       16  /* per class, must be a power of two */
+#endif
+#define EVENT_MAX_TIMERS        4
+
+/* post -> dispatch deadline per class, microseconds */
+#define EVENT_DEADLINE_PRESET_US    200
+#define EVENT_DEADLINE_IPI_US       2000
+
+typedef void (*event_fn_t)(uint32_t arg);
+
+/* per class; times in XTime ticks (see event_loop_ticks_per_us) */
+typedef struct {
+    uint32_t posted;
+    uint32_t dispatched;
+    uint32_t dropped;               /* ring full */
+    uint32_t deadline_misses;       /* dispatched after the class deadline */
+    uint32_t promoted;              /* overdue, run ahead of a higher class */
+    uint32_t worst_latency_ticks;   /* post -> handler entry */
+    uint32_t last_latency_ticks;
+    uint32_t worst_run_ticks;       /* handler execution */
+    uint64_t total_latency_ticks;
+} event_class_stats_t;
+
+/* Call once before any interrupt source that posts is enabled */
+void event_loop_init(void);
+
+/* ISR-safe, lock-free (multiple producers). Returns 0, -1 bad class / not initialised,
+   -2 ring full. */
+int event_loop_post(uint8_t cls, event_fn_t fn, uint32_t arg);
+
+/* Main context only: post once `delay_us` has passed. Returns 0, -2 no free timer. */
+int event_loop_post_after(uint8_t cls, event_fn_t fn, uint32_t arg, uint32_t delay_us);
+
+/* For a handler of class `cls`: 1 if a higher class, or an overdue event of any
+   class, is waiting */
+int event_loop_should_yield(uint8_t cls);
+
+/* Dispatch until the rings are empty and no timer is due; returns events run */
+uint32_t event_loop_run_pending(void);
+
+/* Never returns. `idle` runs whenever the rings are empty; it returns nonzero
+   while it needs polling (the core then does not wait for an interrupt). */
+void event_loop_run(int (*idle)(void));
+
+int event_loop_get_stats(uint8_t cls, event_class_stats_t *out);
+void event_loop_reset_stats(void);
+uint32_t event_loop_ticks_per_us(void);
+
+#endif
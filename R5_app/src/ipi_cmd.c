@@ -0,0 +1,123 @@
+/* ipi_cmd.c */
+#include "ipi_cmd.h"
+#include "xiltimer.h"
+#include <string.h>
+
+static const ipi_cmd_desc_t *registry[IPI_CMD_MAX_ID];
+static ipi_cmd_stats_t cmd_stats[IPI_CMD_MAX_ID];
+static uint32_t unknown_count;
+
+static uint32_t now_ticks(void)
+{
+    XTime t;
+    XTime_GetTime(&t);
+    return (uint32_t)t;
+}
+
+int ipi_cmd_register(uint32_t cmd, const ipi_cmd_desc_t *desc)
+{
+    if (cmd >= IPI_CMD_MAX_ID || desc == NULL || desc->fn == NULL ||
+        desc->nargs > IPI_CMD_MAX_ARGS) {
+        return -1;
+    }
+    if (registry[cmd] != NULL) {
+        return -2;
+    }
+    registry[cmd] = desc;
+    return 0;
+}
+
+/* Length/stride check, then decode whichever leading args fit in the payload */
+static int decode(const ipi_cmd_desc_t *d, ipi_cmd_ctx_t *ctx)
+{
+    if (ctx->len < d->min_len || ctx->len > d->max_len) {
+        return -1;
+    }
+    if (d->stride > 1 && (ctx->len % d->stride) != 0) {
+        return -1;
+    }
+
+    uint32_t off = 0;
+    for (uint32_t a = 0; a < d->nargs; a++) {
+        uint32_t sz = d->args[a];
+        if (off + sz > ctx->len) {
+            break;
+        }
+        uint32_t v = 0;
+        for (uint32_t b = 0; b < sz; b++) {
+            v |= (uint32_t)ctx->payload[off + b] << (8 * b);
+        }
+        ctx->arg[a] = v;
+        ctx->argc = a + 1;
+        off += sz;
+    }
+    return 0;
+}
+
+int ipi_cmd_dispatch(uint32_t cmd, const uint8_t *payload, uint32_t len,
+                     uint8_t *resp, uint32_t resp_max, uint32_t *resp_len)
+{
+    *resp_len = 0;
+
+    const ipi_cmd_desc_t *d = (cmd < IPI_CMD_MAX_ID) ? registry[cmd] : NULL;
+    if (d == NULL) {
+        unknown_count++;
+        return IPI_CMD_ERR_UNKNOWN;
+    }
+
+    ipi_cmd_stats_t *st = &cmd_stats[cmd];
+    ipi_cmd_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.payload  = payload;
+    ctx.len      = len;
+    ctx.resp     = resp;
+    ctx.resp_max = resp_max;
+
+    if (decode(d, &ctx) != 0) {
+        st->rejected++;
+        return IPI_CMD_ERR_LENGTH;
+    }
+
+    uint32_t t0 = now_ticks();
+    int rc = d->fn(&ctx);
+    uint32_t dt = now_ticks() - t0;
+
+    st->count++;
+    st->bytes += len;
+    st->last_ticks = dt;
+    st->total_ticks += dt;
+    if (dt > st->max_ticks) {
+        st->max_ticks = dt;
+    }
+    if (rc != 0) {
+        st->errors++;
+    }
+
+    *resp_len = (ctx.resp_len <= resp_max) ? ctx.resp_len : resp_max;
+    return rc;
+}
+
+int ipi_cmd_get_stats(uint32_t cmd, ipi_cmd_stats_t *out)
+{
+    if (cmd >= IPI_CMD_MAX_ID || registry[cmd] == NULL) {
+        return -1;
+    }
+    *out = cmd_stats[cmd];
+    return 0;
+}
+
+void ipi_cmd_reset_stats(void)
+{
+    memset(cmd_stats, 0, sizeof(cmd_stats));
+    unknown_count = 0;
+}
+
+uint32_t ipi_cmd_unknown_count(void)
+{
+    return unknown_count;
+}
+
+uint32_t ipi_cmd_ticks_per_us(void)
+{
+    return (uint32_t)(COUNTS_PER_SECOND / 1000000u);
+}
@@ -0,0 +1,68 @@
+/* ipi_cmd.h - IPI command registry: id -> handler, payload schema, per-command stats */
+#ifndef IPI_CMD_H
+#define IPI_CMD_H
+
+#include <stdint.h>
+#include "xstatus.h"
+
+/* Command ids index the registry directly: lookup is a bounds check + load */
+#ifndef IPI_CMD_MAX_ID
+#define IPI_CMD_MAX_ID      32
+#endif
+#define IPI_CMD_MAX_ARGS    4
+
+/* Leading fixed-size fields, all little endian */
+#define IPI_ARG_U8          1
+#define IPI_ARG_U16         2
+#define IPI_ARG_U32         4
+
+/* Dispatcher results that never reach a handler */
+#define IPI_CMD_ERR_LENGTH  XST_INVALID_PARAM  /* payload failed schema validation */
+#define IPI_CMD_ERR_UNKNOWN XST_NO_FEATURE     /* no handler registered */
+
+typedef struct {
+    const uint8_t *payload;          /* whole payload, in place (read-only) */
+    uint32_t       len;
+    uint32_t       argc;             /* leading args actually present */
+    uint32_t       arg[IPI_CMD_MAX_ARGS]; /* decoded args; absent ones are 0 */
+    uint8_t       *resp;             /* response buffer, resp_max bytes */
+    uint32_t       resp_max;
+    uint32_t       resp_len;         /* set by the handler */
+} ipi_cmd_ctx_t;
+
+typedef int (*ipi_cmd_fn_t)(ipi_cmd_ctx_t *ctx);
+
+typedef struct {
+    const char  *name;
+    ipi_cmd_fn_t fn;
+    uint32_t     min_len;            /* payload bytes, inclusive */
+    uint32_t     max_len;
+    uint32_t     stride;             /* payload must be a multiple of this (0/1 = any) */
+    uint8_t      nargs;              /* leading args decoded into ctx->arg[] */
+    uint8_t      args[IPI_CMD_MAX_ARGS]; /* IPI_ARG_* sizes */
+} ipi_cmd_desc_t;
+
+typedef struct {
+    uint32_t count;                  /* handler invocations */
+    uint32_t errors;                 /* handler returned non-zero */
+    uint32_t rejected;               /* failed schema validation */
+    uint32_t bytes;                  /* payload bytes accepted */
+    uint32_t last_ticks;             /* handling time, XTime ticks */
+    uint32_t max_ticks;
+    uint32_t total_ticks;
+} ipi_cmd_stats_t;
+
+/* desc must stay valid (static const); returns 0, -1 bad id/desc, -2 id taken */
+int ipi_cmd_register(uint32_t cmd, const ipi_cmd_desc_t *desc);
+
+/* Validate, decode and run one command. Returns the handler result or IPI_CMD_ERR_*. */
+int ipi_cmd_dispatch(uint32_t cmd, const uint8_t *payload, uint32_t len,
+                     uint8_t *resp, uint32_t resp_max, uint32_t *resp_len);
+
+/* Returns 0, -1 if cmd is not registered */
+int ipi_cmd_get_stats(uint32_t cmd, ipi_cmd_stats_t *out);
+void ipi_cmd_reset_stats(void);
+uint32_t ipi_cmd_unknown_count(void);
+uint32_t ipi_cmd_ticks_per_us(void);
+
+#endif
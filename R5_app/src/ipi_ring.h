@@ -0,0 +1,94 @@
+/* ipi_ring.h - lock-free SPSC command rings in APU<->RPU shared memory */
+#ifndef IPI_RING_H
+#define IPI_RING_H
+
+#include <stdint.h>
+
+/* Layout is shared with the A53 side: keep it in sync, bump IPI_RING_VERSION on change.
+   The rings live below the legacy single-message mailbox at 0x7FFFF000. */
+#define IPI_RING_BASE_ADDR    0x7FFF0000U
+#define IPI_RING_MAGIC        0x49505252U  /* "IPRR" */
+#define IPI_RING_VERSION      1
+#define IPI_RING_CACHE_LINE   64           /* A53 line size (R5 is 32) */
+#define IPI_RING_SLOTS        64           /* per direction, power of two */
+#define IPI_RING_SLOT_BYTES   256
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t len;      /* valid payload bytes */
+    uint32_t seq;      /* request sequence number, echoed in the response */
+    uint32_t status;   /* responses: handler result */
+} ipi_slot_hdr_t;
+
+#define IPI_RING_SLOT_PAYLOAD (IPI_RING_SLOT_BYTES - sizeof(ipi_slot_hdr_t))
+
+typedef struct {
+    ipi_slot_hdr_t hdr;
+    uint8_t payload[IPI_RING_SLOT_PAYLOAD];
+} __attribute__((aligned(IPI_RING_CACHE_LINE))) ipi_slot_t;
+
+/* Each index lives in its own cache line and has exactly one writer */
+typedef struct {
+    volatile uint32_t head;     /* producer: next slot to fill */
+    uint8_t pad0[IPI_RING_CACHE_LINE - 4];
+    volatile uint32_t tail;     /* consumer: next slot to read */
+    uint8_t pad1[IPI_RING_CACHE_LINE - 4];
+    volatile uint32_t armed;    /* consumer: 1 = idle, ring the doorbell */
+    uint8_t pad2[IPI_RING_CACHE_LINE - 4];
+    ipi_slot_t slots[IPI_RING_SLOTS];
+} ipi_ring_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_bytes;
+    uint8_t pad[IPI_RING_CACHE_LINE - 16];
+    ipi_ring_t to_rpu;          /* A53 -> R5 requests  */
+    ipi_ring_t to_apu;          /* R5 -> A53 responses */
+} ipi_ring_region_t;
+
+/* producer handle: reservations are private until ipi_ring_publish() */
+typedef struct {
+    ipi_ring_t *ring;
+    uint32_t head;              /* local head incl. unpublished slots */
+} ipi_ring_tx_t;
+
+/* consumer handle */
+typedef struct {
+    ipi_ring_t *ring;
+    uint32_t tail;
+} ipi_ring_rx_t;
+
+/* Zero both rings and stamp the header (owner side, once at boot) */
+void ipi_ring_region_init(ipi_ring_region_t *region);
+
+/* 1 if the region header matches this build */
+int ipi_ring_region_valid(ipi_ring_region_t *region);
+
+void ipi_ring_tx_attach(ipi_ring_tx_t *tx, ipi_ring_t *ring);
+void ipi_ring_rx_attach(ipi_ring_rx_t *rx, ipi_ring_t *ring);
+
+/* Producer: reserve and fill one slot (not visible until publish). -1 if full. */
+int ipi_ring_push(ipi_ring_tx_t *tx, uint32_t cmd, uint32_t seq, uint32_t status,
+                  const void *payload, uint32_t len);
+
+/* Producer: make all reserved slots visible. Returns 1 if the consumer asked
+   for a doorbell (caller triggers the IPI), 0 if it is still draining. */
+int ipi_ring_publish(ipi_ring_tx_t *tx);
+
+/* Consumer: next request or NULL. Only the header and `*len` payload bytes are
+   invalidated; `*len` is hdr.len clamped to the slot, use it instead of hdr.len.
+   The slot stays owned by the caller until ipi_ring_release(). */
+ipi_slot_t *ipi_ring_peek(ipi_ring_rx_t *rx, uint32_t *len);
+
+/* Consumer: hand the oldest peeked slot back to the producer */
+void ipi_ring_release(ipi_ring_rx_t *rx);
+
+/* Consumer: woken up, suppress further doorbells while draining */
+void ipi_ring_disarm(ipi_ring_rx_t *rx);
+
+/* Consumer: declare idle. Returns 1 if work raced in (keep draining). */
+int ipi_ring_arm(ipi_ring_rx_t *rx);
+
+#endif
@@ -1,11 +1,172 @@
 /* platform_i2c.c */
 #include "platform_i2c.h"
 #include "xiic.h"   /* or xiicps.h for PS I2C */
+#include "xiic_l.h"
+#include "xiic_i.h"   /* XIic_ClearEnableIntr */
+#include "xiicps.h"
+#include "xil_exception.h"
+#include "xpseudo_asm.h"
 #include "xparameters.h"
+#include "xiltimer.h"
+#include "xpm_counter.h"
 #include <string.h>
 
 static XIic AxiIicInst;
 static int g_inited = 0;
+static u32 seen_recoveries = 0;   /* XIic_GetBusRecoveryCount() at last resync */
+
+/* async engine state */
+#define ASYNC_IDLE      0
+#define ASYNC_XFER      1   /* MasterSend in flight */
+#define ASYNC_WAIT_BUS  2   /* waiting on BNB before (re)starting */
+
+#define ASYNC_QUEUE_MASK (PLATFORM_I2C_QUEUE_DEPTH - 1)
+
+typedef struct {
+    platform_i2c_xfer_t xfer;
+    platform_i2c_done_cb_t cb;  /* only set on the last transaction of a batch */
+    void *cb_ref;
+} i2c_async_slot_t;
+
+static i2c_async_slot_t async_queue[PLATFORM_I2C_QUEUE_DEPTH];
+static volatile uint16_t async_head = 0;   /* next slot to run  */
+static volatile uint16_t async_tail = 0;   /* next free slot    */
+static volatile uint8_t async_state = ASYNC_IDLE;
+static uint8_t async_batch_failed = 0;
+static int async_use_intr = 0;
+static int async_inited = 0;
+static uint32_t async_t0 = 0;       /* trace stamp of the head transaction */
+/* a polled burst owns the AXI IIC: submits queue but do not start until it ends.
+   Nesting depth, so a fan-out can wrap the batch it runs. */
+static volatile uint8_t polled_owner = 0;
+
+
+/* ---------------- transaction tracer ---------------- */
+
+#define TRACE_MASK           (PLATFORM_I2C_TRACE_DEPTH - 1)
+#define TRACE_CYCLES_PER_US  ((XPAR_CPU_CORE_CLOCK_FREQ_HZ + 500000u) / 1000000u)
+
+#define PMCR_E               0x1u
+#define PMCR_D               0x8u          /* count every 64th cycle */
+#define PMCNTEN_CYCLE        0x80000000u
+
+static platform_i2c_trace_rec_t trace_ring[PLATFORM_I2C_TRACE_DEPTH];
+static uint32_t trace_seq = 0;       /* next record number */
+static platform_i2c_dev_stats_t trace_devs[PLATFORM_I2C_TRACE_DEVS];
+static uint8_t trace_ndevs = 0;
+
+/* cpu_init.S starts the cycle counter with the /64 divider; run it at the core
+   clock instead (nothing else here uses it, XTime runs off a TTC). 32 bits wrap
+   after ~8.6 s, far beyond any single transaction. */
+static void trace_counter_init(void)
+{
+    u32 pmcr = mfcp(XREG_CP15_PERF_MONITOR_CTRL);
+    mtcp(XREG_CP15_PERF_MONITOR_CTRL, (pmcr | PMCR_E) & ~PMCR_D);
+    mtcp(XREG_CP15_COUNT_ENABLE_SET, PMCNTEN_CYCLE);
+}
+
+static inline uint32_t trace_now(void)
+{
+    return Xpm_ReadCycleCounterVal();
+}
+
+/* histogram slot for addr; the last slot collects everything past the table */
+static platform_i2c_dev_stats_t *trace_dev(uint8_t addr)
+{
+    for (uint8_t i = 0; i < trace_ndevs; ++i) {
+        if (trace_devs[i].addr == addr) return &trace_devs[i];
+    }
+    platform_i2c_dev_stats_t *d;
+    if (trace_ndevs < PLATFORM_I2C_TRACE_DEVS - 1) {
+        d = &trace_devs[trace_ndevs++];
+        d->addr = addr;
+    } else {
+        d = &trace_devs[PLATFORM_I2C_TRACE_DEVS - 1];
+        d->addr = PLATFORM_I2C_TRACE_OTHER;
+        trace_ndevs = PLATFORM_I2C_TRACE_DEVS;
+    }
+    return d;
+}
+
+/* log one finished transaction (main or ISR context) */
+static void trace_log(uint8_t op, uint8_t addr, uint8_t reg, uint8_t len,
+                      uint8_t result, uint8_t retries, uint32_t start, uint32_t end)
+{
+    uint32_t cycles = end - start;
+    uint32_t us = cycles / TRACE_CYCLES_PER_US;
+    uint32_t bin = us ? 31u - (uint32_t)__builtin_clz(us) : 0;
+    if (bin >= PLATFORM_I2C_HIST_BINS) bin = PLATFORM_I2C_HIST_BINS - 1;
+
+    u32 cpsr = platform_i2c_irq_save();
+    platform_i2c_trace_rec_t *r = &trace_ring[trace_seq & TRACE_MASK];
+    r->start = start;
+    r->cycles = cycles;
+    r->seq = (uint16_t)trace_seq;
+    r->addr = addr;
+    r->reg = reg;
+    r->len = len;
+    r->op = op;
+    r->result = result;
+    r->retries = retries;
+    trace_seq++;
+
+    platform_i2c_dev_stats_t *d = trace_dev(addr);
+    d->count++;
+    if (result != PLATFORM_I2C_SEG_OK) d->errors++;
+    d->retries += retries;
+    if (cycles > d->max_cycles) d->max_cycles = cycles;
+    d->total_us += us;
+    d->hist[bin]++;
+    platform_i2c_irq_restore(cpsr);
+}
+
+uint32_t platform_i2c_trace_read(uint32_t *seq, platform_i2c_trace_rec_t *out, uint32_t max)
+{
+    u32 cpsr = platform_i2c_irq_save();
+    uint32_t head = trace_seq;
+    uint32_t oldest = (head > PLATFORM_I2C_TRACE_DEPTH) ? head - PLATFORM_I2C_TRACE_DEPTH : 0;
+    uint32_t s = *seq;
+    if (s < oldest || s > head) s = oldest;   /* overwritten, or reset since */
+    uint32_t n = head - s;
+    if (n > max) n = max;
+    for (uint32_t i = 0; i < n; ++i) {
+        out[i] = trace_ring[(s + i) & TRACE_MASK];
+    }
+    platform_i2c_irq_restore(cpsr);
+    *seq = s;
+    return n;
+}
+
+uint32_t platform_i2c_trace_total(void)
+{
+    return trace_seq;
+}
+
+int platform_i2c_trace_dev(uint8_t idx, platform_i2c_dev_stats_t *out)
+{
+    u32 cpsr = platform_i2c_irq_save();
+    int rc = -1;
+    if (idx < trace_ndevs) {
+        *out = trace_devs[idx];
+        rc = 0;
+    }
+    platform_i2c_irq_restore(cpsr);
+    return rc;
+}
+
+void platform_i2c_trace_reset(void)
+{
+    u32 cpsr = platform_i2c_irq_save();
+    trace_seq = 0;
+    trace_ndevs = 0;
+    memset(trace_devs, 0, sizeof(trace_devs));
+    platform_i2c_irq_restore(cpsr);
+}
+
+uint32_t platform_i2c_trace_cycles_per_us(void)
+{
+    return TRACE_CYCLES_PER_US;
+}
 
 
 #define AXI_IIC_DEVICE_ID           XPAR_AXI_IIC_0_DEVICE_ID
@@ -34,6 +195,12 @@ int platform_i2c_init(uint32_t axi_iic_device_id)
     XIic_Start(&AxiIicInst);
     XIic_IntrGlobalDisable(AxiIicInst.BaseAddress);
 
+    /* spin on BB instead of usleep(100) polling; reset the core if the bus is stuck */
+    XIic_SetBusFreeWait(XIIC_BUS_WAIT_SPIN, PLATFORM_I2C_BUS_FREE_TIMEOUT_US);
+    XIic_SetBusRecovery(NULL, 1);
+    seen_recoveries = XIic_GetBusRecoveryCount();
+    trace_counter_init();
+
     xil_printf("AXI IIC init OK @ 0x%08x\r\n",
                (unsigned)AxiIicInst.BaseAddress);
 
@@ -42,6 +209,23 @@ int platform_i2c_init(uint32_t axi_iic_device_id)
     return XST_SUCCESS;
 }
 
+/* back to the state platform_i2c_init leaves the core in */
+static void i2c_restart_core(void)
+{
+    XIic_Reset(&AxiIicInst);
+    XIic_Start(&AxiIicInst);
+    XIic_IntrGlobalDisable(AxiIicInst.BaseAddress);
+}
+
+/* XIic_BusRecover soft-resets the core: restore the interrupt driver's setup */
+static void i2c_resync(void)
+{
+    u32 n = XIic_GetBusRecoveryCount();
+    if (n == seen_recoveries) return;
+    seen_recoveries = n;
+    i2c_restart_core();
+}
+
 void platform_i2c_deinit(void)
 {
     if (!g_inited) return;
@@ -53,37 +237,76 @@ void platform_i2c_deinit(void)
 
 
 
-#define MUX_ADDR 0x70
+static void i2c_async_resume(void);
 
-/* example mapping from logical bus id -> mux selection or nothing */
-int platform_i2c_write_mux(uint8_t value) {
-    if (!g_inited) return -1;
+/* Take the AXI IIC for a polled burst; fails if the async engine holds it */
+static int polled_begin(void)
+{
+    u32 cpsr = platform_i2c_irq_save();
+    if (polled_owner == 0 && platform_i2c_async_busy()) {
+        platform_i2c_irq_restore(cpsr);
+        return -1;
+    }
+    polled_owner++;
+    platform_i2c_irq_restore(cpsr);
+    return 0;
+}
+
+/* Hand the core back and start anything an ISR queued meanwhile */
+static void polled_end(void)
+{
+    u32 cpsr = platform_i2c_irq_save();
+    if (--polled_owner == 0) {
+        i2c_async_resume();
+    }
+    platform_i2c_irq_restore(cpsr);
+}
+
+/* Single-shot bodies: the caller holds the core through polled_begin() */
+static int write_mux_polled(uint8_t value)
+{
+    i2c_resync();
 
     int Sent;
     u8 buf = 1 << value;
+    uint32_t t0 = trace_now();
 
     Sent = XIic_Send(AxiIicInst.BaseAddress,
-                     MUX_ADDR,
+                     PLATFORM_I2C_MUX_ADDR,
                      &buf,
                      1,
                      XIIC_STOP);
+    trace_log(PLATFORM_I2C_OP_MUX_WRITE, PLATFORM_I2C_MUX_ADDR, buf, 0,
+              (Sent == 1) ? PLATFORM_I2C_SEG_OK : PLATFORM_I2C_SEG_NACK, 0, t0, trace_now());
 
     return (Sent == 1) ? XST_SUCCESS : XST_FAILURE;
 }
 
 /* example mapping from logical bus id -> mux selection or nothing */
-int platform_i2c_read_mux(uint8_t *out) {
+int platform_i2c_write_mux(uint8_t value) {
     if (!g_inited) return -1;
+    if (polled_begin() != 0) return XST_DEVICE_BUSY;
+    int rc = write_mux_polled(value);
+    polled_end();
+    return rc;
+}
+
+static int read_mux_polled(uint8_t *out)
+{
+    i2c_resync();
 
     int Recv;
     u8 buf;
+    uint32_t t0 = trace_now();
 
     // Read 1 byte, with STOP at the end
     Recv = XIic_Recv(AxiIicInst.BaseAddress,
-                     MUX_ADDR,
+                     PLATFORM_I2C_MUX_ADDR,
                      &buf,
                      1,
                      XIIC_STOP);
+    trace_log(PLATFORM_I2C_OP_MUX_READ, PLATFORM_I2C_MUX_ADDR, 0, 1,
+              (Recv == 1) ? PLATFORM_I2C_SEG_OK : PLATFORM_I2C_SEG_NACK, 0, t0, trace_now());
     // xil_printf("Recv: Recv=%d\r\n", Recv);
     if (Recv != 1) return XST_FAILURE;
 
@@ -91,11 +314,20 @@ int platform_i2c_read_mux(uint8_t *out) {
     return XST_SUCCESS;
 }
 
+/* example mapping from logical bus id -> mux selection or nothing */
+int platform_i2c_read_mux(uint8_t *out) {
+    if (!g_inited) return -1;
+    if (polled_begin() != 0) return XST_DEVICE_BUSY;
+    int rc = read_mux_polled(out);
+    polled_end();
+    return rc;
+}
+
 
 /* blocking write: compose [reg, data...] and send via XIic_Send */
-int platform_i2c_write(uint8_t dev_addr, uint8_t reg, const uint8_t *data, uint8_t len)
+static int write_polled(uint8_t dev_addr, uint8_t reg, const uint8_t *data, uint8_t len)
 {
-    if (!g_inited) return -1;
+    i2c_resync();
 
     /* set mux for bus (prefer GPIO toggling here) */
     /* platform_set_mux_gpio(bus); */
@@ -107,21 +339,40 @@ int platform_i2c_write(uint8_t dev_addr, uint8_t reg, const uint8_t *data, uint8
 
     int retries = 0;
     const int max_retries = 2;
+    uint8_t result = PLATFORM_I2C_SEG_OK;
+    uint32_t t0 = trace_now();
     while (retries <= max_retries) {
-        int rc = XIic_Send(AxiIicInst.BaseAddress, dev_addr, txbuf, 1 + len, XIIC_STOP);
-        /* XIic_Send return semantics vary; check for success */
-        if (rc >= 0) return 0;
+        /* XIic_Send returns the number of bytes sent: 0 on bus timeout, short on NACK */
+        unsigned sent = XIic_Send(AxiIicInst.BaseAddress, dev_addr, txbuf, 1 + len, XIIC_STOP);
+        if (sent == (unsigned)(1 + len)) {
+            trace_log(PLATFORM_I2C_OP_WRITE, dev_addr, reg, len, PLATFORM_I2C_SEG_OK,
+                      (uint8_t)retries, t0, trace_now());
+            return 0;
+        }
+        result = sent ? PLATFORM_I2C_SEG_NACK : PLATFORM_I2C_SEG_TIMEOUT;
         retries++;
     }
+    trace_log(PLATFORM_I2C_OP_WRITE, dev_addr, reg, len, result,
+              (uint8_t)max_retries, t0, trace_now());
     return -3;
 }
 
-int platform_i2c_read(uint8_t addr7, uint8_t reg, uint16_t *out)
+int platform_i2c_write(uint8_t dev_addr, uint8_t reg, const uint8_t *data, uint8_t len)
 {
     if (!g_inited) return -1;
+    if (polled_begin() != 0) return XST_DEVICE_BUSY; /* async engine owns the bus */
+    int rc = write_polled(dev_addr, reg, data, len);
+    polled_end();
+    return rc;
+}
+
+static int read_polled(uint8_t addr7, uint8_t reg, uint16_t *out)
+{
+    i2c_resync();
 
     int Sent, Recv;
     u8 buf[2];
+    uint32_t t0 = trace_now();
 
     // Set pointer register, with repeated start (no STOP)
     Sent = XIic_Send(AxiIicInst.BaseAddress,
@@ -130,7 +381,10 @@ int platform_i2c_read(uint8_t addr7, uint8_t reg, uint16_t *out)
                      1,
                      XIIC_REPEATED_START);
     // xil_printf("Send: Sent=%d\r\n", Sent);
-    if (Sent != 1) return XST_FAILURE;
+    if (Sent != 1) {
+        trace_log(PLATFORM_I2C_OP_READ, addr7, reg, 2, PLATFORM_I2C_SEG_NACK, 0, t0, trace_now());
+        return XST_FAILURE;
+    }
 
     // Read 2 bytes, with STOP at the end
     Recv = XIic_Recv(AxiIicInst.BaseAddress,
@@ -139,8 +393,774 @@ int platform_i2c_read(uint8_t addr7, uint8_t reg, uint16_t *out)
                      2,
                      XIIC_STOP);
     // xil_printf("Recv: Recv=%d\r\n", Recv);
+    trace_log(PLATFORM_I2C_OP_READ, addr7, reg, 2,
+              (Recv == 2) ? PLATFORM_I2C_SEG_OK : PLATFORM_I2C_SEG_NACK, 0, t0, trace_now());
     if (Recv != 2) return XST_FAILURE;
 
     *out = ((u16)buf[0] << 8) | buf[1];
     return XST_SUCCESS;
-}
\ No newline at end of file
+}
+
+int platform_i2c_read(uint8_t addr7, uint8_t reg, uint16_t *out)
+{
+    if (!g_inited) return -1;
+    if (polled_begin() != 0) return XST_DEVICE_BUSY;
+    int rc = read_polled(addr7, reg, out);
+    polled_end();
+    return rc;
+}
+
+
+/* ---------------- batched writes in dynamic mode ----------------
+   Every segment is flattened into TX FIFO words (START|addr, reg, data..., STOP
+   on the last byte where needed); the FIFO is refilled whenever it has room
+   instead of draining per byte as XIic_DynSend does. On TX error / arbitration
+   loss the FIFO occupancy tells how far the wire got, which identifies the
+   failing segment; the FIFO is flushed and the burst restarts after it. */
+
+#define BATCH_TIMEOUT_US  PLATFORM_I2C_BUS_FREE_TIMEOUT_US
+#define BATCH_TICKS_PER_US (COUNTS_PER_SECOND / 1000000u)
+
+static uint32_t batch_now(void)
+{
+    XTime t;
+    XTime_GetTime(&t);
+    return (uint32_t)t;
+}
+
+/* TX FIFO word `j` of segment `sg` (j == 0 is the address) */
+static u32 batch_word(const platform_i2c_seg_t *sg, uint8_t j, int stop)
+{
+    u32 w;
+    if (j == 0) {
+        w = XIIC_TX_DYN_START_MASK | ((u32)sg->addr << 1) | XIIC_WRITE_OPERATION;
+    } else if (j == 1) {
+        w = sg->reg;
+    } else {
+        w = sg->data[j - 2];
+    }
+    if (stop && j == (uint8_t)(sg->len + 1)) {
+        w |= XIIC_TX_DYN_STOP_MASK;
+    }
+    return w;
+}
+
+/* called on every pass of the burst loop (fan-out services the PS side here) */
+static void (*batch_idle_hook)(void) = NULL;
+
+static u32 batch_fifo_level(UINTPTR base)
+{
+    if (XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_TX_FIFO_EMPTY_MASK) return 0;
+    return XIic_ReadReg(base, XIIC_TFO_REG_OFFSET) + 1;
+}
+
+/* drop whatever is queued and release the bus */
+static void batch_abort(UINTPTR base)
+{
+    XIic_WriteReg(base, XIIC_CR_REG_OFFSET,
+                  XIIC_CR_ENABLE_DEVICE_MASK | XIIC_CR_TX_FIFO_RESET_MASK);
+    XIic_WriteReg(base, XIIC_CR_REG_OFFSET, XIIC_CR_ENABLE_DEVICE_MASK);
+    (void)XIic_WaitBusFree(base);
+    XIic_ClearIisr(base, XIIC_INTR_TX_ERROR_MASK | XIIC_INTR_ARB_LOST_MASK);
+}
+
+/* trace segments [from, to) of a burst; each gets the time since the previous
+   one retired (they normally retire one per pass of the burst loop) */
+static void batch_trace(const platform_i2c_seg_t *segs, uint8_t from, uint8_t to,
+                        uint8_t result, uint32_t *c_prev)
+{
+    uint32_t now = trace_now();
+    for (uint8_t i = from; i < to; ++i) {
+        trace_log(PLATFORM_I2C_OP_BATCH, segs[i].addr, segs[i].reg, segs[i].len,
+                  result, 0, *c_prev, now);
+        *c_prev = now;
+    }
+}
+
+int platform_i2c_write_batch(const platform_i2c_seg_t *segs, uint8_t count,
+                             uint8_t *seg_status)
+{
+    if (!g_inited) return -1;
+    if (count == 0 || count > PLATFORM_I2C_BATCH_MAX_SEGS) return -2;
+    if (polled_begin() != 0) return -4;
+    i2c_resync();
+
+    UINTPTR base = AxiIicInst.BaseAddress;
+    uint8_t status[PLATFORM_I2C_BATCH_MAX_SEGS];
+    uint16_t seg_start[PLATFORM_I2C_BATCH_MAX_SEGS + 1];   /* word index of each segment */
+    seg_start[0] = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        status[i] = PLATFORM_I2C_SEG_OK;
+        seg_start[i + 1] = (uint16_t)(seg_start[i] + 2 + segs[i].len);
+    }
+
+    int failed = 0;
+    uint8_t traced = 0;             /* segments already logged */
+    uint32_t c_prev = trace_now();
+    if (XIic_WaitBusFree(base) != XST_SUCCESS || XIic_DynInit(base) != XST_SUCCESS) {
+        for (uint8_t i = 0; i < count; ++i) status[i] = PLATFORM_I2C_SEG_TIMEOUT;
+        failed = count;
+        batch_trace(segs, 0, count, PLATFORM_I2C_SEG_TIMEOUT, &c_prev);
+        goto out;
+    }
+    XIic_ClearIisr(base, XIIC_INTR_TX_ERROR_MASK | XIIC_INTR_ARB_LOST_MASK);
+
+    uint8_t seg = 0;        /* next segment to push */
+    uint8_t j = 0;          /* next word within it */
+    uint16_t pushed = 0;    /* words pushed since the last (re)start */
+    uint8_t first = 0;      /* segment at word 0 of the current run */
+    u32 last_level = 0;
+    uint32_t t0 = batch_now();  /* last time the wire made progress */
+    const uint32_t limit = BATCH_TIMEOUT_US * BATCH_TICKS_PER_US;
+
+    for (;;) {
+        if (batch_idle_hook) batch_idle_hook();
+
+        u32 isr = XIic_ReadIisr(base);
+        if (isr & (XIIC_INTR_TX_ERROR_MASK | XIIC_INTR_ARB_LOST_MASK)) {
+            /* last word to leave the FIFO is the one that failed */
+            u32 sent = (u32)pushed - batch_fifo_level(base);
+            u32 word = (u32)seg_start[first] + (sent ? sent - 1 : 0);
+            uint8_t bad = first;
+            while (bad + 1 < count && seg_start[bad + 1] <= word) bad++;
+            status[bad] = (isr & XIIC_INTR_ARB_LOST_MASK) ? PLATFORM_I2C_SEG_ARB_LOST
+                                                          : PLATFORM_I2C_SEG_NACK;
+            failed++;
+            if (bad >= traced) {
+                batch_trace(segs, traced, bad, PLATFORM_I2C_SEG_OK, &c_prev);
+                batch_trace(segs, bad, (uint8_t)(bad + 1), status[bad], &c_prev);
+                traced = (uint8_t)(bad + 1);
+            }
+            batch_abort(base);
+            seg = first = (uint8_t)(bad + 1);
+            j = 0;
+            pushed = 0;
+            t0 = batch_now();
+            if (seg >= count) break;
+            continue;
+        }
+
+        /* a segment has retired once its last word left the FIFO; the final
+           one is logged at bus-free below */
+        u32 level = batch_fifo_level(base);
+        u32 gone = (u32)seg_start[first] + pushed - level;
+        while (traced + 1 < count && seg_start[traced + 1] <= gone) {
+            batch_trace(segs, traced, (uint8_t)(traced + 1), PLATFORM_I2C_SEG_OK, &c_prev);
+            traced++;
+        }
+
+        if (seg >= count) {
+            /* everything queued: done once the final STOP has gone out */
+            if (level == 0 &&
+                !(XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_BUS_BUSY_MASK)) {
+                batch_trace(segs, traced, count, PLATFORM_I2C_SEG_OK, &c_prev);
+                break;
+            }
+            if (level != last_level) {
+                last_level = level;
+                t0 = batch_now();
+            }
+        } else {
+            while (seg < count &&
+                   !(XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_TX_FIFO_FULL_MASK)) {
+                const platform_i2c_seg_t *sg = &segs[seg];
+                int stop = (sg->flags & PLATFORM_I2C_SEG_STOP) || (seg + 1 == count);
+                XIic_WriteReg(base, XIIC_DTR_REG_OFFSET, batch_word(sg, j, stop));
+                pushed++;
+                t0 = batch_now();
+                if (++j == sg->len + 2) {
+                    j = 0;
+                    seg++;
+                }
+            }
+        }
+
+        if (batch_now() - t0 > limit) {
+            /* no progress for the whole timeout (stretching, hung bus): fail the rest */
+            u32 sent = (u32)pushed - batch_fifo_level(base);
+            u32 word = (u32)seg_start[first] + sent;
+            uint8_t bad = first;
+            while (bad + 1 < count && seg_start[bad + 1] <= word) bad++;
+            for (uint8_t i = bad; i < count; ++i) {
+                status[i] = PLATFORM_I2C_SEG_TIMEOUT;
+                failed++;
+            }
+            if (bad < traced) bad = traced;
+            batch_trace(segs, traced, bad, PLATFORM_I2C_SEG_OK, &c_prev);
+            batch_trace(segs, bad, count, PLATFORM_I2C_SEG_TIMEOUT, &c_prev);
+            batch_abort(base);
+            break;
+        }
+    }
+
+out:
+    /* XIic_DynInit reset the core: hand it back to the interrupt driver */
+    i2c_restart_core();
+    polled_end();
+    if (seg_status) memcpy(seg_status, status, count);
+    return failed;
+}
+
+
+/* ---------------- batched register reads ----------------
+   Same dynamic-mode setup as the write burst, but a read cannot be pipelined
+   blindly: its bytes have to be drained from the RX FIFO. Segments therefore
+   run one at a time, still back to back inside one call (no driver round trip
+   or bus-free wait between them). A read is START|addr+W, reg, START|addr+R,
+   STOP|count; the core NACKs the last byte itself. */
+
+/* push one TX FIFO word, waiting for room */
+static int batch_push(UINTPTR base, u32 word)
+{
+    uint32_t t0 = batch_now();
+    while (XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_TX_FIFO_FULL_MASK) {
+        if (batch_now() - t0 > BATCH_TIMEOUT_US * BATCH_TICKS_PER_US) return -1;
+    }
+    XIic_WriteReg(base, XIIC_DTR_REG_OFFSET, word);
+    return 0;
+}
+
+static uint8_t batch_error(u32 isr)
+{
+    return (isr & XIIC_INTR_ARB_LOST_MASK) ? PLATFORM_I2C_SEG_ARB_LOST : PLATFORM_I2C_SEG_NACK;
+}
+
+/* a write segment: queue it, then wait until it has left the FIFO (and the bus,
+   when it ends with STOP) */
+static uint8_t batch_run_write(UINTPTR base, const platform_i2c_seg_t *sg, int stop)
+{
+    for (uint8_t j = 0; j < sg->len + 2; ++j) {
+        if (batch_push(base, batch_word(sg, j, stop)) != 0) return PLATFORM_I2C_SEG_TIMEOUT;
+    }
+    uint32_t t0 = batch_now();
+    for (;;) {
+        u32 isr = XIic_ReadIisr(base);
+        if (isr & (XIIC_INTR_TX_ERROR_MASK | XIIC_INTR_ARB_LOST_MASK)) return batch_error(isr);
+        if (batch_fifo_level(base) == 0 &&
+            (!stop || !(XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_BUS_BUSY_MASK))) {
+            return PLATFORM_I2C_SEG_OK;
+        }
+        if (batch_now() - t0 > BATCH_TIMEOUT_US * BATCH_TICKS_PER_US) return PLATFORM_I2C_SEG_TIMEOUT;
+    }
+}
+
+static uint8_t batch_run_read(UINTPTR base, const platform_i2c_seg_t *sg)
+{
+    const u32 words[4] = {
+        XIIC_TX_DYN_START_MASK | ((u32)sg->addr << 1) | XIIC_WRITE_OPERATION,
+        sg->reg,
+        XIIC_TX_DYN_START_MASK | ((u32)sg->addr << 1) | XIIC_READ_OPERATION,
+        XIIC_TX_DYN_STOP_MASK | sg->len,
+    };
+    for (uint8_t j = 0; j < 4; ++j) {
+        if (batch_push(base, words[j]) != 0) return PLATFORM_I2C_SEG_TIMEOUT;
+    }
+
+    uint8_t got = 0;
+    uint32_t t0 = batch_now();
+    for (;;) {
+        /* drain first: the NACK the core gives the last byte must not read as an error */
+        if (!(XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_RX_FIFO_EMPTY_MASK)) {
+            sg->rx[got++] = (uint8_t)XIic_ReadReg(base, XIIC_DRR_REG_OFFSET);
+            t0 = batch_now();
+            if (got == sg->len) break;
+            continue;
+        }
+        u32 isr = XIic_ReadIisr(base);
+        if (isr & (XIIC_INTR_TX_ERROR_MASK | XIIC_INTR_ARB_LOST_MASK)) return batch_error(isr);
+        if (batch_now() - t0 > BATCH_TIMEOUT_US * BATCH_TICKS_PER_US) return PLATFORM_I2C_SEG_TIMEOUT;
+    }
+    /* STOP out before the next START */
+    t0 = batch_now();
+    while (XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_BUS_BUSY_MASK) {
+        if (batch_now() - t0 > BATCH_TIMEOUT_US * BATCH_TICKS_PER_US) return PLATFORM_I2C_SEG_TIMEOUT;
+    }
+    return PLATFORM_I2C_SEG_OK;
+}
+
+int platform_i2c_read_batch(const platform_i2c_seg_t *segs, uint8_t count,
+                            uint8_t *seg_status)
+{
+    if (!g_inited) return -1;
+    if (count == 0 || count > PLATFORM_I2C_BATCH_MAX_SEGS) return -2;
+    for (uint8_t i = 0; i < count; ++i) {
+        if ((segs[i].flags & PLATFORM_I2C_SEG_READ) && (segs[i].len == 0 || !segs[i].rx)) return -2;
+    }
+    if (polled_begin() != 0) return -4;
+    i2c_resync();
+
+    UINTPTR base = AxiIicInst.BaseAddress;
+    int failed = 0;
+    uint8_t i = 0;
+    if (XIic_WaitBusFree(base) != XST_SUCCESS || XIic_DynInit(base) != XST_SUCCESS) {
+        uint32_t c0 = trace_now();
+        for (; i < count; ++i) {
+            if (seg_status) seg_status[i] = PLATFORM_I2C_SEG_TIMEOUT;
+            trace_log((segs[i].flags & PLATFORM_I2C_SEG_READ) ? PLATFORM_I2C_OP_READ : PLATFORM_I2C_OP_BATCH,
+                      segs[i].addr, segs[i].reg, segs[i].len, PLATFORM_I2C_SEG_TIMEOUT, 0, c0, c0);
+        }
+        failed = count;
+    }
+    for (; i < count; ++i) {
+        const platform_i2c_seg_t *sg = &segs[i];
+        int read = (sg->flags & PLATFORM_I2C_SEG_READ) != 0;
+        uint32_t c0 = trace_now();
+
+        XIic_ClearIisr(base, XIIC_INTR_TX_ERROR_MASK | XIIC_INTR_ARB_LOST_MASK);
+        uint8_t st = read ? batch_run_read(base, sg)
+                          : batch_run_write(base, sg, (sg->flags & PLATFORM_I2C_SEG_STOP) || (i + 1 == count));
+        trace_log(read ? PLATFORM_I2C_OP_READ : PLATFORM_I2C_OP_BATCH,
+                  sg->addr, sg->reg, sg->len, st, 0, c0, trace_now());
+        if (st != PLATFORM_I2C_SEG_OK) {
+            failed++;
+            batch_abort(base);
+            /* bytes of an aborted read must not leak into the next one */
+            while (!(XIic_ReadReg(base, XIIC_SR_REG_OFFSET) & XIIC_SR_RX_FIFO_EMPTY_MASK)) {
+                (void)XIic_ReadReg(base, XIIC_DRR_REG_OFFSET);
+            }
+        }
+        if (seg_status) seg_status[i] = st;
+    }
+
+    i2c_restart_core();
+    polled_end();
+    return failed;
+}
+
+
+/* ---------------- async (interrupt-driven) transaction engine ----------------
+   Transactions are queued in a fixed ring and executed back to back with
+   XIic_MasterSend. Completion of each write is signalled by the driver's
+   BusNotBusy path (SendHandler), which starts the next queued transaction,
+   so the CPU never spins on the bus. */
+
+/* IRQ-safe critical section (submit may be called from main or ISR context) */
+uint32_t platform_i2c_irq_save(void)
+{
+    u32 cpsr = mfcpsr();
+    Xil_ExceptionDisableMask(XIL_EXCEPTION_IRQ);
+    return cpsr;
+}
+
+void platform_i2c_irq_restore(uint32_t cpsr)
+{
+    if ((cpsr & XIL_EXCEPTION_IRQ) == 0) {
+        Xil_ExceptionEnableMask(XIL_EXCEPTION_IRQ);
+    }
+}
+
+/* the standalone vectors run handlers in the exception mode, never in SYS */
+int platform_i2c_in_isr(void)
+{
+    u32 mode = mfcpsr() & XREG_CPSR_MODE_BITS;
+    return mode == XREG_CPSR_IRQ_MODE || mode == XREG_CPSR_FIQ_MODE;
+}
+
+static void i2c_async_kick(void);
+
+/* retire the head transaction and run the batch callback if it was the last one */
+static void i2c_async_complete(uint8_t result)
+{
+    i2c_async_slot_t *slot = &async_queue[async_head & ASYNC_QUEUE_MASK];
+    platform_i2c_done_cb_t cb = slot->cb;
+    void *cb_ref = slot->cb_ref;
+
+    trace_log(PLATFORM_I2C_OP_ASYNC, slot->xfer.addr, slot->xfer.buf[0],
+              (uint8_t)(slot->xfer.len - 1), result, 0, async_t0, trace_now());
+    if (result != PLATFORM_I2C_SEG_OK) async_batch_failed++;
+    async_head++;
+
+    if (cb) {
+        uint8_t failed = async_batch_failed;
+        async_batch_failed = 0;
+        cb(cb_ref, failed);
+    }
+    i2c_async_kick();
+}
+
+/* start the transaction at the head of the queue (called with IRQs masked or from ISR) */
+static void i2c_async_kick(void)
+{
+    if (async_state == ASYNC_IDLE) {
+        i2c_resync();   /* a blocking transfer may have recovered the bus */
+    }
+    int resume = (async_state == ASYNC_WAIT_BUS);   /* keep the original stamp */
+    while (async_head != async_tail) {
+        i2c_async_slot_t *slot = &async_queue[async_head & ASYNC_QUEUE_MASK];
+        if (!resume) async_t0 = trace_now();
+        resume = 0;
+
+        XIic_SetAddress(&AxiIicInst, XII_ADDR_TO_SEND_TYPE, slot->xfer.addr);
+        int rc = XIic_MasterSend(&AxiIicInst, slot->xfer.buf, slot->xfer.len);
+        if (rc == XST_SUCCESS) {
+            async_state = ASYNC_XFER;
+            return;
+        }
+        if (rc == XST_IIC_BUS_BUSY) {
+            /* previous STOP still on the wire: the driver reports BNB through the
+               multi-master handler as XII_BUS_NOT_BUSY_EVENT, resume from there */
+            async_state = ASYNC_WAIT_BUS;
+            XIic_ClearEnableIntr(AxiIicInst.BaseAddress, XIIC_INTR_BNB_MASK);
+            return;
+        }
+        /* could not start: drop it and move on */
+        trace_log(PLATFORM_I2C_OP_ASYNC, slot->xfer.addr, slot->xfer.buf[0],
+                  (uint8_t)(slot->xfer.len - 1), PLATFORM_I2C_SEG_TIMEOUT, 0,
+                  async_t0, trace_now());
+        i2c_async_slot_t done = *slot;
+        async_head++;
+        async_batch_failed++;
+        if (done.cb) {
+            uint8_t failed = async_batch_failed;
+            async_batch_failed = 0;
+            done.cb(done.cb_ref, failed);
+        }
+    }
+    async_state = ASYNC_IDLE;
+    XIic_IntrGlobalDisable(AxiIicInst.BaseAddress);
+}
+
+/* XIic send callback: message fully sent and bus released (BNB) */
+static void i2c_async_send_handler(void *ref, int byte_count)
+{
+    (void)ref;
+    if (async_state == ASYNC_XFER) {
+        i2c_async_complete(byte_count == 0 ? PLATFORM_I2C_SEG_OK : PLATFORM_I2C_SEG_NACK);
+    }
+}
+
+/* XIic status callback: bus released while waiting to start, or NACK /
+   arbitration lost aborting the current transaction */
+static void i2c_async_status_handler(void *ref, int event)
+{
+    (void)ref;
+    if (async_state == ASYNC_WAIT_BUS) {
+        if (event & XII_BUS_NOT_BUSY_EVENT) {
+            i2c_async_kick();
+        }
+        return;
+    }
+    if (async_state != ASYNC_XFER) return;
+    if (event & (XII_SLAVE_NO_ACK_EVENT | XII_ARB_LOST_EVENT)) {
+        /* release the bus; controller is left holding MSMS after a NACK */
+        XIic_Reset(&AxiIicInst);
+        XIic_Start(&AxiIicInst);
+        i2c_async_complete((event & XII_ARB_LOST_EVENT) ? PLATFORM_I2C_SEG_ARB_LOST
+                                                        : PLATFORM_I2C_SEG_NACK);
+    }
+}
+
+int platform_i2c_async_init(int use_interrupts)
+{
+    if (!g_inited) return -1;
+
+    /* without it the driver routes bus-not-busy (BNBOnly) and arbitration lost
+       to its asserting stub instead of the status handler */
+    XIic_MultiMasterInclude();
+    XIic_SetSendHandler(&AxiIicInst, NULL, i2c_async_send_handler);
+    XIic_SetStatusHandler(&AxiIicInst, NULL, i2c_async_status_handler);
+    async_head = async_tail = 0;
+    async_state = ASYNC_IDLE;
+    async_batch_failed = 0;
+    async_use_intr = use_interrupts;
+    async_inited = 1;
+    return XST_SUCCESS;
+}
+
+void platform_i2c_mux_xfer(uint8_t bus, platform_i2c_xfer_t *out)
+{
+    out->addr = PLATFORM_I2C_MUX_ADDR;
+    out->len = 1;
+    out->buf[0] = (uint8_t)(1u << bus);
+}
+
+int platform_i2c_submit(const platform_i2c_xfer_t *xfers, uint8_t count,
+                        platform_i2c_done_cb_t cb, void *ref)
+{
+    if (!async_inited) return -1;
+    if (!xfers || count == 0) return -2;
+
+    u32 cpsr = platform_i2c_irq_save();
+    uint16_t used = (uint16_t)(async_tail - async_head);
+    if (used + count > PLATFORM_I2C_QUEUE_DEPTH) {
+        platform_i2c_irq_restore(cpsr);
+        return -2;
+    }
+    for (uint8_t i = 0; i < count; ++i) {
+        i2c_async_slot_t *slot = &async_queue[(async_tail + i) & ASYNC_QUEUE_MASK];
+        slot->xfer = xfers[i];
+        if (slot->xfer.len > PLATFORM_I2C_XFER_MAX_BYTES) slot->xfer.len = PLATFORM_I2C_XFER_MAX_BYTES;
+        slot->cb = (i == count - 1) ? cb : NULL;
+        slot->cb_ref = ref;
+    }
+    async_tail += count;
+    if (async_state == ASYNC_IDLE && !polled_owner) {
+        i2c_async_kick();
+    }
+    platform_i2c_irq_restore(cpsr);
+    return 0;
+}
+
+/* start transactions queued while a polled burst held the core (IRQs masked) */
+static void i2c_async_resume(void)
+{
+    if (async_inited && async_state == ASYNC_IDLE && async_head != async_tail) {
+        i2c_async_kick();
+    }
+}
+
+int platform_i2c_async_ready(void)
+{
+    return async_inited;
+}
+
+int platform_i2c_async_busy(void)
+{
+    return async_state != ASYNC_IDLE || async_head != async_tail;
+}
+
+/* XIic_InterruptHandler, then re-arm BNB if a kick made from inside its BNB
+   dispatch found the bus taken again: the driver disables BNB (and clears
+   BNBOnly) after the callback returns, which would leave ASYNC_WAIT_BUS stuck */
+static void i2c_async_dispatch(void)
+{
+    XIic_InterruptHandler(&AxiIicInst);
+    if (async_state == ASYNC_WAIT_BUS &&
+        (XIic_ReadIier(AxiIicInst.BaseAddress) & XIIC_INTR_BNB_MASK) == 0) {
+        AxiIicInst.BNBOnly = TRUE;
+        XIic_ClearEnableIntr(AxiIicInst.BaseAddress, XIIC_INTR_BNB_MASK);
+    }
+}
+
+void platform_i2c_intr_handler(void *ref)
+{
+    (void)ref;
+    i2c_async_dispatch();
+}
+
+void platform_i2c_service(void)
+{
+    if (async_use_intr || async_state == ASYNC_IDLE) return;
+
+    /* XIic_InterruptHandler only acts on pending & enabled sources */
+    u32 cpsr = platform_i2c_irq_save();
+    i2c_async_dispatch();
+    platform_i2c_irq_restore(cpsr);
+}
+
+
+/* ---------------- multi-controller fan-out ---------------- */
+
+static XIicPs PsIicInst;
+static int ps_inited = 0;
+static platform_i2c_route_t bus_routes[PLATFORM_I2C_NUM_BUSES] = PLATFORM_I2C_DEFAULT_ROUTES;
+
+/* PS side of a fan-out: xfers sent one after another from ps_poll() */
+static struct {
+    const platform_i2c_xfer_t *xfers;
+    uint8_t *status;
+    uint8_t count;
+    uint8_t next;            /* xfer in flight (or next to start) */
+    uint8_t in_flight;
+    volatile uint32_t event; /* XIICPS_EVENT_* from the status handler */
+    uint32_t t0;
+    uint32_t c0;             /* trace stamp */
+} ps_job;
+
+static void ps_status_handler(void *ref, u32 event)
+{
+    (void)ref;
+    ps_job.event |= event;
+}
+
+int platform_i2c_ps_init(void)
+{
+    if (ps_inited) return 0;
+
+    XIicPs_Config *CfgPtr;
+    CfgPtr = XIicPs_LookupConfig(XPAR_XIICPS_0_BASEADDR);
+    if (CfgPtr == NULL) {
+        xil_printf("PS IIC: LookupConfig failed\r\n");
+        return XST_FAILURE;
+    }
+    int Status = XIicPs_CfgInitialize(&PsIicInst, CfgPtr, CfgPtr->BaseAddress);
+    if (Status != XST_SUCCESS) {
+        xil_printf("PS IIC: CfgInitialize failed: %d\r\n", Status);
+        return Status;
+    }
+    XIicPs_Reset(&PsIicInst);
+    XIicPs_SetSClk(&PsIicInst, PLATFORM_I2C_PS_SCLK_HZ);
+    XIicPs_SetStatusHandler(&PsIicInst, NULL, ps_status_handler);
+
+    ps_inited = 1;
+    return XST_SUCCESS;
+}
+
+int platform_i2c_set_route(uint8_t bus, uint8_t ctrl, uint8_t mux_chan)
+{
+    if (bus >= PLATFORM_I2C_NUM_BUSES || ctrl >= PLATFORM_I2C_NUM_CTRL) return -1;
+    if (ctrl == PLATFORM_I2C_CTRL_PS && !ps_inited) return -2;
+    bus_routes[bus].ctrl = ctrl;
+    bus_routes[bus].mux_chan = mux_chan;
+    return 0;
+}
+
+int platform_i2c_fanout_active(void)
+{
+    for (uint8_t b = 1; b < PLATFORM_I2C_NUM_BUSES; ++b) {
+        if (bus_routes[b].ctrl != bus_routes[0].ctrl) return 1;
+    }
+    return 0;
+}
+
+/* Advance the PS job: the IRQ line is not used, XIicPs_MasterInterruptHandler
+   only acts on pending, enabled sources so it is safe to poll */
+static void ps_trace(void)
+{
+    const platform_i2c_xfer_t *x = &ps_job.xfers[ps_job.next];
+    trace_log(PLATFORM_I2C_OP_PS, x->addr, x->buf[0], (uint8_t)(x->len - 1),
+              ps_job.status[ps_job.next], 0, ps_job.c0, trace_now());
+}
+
+static void ps_poll(void)
+{
+    if (ps_job.next >= ps_job.count) return;
+
+    if (ps_job.in_flight) {
+        XIicPs_MasterInterruptHandler(&PsIicInst);
+        uint32_t ev = ps_job.event;
+        if (ev == 0) {
+            if (batch_now() - ps_job.t0 > BATCH_TIMEOUT_US * BATCH_TICKS_PER_US) {
+                XIicPs_Abort(&PsIicInst);
+                ps_job.status[ps_job.next] = PLATFORM_I2C_SEG_TIMEOUT;
+                ps_trace();
+                ps_job.in_flight = 0;
+                ps_job.next++;
+            }
+            return;
+        }
+        if (ev & XIICPS_EVENT_COMPLETE_SEND) {
+            ps_job.status[ps_job.next] = PLATFORM_I2C_SEG_OK;
+        } else if (ev & XIICPS_EVENT_ARB_LOST) {
+            ps_job.status[ps_job.next] = PLATFORM_I2C_SEG_ARB_LOST;
+        } else if (ev & XIICPS_EVENT_NACK) {
+            ps_job.status[ps_job.next] = PLATFORM_I2C_SEG_NACK;
+        } else {
+            ps_job.status[ps_job.next] = PLATFORM_I2C_SEG_TIMEOUT;
+        }
+        ps_trace();
+        ps_job.in_flight = 0;
+        ps_job.next++;
+        if (ps_job.next >= ps_job.count) return;
+    }
+
+    if (XIicPs_BusIsBusy(&PsIicInst)) {
+        return;   /* previous STOP still on the wire */
+    }
+    const platform_i2c_xfer_t *x = &ps_job.xfers[ps_job.next];
+    ps_job.event = 0;
+    ps_job.in_flight = 1;
+    ps_job.t0 = batch_now();
+    ps_job.c0 = trace_now();
+    XIicPs_MasterSend(&PsIicInst, (u8 *)x->buf, x->len, x->addr);
+}
+
+int platform_i2c_fanout(const platform_i2c_xfer_t *xfers, const uint8_t *bus,
+                        uint8_t count, uint8_t *status)
+{
+    if (!g_inited) return -1;
+    if (count > PLATFORM_I2C_FANOUT_MAX) return -2;
+    /* held across both controllers: the AXI batch below nests inside it, and
+       nothing queued meanwhile starts until the PS side has joined too */
+    if (polled_begin() != 0) return -4;
+
+    /* split per controller, inserting a mux select at each bus change;
+       map[] holds the caller's index, or 0xFF for an inserted select */
+    platform_i2c_seg_t axi_segs[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t axi_map[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t axi_st[2 * PLATFORM_I2C_FANOUT_MAX];
+    platform_i2c_xfer_t ps_x[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t ps_map[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t ps_st[2 * PLATFORM_I2C_FANOUT_MAX];
+    uint8_t res[PLATFORM_I2C_FANOUT_MAX];
+    uint8_t n_axi = 0, n_ps = 0;
+    uint8_t cur_bus[PLATFORM_I2C_NUM_CTRL] = { 0xFF, 0xFF };
+
+    for (uint8_t i = 0; i < count; ++i) {
+        const platform_i2c_route_t *r = &bus_routes[bus[i] % PLATFORM_I2C_NUM_BUSES];
+        const platform_i2c_xfer_t *x = &xfers[i];
+        res[i] = PLATFORM_I2C_SEG_OK;
+
+        if (r->ctrl == PLATFORM_I2C_CTRL_PS) {
+            if (r->mux_chan != PLATFORM_I2C_NO_MUX && cur_bus[r->ctrl] != bus[i]) {
+                ps_x[n_ps].addr = PLATFORM_I2C_MUX_ADDR;
+                ps_x[n_ps].len = 1;
+                ps_x[n_ps].buf[0] = (uint8_t)(1u << r->mux_chan);
+                ps_map[n_ps++] = 0xFF;
+            }
+            ps_x[n_ps] = *x;
+            ps_map[n_ps++] = i;
+        } else {
+            if (r->mux_chan != PLATFORM_I2C_NO_MUX && cur_bus[r->ctrl] != bus[i]) {
+                axi_segs[n_axi].addr = PLATFORM_I2C_MUX_ADDR;
+                axi_segs[n_axi].reg = (uint8_t)(1u << r->mux_chan);
+                axi_segs[n_axi].len = 0;
+                axi_segs[n_axi].data = NULL;
+                axi_segs[n_axi].flags = PLATFORM_I2C_SEG_STOP;
+                axi_map[n_axi++] = 0xFF;
+            }
+            axi_segs[n_axi].addr = x->addr;
+            axi_segs[n_axi].reg = x->buf[0];
+            axi_segs[n_axi].len = (uint8_t)(x->len - 1);
+            axi_segs[n_axi].data = &x->buf[1];
+            axi_segs[n_axi].flags = 0;
+            axi_map[n_axi++] = i;
+        }
+        cur_bus[r->ctrl] = bus[i];
+    }
+
+    /* PS job first so it runs while the AXI burst is in progress */
+    ps_job.xfers = ps_x;
+    ps_job.status = ps_st;
+    ps_job.count = n_ps;
+    ps_job.next = 0;
+    ps_job.in_flight = 0;
+    if (n_ps && !ps_inited) {
+        memset(ps_st, PLATFORM_I2C_SEG_TIMEOUT, n_ps);
+        ps_job.count = 0;
+    }
+    ps_poll();
+
+    if (n_axi) {
+        batch_idle_hook = ps_poll;
+        if (platform_i2c_write_batch(axi_segs, n_axi, axi_st) < 0) {
+            memset(axi_st, PLATFORM_I2C_SEG_TIMEOUT, n_axi);
+        }
+        batch_idle_hook = NULL;
+    }
+
+    /* join */
+    while (ps_job.next < ps_job.count) {
+        ps_poll();
+    }
+
+    /* a failed mux select fails every write that followed it on that controller's bus */
+    uint8_t sel_failed = PLATFORM_I2C_SEG_OK;
+    for (uint8_t k = 0; k < n_axi; ++k) {
+        if (axi_map[k] == 0xFF) { sel_failed = axi_st[k]; continue; }
+        res[axi_map[k]] = sel_failed ? sel_failed : axi_st[k];
+    }
+    sel_failed = PLATFORM_I2C_SEG_OK;
+    for (uint8_t k = 0; k < n_ps; ++k) {
+        if (ps_map[k] == 0xFF) { sel_failed = ps_st[k]; continue; }
+        res[ps_map[k]] = sel_failed ? sel_failed : ps_st[k];
+    }
+
+    int failed = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        if (res[i] != PLATFORM_I2C_SEG_OK) failed++;
+    }
+    if (status) memcpy(status, res, count);
+    polled_end();
+    return failed;
+}
@@ -15,10 +15,18 @@ typedef struct {
 // int platform_i2c_init(uint32_t xiic_baseaddr, int use_interrupts);
 int platform_i2c_init(uint32_t axi_iic_device_id);
 
+/* longest a blocking transfer waits for bus-free before XIic_BusRecover */
+#ifndef PLATFORM_I2C_BUS_FREE_TIMEOUT_US
+#define PLATFORM_I2C_BUS_FREE_TIMEOUT_US 2000
+#endif
+
 
 /* deinit if needed */
 void platform_i2c_deinit(void);
 
+/* The four single-shot calls below take the AXI IIC like a polled burst and
+   return XST_DEVICE_BUSY while the async engine holds it. */
+
 /* simple blocking write (modules call this) */
 int platform_i2c_write(uint8_t dev_addr, uint8_t reg, const uint8_t *data, uint8_t len);
 
@@ -29,4 +37,199 @@ int platform_i2c_write_mux(uint8_t bus); /* select I2C MUX channel */
 
 int platform_i2c_read_mux(uint8_t *out);
 
+/* --- batched blocking writes (dynamic mode, repeated START between segments) --- */
+
+#define PLATFORM_I2C_BATCH_MAX_SEGS  32
+
+/* segment flags */
+#define PLATFORM_I2C_SEG_STOP        0x01  /* end with STOP (PCA954x selects only
+                                              take effect after a STOP) */
+#define PLATFORM_I2C_SEG_READ        0x02  /* platform_i2c_read_batch only: write reg,
+                                              repeated START, read len bytes to rx, STOP */
+
+/* per-segment result */
+#define PLATFORM_I2C_SEG_OK          0
+#define PLATFORM_I2C_SEG_NACK        1
+#define PLATFORM_I2C_SEG_ARB_LOST    2
+#define PLATFORM_I2C_SEG_TIMEOUT     3
+
+/* one write: START, addr+W, reg, data[0..len-1]. reg is simply the first byte
+   on the wire (the channel mask for a mux select, with len = 0) */
+typedef struct {
+    uint8_t addr;
+    uint8_t reg;
+    uint8_t len;
+    uint8_t flags;
+    const uint8_t *data;
+    uint8_t *rx;           /* PLATFORM_I2C_SEG_READ segments */
+} platform_i2c_seg_t;
+
+/* Run `count` segments as one burst, keeping the TX FIFO topped up. A NACKed
+   segment is aborted and the burst resumes with the next one. seg_status
+   (optional, count entries) gets PLATFORM_I2C_SEG_*. Returns the number of
+   failed segments, <0 if not initialised / async engine busy / bad args. */
+int platform_i2c_write_batch(const platform_i2c_seg_t *segs, uint8_t count,
+                             uint8_t *seg_status);
+
+/* Mixed burst of writes (mux selects, rewrites) and PLATFORM_I2C_SEG_READ
+   register reads, run back to back in dynamic mode. A failed segment is
+   aborted and the burst goes on with the next one. Same returns as
+   platform_i2c_write_batch. */
+int platform_i2c_read_batch(const platform_i2c_seg_t *segs, uint8_t count,
+                            uint8_t *seg_status);
+
+/* --- async (interrupt-driven) transaction engine --- */
+
+#define PLATFORM_I2C_MUX_ADDR        0x70
+#define PLATFORM_I2C_XFER_MAX_BYTES  4   /* reg + 3 payload bytes */
+#define PLATFORM_I2C_QUEUE_DEPTH     32  /* must be a power of two */
+
+/* single write transaction: buf[0] is normally the register address */
+typedef struct {
+    uint8_t addr;
+    uint8_t len;
+    uint8_t buf[PLATFORM_I2C_XFER_MAX_BYTES];
+} platform_i2c_xfer_t;
+
+/* batch completion callback, runs in ISR context (or from platform_i2c_service)
+   failed: number of transactions in the batch that were NACKed/aborted */
+typedef void (*platform_i2c_done_cb_t)(void *ref, uint8_t failed);
+
+/* Set up XIic callbacks for the async engine.
+   use_interrupts: 1 -> caller connects platform_i2c_intr_handler to the AXI IIC IRQ
+                   0 -> no IRQ line, main loop must call platform_i2c_service() */
+int platform_i2c_async_init(int use_interrupts);
+
+/* Queue `count` transactions as one batch; cb (may be NULL) fires after the last one.
+   Returns 0 on success, -1 not initialized, -2 queue full / bad args. Safe from ISR. */
+int platform_i2c_submit(const platform_i2c_xfer_t *xfers, uint8_t count,
+                        platform_i2c_done_cb_t cb, void *ref);
+
+/* Fill a mux-select transaction for logical bus `bus` */
+void platform_i2c_mux_xfer(uint8_t bus, platform_i2c_xfer_t *out);
+
+/* 1 once platform_i2c_async_init() has run */
+int platform_i2c_async_ready(void);
+
+/* 1 while queued/in-flight transactions exist */
+int platform_i2c_async_busy(void);
+
+/* AXI IIC interrupt entry point (connect to GIC/INTC) */
+void platform_i2c_intr_handler(void *ref);
+
+/* Polled fallback: services pending controller events without spinning */
+void platform_i2c_service(void);
+
+/* --- multi-controller fan-out ---
+   Logical buses (ioexp_map bus ids) are routed to a controller, optionally via
+   a PCA954x channel on that controller. Transfers for different controllers run
+   concurrently; platform_i2c_fanout joins on all of them. */
+
+#define PLATFORM_I2C_CTRL_AXI        0   /* axi_iic_0 */
+#define PLATFORM_I2C_CTRL_PS         1   /* PS I2C1 (iicps) */
+#define PLATFORM_I2C_NUM_CTRL        2
+#define PLATFORM_I2C_NUM_BUSES       4
+#define PLATFORM_I2C_NO_MUX          0xFF  /* route is wired straight to the controller */
+#define PLATFORM_I2C_FANOUT_MAX      (PLATFORM_I2C_BATCH_MAX_SEGS / 2)
+
+#ifndef PLATFORM_I2C_PS_SCLK_HZ
+#define PLATFORM_I2C_PS_SCLK_HZ      400000
+#endif
+
+typedef struct {
+    uint8_t ctrl;       /* PLATFORM_I2C_CTRL_* */
+    uint8_t mux_chan;   /* PCA954x channel on that controller, or PLATFORM_I2C_NO_MUX */
+} platform_i2c_route_t;
+
+/* current board: every logical bus is a mux channel behind the AXI IIC */
+#ifndef PLATFORM_I2C_DEFAULT_ROUTES
+#define PLATFORM_I2C_DEFAULT_ROUTES {              \
+    { PLATFORM_I2C_CTRL_AXI, 0 },                  \
+    { PLATFORM_I2C_CTRL_AXI, 1 },                  \
+    { PLATFORM_I2C_CTRL_AXI, 2 },                  \
+    { PLATFORM_I2C_CTRL_AXI, 3 } }
+#endif
+
+/* Bring up the PS I2C controller (optional; needed before routing buses to it) */
+int platform_i2c_ps_init(void);
+
+/* Returns 0, -1 bad bus/ctrl, -2 controller not initialised */
+int platform_i2c_set_route(uint8_t bus, uint8_t ctrl, uint8_t mux_chan);
+
+/* 1 when the routes span more than one controller */
+int platform_i2c_fanout_active(void);
+
+/* Blocking: run xfers[i] on logical bus bus[i] (mux selects are inserted here,
+   callers pass only device writes). Per-controller order is preserved.
+   status (optional) gets PLATFORM_I2C_SEG_* per xfer. Returns failed count,
+   <0 if not initialised / async engine busy / too many xfers. */
+int platform_i2c_fanout(const platform_i2c_xfer_t *xfers, const uint8_t *bus,
+                        uint8_t count, uint8_t *status);
+
+/* --- transaction tracer ---
+   Every transaction (blocking, burst segment, async, PS fan-out) is stamped with
+   the R5 PMU cycle counter and logged to a ring; per-device latency histograms
+   are kept alongside. Always compiled in: a record costs two counter reads and
+   a few stores with IRQs masked. */
+
+#define PLATFORM_I2C_TRACE_DEPTH     128  /* records, must be a power of two */
+#define PLATFORM_I2C_TRACE_DEVS      8    /* distinct addresses with a histogram */
+#define PLATFORM_I2C_HIST_BINS       16   /* bin k: [2^k, 2^(k+1)) us, last bin open */
+#define PLATFORM_I2C_TRACE_OTHER     0xFF /* histogram slot for addresses past the table */
+
+/* op */
+#define PLATFORM_I2C_OP_WRITE        0
+#define PLATFORM_I2C_OP_READ         1
+#define PLATFORM_I2C_OP_MUX_WRITE    2
+#define PLATFORM_I2C_OP_MUX_READ     3
+#define PLATFORM_I2C_OP_BATCH        4   /* one segment of a dynamic-mode burst */
+#define PLATFORM_I2C_OP_ASYNC        5
+#define PLATFORM_I2C_OP_PS           6   /* fan-out transfer on the PS controller */
+
+typedef struct {
+    uint32_t start;     /* PMU cycle count when the transaction started */
+    uint32_t cycles;    /* duration */
+    uint16_t seq;       /* low bits of the record number */
+    uint8_t addr;
+    uint8_t reg;        /* first byte on the wire */
+    uint8_t len;        /* bytes after reg */
+    uint8_t op;         /* PLATFORM_I2C_OP_* */
+    uint8_t result;     /* PLATFORM_I2C_SEG_* */
+    uint8_t retries;
+} platform_i2c_trace_rec_t;
+
+typedef struct {
+    uint8_t addr;       /* PLATFORM_I2C_TRACE_OTHER for the overflow slot */
+    uint8_t pad[3];
+    uint32_t count;
+    uint32_t errors;
+    uint32_t retries;
+    uint32_t max_cycles;
+    uint32_t total_us;
+    uint32_t hist[PLATFORM_I2C_HIST_BINS];
+} platform_i2c_dev_stats_t;
+
+/* Copy records starting at record number *seq (bumped to the oldest one still
+   held if it has been overwritten). Returns the number copied, *seq is the
+   number of the first one. */
+uint32_t platform_i2c_trace_read(uint32_t *seq, platform_i2c_trace_rec_t *out, uint32_t max);
+
+/* records logged since the last reset (next record number) */
+uint32_t platform_i2c_trace_total(void);
+
+/* Histogram slot `idx` in first-seen order. Returns 0, -1 if unused. */
+int platform_i2c_trace_dev(uint8_t idx, platform_i2c_dev_stats_t *out);
+
+void platform_i2c_trace_reset(void);
+
+/* PMU counts per microsecond (the counter runs at the core clock) */
+uint32_t platform_i2c_trace_cycles_per_us(void);
+
+/* Mask IRQs around code shared with the I2C/GPIO ISRs; nests via the saved CPSR */
+uint32_t platform_i2c_irq_save(void);
+void platform_i2c_irq_restore(uint32_t cpsr);
+
+/* 1 when called from an IRQ/FIQ handler: the polled paths must not be entered */
+int platform_i2c_in_isr(void);
+
 #endif
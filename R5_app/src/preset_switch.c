@@ -0,0 +1,181 @@
+/* preset_switch.c */
+#include "preset_switch.h"
+#include "aperture_tuning.h"
+#include "platform_i2c.h"
+#include "xiltimer.h"
+#include <string.h>
+
+/* Retunes complete in submission order (the I2C queue is FIFO), so in-flight
+   requests are tracked in a small ring and matched to completions in order. */
+#define INFLIGHT_DEPTH 4
+#define LOG_MASK (PRESET_SWITCH_LOG_DEPTH - 1)
+
+typedef struct {
+    uint8_t  preset;
+    uint8_t  xfers;
+    uint8_t  from_isr;
+    uint32_t edge_ticks;
+} inflight_t;
+
+static int switch_mode = PRESET_SWITCH_MODE_DEFERRED;
+
+static inflight_t inflight[INFLIGHT_DEPTH];
+static volatile uint8_t inflight_head = 0;
+static volatile uint8_t inflight_tail = 0;
+
+/* set while preset_switch_apply runs the apply with IRQs enabled: the ISR
+   defers to the main loop then, so only one context fills the in-flight ring
+   at a time and slots keep matching completions in order */
+static volatile uint8_t main_kicking = 0;
+
+/* edge time of a GPIO request the ISR handed to the main loop */
+static volatile uint32_t deferred_edge_ticks = 0;
+static volatile uint8_t deferred_edge_valid = 0;
+
+static preset_switch_record_t switch_log[PRESET_SWITCH_LOG_DEPTH];
+static volatile uint32_t switch_log_wr = 0;
+static preset_switch_stats_t switch_stats;
+
+static inline uint32_t now_ticks(void)
+{
+    XTime t;
+    XTime_GetTime(&t);
+    return (uint32_t)t;   /* TTC counter is 32 bit; deltas wrap cleanly */
+}
+
+/* atc apply callback: runs in I2C ISR context (or inline for polled/no-op applies) */
+static void switch_done(uint8_t preset_index, int status)
+{
+    uint32_t t_done = now_ticks();
+    if (inflight_head == inflight_tail) return;   /* not ours */
+
+    inflight_t *f = &inflight[inflight_head % INFLIGHT_DEPTH];
+    inflight_head++;
+
+    preset_switch_record_t *r = &switch_log[switch_log_wr & LOG_MASK];
+    r->preset = preset_index;
+    r->xfers = f->xfers;
+    r->failed = (uint8_t)status;
+    r->from_isr = f->from_isr;
+    r->edge_ticks = f->edge_ticks;
+    r->latency_ticks = t_done - f->edge_ticks;
+    switch_log_wr++;
+
+    switch_stats.count++;
+    if (status) switch_stats.errors++;
+    switch_stats.last_ticks = r->latency_ticks;
+    if (r->latency_ticks > switch_stats.worst_ticks) switch_stats.worst_ticks = r->latency_ticks;
+}
+
+/* reserve the slot first: the completion can fire before apply returns.
+   Called with IRQs masked (or from the ISR). */
+static inflight_t *switch_reserve(uint8_t preset, uint32_t edge, uint8_t from_isr)
+{
+    if ((uint8_t)(inflight_tail - inflight_head) >= INFLIGHT_DEPTH) {
+        switch_stats.dropped++;
+        return NULL;
+    }
+
+    inflight_t *f = &inflight[inflight_tail % INFLIGHT_DEPTH];
+    f->preset = preset;
+    f->xfers = 0;
+    f->from_isr = from_isr;
+    f->edge_ticks = edge;
+    inflight_tail++;
+    return f;
+}
+
+/* settle a reserved slot once the apply returned n. Called with IRQs masked. */
+static int switch_settle(inflight_t *f, int n)
+{
+    if (n < 0) {
+        /* nothing queued, no completion will come; nobody reserved after us */
+        inflight_tail--;
+        switch_stats.dropped++;
+        return -1;
+    }
+    f->xfers = (uint8_t)n;
+    return 0;
+}
+
+void preset_switch_init(int mode)
+{
+    switch_mode = mode;
+    inflight_head = inflight_tail = 0;
+    deferred_edge_valid = 0;
+    switch_log_wr = 0;
+    memset(&switch_stats, 0, sizeof(switch_stats));
+    switch_stats.ticks_per_us = COUNTS_PER_SECOND / 1000000u;
+    (void)now_ticks();    /* first XTime_GetTime starts the TTC; keep it out of the ISR */
+    atc_set_apply_callback(switch_done);
+}
+
+int preset_switch_mode(void) { return switch_mode; }
+
+int preset_switch_from_isr(uint8_t preset)
+{
+    uint32_t edge = now_ticks();
+    /* never run the polled or fan-out executors from interrupt context */
+    if (switch_mode == PRESET_SWITCH_MODE_ISR && platform_i2c_async_ready() &&
+        !platform_i2c_fanout_active() && !main_kicking) {
+        inflight_t *f = switch_reserve(preset, edge, 1);
+        if (f && switch_settle(f, atc_apply_preset_delta(preset, NULL)) == 0) {
+            return 0;
+        }
+    }
+    /* main loop applies it; keep the edge so latency still starts there */
+    deferred_edge_ticks = edge;
+    deferred_edge_valid = 1;
+    return -1;
+}
+
+int preset_switch_apply(uint8_t preset)
+{
+    uint32_t cpsr = platform_i2c_irq_save();
+    uint32_t edge = deferred_edge_valid ? deferred_edge_ticks : now_ticks();
+    deferred_edge_valid = 0;
+    inflight_t *f = switch_reserve(preset, edge, 0);
+    main_kicking = (f != NULL);
+    platform_i2c_irq_restore(cpsr);
+    if (!f) return -1;
+
+    /* IRQs stay on for the apply: it may be a whole blocking program run,
+       and the sample pulses and IPI must not wait for it */
+    int n = atc_apply_preset_delta(preset, NULL);
+
+    cpsr = platform_i2c_irq_save();
+    main_kicking = 0;
+    int rc = switch_settle(f, n);
+    platform_i2c_irq_restore(cpsr);
+    return rc;
+}
+
+uint32_t preset_switch_get_log(preset_switch_record_t *out, uint32_t max)
+{
+    uint32_t cpsr = platform_i2c_irq_save();
+    uint32_t wr = switch_log_wr;
+    uint32_t avail = (wr < PRESET_SWITCH_LOG_DEPTH) ? wr : PRESET_SWITCH_LOG_DEPTH;
+    uint32_t n = (max < avail) ? max : avail;
+    for (uint32_t i = 0; i < n; ++i) {
+        out[i] = switch_log[(wr - n + i) & LOG_MASK];
+    }
+    platform_i2c_irq_restore(cpsr);
+    return n;
+}
+
+void preset_switch_get_stats(preset_switch_stats_t *out)
+{
+    uint32_t cpsr = platform_i2c_irq_save();
+    *out = switch_stats;
+    platform_i2c_irq_restore(cpsr);
+}
+
+void preset_switch_reset_stats(void)
+{
+    uint32_t cpsr = platform_i2c_irq_save();
+    uint32_t tpu = switch_stats.ticks_per_us;
+    memset(&switch_stats, 0, sizeof(switch_stats));
+    switch_stats.ticks_per_us = tpu;
+    switch_log_wr = 0;
+    platform_i2c_irq_restore(cpsr);
+}
@@ -0,0 +1,52 @@
+/* preset_switch.h */
+#ifndef PRESET_SWITCH_H
+#define PRESET_SWITCH_H
+
+#include <stdint.h>
+
+/* Where a DDS GPIO edge gets turned into I2C traffic */
+#define PRESET_SWITCH_MODE_DEFERRED 0   /* ISR latches, main loop applies (legacy) */
+#define PRESET_SWITCH_MODE_ISR      1   /* ISR queues the precompiled program directly */
+
+#ifndef PRESET_SWITCH_LOG_DEPTH
+#define PRESET_SWITCH_LOG_DEPTH 64      /* must be a power of two */
+#endif
+
+/* one retune, edge -> last expander ACK; times in XTime (TTC) ticks */
+typedef struct {
+    uint8_t  preset;
+    uint8_t  xfers;          /* bus transactions issued */
+    uint8_t  failed;         /* transactions NACKed/aborted */
+    uint8_t  from_isr;       /* 1 = kicked from the GPIO ISR */
+    uint32_t edge_ticks;     /* low 32 bits of XTime at the GPIO edge */
+    uint32_t latency_ticks;  /* edge -> completion */
+} preset_switch_record_t;
+
+typedef struct {
+    uint32_t count;          /* completed retunes */
+    uint32_t errors;         /* retunes with at least one failed transaction */
+    uint32_t dropped;        /* requests that could not be queued */
+    uint32_t worst_ticks;
+    uint32_t last_ticks;
+    uint32_t ticks_per_us;
+} preset_switch_stats_t;
+
+/* Call after atc_precompute_sets/platform_i2c_async_init; owns the atc apply callback */
+void preset_switch_init(int mode);
+
+int preset_switch_mode(void);
+
+/* GPIO ISR entry: timestamps the edge and, in ISR mode, queues the program.
+   Returns 0 if queued, -1 if the caller must defer to preset_switch_apply(). */
+int preset_switch_from_isr(uint8_t preset);
+
+/* Main-loop entry (deferred mode, IPI initial tuning, ISR fallback) */
+int preset_switch_apply(uint8_t preset);
+
+/* Copy up to `max` most recent records (oldest first); returns count copied */
+uint32_t preset_switch_get_log(preset_switch_record_t *out, uint32_t max);
+
+void preset_switch_get_stats(preset_switch_stats_t *out);
+void preset_switch_reset_stats(void);
+
+#endif
@@ -0,0 +1,162 @@
+/* sample_seq.c */
+#include "sample_seq.h"
+#include "xttcps.h"
+#include "xparameters.h"
+#include "xstatus.h"
+#include "xinterrupt_wrap.h"
+#include <string.h>
+
+#define SEQ_TTC_BASEADDR   XPAR_XTTCPS_0_BASEADDR
+/* TTC0 counter 0; the SDT encoding holds the SPI number, GIC ids start SPIs at 32 */
+#define SEQ_TTC_INTR_ID    (XGet_IntrId(XPAR_XTTCPS_0_INTERRUPTS) + 32U)
+#define SEQ_TICKS_PER_US   (XPAR_XTTCPS_0_CLOCK_FREQ / 1000000u)
+#define SEQ_GPIO_CH        1
+
+/* segment currently being timed */
+#define SEG_IDLE 0
+#define SEG_HIGH 1
+#define SEG_LOW  2
+#define SEG_GAP  3
+
+static XTtcPs TtcInst;
+static XGpio *seq_gpio = NULL;
+
+static volatile uint8_t seg = SEG_IDLE;
+static volatile uint8_t run_done = 0;
+static uint32_t cfg_echos, cfg_scans, cfg_gap_ticks;
+static uint32_t echos_left;
+static sample_seq_stats_t seq_stats;
+
+static inline void seq_set_interval(uint32_t ticks)
+{
+    XTtcPs_SetInterval(&TtcInst, (XInterval)ticks);
+}
+
+/* start scan: first pulse, or straight to the gap when echos == 0 */
+static void seq_begin_scan(void)
+{
+    echos_left = cfg_echos;
+    if (echos_left) {
+        XGpio_DiscreteWrite(seq_gpio, SEQ_GPIO_CH, 1);
+        seq_set_interval(SAMPLE_SEQ_PULSE_HIGH_US * SEQ_TICKS_PER_US);
+        seg = SEG_HIGH;
+    } else {
+        seq_set_interval(cfg_gap_ticks);
+        seg = SEG_GAP;
+    }
+}
+
+static void seq_finish(void)
+{
+    XTtcPs_Stop(&TtcInst);
+    XGpio_DiscreteWrite(seq_gpio, SEQ_GPIO_CH, 0);
+    seg = SEG_IDLE;
+    run_done = 1;
+}
+
+/* Interval interrupt: the counter has already restarted from 0 in hardware,
+   so ISR latency only shifts the GPIO edge, it never accumulates. */
+static void seq_ttc_isr(void *ref)
+{
+    (void)ref;
+    uint32_t lat = XTtcPs_GetCounterValue(&TtcInst);
+    u32 status = XTtcPs_GetInterruptStatus(&TtcInst);
+    XTtcPs_ClearInterruptStatus(&TtcInst, status);
+    if (!(status & XTTCPS_IXR_INTERVAL_MASK) || seg == SEG_IDLE) return;
+
+    if (seq_stats.segments == 0 || lat < seq_stats.isr_lat_min_ticks) seq_stats.isr_lat_min_ticks = lat;
+    if (lat > seq_stats.isr_lat_max_ticks) seq_stats.isr_lat_max_ticks = lat;
+    seq_stats.segments++;
+
+    switch (seg) {
+    case SEG_HIGH:
+        XGpio_DiscreteWrite(seq_gpio, SEQ_GPIO_CH, 0);
+        seq_set_interval(SAMPLE_SEQ_PULSE_LOW_US * SEQ_TICKS_PER_US);
+        seg = SEG_LOW;
+        break;
+    case SEG_LOW:
+        if (--echos_left) {
+            XGpio_DiscreteWrite(seq_gpio, SEQ_GPIO_CH, 1);
+            seq_set_interval(SAMPLE_SEQ_PULSE_HIGH_US * SEQ_TICKS_PER_US);
+            seg = SEG_HIGH;
+        } else {
+            seq_set_interval(cfg_gap_ticks);
+            seg = SEG_GAP;
+        }
+        break;
+    case SEG_GAP:
+        seq_stats.scans_done++;
+        if (seq_stats.scans_done >= cfg_scans) {
+            seq_finish();
+        } else {
+            seq_begin_scan();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+int sample_seq_init(XScuGic *gic, XGpio *gpio)
+{
+    XTtcPs_Config *cfg = XTtcPs_LookupConfig(SEQ_TTC_BASEADDR);
+    if (cfg == NULL) return XST_FAILURE;
+
+    int Status = XTtcPs_CfgInitialize(&TtcInst, cfg, cfg->BaseAddress);
+    if (Status != XST_SUCCESS) {
+        /* left running by a previous boot: stop and retry */
+        XTtcPs_Stop(&TtcInst);
+        Status = XTtcPs_CfgInitialize(&TtcInst, cfg, cfg->BaseAddress);
+        if (Status != XST_SUCCESS) return Status;
+    }
+
+    XTtcPs_SetOptions(&TtcInst, XTTCPS_OPTION_INTERVAL_MODE | XTTCPS_OPTION_WAVE_DISABLE);
+    XTtcPs_SetPrescaler(&TtcInst, XTTCPS_CLK_CNTRL_PS_DISABLE);
+
+    Status = XScuGic_Connect(gic, SEQ_TTC_INTR_ID, (Xil_ExceptionHandler)seq_ttc_isr, NULL);
+    if (Status != XST_SUCCESS) return Status;
+    XScuGic_Enable(gic, SEQ_TTC_INTR_ID);
+
+    XTtcPs_EnableInterrupts(&TtcInst, XTTCPS_IXR_INTERVAL_MASK);
+    seq_gpio = gpio;
+    seg = SEG_IDLE;
+    return XST_SUCCESS;
+}
+
+int sample_seq_start(uint32_t echos, uint32_t scans, uint32_t t_end_us)
+{
+    if (!seq_gpio || seg != SEG_IDLE || scans == 0) return -1;
+    /* t_end_us comes straight from the IPI payload: the gap must fit the counter */
+    if (t_end_us > UINT32_MAX / SEQ_TICKS_PER_US) return -1;
+
+    cfg_echos = echos;
+    cfg_scans = scans;
+    /* a zero gap still needs one timer period to move on to the next scan */
+    cfg_gap_ticks = t_end_us ? t_end_us * SEQ_TICKS_PER_US : 1;
+
+    memset(&seq_stats, 0, sizeof(seq_stats));
+    seq_stats.ticks_per_us = SEQ_TICKS_PER_US;
+    run_done = 0;
+
+    XTtcPs_Stop(&TtcInst);
+    seq_begin_scan();
+    XTtcPs_ResetCounterValue(&TtcInst);
+    XTtcPs_Start(&TtcInst);
+    return 0;
+}
+
+void sample_seq_stop(void)
+{
+    if (seg != SEG_IDLE) seq_finish();
+}
+
+int sample_seq_busy(void) { return seg != SEG_IDLE; }
+
+int sample_seq_take_done(void)
+{
+    if (!run_done) return 0;
+    run_done = 0;
+    return 1;
+}
+
+void sample_seq_get_stats(sample_seq_stats_t *out) { *out = seq_stats; }
@@ -0,0 +1,40 @@
+/* sample_seq.h */
+#ifndef SAMPLE_SEQ_H
+#define SAMPLE_SEQ_H
+
+#include <stdint.h>
+#include "xscugic.h"
+#include "xgpio.h"
+
+/* Hardware-timed echo/scan/t_end pulse pattern on TTC0 counter 0.
+   (xiltimer owns TTC2/TTC3 on the R5, the A53 FreeRTOS tick owns TTC1.) */
+
+#define SAMPLE_SEQ_PULSE_HIGH_US 400
+#define SAMPLE_SEQ_PULSE_LOW_US  400
+
+typedef struct {
+    uint32_t scans_done;        /* scans completed in the current/last run */
+    uint32_t segments;          /* timer segments serviced */
+    uint32_t isr_lat_min_ticks; /* counter value at ISR entry = delay after expiry */
+    uint32_t isr_lat_max_ticks; /* max - min = edge jitter, in TTC ticks */
+    uint32_t ticks_per_us;
+} sample_seq_stats_t;
+
+/* gpio: sample output (channel 1). Connects the TTC IRQ to `gic`. */
+int sample_seq_init(XScuGic *gic, XGpio *gpio);
+
+/* Start a run of `scans` scans, each `echos` pulses followed by a t_end_us gap.
+   Returns 0, or -1 if a run is already active / arguments are invalid (including
+   a gap too long for the 32-bit TTC interval, about 42.9 s at 100 MHz). */
+int sample_seq_start(uint32_t echos, uint32_t scans, uint32_t t_end_us);
+
+void sample_seq_stop(void);
+
+int sample_seq_busy(void);
+
+/* Returns 1 once per finished run (clears on read) */
+int sample_seq_take_done(void);
+
+void sample_seq_get_stats(sample_seq_stats_t *out);
+
+#endif
@@ -169,6 +169,31 @@ macros is used. */
 handler for whichever peripheral is used to generate the RTOS tick. */
 void FreeRTOS_Tick_Handler( void );
 
+/* Tickless idle support, implemented in portZynqUltrascale.c. */
+#if( configUSE_TICKLESS_IDLE == 1 )
+	extern void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime );
+	#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+#endif
+
+/* Run time stats and task profiling, implemented in port_prof.c. */
+#if( configGENERATE_RUN_TIME_STATS == 1 )
+	/* Generic counter; runs at CNTFRQ_EL0 and keeps counting in WFI. */
+	static inline uint64_t ullPortProfNow( void )
+	{
+		__asm volatile( "ISB SY" ::: "memory" );
+		return mfcp( CNTPCT_EL0 );
+	}
+
+	extern void vPortProfInit( void );
+	extern uint64_t ullPortProfRunTime( void );
+	extern void vPortProfTaskReady( void *pvTCB );
+	extern void vPortProfTaskSwitchedIn( void *pvTCB );
+	extern void vPortProfIrqDone( uint32_t ulInterruptID, uint64_t ullStart );
+
+	#define traceMOVED_TASK_TO_READY_STATE( pxTCB )	vPortProfTaskReady( ( void * ) ( pxTCB ) )
+	#define traceTASK_SWITCHED_IN()			vPortProfTaskSwitchedIn( ( void * ) pxCurrentTCB )
+#endif
+
 /*
  * Installs pxHandler as the interrupt handler for the peripheral specified by
  * the ucInterruptID parameter.
@@ -30,7 +30,7 @@
 #define	configUSE_TIMERS			  1
 #define	FREERTOS_TIMER_TICK_TRACE		 0
 
-#define	configTICK_RATE_HZ			(100)
+#define	configTICK_RATE_HZ			(1000)
 #define	configMAX_API_CALL_INTERRUPT_PRIORITY	18
 #define	configMAX_PRIORITIES			(8)
 #define	configMINIMAL_STACK_SIZE		((unsigned short) 200)
@@ -43,7 +43,7 @@
 #define	configTIMER_TASK_PRIORITY		(configMAX_PRIORITIES-1)
 #define	configTIMER_QUEUE_LENGTH		10
 #define	configTIMER_TASK_STACK_DEPTH		((configMINIMAL_STACK_SIZE * 2))
-#define	configGENERATE_RUN_TIME_STATS		0x0
+#define	configGENERATE_RUN_TIME_STATS		0x1
 #define	configMAX_CO_ROUTINE_PRIORITIES		2
 #define	configTIMER_BASEADDR			0xff110000
 #define	configTIMER_SELECT_CNTR			0x0
@@ -52,7 +52,8 @@
 #define	configUSE_16_BIT_TICKS			0x0
 #define	configUSE_APPLICATION_TASK_TAG		0x0
 #define	configUSE_CO_ROUTINES			0x0
-#define	configUSE_TICKLESS_IDLE			0x0
+#define	configUSE_TICKLESS_IDLE			0x1
+#define	configUSE_HEAP_POOLS			0x1
 #define	INCLUDE_vTaskPrioritySet		1
 #define	INCLUDE_uxTaskPriorityGet		1
 #define	INCLUDE_vTaskDelete			1
@@ -71,10 +72,15 @@
 #define	configINTERRUPT_CONTROLLER_CPU_INTERFACE_OFFSET (0x10000)
 
 #define configASSERT( x ) if( ( x ) == 0 ) vApplicationAssert( __FILE__, __LINE__ )
+void xCONFIGURE_TIMER_FOR_RUN_TIME_STATS(void);
 
-#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() \
+              xCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define configRUN_TIME_COUNTER_TYPE uint64_t
+uint64_t xGET_RUN_TIME_COUNTER_VALUE(void);
 
-#define portGET_RUN_TIME_COUNTER_VALUE()
+#define portGET_RUN_TIME_COUNTER_VALUE() \
+                                        xGET_RUN_TIME_COUNTER_VALUE()
 
 void vApplicationAssert( const char *pcFile, uint32_t ulLine );
 void FreeRTOS_SetupTickInterrupt(void);
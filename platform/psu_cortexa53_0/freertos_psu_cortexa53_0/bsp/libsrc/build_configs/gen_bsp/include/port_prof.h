@@ -0,0 +1,97 @@
+/*
+ * FreeRTOS Kernel V10.6.1
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * Copyright (c) 2022 - 2023 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef PORT_PROF_H
+#define PORT_PROF_H
+
+/*
+ * Task and interrupt profiling for the Cortex-A53 port, built when
+ * configGENERATE_RUN_TIME_STATS is 1.
+ *
+ * Time is measured with the ARMv8 generic counter, at CNTFRQ_EL0 counts per
+ * second. The run time counter handed to the kernel excludes time spent in
+ * interrupt handlers, so task run times do not include the interrupts that
+ * happened to hit them; interrupt time is reported per interrupt ID instead.
+ *
+ * xPortProfSnapshot() writes a binary snapshot: one PortProfHeader_t, then
+ * usTaskCount PortProfTask_t records, then usIrqCount PortProfIrq_t records
+ * (only interrupts that have fired). Records are little-endian with natural
+ * alignment and the record sizes are in the header, so a host tool can read
+ * newer versions that append fields. All counters except the maxima are
+ * cumulative since boot: the difference between two snapshots is the profile
+ * of the interval between them.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "xscugic_hw.h"
+
+#define portPROF_MAGIC			0x53505452UL	/* "RTPS" */
+#define portPROF_VERSION		1U
+#define portPROF_MAX_TASKS		32U		/* slot 0 collects tasks beyond this */
+#define portPROF_NAME_LEN		16U
+#define portPROF_MAX_IRQS		XSCUGIC_MAX_NUM_INTR_INPUTS
+
+typedef struct
+{
+	uint32_t ulMagic;
+	uint16_t usVersion;
+	uint16_t usHeaderSize;
+	uint16_t usTaskRecordSize;
+	uint16_t usIrqRecordSize;
+	uint16_t usTaskCount;
+	uint16_t usIrqCount;
+	uint32_t ulSequence;		/* incremented by each snapshot */
+	uint32_t ulReserved;
+	uint64_t ullCounterHz;		/* generic counter frequency */
+	uint64_t ullTimestamp;		/* generic counter at capture */
+	uint64_t ullIsrTime;		/* counts spent in interrupt handlers */
+	uint64_t ullIsrCount;
+	uint64_t ullSwitchCount;	/* context switches, all tasks */
+} PortProfHeader_t;
+
+typedef struct
+{
+	char cName[ portPROF_NAME_LEN ];
+	uint32_t ulTaskNumber;		/* profiling slot, stable for the task's life */
+	uint32_t ulPriority;
+	uint32_t ulState;		/* eTaskState */
+	uint32_t ulStackHighWater;	/* words */
+	uint64_t ullRunTime;		/* counts, interrupt handlers excluded */
+	uint64_t ullSwitchesIn;
+	uint64_t ullReadyCount;		/* ready -> running transitions timed */
+	uint64_t ullReadyLatencyTotal;	/* counts from made ready to running */
+	uint64_t ullReadyLatencyMax;	/* since boot or the last reset */
+} PortProfTask_t;
+
+typedef struct
+{
+	uint32_t ulIrqId;
+	uint32_t ulMaxTime;		/* counts, since boot or the last reset */
+	uint64_t ullCount;
+	uint64_t ullTime;		/* counts, nested interrupts included */
+} PortProfIrq_t;
+
+/* Largest possible snapshot, for sizing the caller's buffer. */
+#define portPROF_SNAPSHOT_MAX	( sizeof( PortProfHeader_t ) +						\
+				  ( portPROF_MAX_TASKS * sizeof( PortProfTask_t ) ) +		\
+				  ( portPROF_MAX_IRQS * sizeof( PortProfIrq_t ) ) )
+
+/*
+ * Write a snapshot into pvBuffer. Returns the number of bytes written, or 0 if
+ * xLength is too small. If xResetMax is pdTRUE the latency and interrupt
+ * maxima start again from zero once copied. Call from one task at a time.
+ */
+size_t xPortProfSnapshot( void *pvBuffer, size_t xLength, BaseType_t xResetMax );
+
+#endif /* PORT_PROF_H */
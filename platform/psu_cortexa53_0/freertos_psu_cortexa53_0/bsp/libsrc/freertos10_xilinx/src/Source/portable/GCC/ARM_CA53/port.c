@@ -200,13 +200,6 @@ uint64_t ullPortYieldRequired = pdFALSE;
 /* Counts the interrupt nesting depth.  A context switch is only performed if
 if the nesting depth is 0. */
 uint64_t ullPortInterruptNesting = 0;
-/*
- * Global counter used for calculation of run time statistics of tasks.
- * Defined only when the relevant option is turned on
- */
-#if (configGENERATE_RUN_TIME_STATS==1)
-volatile uint32_t ulHighFrequencyTimerTicks;
-#endif
 
 /* The space on the stack required to hold the FPU registers.  This is 32 128-bit
  * registers, that means (64 * 8) 64 double words */
@@ -629,17 +622,9 @@ void FreeRTOS_Tick_Handler( void )
 #endif
 
 	/*
-	 * The Xilinx implementation of generating run time task stats uses the same timer used for generating
-	 * FreeRTOS ticks. In case user decides to generate run time stats the tick handler is called more
-	 * frequently (10 times faster). The timer/tick handler uses logic to handle the same. It handles
-	 * the FreeRTOS tick once per 10 interrupts.
-	 * For handling generation of run time stats, it increments a pre-defined counter every time the
-	 * interrupt handler executes.
+	 * Run time stats are timed by the generic counter (see
+	 * xGET_RUN_TIME_COUNTER_VALUE), so every tick timer interrupt is a tick.
 	 */
-#if (configGENERATE_RUN_TIME_STATS == 1)
-	ulHighFrequencyTimerTicks++;
-	if (!(ulHighFrequencyTimerTicks % 10))
-#endif
 	{
 
 		/* Must be the lowest possible priority. */
@@ -686,10 +671,6 @@ void FreeRTOS_Tick_Handler( void )
 		}
 	}
 
-#if (configGENERATE_RUN_TIME_STATS == 1)
-		configCLEAR_TICK_INTERRUPT();
-#endif
-
 	/* Ensure all interrupt priorities are active again. */
 	portCLEAR_INTERRUPT_MASK();
 }
@@ -816,21 +797,23 @@ void vPortValidateInterruptPriority( void )
 
 #if( configGENERATE_RUN_TIME_STATS == 1 )
 /*
- * For Xilinx implementation this is a dummy function that does a redundant operation
- * of zeroing out the global counter.
- * It is called by FreeRTOS kernel.
+ * Run time stats are timed by the ARMv8 generic counter (CNTPCT_EL0). It is
+ * 64 bits wide, is already running when the application starts, and, unlike
+ * the PMU cycle counter, keeps counting while the core sleeps in WFI. Nothing
+ * needs to be configured; the profiling state is cleared here.
  */
 void xCONFIGURE_TIMER_FOR_RUN_TIME_STATS (void)
 {
-	ulHighFrequencyTimerTicks = 0;
+	vPortProfInit();
 }
 /*
- * For Xilinx implementation this function returns the global counter used for
- * run time task stats calculation.
+ * Returns the generic counter, at CNTFRQ_EL0 counts per second, less the time
+ * spent in interrupt handlers, so that time is not charged to the task that
+ * was interrupted.
  * It is called by FreeRTOS kernel task handling logic.
  */
-uint32_t xGET_RUN_TIME_COUNTER_VALUE (void)
+uint64_t xGET_RUN_TIME_COUNTER_VALUE (void)
 {
-	return ulHighFrequencyTimerTicks;
+	return ullPortProfRunTime();
 }
 #endif
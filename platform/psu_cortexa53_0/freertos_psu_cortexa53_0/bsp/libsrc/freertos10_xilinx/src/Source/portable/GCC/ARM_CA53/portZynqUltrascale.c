@@ -65,6 +65,26 @@ XScuGic xInterruptController;
 #else
 extern uintptr_t IntrControllerAddr;
 #endif
+
+/* TTC instance that generates the tick, when there is one. */
+#if !defined(XPAR_XILTIMER_ENABLED) && !defined(SDT)
+#define portTICK_TTC	( &xTimerInstance )
+#elif defined(XTICKTIMER_IS_TTCPS)
+#define portTICK_TTC	( &TimerInst.TtcPs_TickInst )
+#endif
+
+#if( configUSE_TICKLESS_IDLE == 1 )
+#if !defined(portTICK_TTC)
+	#error Tickless idle needs a TTC tick timer
+#endif
+/* Timer counts in one tick period, and the most ticks one interval can span. */
+static uint32_t ulTimerCountsForOneTick;
+static TickType_t xMaximumPossibleSuppressedTicks;
+
+/* Set after a sleep, when the tick timer was restarted with a shortened first
+period. The next tick interrupt puts the full period back. */
+static volatile uint32_t ulRestoreTickInterval;
+#endif
 /*-----------------------------------------------------------*/
 
 #if !defined(XPAR_XILTIMER_ENABLED) && !defined(SDT)
@@ -92,20 +112,17 @@ const uint8_t ucLevelSensitive = 1;
 
 	/* Set the options. */
 	XTtcPs_SetOptions( &xTimerInstance, ( XTTCPS_OPTION_INTERVAL_MODE | XTTCPS_OPTION_WAVE_DISABLE ) );
-	/*
-	 * The Xilinx implementation of generating run time task stats uses the same timer used for generating
-	 * FreeRTOS ticks. In case user decides to generate run time stats the timer time out interval is changed
-	 * as "configured tick rate * 10". The multiplying factor of 10 is hard coded for Xilinx FreeRTOS ports.
-	 */
-#if (configGENERATE_RUN_TIME_STATS == 1)
-	XTtcPs_CalcIntervalFromFreq( &xTimerInstance, configTICK_RATE_HZ*10, &usInterval, &ucPrescale );
-#else
+	/* Run time stats are timed by the generic counter (see port_prof.c), so
+	the tick timer always runs at the tick rate. */
 	XTtcPs_CalcIntervalFromFreq( &xTimerInstance, configTICK_RATE_HZ, &( usInterval ), &( ucPrescale ) );
-#endif
 
 	/* Set the interval and prescale. */
 	XTtcPs_SetInterval( &xTimerInstance, usInterval );
 	XTtcPs_SetPrescaler( &xTimerInstance, ucPrescale );
+#if( configUSE_TICKLESS_IDLE == 1 )
+	ulTimerCountsForOneTick = usInterval;
+	xMaximumPossibleSuppressedTicks = XTTCPS_MAX_INTERVAL_COUNT / ulTimerCountsForOneTick;
+#endif
 
 	xPortInstallInterruptHandler(configTIMER_INTERRUPT_ID,
 					( Xil_InterruptHandler ) FreeRTOS_Tick_Handler,
@@ -134,24 +151,36 @@ void FreeRTOS_SetupTickInterrupt( void )
 	/* Limit the configTICK_RATE_HZ to 1000 if user configured greater than 1000 */
 	uint32_t Tick_Rate = (configTICK_RATE_HZ > 1000) ? 1000 : configTICK_RATE_HZ;
 
-	/*
-	 * The Xilinx implementation of generating run time task stats uses the same timer used for generating
-	 * FreeRTOS ticks. In case user decides to generate run time stats the timer time out interval is changed
-	 * as "configured tick rate * 10". The multiplying factor of 10 is hard coded for Xilinx FreeRTOS ports.
-	 */
-#if (configGENERATE_RUN_TIME_STATS == 1)
-	/* XTimer_SetInterval() API expects delay in milli seconds
-         * Convert the user provided tick rate to milli seconds.
-         */
-	XTimer_SetInterval(XTIMER_DELAY_MSEC/(Tick_Rate * 10));
-#else
-	/* XTimer_SetInterval() API expects delay in milli seconds
+	/* Run time stats are timed by the generic counter (see port_prof.c), so
+	 * the tick timer always runs at the tick rate.
+	 * XTimer_SetInterval() API expects delay in milli seconds
          * Convert the user provided tick rate to milli seconds.
          */
 	XTimer_SetInterval(XTIMER_DELAY_MSEC/Tick_Rate);
-#endif
 	XTimer_SetHandler(TimerCounterHandler, 0,
 			portLOWEST_USABLE_INTERRUPT_PRIORITY << portPRIORITY_SHIFT);
+
+#if defined(XTICKTIMER_IS_TTCPS)
+	{
+	/* XTimer_SetInterval() only takes whole milliseconds. Program the TTC
+	for the exact rate, which also lifts the 1000 Hz limit above. */
+	XTtcPs *pxTimer = portTICK_TTC;
+	XInterval xInterval;
+	uint8_t ucPrescale;
+
+		XTtcPs_Stop( pxTimer );
+		XTtcPs_CalcIntervalFromFreq( pxTimer, configTICK_RATE_HZ, &xInterval, &ucPrescale );
+		configASSERT( ucPrescale != 0xFFU );
+		XTtcPs_SetInterval( pxTimer, xInterval );
+		XTtcPs_SetPrescaler( pxTimer, ucPrescale );
+		XTtcPs_ResetCounterValue( pxTimer );
+		XTtcPs_Start( pxTimer );
+#if( configUSE_TICKLESS_IDLE == 1 )
+		ulTimerCountsForOneTick = xInterval;
+		xMaximumPossibleSuppressedTicks = XTTCPS_MAX_INTERVAL_COUNT / ulTimerCountsForOneTick;
+#endif
+	}
+#endif
 }
 #endif
 /*-----------------------------------------------------------*/
@@ -165,8 +194,105 @@ void FreeRTOS_ClearTickInterrupt( void )
 #else
 	XTimer_ClearTickInterrupt();
 #endif
+#if( configUSE_TICKLESS_IDLE == 1 )
+	/* The counter has just wrapped, so the new interval applies from now. */
+	if( ulRestoreTickInterval != 0U )
+	{
+		XTtcPs_SetInterval( portTICK_TTC, ulTimerCountsForOneTick );
+		ulRestoreTickInterval = 0U;
+	}
+#endif
+}
+/*-----------------------------------------------------------*/
+
+#if( configUSE_TICKLESS_IDLE == 1 )
+/*
+ * Called by the idle task, with the scheduler suspended, when no task is due
+ * to run for at least configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks. The tick
+ * TTC is stopped, reloaded to expire at the start of the tick in which the
+ * next task is due, and the core waits in WFI. On wakeup, by that expiry or
+ * by any other interrupt, the elapsed time is read back from the counter, the
+ * tick count is stepped by the whole ticks that passed, and the timer is
+ * restarted with the remainder of the current tick so the tick phase is kept.
+ * The few register accesses while the counter is stopped are not counted.
+ */
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+XTtcPs *pxTimer = portTICK_TTC;
+uint32_t ulElapsed, ulSleepCounts;
+TickType_t xPendingTicks = 0, xCompleteTicks, xModifiableIdleTime;
+
+	if( xExpectedIdleTime > xMaximumPossibleSuppressedTicks )
+	{
+		xExpectedIdleTime = xMaximumPossibleSuppressedTicks;
+	}
+
+	/* Mask IRQs at the core. An interrupt that becomes pending still ends
+	WFI; it is taken once interrupts are enabled again below. */
+	portDISABLE_INTERRUPTS();
+	if( eTaskConfirmSleepModeStatus() == eAbortSleep )
+	{
+		portENABLE_INTERRUPTS();
+		return;
+	}
+
+	XTtcPs_Stop( pxTimer );
+	ulElapsed = XTtcPs_GetCounterValue( pxTimer );
+
+	/* The status register clears on read. A tick that expired after
+	interrupts were masked is therefore counted here, not by the handler. */
+	if( ( XTtcPs_GetInterruptStatus( pxTimer ) & XTTCPS_IXR_INTERVAL_MASK ) != 0U )
+	{
+		xPendingTicks = 1;
+	}
+
+	/* The rest of the current tick, then the remaining whole ticks. */
+	XTtcPs_SetInterval( pxTimer, ( ulTimerCountsForOneTick * ( uint32_t ) ( xExpectedIdleTime - xPendingTicks ) ) - ulElapsed );
+	XTtcPs_ResetCounterValue( pxTimer );
+	XTtcPs_Start( pxTimer );
+
+	xModifiableIdleTime = xExpectedIdleTime;
+	configPRE_SLEEP_PROCESSING( xModifiableIdleTime );
+	if( xModifiableIdleTime > 0 )
+	{
+		__asm volatile( "DSB SY" ::: "memory" );
+		__asm volatile( "WFI" );
+		__asm volatile( "ISB SY" );
+	}
+	configPOST_SLEEP_PROCESSING( xExpectedIdleTime );
+
+	XTtcPs_Stop( pxTimer );
+	ulSleepCounts = XTtcPs_GetCounterValue( pxTimer );
+
+	if( ( XTtcPs_GetInterruptStatus( pxTimer ) & XTTCPS_IXR_INTERVAL_MASK ) != 0U )
+	{
+		/* Slept to the end: the counter has been running in the next tick
+		since it wrapped. */
+		xCompleteTicks = xExpectedIdleTime;
+		if( ulSleepCounts >= ulTimerCountsForOneTick )
+		{
+			ulSleepCounts = ulTimerCountsForOneTick - 1U;
+		}
+	}
+	else
+	{
+		/* Another interrupt ended the sleep early. */
+		ulSleepCounts += ulElapsed;
+		xCompleteTicks = xPendingTicks + ( TickType_t ) ( ulSleepCounts / ulTimerCountsForOneTick );
+		ulSleepCounts %= ulTimerCountsForOneTick;
+	}
+
+	/* Finish the current tick, then go back to the normal period. */
+	XTtcPs_SetInterval( pxTimer, ulTimerCountsForOneTick - ulSleepCounts );
+	ulRestoreTickInterval = 1U;
+	XTtcPs_ResetCounterValue( pxTimer );
+	XTtcPs_Start( pxTimer );
+
+	vTaskStepTick( xCompleteTicks );
+	portENABLE_INTERRUPTS();
 }
 /*-----------------------------------------------------------*/
+#endif
 
 void vApplicationIRQHandler( uint32_t ulICCIAR )
 {
@@ -174,6 +300,9 @@ extern XScuGic_Config XScuGic_ConfigTable[];
 static const XScuGic_VectorTableEntry *pxVectorTable = XScuGic_ConfigTable[ XPAR_SCUGIC_SINGLE_DEVICE_ID ].HandlerTable;
 uint32_t ulInterruptID;
 const XScuGic_VectorTableEntry *pxVectorEntry;
+#if( configGENERATE_RUN_TIME_STATS == 1 )
+uint64_t ullStart = ullPortProfNow();
+#endif
 
 	/* Interrupts cannot be re-enabled until the source of the interrupt is
 	cleared. The ID of the interrupt is obtained by bitwise ANDing the ICCIAR
@@ -187,6 +316,9 @@ const XScuGic_VectorTableEntry *pxVectorEntry;
 		pxVectorEntry = &( pxVectorTable[ ulInterruptID ] );
 		configASSERT( pxVectorEntry );
 		pxVectorEntry->Handler( pxVectorEntry->CallBackRef );
+#if( configGENERATE_RUN_TIME_STATS == 1 )
+		vPortProfIrqDone( ulInterruptID, ullStart );
+#endif
 	}
 }
 /*-----------------------------------------------------------*/
@@ -0,0 +1,267 @@
+/*
+ * FreeRTOS Kernel V10.6.1
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * Copyright (c) 2022 - 2023 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "port_prof.h"
+
+#if( configGENERATE_RUN_TIME_STATS == 1 )
+
+#if( configUSE_TRACE_FACILITY != 1 )
+	#error Task profiling keeps its slot number in the task number: set configUSE_TRACE_FACILITY to 1
+#endif
+
+/* Per task counters. A task is given a slot the first time it is made ready,
+and the slot number is stored as its task number (vTaskSetTaskNumber()). */
+typedef struct
+{
+	uint64_t ullSwitchesIn;
+	uint64_t ullReadySince;		/* 0 when not waiting to run */
+	uint64_t ullReadyCount;
+	uint64_t ullReadyLatencyTotal;
+	uint64_t ullReadyLatencyMax;
+} ProfTaskSlot_t;
+
+typedef struct
+{
+	uint64_t ullCount;
+	uint64_t ullTime;
+	uint32_t ulMaxTime;
+} ProfIrq_t;
+
+/* Defined in port.c, incremented by FreeRTOS_IRQ_Handler around the C handler. */
+extern uint64_t ullPortInterruptNesting;
+
+static ProfTaskSlot_t xTaskSlots[ portPROF_MAX_TASKS ];
+static UBaseType_t uxNextSlot = 1;
+static ProfIrq_t xIrqs[ portPROF_MAX_IRQS ];
+static volatile uint64_t ullIsrTime;
+static uint64_t ullIsrCount;
+static uint64_t ullSwitchCount;
+static uint64_t ullCounterHz;
+static uint32_t ulSequence;
+/*-----------------------------------------------------------*/
+
+/* The tick handler runs with interrupts enabled, so interrupt counters are
+updated with IRQs masked at the core rather than through the GIC. */
+static inline uint64_t prvMaskIrq( void )
+{
+uint64_t ullDaif;
+
+	__asm volatile( "MRS %0, DAIF" : "=r"( ullDaif ) :: "memory" );
+	__asm volatile( "MSR DAIFSET, #2" ::: "memory" );
+	return ullDaif;
+}
+
+static inline void prvRestoreIrq( uint64_t ullDaif )
+{
+	__asm volatile( "MSR DAIF, %0" :: "r"( ullDaif ) : "memory" );
+}
+/*-----------------------------------------------------------*/
+
+static ProfTaskSlot_t *prvTaskSlot( void *pvTCB )
+{
+TaskHandle_t xTask = ( TaskHandle_t ) pvTCB;
+UBaseType_t uxSlot = uxTaskGetTaskNumber( xTask );
+
+	if( ( uxSlot == 0U ) && ( uxNextSlot < portPROF_MAX_TASKS ) )
+	{
+		uxSlot = uxNextSlot++;
+		vTaskSetTaskNumber( xTask, uxSlot );
+	}
+	else if( uxSlot >= portPROF_MAX_TASKS )
+	{
+		uxSlot = 0U;
+	}
+	return &xTaskSlots[ uxSlot ];
+}
+/*-----------------------------------------------------------*/
+
+/* Called through portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() when the scheduler
+starts. Tasks created before that were made ready long before they could run,
+so their ready time is not a latency. */
+void vPortProfInit( void )
+{
+UBaseType_t x;
+
+	ullCounterHz = mfcp( CNTFRQ_EL0 );
+	for( x = 0; x < portPROF_MAX_TASKS; x++ )
+	{
+		xTaskSlots[ x ].ullReadySince = 0U;
+	}
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullPortProfRunTime( void )
+{
+	return ullPortProfNow() - ullIsrTime;
+}
+/*-----------------------------------------------------------*/
+
+/* traceMOVED_TASK_TO_READY_STATE(): the kernel holds interrupts masked. */
+void vPortProfTaskReady( void *pvTCB )
+{
+ProfTaskSlot_t *pxSlot = prvTaskSlot( pvTCB );
+
+	if( pxSlot->ullReadySince == 0U )
+	{
+		pxSlot->ullReadySince = ullPortProfNow();
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* traceTASK_SWITCHED_IN(), from vTaskSwitchContext(). */
+void vPortProfTaskSwitchedIn( void *pvTCB )
+{
+ProfTaskSlot_t *pxSlot = prvTaskSlot( pvTCB );
+
+	ullSwitchCount++;
+	pxSlot->ullSwitchesIn++;
+	if( pxSlot->ullReadySince != 0U )
+	{
+		uint64_t ullLatency = ullPortProfNow() - pxSlot->ullReadySince;
+
+		pxSlot->ullReadySince = 0U;
+		pxSlot->ullReadyCount++;
+		pxSlot->ullReadyLatencyTotal += ullLatency;
+		if( ullLatency > pxSlot->ullReadyLatencyMax )
+		{
+			pxSlot->ullReadyLatencyMax = ullLatency;
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* Called by vApplicationIRQHandler() once the handler for ulInterruptID has
+returned. Only the outermost interrupt adds to the total, so nested handlers
+are not counted twice. */
+void vPortProfIrqDone( uint32_t ulInterruptID, uint64_t ullStart )
+{
+uint64_t ullDaif = prvMaskIrq();
+uint64_t ullTime = ullPortProfNow() - ullStart;
+ProfIrq_t *pxIrq = &xIrqs[ ulInterruptID ];
+
+	pxIrq->ullCount++;
+	pxIrq->ullTime += ullTime;
+	if( ullTime > pxIrq->ulMaxTime )
+	{
+		pxIrq->ulMaxTime = ( ullTime > UINT32_MAX ) ? UINT32_MAX : ( uint32_t ) ullTime;
+	}
+	ullIsrCount++;
+	if( ullPortInterruptNesting == 1U )
+	{
+		ullIsrTime += ullTime;
+	}
+	prvRestoreIrq( ullDaif );
+}
+/*-----------------------------------------------------------*/
+
+size_t xPortProfSnapshot( void *pvBuffer, size_t xLength, BaseType_t xResetMax )
+{
+/* Static: too large for most task stacks. */
+static TaskStatus_t xStatus[ portPROF_MAX_TASKS ];
+PortProfHeader_t *pxHeader = ( PortProfHeader_t * ) pvBuffer;
+PortProfTask_t *pxTask;
+PortProfIrq_t *pxIrq;
+configRUN_TIME_COUNTER_TYPE ullTotalRunTime;
+UBaseType_t uxTasks, uxIrqs = 0, x;
+size_t xUsed;
+uint64_t ullDaif;
+
+	/* Returns 0 if there are more tasks than portPROF_MAX_TASKS. */
+	uxTasks = uxTaskGetSystemState( xStatus, portPROF_MAX_TASKS, &ullTotalRunTime );
+	( void ) ullTotalRunTime;
+	xUsed = sizeof( PortProfHeader_t ) + ( uxTasks * sizeof( PortProfTask_t ) );
+	if( xUsed > xLength )
+	{
+		return 0;
+	}
+
+	pxTask = ( PortProfTask_t * ) ( pxHeader + 1 );
+	for( x = 0; x < uxTasks; x++, pxTask++ )
+	{
+		UBaseType_t uxSlot = xStatus[ x ].xTaskNumber;
+		ProfTaskSlot_t *pxSlot = &xTaskSlots[ ( uxSlot < portPROF_MAX_TASKS ) ? uxSlot : 0U ];
+
+		memset( pxTask, 0, sizeof( *pxTask ) );
+		strncpy( pxTask->cName, xStatus[ x ].pcTaskName, portPROF_NAME_LEN - 1U );
+		pxTask->ulTaskNumber = ( uint32_t ) uxSlot;
+		pxTask->ulPriority = ( uint32_t ) xStatus[ x ].uxCurrentPriority;
+		pxTask->ulState = ( uint32_t ) xStatus[ x ].eCurrentState;
+		pxTask->ulStackHighWater = ( uint32_t ) xStatus[ x ].usStackHighWaterMark;
+		pxTask->ullRunTime = xStatus[ x ].ulRunTimeCounter;
+
+		taskENTER_CRITICAL();
+		pxTask->ullSwitchesIn = pxSlot->ullSwitchesIn;
+		pxTask->ullReadyCount = pxSlot->ullReadyCount;
+		pxTask->ullReadyLatencyTotal = pxSlot->ullReadyLatencyTotal;
+		pxTask->ullReadyLatencyMax = pxSlot->ullReadyLatencyMax;
+		if( xResetMax != pdFALSE )
+		{
+			pxSlot->ullReadyLatencyMax = 0U;
+		}
+		taskEXIT_CRITICAL();
+	}
+
+	pxIrq = ( PortProfIrq_t * ) pxTask;
+	for( x = 0; x < portPROF_MAX_IRQS; x++ )
+	{
+		if( xIrqs[ x ].ullCount == 0U )
+		{
+			continue;
+		}
+		if( ( xUsed + sizeof( PortProfIrq_t ) ) > xLength )
+		{
+			break;
+		}
+		ullDaif = prvMaskIrq();
+		pxIrq->ulIrqId = ( uint32_t ) x;
+		pxIrq->ulMaxTime = xIrqs[ x ].ulMaxTime;
+		pxIrq->ullCount = xIrqs[ x ].ullCount;
+		pxIrq->ullTime = xIrqs[ x ].ullTime;
+		if( xResetMax != pdFALSE )
+		{
+			xIrqs[ x ].ulMaxTime = 0U;
+		}
+		prvRestoreIrq( ullDaif );
+		pxIrq++;
+		uxIrqs++;
+		xUsed += sizeof( PortProfIrq_t );
+	}
+
+	memset( pxHeader, 0, sizeof( *pxHeader ) );
+	pxHeader->ulMagic = portPROF_MAGIC;
+	pxHeader->usVersion = portPROF_VERSION;
+	pxHeader->usHeaderSize = sizeof( PortProfHeader_t );
+	pxHeader->usTaskRecordSize = sizeof( PortProfTask_t );
+	pxHeader->usIrqRecordSize = sizeof( PortProfIrq_t );
+	pxHeader->usTaskCount = ( uint16_t ) uxTasks;
+	pxHeader->usIrqCount = ( uint16_t ) uxIrqs;
+	pxHeader->ulSequence = ++ulSequence;
+	pxHeader->ullCounterHz = ullCounterHz;
+
+	ullDaif = prvMaskIrq();
+	pxHeader->ullTimestamp = ullPortProfNow();
+	pxHeader->ullIsrTime = ullIsrTime;
+	pxHeader->ullIsrCount = ullIsrCount;
+	pxHeader->ullSwitchCount = ullSwitchCount;
+	prvRestoreIrq( ullDaif );
+
+	return xUsed;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configGENERATE_RUN_TIME_STATS */
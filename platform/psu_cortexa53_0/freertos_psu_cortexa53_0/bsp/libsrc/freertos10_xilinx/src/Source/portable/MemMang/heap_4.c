@@ -47,6 +47,17 @@
 
 #undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
 
+#if ( configUSE_HEAP_POOLS == 1 )
+
+/* heap_pool.c provides the allocation entry points and uses this heap for the
+ * pool region and for the requests the pools do not serve. */
+    #include "heap_pool.h"
+
+    #define pvPortMalloc    pvHeap4Malloc
+    #define pvPortCalloc    pvHeap4Calloc
+    #define vPortFree       vHeap4Free
+#endif
+
 #if ( configSUPPORT_DYNAMIC_ALLOCATION == 0 )
     #error This file must not be used if configSUPPORT_DYNAMIC_ALLOCATION is 0
 #endif
@@ -0,0 +1,415 @@
+/*
+ * FreeRTOS Kernel V10.6.1
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * Copyright (c) 2022 - 2023 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Fixed block pools in front of heap_4.c, see heap_pool.h.  Built together
+ * with heap_4.c, which renames its own pvPortMalloc(), pvPortCalloc() and
+ * vPortFree() when configUSE_HEAP_POOLS is 1.
+ *
+ * Each size class is an array of equal blocks.  A free block holds the number
+ * of the next free block in its first word.  The head of the free list packs
+ * the number of the first free block (block index + 1, 0 when the list is
+ * empty) in its low 32 bits and a tag in its high 32 bits.  The tag changes on
+ * every update, so a compare and swap cannot succeed against a head that was
+ * popped and pushed back in between (ABA).  Allocating and freeing a block
+ * never walks a list and never suspends the scheduler.
+ */
+#include <string.h>
+
+/* Defining MPU_WRAPPERS_INCLUDED_FROM_API_FILE prevents task.h from redefining
+ * all the API functions to use the MPU wrappers.  That should only be done when
+ * task.h is included from an application file. */
+#define MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "heap_pool.h"
+
+#undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#if ( configUSE_HEAP_POOLS == 1 )
+
+#if ( configSUPPORT_DYNAMIC_ALLOCATION == 0 )
+    #error This file must not be used if configSUPPORT_DYNAMIC_ALLOCATION is 0
+#endif
+
+#ifndef configHEAP_CLEAR_MEMORY_ON_FREE
+    #define configHEAP_CLEAR_MEMORY_ON_FREE    0
+#endif
+
+/* Max value that fits in a size_t type. */
+#define heapSIZE_MAX                          ( ~( ( size_t ) 0 ) )
+
+/* Check if multiplying a and b will result in overflow. */
+#define heapMULTIPLY_WILL_OVERFLOW( a, b )    ( ( ( a ) > 0 ) && ( ( b ) > ( heapSIZE_MAX / ( a ) ) ) )
+
+#define heapPOOL_UNINITIALISED                ( ( UBaseType_t ) 0 )
+#define heapPOOL_READY                        ( ( UBaseType_t ) 1 )
+#define heapPOOL_UNAVAILABLE                  ( ( UBaseType_t ) 2 )
+
+#define heapPOOL_INDEX_MASK                   ( ( uint64_t ) 0xFFFFFFFFUL )
+#define heapPOOL_TAG_ONE                      ( ( uint64_t ) 1 << 32 )
+
+#define heapPOOL_CLASSES                      ( ( UBaseType_t ) ( sizeof( usPoolBlocks ) / sizeof( usPoolBlocks[ 0 ] ) ) )
+#define heapPOOL_BLOCK_SIZE( uxClass )        ( heapPOOL_MIN_BLOCK_SIZE << ( uxClass ) )
+#define heapPOOL_MAX_BLOCK_SIZE               heapPOOL_BLOCK_SIZE( heapPOOL_CLASSES - 1U )
+
+#define heapATOMIC_ADD( pxCounter, xValue )    ( void ) __atomic_add_fetch( ( pxCounter ), ( xValue ), __ATOMIC_RELAXED )
+#define heapATOMIC_READ( pxCounter )           __atomic_load_n( ( pxCounter ), __ATOMIC_RELAXED )
+
+/*-----------------------------------------------------------*/
+
+typedef struct A_POOL_CLASS
+{
+    uint8_t * pucBase;           /**< First block of the class. */
+    uint64_t ullFreeHead;        /**< Tag and first free block, see the top of the file. */
+    size_t xBlocksInUse;
+    size_t xMaxBlocksInUse;
+    size_t xFrees;
+    size_t xSpills;
+    uint64_t ullRequestedBytes;
+} PoolClass_t;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Called the first time pvPortMalloc() is called to take the pool region from
+ * heap_4 and thread the free lists through it.
+ */
+static void prvPoolInit( void ) PRIVILEGED_FUNCTION;
+
+/*-----------------------------------------------------------*/
+
+/* Number of blocks in each class, smallest class first. */
+static const uint16_t usPoolBlocks[] = configHEAP_POOL_BLOCKS;
+
+PRIVILEGED_DATA static PoolClass_t xPools[ sizeof( usPoolBlocks ) / sizeof( usPoolBlocks[ 0 ] ) ];
+
+/* The pool region, so vPortFree() can tell pool blocks from heap_4 blocks. */
+PRIVILEGED_DATA static uintptr_t uxPoolStart = 0U;
+PRIVILEGED_DATA static uintptr_t uxPoolEnd = 0U;
+PRIVILEGED_DATA static size_t xPoolBytes = 0U;
+PRIVILEGED_DATA static UBaseType_t uxPoolState = heapPOOL_UNINITIALISED;
+
+PRIVILEGED_DATA static size_t xLargeAllocations = 0U;
+PRIVILEGED_DATA static size_t xFallbackAllocations = 0U;
+
+/*-----------------------------------------------------------*/
+
+/* Smallest class whose blocks hold xWantedSize bytes, xWantedSize > 0. */
+static inline UBaseType_t prvPoolClass( size_t xWantedSize )
+{
+    UBaseType_t uxClass = 0U;
+
+    if( xWantedSize > heapPOOL_MIN_BLOCK_SIZE )
+    {
+        uxClass = ( UBaseType_t ) ( ( sizeof( unsigned long ) * 8U ) - ( size_t ) __builtin_clzl( ( unsigned long ) ( xWantedSize - 1U ) ) );
+        uxClass -= heapPOOL_MIN_BLOCK_SHIFT;
+    }
+
+    return uxClass;
+}
+/*-----------------------------------------------------------*/
+
+static void * prvPoolPop( PoolClass_t * pxPool,
+                          size_t xBlockSize )
+{
+    uint64_t ullHead = __atomic_load_n( &( pxPool->ullFreeHead ), __ATOMIC_ACQUIRE );
+    uint64_t ullNewHead;
+    uint32_t ulFirst;
+    uint8_t * pucBlock;
+
+    do
+    {
+        ulFirst = ( uint32_t ) ( ullHead & heapPOOL_INDEX_MASK );
+
+        if( ulFirst == 0U )
+        {
+            return NULL;
+        }
+
+        pucBlock = pxPool->pucBase + ( ( size_t ) ( ulFirst - 1U ) * xBlockSize );
+
+        /* If another task takes this block first, the link read here may
+         * already be overwritten, but the tag has then changed and the compare
+         * and swap fails. */
+        ullNewHead = ( ( ullHead & ~heapPOOL_INDEX_MASK ) + heapPOOL_TAG_ONE ) |
+                     __atomic_load_n( ( uint32_t * ) pucBlock, __ATOMIC_RELAXED );
+    } while( __atomic_compare_exchange_n( &( pxPool->ullFreeHead ), &ullHead, ullNewHead,
+                                          pdTRUE, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ) == 0 );
+
+    return pucBlock;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPoolPush( PoolClass_t * pxPool,
+                         uint8_t * pucBlock,
+                         uint32_t ulIndex )
+{
+    uint64_t ullHead = __atomic_load_n( &( pxPool->ullFreeHead ), __ATOMIC_RELAXED );
+    uint64_t ullNewHead;
+
+    do
+    {
+        __atomic_store_n( ( uint32_t * ) pucBlock, ( uint32_t ) ( ullHead & heapPOOL_INDEX_MASK ), __ATOMIC_RELAXED );
+        ullNewHead = ( ( ullHead & ~heapPOOL_INDEX_MASK ) + heapPOOL_TAG_ONE ) | ( uint64_t ) ( ulIndex + 1U );
+    } while( __atomic_compare_exchange_n( &( pxPool->ullFreeHead ), &ullHead, ullNewHead,
+                                          pdTRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED ) == 0 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvPoolCountAllocation( PoolClass_t * pxPool,
+                                    size_t xWantedSize )
+{
+    size_t xInUse = __atomic_add_fetch( &( pxPool->xBlocksInUse ), 1U, __ATOMIC_RELAXED );
+    size_t xMax = heapATOMIC_READ( &( pxPool->xMaxBlocksInUse ) );
+
+    while( ( xInUse > xMax ) &&
+           ( __atomic_compare_exchange_n( &( pxPool->xMaxBlocksInUse ), &xMax, xInUse,
+                                          pdTRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) == 0 ) )
+    {
+        /* xMax was reloaded by the failed compare and swap. */
+    }
+
+    heapATOMIC_ADD( &( pxPool->ullRequestedBytes ), ( uint64_t ) xWantedSize );
+}
+/*-----------------------------------------------------------*/
+
+void * pvPortMalloc( size_t xWantedSize )
+{
+    void * pvReturn = NULL;
+    UBaseType_t uxClass;
+    UBaseType_t uxServed;
+
+    if( __atomic_load_n( &uxPoolState, __ATOMIC_ACQUIRE ) == heapPOOL_UNINITIALISED )
+    {
+        prvPoolInit();
+    }
+
+    if( ( xWantedSize > 0U ) && ( xWantedSize <= heapPOOL_MAX_BLOCK_SIZE ) )
+    {
+        if( __atomic_load_n( &uxPoolState, __ATOMIC_ACQUIRE ) == heapPOOL_READY )
+        {
+            /* An empty class spills into the next larger one, so the search is
+             * bounded by the number of classes. */
+            uxClass = prvPoolClass( xWantedSize );
+
+            for( uxServed = uxClass; uxServed < heapPOOL_CLASSES; uxServed++ )
+            {
+                pvReturn = prvPoolPop( &( xPools[ uxServed ] ), heapPOOL_BLOCK_SIZE( uxServed ) );
+
+                if( pvReturn != NULL )
+                {
+                    break;
+                }
+            }
+
+            if( pvReturn != NULL )
+            {
+                if( uxServed != uxClass )
+                {
+                    heapATOMIC_ADD( &( xPools[ uxClass ].xSpills ), 1U );
+                }
+
+                prvPoolCountAllocation( &( xPools[ uxServed ] ), xWantedSize );
+                traceMALLOC( pvReturn, xWantedSize );
+            }
+        }
+
+        if( pvReturn == NULL )
+        {
+            heapATOMIC_ADD( &xFallbackAllocations, 1U );
+            pvReturn = pvHeap4Malloc( xWantedSize );
+        }
+    }
+    else
+    {
+        if( xWantedSize > 0U )
+        {
+            heapATOMIC_ADD( &xLargeAllocations, 1U );
+        }
+
+        pvReturn = pvHeap4Malloc( xWantedSize );
+    }
+
+    return pvReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vPortFree( void * pv )
+{
+    uintptr_t uxAddress = ( uintptr_t ) pv;
+    UBaseType_t uxClass;
+    size_t xOffset;
+
+    if( ( uxAddress >= uxPoolStart ) && ( uxAddress < uxPoolEnd ) )
+    {
+        /* Classes are laid out smallest first. */
+        uxClass = heapPOOL_CLASSES - 1U;
+
+        while( uxAddress < ( uintptr_t ) xPools[ uxClass ].pucBase )
+        {
+            uxClass--;
+        }
+
+        xOffset = ( size_t ) ( uxAddress - ( uintptr_t ) xPools[ uxClass ].pucBase );
+        configASSERT( ( xOffset & ( heapPOOL_BLOCK_SIZE( uxClass ) - 1U ) ) == 0U );
+
+        #if ( configHEAP_CLEAR_MEMORY_ON_FREE == 1 )
+        {
+            ( void ) memset( pv, 0, heapPOOL_BLOCK_SIZE( uxClass ) );
+        }
+        #endif
+
+        traceFREE( pv, heapPOOL_BLOCK_SIZE( uxClass ) );
+        ( void ) __atomic_sub_fetch( &( xPools[ uxClass ].xBlocksInUse ), 1U, __ATOMIC_RELAXED );
+        heapATOMIC_ADD( &( xPools[ uxClass ].xFrees ), 1U );
+        prvPoolPush( &( xPools[ uxClass ] ), ( uint8_t * ) pv,
+                     ( uint32_t ) ( xOffset >> ( uxClass + heapPOOL_MIN_BLOCK_SHIFT ) ) );
+    }
+    else
+    {
+        vHeap4Free( pv );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void * pvPortCalloc( size_t xNum,
+                     size_t xSize )
+{
+    void * pv = NULL;
+
+    if( heapMULTIPLY_WILL_OVERFLOW( xNum, xSize ) == 0 )
+    {
+        pv = pvPortMalloc( xNum * xSize );
+
+        if( pv != NULL )
+        {
+            ( void ) memset( pv, 0, xNum * xSize );
+        }
+    }
+
+    return pv;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPoolInit( void ) /* PRIVILEGED_FUNCTION */
+{
+    uint8_t * pucBlock;
+    size_t xBytes = 0U;
+    size_t xBlockSize;
+    UBaseType_t uxClass;
+    uint32_t ulBlock;
+
+    configASSERT( heapPOOL_CLASSES <= heapPOOL_MAX_CLASSES );
+
+    vTaskSuspendAll();
+    {
+        /* Another task may have got here first. */
+        if( uxPoolState == heapPOOL_UNINITIALISED )
+        {
+            for( uxClass = 0; uxClass < heapPOOL_CLASSES; uxClass++ )
+            {
+                xBytes += heapPOOL_BLOCK_SIZE( uxClass ) * usPoolBlocks[ uxClass ];
+            }
+
+            pucBlock = ( uint8_t * ) pvHeap4Malloc( xBytes );
+
+            /* configHEAP_POOL_BLOCKS does not fit in configTOTAL_HEAP_SIZE.
+             * Without the assert every request goes to heap_4. */
+            configASSERT( pucBlock != NULL );
+
+            if( pucBlock != NULL )
+            {
+                uxPoolStart = ( uintptr_t ) pucBlock;
+
+                for( uxClass = 0; uxClass < heapPOOL_CLASSES; uxClass++ )
+                {
+                    xBlockSize = heapPOOL_BLOCK_SIZE( uxClass );
+                    xPools[ uxClass ].pucBase = pucBlock;
+
+                    /* Free list in address order: block n links to n + 1. */
+                    for( ulBlock = 0; ulBlock < usPoolBlocks[ uxClass ]; ulBlock++ )
+                    {
+                        *( ( uint32_t * ) pucBlock ) = ( ( ulBlock + 1U ) < usPoolBlocks[ uxClass ] ) ? ( ulBlock + 2U ) : 0U;
+                        pucBlock += xBlockSize;
+                    }
+
+                    xPools[ uxClass ].ullFreeHead = ( usPoolBlocks[ uxClass ] > 0U ) ? 1U : 0U;
+                }
+
+                uxPoolEnd = ( uintptr_t ) pucBlock;
+                xPoolBytes = xBytes;
+                __atomic_store_n( &uxPoolState, heapPOOL_READY, __ATOMIC_RELEASE );
+            }
+            else
+            {
+                uxPoolState = heapPOOL_UNAVAILABLE;
+            }
+        }
+    }
+    ( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+void vPortGetHeapPoolStats( HeapPoolStats_t * pxStats )
+{
+    HeapPoolClassStats_t * pxClass;
+    uint64_t ullGranted = 0U;
+    uint64_t ullRequested = 0U;
+    UBaseType_t uxClass;
+
+    ( void ) memset( pxStats, 0, sizeof( *pxStats ) );
+
+    if( __atomic_load_n( &uxPoolState, __ATOMIC_ACQUIRE ) == heapPOOL_READY )
+    {
+        pxStats->uxClasses = heapPOOL_CLASSES;
+        pxStats->xPoolBytes = xPoolBytes;
+
+        for( uxClass = 0; uxClass < heapPOOL_CLASSES; uxClass++ )
+        {
+            pxClass = &( pxStats->xClass[ uxClass ] );
+            pxClass->xBlockSize = heapPOOL_BLOCK_SIZE( uxClass );
+            pxClass->xBlocks = usPoolBlocks[ uxClass ];
+            /* Allocations are not counted separately: every block handed out
+             * is either still in use or has been freed. */
+            pxClass->xFrees = heapATOMIC_READ( &( xPools[ uxClass ].xFrees ) );
+            pxClass->xBlocksInUse = heapATOMIC_READ( &( xPools[ uxClass ].xBlocksInUse ) );
+            pxClass->xMaxBlocksInUse = heapATOMIC_READ( &( xPools[ uxClass ].xMaxBlocksInUse ) );
+            pxClass->xAllocations = pxClass->xFrees + pxClass->xBlocksInUse;
+            pxClass->xSpills = heapATOMIC_READ( &( xPools[ uxClass ].xSpills ) );
+            pxClass->ullRequestedBytes = heapATOMIC_READ( &( xPools[ uxClass ].ullRequestedBytes ) );
+
+            ullGranted += ( uint64_t ) pxClass->xAllocations * pxClass->xBlockSize;
+            ullRequested += pxClass->ullRequestedBytes;
+        }
+    }
+
+    pxStats->xLargeAllocations = heapATOMIC_READ( &xLargeAllocations );
+    pxStats->xFallbackAllocations = heapATOMIC_READ( &xFallbackAllocations );
+
+    if( ( ullGranted > 0U ) && ( ullGranted >= ullRequested ) )
+    {
+        pxStats->ulInternalFragmentation = ( uint32_t ) ( ( ( ullGranted - ullRequested ) * 1000U ) / ullGranted );
+    }
+
+    vPortGetHeapStats( &( pxStats->xHeap4 ) );
+
+    if( pxStats->xHeap4.xAvailableHeapSpaceInBytes > 0U )
+    {
+        pxStats->ulExternalFragmentation = ( uint32_t ) ( 1000U - ( ( ( uint64_t ) pxStats->xHeap4.xSizeOfLargestFreeBlockInBytes * 1000U ) /
+                                                                    pxStats->xHeap4.xAvailableHeapSpaceInBytes ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_HEAP_POOLS */
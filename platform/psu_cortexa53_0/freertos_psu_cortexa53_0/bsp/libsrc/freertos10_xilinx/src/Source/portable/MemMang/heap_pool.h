@@ -0,0 +1,83 @@
+/*
+ * FreeRTOS Kernel V10.6.1
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ * Copyright (c) 2022 - 2023 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef HEAP_POOL_H
+#define HEAP_POOL_H
+
+/*
+ * Fixed block pools in front of heap_4, built when configUSE_HEAP_POOLS is 1.
+ *
+ * Small requests are served from per size class pools of power of two
+ * blocks: heapPOOL_MIN_BLOCK_SIZE bytes for the first class, doubling for
+ * each class after it.
+ * Allocating and freeing a pool block is O(1): a compare and swap on the
+ * class's free list, without suspending the scheduler. A request whose class
+ * is empty is served by the next larger class that is not, and only then by
+ * heap_4. Larger requests (task stacks, long queues) go straight to heap_4.
+ *
+ * The pools are carved out of the heap_4 heap on the first allocation, so
+ * configTOTAL_HEAP_SIZE remains the whole RAM budget and xPortGetFreeHeapSize()
+ * reports the heap_4 free space left beside them. configHEAP_POOL_BLOCKS lists
+ * the number of blocks in each class, smallest class first.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+
+#ifndef configHEAP_POOL_BLOCKS
+    /* 32, 64, 128, 256 and 512 byte blocks: 20 KiB. */
+    #define configHEAP_POOL_BLOCKS    { 64, 64, 32, 24, 8 }
+#endif
+
+#define heapPOOL_MIN_BLOCK_SHIFT    5U
+#define heapPOOL_MIN_BLOCK_SIZE     ( ( size_t ) 1 << heapPOOL_MIN_BLOCK_SHIFT )
+#define heapPOOL_MAX_CLASSES        8U
+
+typedef struct xHEAP_POOL_CLASS_STATS
+{
+    size_t xBlockSize;
+    size_t xBlocks;
+    size_t xBlocksInUse;
+    size_t xMaxBlocksInUse;      /* High-water mark since boot. */
+    size_t xAllocations;         /* Blocks handed out, spills from smaller classes included. */
+    size_t xFrees;
+    size_t xSpills;              /* Requests for this class served by a larger one. */
+    uint64_t ullRequestedBytes;  /* Sum of the sizes asked for by xAllocations. */
+} HeapPoolClassStats_t;
+
+typedef struct xHEAP_POOL_STATS
+{
+    UBaseType_t uxClasses;                                /* 0 before the first allocation, or if the pools did not fit. */
+    size_t xPoolBytes;                                    /* Taken from the heap_4 heap by the pools. */
+    size_t xLargeAllocations;                             /* Larger than any class, served by heap_4. */
+    size_t xFallbackAllocations;                          /* Pool sized, served by heap_4 because the pools were empty. */
+    uint32_t ulInternalFragmentation;                     /* Per mille of handed out pool bytes that were not asked for. */
+    uint32_t ulExternalFragmentation;                     /* Per mille of heap_4 free space outside its largest free block. */
+    HeapPoolClassStats_t xClass[ heapPOOL_MAX_CLASSES ];
+    HeapStats_t xHeap4;                                   /* heap_4 statistics, pool region counted as allocated. */
+} HeapPoolStats_t;
+
+/*
+ * Fill pxStats. Counters are read one at a time without stopping allocators,
+ * so a snapshot taken while other tasks allocate may be off by the allocations
+ * in flight.
+ */
+void vPortGetHeapPoolStats( HeapPoolStats_t * pxStats );
+
+/* heap_4.c entry points, renamed when the pools own pvPortMalloc(). */
+void * pvHeap4Malloc( size_t xWantedSize ) PRIVILEGED_FUNCTION;
+void * pvHeap4Calloc( size_t xNum,
+                      size_t xSize ) PRIVILEGED_FUNCTION;
+void vHeap4Free( void * pv ) PRIVILEGED_FUNCTION;
+
+#endif /* HEAP_POOL_H */
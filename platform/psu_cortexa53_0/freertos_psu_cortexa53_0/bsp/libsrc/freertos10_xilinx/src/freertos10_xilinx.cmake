@@ -76,6 +76,12 @@ set_property(CACHE freertos_use_task_fpu_support PROPERTY STRINGS 0x0 0x1 0x2)
 set(freertos_generate_runtime_stats 0x0 CACHE STRING "Set to 1 generate \
 runtime stats for tasks.")
 set_property(CACHE freertos_generate_runtime_stats PROPERTY STRINGS 0x0 0x1)
+set(freertos_use_tickless_idle 0x0 CACHE STRING "Set to 1 to stop the tick \
+interrupt while the idle task runs and sleep until the next task is due.")
+set_property(CACHE freertos_use_tickless_idle PROPERTY STRINGS 0x0 0x1)
+set(freertos_use_heap_pools 0x0 CACHE STRING "Set to 1 to serve small \
+allocations from fixed block pools carved out of the heap_4 heap.")
+set_property(CACHE freertos_use_heap_pools PROPERTY STRINGS 0x0 0x1)
 
 #hook function settings
 option(freertos_use_idle_hook "Set to true for the kernel to call \
@@ -161,6 +167,12 @@ if("${freertos_generate_runtime_stats}" EQUAL 1)
         string(CONCAT PRINT_GET_CNTR_LINES "${PRINT_GET_CNTR_LINE1}"
                                            "${PRINT_GET_CNTR_LINE2}"
                                            "${PRINT_GET_CNTR_LINE3}")
+    elseif(("${CMAKE_SYSTEM_PROCESSOR}" STREQUAL "cortexa53") OR
+           ("${CMAKE_SYSTEM_PROCESSOR}" STREQUAL "cortexa72") OR
+           ("${CMAKE_SYSTEM_PROCESSOR}" STREQUAL "cortexa78"))
+        # 64-bit generic counter, see ARM_CA53/port_prof.c
+        set(PRINT_GET_CNTR_LINES "#define configRUN_TIME_COUNTER_TYPE uint64_t\n\
+uint64_t xGET_RUN_TIME_COUNTER_VALUE(void);\n")
     else()
         set(PRINT_GET_CNTR_LINES "uint32_t xGET_RUN_TIME_COUNTER_VALUE(void);\n")
     endif()
@@ -193,7 +205,8 @@ set(configUSE_16_BIT_TICKS 0x0)
 set(configUSE_APPLICATION_TASK_TAG 0x0)
 set(configUSE_CO_ROUTINES 0x0)
 set(configMAX_CO_ROUTINE_PRIORITIES 2)
-set(configUSE_TICKLESS_IDLE 0x0)
+set(configUSE_TICKLESS_IDLE ${freertos_use_tickless_idle})
+set(configUSE_HEAP_POOLS ${freertos_use_heap_pools})
 set(configTASK_RETURN_ADDRESS	NULL)
 set(INCLUDE_vTaskPrioritySet 1)
 set(INCLUDE_uxTaskPriorityGet 1)
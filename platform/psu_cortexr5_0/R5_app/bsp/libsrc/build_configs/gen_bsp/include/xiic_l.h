@@ -57,6 +57,7 @@
 *                     XIic_DynRecv, XIic_DynSend and XIic_DynInit APIs.
 * 3.3   als  06/27/16 Added Low-level XIic_CheckIsBusBusy API.
 * 3.3   als  06/27/16 Added low-level XIic_WaitBusFree API.
+* 3.5a  sw   10/17/26 Added configurable bus-free wait and bus recovery APIs.
 * </pre>
 *
 *****************************************************************************/
@@ -226,6 +227,46 @@ extern "C" {
 #define XIIC_REPEATED_START	0x01 /**< Donot Send a stop on the IIC bus after
 					* the current data transfer */
 
+/**
+ * The following constants select how XIic_WaitBusFree waits for the bus to
+ * go idle (see XIic_SetBusFreeWait).
+ */
+#define XIIC_BUS_WAIT_SLEEP	0 /**< Poll with usleep(100) between checks */
+#define XIIC_BUS_WAIT_SPIN	1 /**< Spin on BB against a timer deadline */
+#define XIIC_BUS_WAIT_INTR	2 /**< Arm the BNB interrupt and call the wait
+				    * hook until the bus is free */
+
+#ifndef XIIC_BUS_WAIT_DEFAULT_MODE
+#define XIIC_BUS_WAIT_DEFAULT_MODE	XIIC_BUS_WAIT_SPIN
+#endif
+#ifndef XIIC_BUS_WAIT_DEFAULT_US
+#define XIIC_BUS_WAIT_DEFAULT_US	10000U /**< Bus-free timeout, usec */
+#endif
+
+#define XIIC_BUS_RECOVERY_CLOCKS	9  /**< SCL pulses to free a stuck slave */
+#define XIIC_BUS_RECOVERY_HALF_US	5  /**< SCL half period, ~100 kHz */
+
+/**************************** Type Definitions *******************************/
+
+/**
+ * Called repeatedly by XIic_WaitBusFree in XIIC_BUS_WAIT_INTR mode while the
+ * bus is busy, with the BNB interrupt enabled (e.g. to execute WFI or to
+ * block on a semaphore given from the IIC interrupt handler).
+ */
+typedef void (*XIic_BusWaitHook) (UINTPTR BaseAddress, void *CallBackRef);
+
+/**
+ * Board hooks used by XIic_BusRecover to bit-bang SCL/SDA (for example via
+ * GPIO pins that are muxed onto the IIC lines during recovery). Level 1
+ * releases the line, 0 drives it low.
+ */
+typedef struct {
+	void (*SetScl) (void *CallBackRef, u8 Level);
+	void (*SetSda) (void *CallBackRef, u8 Level);
+	u8 (*GetSda) (void *CallBackRef);
+	void *CallBackRef;
+} XIic_BusRecoveryOps;
+
 /***************** Macros (Inline Functions) Definitions *********************/
 
 #define XIic_In32 	Xil_In32
@@ -563,6 +604,16 @@ u32 XIic_CheckIsBusBusy(UINTPTR BaseAddress);
 
 u32 XIic_WaitBusFree(UINTPTR BaseAddress);
 
+void XIic_SetBusFreeWait(u32 Mode, u32 TimeoutUs);
+
+void XIic_SetBusWaitHook(XIic_BusWaitHook Hook, void *CallBackRef);
+
+void XIic_SetBusRecovery(const XIic_BusRecoveryOps *OpsPtr, u32 AutoRecover);
+
+int XIic_BusRecover(UINTPTR BaseAddress);
+
+u32 XIic_GetBusRecoveryCount(void);
+
 #ifdef __cplusplus
 }
 #endif
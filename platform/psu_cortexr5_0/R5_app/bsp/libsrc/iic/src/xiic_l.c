@@ -66,6 +66,8 @@
 * 3.3   als  06/27/16 Added low-level XIic_WaitBusFree API.
 * 3.4	nk   16/11/16 Reduced sleeping time in Bus-busy check.
 * 3.5   sd   08/29/18 Fix bus busy check for the NACK case.
+* 3.5a  sw   10/17/26 XIic_WaitBusFree: configurable spin/interrupt/sleep
+*		      wait with a timer deadline, optional bus recovery.
 * </pre>
 *
 ****************************************************************************/
@@ -73,6 +75,7 @@
 /***************************** Include Files *******************************/
 
 #include <sleep.h>
+#include "xiltimer.h"
 #include "xil_types.h"
 #include "xil_assert.h"
 #include "xiic_l.h"
@@ -94,8 +97,18 @@ static unsigned DynRecvData(UINTPTR BaseAddress, u8 *BufferPtr, u8 ByteCount);
 static unsigned DynSendData(UINTPTR BaseAddress, u8 *BufferPtr,
 				u8 ByteCount, u8 Option);
 
+static u32 BusWait(UINTPTR BaseAddress);
+
 /************************** Variable Definitions **************************/
 
+static u32 BusWaitMode = XIIC_BUS_WAIT_DEFAULT_MODE;
+static u32 BusWaitUs = XIIC_BUS_WAIT_DEFAULT_US;
+static XIic_BusWaitHook BusWaitHook;
+static void *BusWaitHookRef;
+static const XIic_BusRecoveryOps *BusRecoveryOps;
+static u32 BusAutoRecover;
+static u32 BusRecoveryCount;
+
 /****************************************************************************/
 /**
 * Receive data as a master on the IIC bus.  This function receives the data
@@ -1050,6 +1063,10 @@ u32 XIic_CheckIsBusBusy(UINTPTR BaseAddress)
 /**
 * This function will wait until the I2C bus is free or timeout.
 *
+* The wait strategy and timeout are set with XIic_SetBusFreeWait. If the bus
+* is still busy at the deadline and automatic recovery is enabled (see
+* XIic_SetBusRecovery), XIic_BusRecover is tried once.
+*
 * @param	BaseAddress contains the base address of the I2C device.
 *
 * @return
@@ -1061,15 +1078,244 @@ u32 XIic_CheckIsBusBusy(UINTPTR BaseAddress)
 *******************************************************************************/
 u32 XIic_WaitBusFree(UINTPTR BaseAddress)
 {
-	u32 BusyCount = 0;
+	/*
+	 * Fast path: back-to-back transfers normally find the bus idle.
+	 */
+	if (!XIic_CheckIsBusBusy(BaseAddress)) {
+		return XST_SUCCESS;
+	}
+
+	if (BusWait(BaseAddress) == XST_SUCCESS) {
+		return XST_SUCCESS;
+	}
+
+	if (BusAutoRecover &&
+	    (XIic_BusRecover(BaseAddress) == XST_SUCCESS)) {
+		return XST_SUCCESS;
+	}
+
+	return XST_FAILURE;
+}
+
+/******************************************************************************/
+/**
+* Wait for BB to clear using the configured strategy. Deadlines are taken on
+* the xiltimer counter; differences are computed modulo 2^32 so a counter
+* wrap during the wait is harmless.
+*
+* @param	BaseAddress contains the base address of the I2C device.
+*
+* @return	XST_SUCCESS if the bus went idle, XST_FAILURE on timeout.
+*
+* @note		None.
+*
+*******************************************************************************/
+static u32 BusWait(UINTPTR BaseAddress)
+{
+	XTime Now;
+	u32 Start;
+	u32 Timeout;
+	u32 Ier;
+	u32 Status = XST_FAILURE;
+
+	if (BusWaitMode == XIIC_BUS_WAIT_SLEEP) {
+		u32 BusyCount = 0;
+
+		while (XIic_CheckIsBusBusy(BaseAddress)) {
+			if (BusyCount++ > (BusWaitUs / 100U)) {
+				return XST_FAILURE;
+			}
+			usleep(100);
+		}
+		return XST_SUCCESS;
+	}
+
+	Timeout = BusWaitUs * (u32)(COUNTS_PER_SECOND / 1000000U);
+	XTime_GetTime(&Now);
+	Start = (u32)Now;
+
+	if (BusWaitMode == XIIC_BUS_WAIT_INTR) {
+		/*
+		 * BNB is level sensitive: clear the latched bit and let it
+		 * assert again once the bus actually goes idle.
+		 */
+		Ier = XIic_ReadIier(BaseAddress);
+		XIic_WriteIisr(BaseAddress,
+			       XIic_ReadIisr(BaseAddress) & XIIC_INTR_BNB_MASK);
+		XIic_WriteIier(BaseAddress, Ier | XIIC_INTR_BNB_MASK);
+	}
+
+	for (;;) {
+		if (!XIic_CheckIsBusBusy(BaseAddress)) {
+			Status = XST_SUCCESS;
+			break;
+		}
+		XTime_GetTime(&Now);
+		if (((u32)Now - Start) > Timeout) {
+			break;
+		}
+		if ((BusWaitMode == XIIC_BUS_WAIT_INTR) &&
+		    (BusWaitHook != NULL)) {
+			BusWaitHook(BaseAddress, BusWaitHookRef);
+		}
+	}
+
+	if (BusWaitMode == XIIC_BUS_WAIT_INTR) {
+		XIic_WriteIier(BaseAddress, Ier);
+		XIic_WriteIisr(BaseAddress,
+			       XIic_ReadIisr(BaseAddress) & XIIC_INTR_BNB_MASK);
+	}
+
+	return Status;
+}
+
+/******************************************************************************/
+/**
+* Select how XIic_WaitBusFree waits for the bus. The setting is shared by all
+* IIC instances using the low-level API.
+*
+* @param	Mode is XIIC_BUS_WAIT_SLEEP, XIIC_BUS_WAIT_SPIN or
+*		XIIC_BUS_WAIT_INTR.
+* @param	TimeoutUs is the maximum time to wait, in microseconds.
+*
+* @return	None.
+*
+* @note		XIIC_BUS_WAIT_INTR without a hook (XIic_SetBusWaitHook)
+*		behaves like XIIC_BUS_WAIT_SPIN.
+*
+*******************************************************************************/
+void XIic_SetBusFreeWait(u32 Mode, u32 TimeoutUs)
+{
+	Xil_AssertVoid(Mode <= XIIC_BUS_WAIT_INTR);
+	Xil_AssertVoid(TimeoutUs <=
+		       (0xFFFFFFFFU / (u32)(COUNTS_PER_SECOND / 1000000U)));
+
+	BusWaitMode = Mode;
+	BusWaitUs = TimeoutUs;
+}
+
+/******************************************************************************/
+/**
+* Register the function called while waiting in XIIC_BUS_WAIT_INTR mode.
+*
+* @param	Hook is the wait function, or NULL to spin.
+* @param	CallBackRef is passed back to Hook.
+*
+* @return	None.
+*
+* @note		The hook runs with the BNB interrupt enabled in IIER; whoever
+*		services the IIC interrupt must not leave it enabled.
+*
+*******************************************************************************/
+void XIic_SetBusWaitHook(XIic_BusWaitHook Hook, void *CallBackRef)
+{
+	BusWaitHook = Hook;
+	BusWaitHookRef = CallBackRef;
+}
+
+/******************************************************************************/
+/**
+* Configure bus recovery.
+*
+* @param	OpsPtr points to the board SCL/SDA hooks, or NULL if the lines
+*		cannot be driven directly (recovery is then limited to a core
+*		reset). The structure must stay valid.
+* @param	AutoRecover, when non-zero, makes XIic_WaitBusFree call
+*		XIic_BusRecover once on timeout.
+*
+* @return	None.
+*
+* @note		None.
+*
+*******************************************************************************/
+void XIic_SetBusRecovery(const XIic_BusRecoveryOps *OpsPtr, u32 AutoRecover)
+{
+	BusRecoveryOps = OpsPtr;
+	BusAutoRecover = AutoRecover;
+}
+
+/******************************************************************************/
+/**
+* Try to free a stuck bus. A slave holding SDA low (e.g. after a master
+* reset in the middle of a read) is clocked with up to
+* XIIC_BUS_RECOVERY_CLOCKS SCL pulses until it releases SDA, then a STOP is
+* generated. The core is then reset and re-enabled.
+*
+* @param	BaseAddress contains the base address of the I2C device.
+*
+* @return
+*		- XST_SUCCESS if the bus is idle afterwards.
+*		- XST_FAILURE otherwise.
+*
+* @note		The soft reset clears IIER, GIE and the Rx FIFO depth. Users
+*		of the interrupt driver must call XIic_Reset and XIic_Start
+*		when XIic_GetBusRecoveryCount changes.
+*
+*******************************************************************************/
+int XIic_BusRecover(UINTPTR BaseAddress)
+{
+	const XIic_BusRecoveryOps *Ops = BusRecoveryOps;
+	int Index;
+
+	BusRecoveryCount++;
+
+	/*
+	 * Take the core off the bus while the lines are bit-banged.
+	 */
+	XIic_WriteReg(BaseAddress, XIIC_CR_REG_OFFSET, 0);
 
-	while (XIic_CheckIsBusBusy(BaseAddress)) {
-		if (BusyCount++ > 10000) {
-			return XST_FAILURE;
+	if ((Ops != NULL) && (Ops->SetScl != NULL) &&
+	    (Ops->SetSda != NULL) && (Ops->GetSda != NULL)) {
+		Ops->SetSda(Ops->CallBackRef, 1);
+		for (Index = 0; Index < XIIC_BUS_RECOVERY_CLOCKS; Index++) {
+			if (Ops->GetSda(Ops->CallBackRef)) {
+				break;
+			}
+			Ops->SetScl(Ops->CallBackRef, 0);
+			usleep(XIIC_BUS_RECOVERY_HALF_US);
+			Ops->SetScl(Ops->CallBackRef, 1);
+			usleep(XIIC_BUS_RECOVERY_HALF_US);
 		}
-		usleep(100);
+
+		/*
+		 * STOP: SDA low -> high while SCL is high.
+		 */
+		Ops->SetScl(Ops->CallBackRef, 0);
+		Ops->SetSda(Ops->CallBackRef, 0);
+		usleep(XIIC_BUS_RECOVERY_HALF_US);
+		Ops->SetScl(Ops->CallBackRef, 1);
+		usleep(XIIC_BUS_RECOVERY_HALF_US);
+		Ops->SetSda(Ops->CallBackRef, 1);
+		usleep(XIIC_BUS_RECOVERY_HALF_US);
+	}
+
+	/*
+	 * Reset the core so BB reflects the lines again, then enable it.
+	 */
+	XIic_WriteReg(BaseAddress, XIIC_RESETR_OFFSET, XIIC_RESET_MASK);
+	XIic_WriteReg(BaseAddress, XIIC_CR_REG_OFFSET,
+		      XIIC_CR_TX_FIFO_RESET_MASK);
+	XIic_WriteReg(BaseAddress, XIIC_CR_REG_OFFSET,
+		      XIIC_CR_ENABLE_DEVICE_MASK);
+
+	if (XIic_CheckIsBusBusy(BaseAddress)) {
+		return XST_FAILURE;
 	}
 
 	return XST_SUCCESS;
 }
+
+/******************************************************************************/
+/**
+* Number of times XIic_BusRecover has run (explicitly or on timeout).
+*
+* @return	The recovery count.
+*
+* @note		None.
+*
+*******************************************************************************/
+u32 XIic_GetBusRecoveryCount(void)
+{
+	return BusRecoveryCount;
+}
 /** @} */